@@ -0,0 +1,255 @@
+// Measures the cost of tracking modified bytes in ByteBuffer.
+//
+// Usage: ByteBufferBench [file size in MiB] [scattered edits] [contiguous edit in MiB]
+//
+// The scattered run overwrites bytes at random offsets all over the file, the contiguous run
+// overwrites a single range at the start of it. Each run reports the time taken by the edits,
+// the heap they hold on to, the time taken to query the dirty bytes of every line of the edited
+// range the way the renderer does, and the time taken to save. The same edits are also applied
+// to a per-byte hash map, the way ByteBuffer used to track them, for comparison. The scattered
+// edits get saved through UringHandler as well, where io_uring is available.
+//
+// The read runs go through the whole file line by line, once with a call of operator[] per byte and
+// once with read_range() per line, along with dirty_mask() per line, both on the unmodified file and after
+// a byte has been inserted at its start, which moves all the reads onto the pieces.
+#include "ByteBuffer.h"
+#include "PosixFileHandler.h"
+#include "config.h"
+#ifdef HEXIT_HAS_IO_URING
+#include "UringHandler.h"
+#endif
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <malloc.h>
+#include <map>
+#include <random>
+#include <span>
+#include <string>
+#include <type_traits>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+using namespace Hexit;
+namespace
+{
+namespace fs = std::filesystem;
+
+// The byte map takes up about 40 bytes per edit, larger runs are skipped for it.
+constexpr std::uintmax_t BYTE_MAP_LIMIT = 16 * 1024 * 1024;
+
+void create_file(const fs::path& path, std::uintmax_t size)
+{
+    std::mt19937_64           rng(42);
+    std::vector<std::uint8_t> block(1024 * 1024);
+    std::ofstream             file(path, std::ios::binary);
+    for (std::uintmax_t written = 0; written < size; written += block.size())
+    {
+        for (auto& byte : block)
+            byte = static_cast<std::uint8_t>(rng());
+        file.write(reinterpret_cast<const char*>(block.data()),
+                   static_cast<std::streamsize>(std::min<std::uintmax_t>(block.size(), size - written)));
+    }
+}
+
+// Heap in use, in bytes.
+std::uintmax_t heap_in_use()
+{
+    return mallinfo2().uordblks;
+}
+
+double seconds_since(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// The per-byte bookkeeping that ByteBuffer used before overlay pages.
+struct ByteMap
+{
+    void set_byte(std::uintmax_t byte_id, std::uint8_t value)
+    {
+        if (!m_bytes.contains(byte_id))
+            m_chunks[byte_id / CHUNK_SIZE].emplace_back(byte_id % CHUNK_SIZE);
+        m_bytes.insert_or_assign(byte_id, value);
+    }
+
+    std::uint64_t dirty_mask(std::uintmax_t byte_id, std::uintmax_t count) const
+    {
+        std::uint64_t mask = 0;
+        for (std::uintmax_t i = 0; i < count; ++i)
+        {
+            if (m_bytes.contains(byte_id + i))
+                mask |= std::uint64_t { 1 } << i;
+        }
+        return mask;
+    }
+
+    std::unordered_map<std::uintmax_t, std::uint8_t>      m_bytes;
+    std::map<std::uintmax_t, std::vector<std::uintmax_t>> m_chunks;
+};
+
+template <typename Tracker>
+std::uint64_t scan_lines(const Tracker& tracker, std::uintmax_t first, std::uintmax_t last)
+{
+    std::uint64_t dirty = 0;
+    for (std::uintmax_t line = first; line < last; line += BYTES_PER_LINE)
+        dirty += static_cast<std::uint64_t>(__builtin_popcountll(tracker.dirty_mask(line, BYTES_PER_LINE)));
+    return dirty;
+}
+
+void report(const char* name, const char* tracker, std::uintmax_t edits, double edit_s, std::uintmax_t heap, double scan_s, double save_s)
+{
+    std::printf("%-10s %-8s %10ju edits %9.1f ns/edit %10.1f MiB heap %9.1f ms scan",
+                name,
+                tracker,
+                edits,
+                edit_s * 1e9 / static_cast<double>(edits),
+                static_cast<double>(heap) / (1024.0 * 1024.0),
+                scan_s * 1e3);
+    if (save_s >= 0)
+        std::printf(" %9.1f ms save", save_s * 1e3);
+    std::printf("\n");
+}
+
+template <typename Handler = PosixFileHandler>
+void run(const char* name, const char* tracker, const fs::path& path, const std::vector<std::uintmax_t>& offsets, std::uintmax_t first, std::uintmax_t last)
+{
+    {
+        Handler handler;
+        if (!handler.open(path))
+        {
+            std::fprintf(stderr, "Could not open %s\n", path.c_str());
+            return;
+        }
+
+        ByteBuffer           buffer(handler);
+        const std::uintmax_t heap  = heap_in_use();
+        auto                 start = std::chrono::steady_clock::now();
+        for (auto offset : offsets)
+            buffer.set_byte(offset, static_cast<std::uint8_t>(offset));
+        const double         edit_s = seconds_since(start);
+        const std::uintmax_t used   = heap_in_use() - heap;
+
+        start                      = std::chrono::steady_clock::now();
+        const std::uint64_t dirty  = scan_lines(buffer, first, last);
+        const double        scan_s = seconds_since(start);
+
+        start = std::chrono::steady_clock::now();
+        buffer.save();
+        const double save_s = seconds_since(start);
+        report(name, tracker, offsets.size(), edit_s, used, scan_s, save_s);
+        if (!buffer.is_ok() || dirty == 0)
+            std::fprintf(stderr, "%s\n", buffer.error_msg().c_str());
+    }
+
+    if constexpr (!std::is_same_v<Handler, PosixFileHandler>)
+        return;
+    if (offsets.size() > BYTE_MAP_LIMIT)
+    {
+        std::printf("%-10s %-8s skipped, it would not fit in memory\n", name, "byte map");
+        return;
+    }
+
+    {
+        ByteMap              tracker;
+        const std::uintmax_t heap  = heap_in_use();
+        auto                 start = std::chrono::steady_clock::now();
+        for (auto offset : offsets)
+            tracker.set_byte(offset, static_cast<std::uint8_t>(offset));
+        const double         edit_s = seconds_since(start);
+        const std::uintmax_t used   = heap_in_use() - heap;
+
+        start                      = std::chrono::steady_clock::now();
+        const std::uint64_t dirty  = scan_lines(tracker, first, last);
+        const double        scan_s = seconds_since(start);
+        report(name, "byte map", offsets.size(), edit_s, used, scan_s, -1);
+        if (dirty == 0)
+            std::fprintf(stderr, "No dirty bytes found\n");
+    }
+}
+
+void read(const fs::path& path, bool inserted)
+{
+    PosixFileHandler handler;
+    if (!handler.open(path))
+    {
+        std::fprintf(stderr, "Could not open %s\n", path.c_str());
+        return;
+    }
+
+    ByteBuffer buffer(handler);
+    if (inserted)
+        buffer.insert_byte(0, 0xAA);
+    // A first pass gets the file into the page cache, so that both runs read from memory.
+    std::uint64_t checksum = 0;
+    for (std::uintmax_t byte_id = 0; byte_id < buffer.size(); ++byte_id)
+        checksum += buffer[byte_id];
+
+    // The renderer used to read every byte on its own, along with the dirty mask of the line.
+    auto start = std::chrono::steady_clock::now();
+    for (std::uintmax_t byte_id = 0; byte_id < buffer.size(); ++byte_id)
+    {
+        checksum += buffer[byte_id];
+        if (byte_id % BYTES_PER_LINE == 0)
+            checksum += buffer.dirty_mask(byte_id, std::min<std::uintmax_t>(BYTES_PER_LINE, buffer.size() - byte_id));
+    }
+    const double byte_s = seconds_since(start);
+
+    std::uint8_t line[BYTES_PER_LINE];
+    start = std::chrono::steady_clock::now();
+    for (std::uintmax_t byte_id = 0; byte_id < buffer.size(); byte_id += BYTES_PER_LINE)
+    {
+        const std::uintmax_t count = std::min<std::uintmax_t>(BYTES_PER_LINE, buffer.size() - byte_id);
+        buffer.read_range(byte_id, std::span(line, count));
+        checksum += line[0] + buffer.dirty_mask(byte_id, count);
+    }
+    const double range_s = seconds_since(start);
+
+    const double bytes = static_cast<double>(buffer.size());
+    std::printf("read %-8s %9.2f ns/byte byte by byte %9.2f ns/byte by line %9.1f MiB/s by line (%ju)\n",
+                inserted ? "pieces" : "original",
+                byte_s * 1e9 / bytes,
+                range_s * 1e9 / bytes,
+                bytes / range_s / (1024.0 * 1024.0),
+                static_cast<std::uintmax_t>(checksum & 0xF));
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+    const std::uintmax_t size_mib       = argc > 1 ? std::stoull(argv[1]) : 256u;
+    const std::uintmax_t scattered      = argc > 2 ? std::stoull(argv[2]) : 1000000u;
+    const std::uintmax_t contiguous_mib = argc > 3 ? std::stoull(argv[3]) : 100u;
+    const std::uintmax_t size           = size_mib * 1024 * 1024;
+    const fs::path       path           = fs::temp_directory_path() / ("hexit_buffer_bench_" + std::to_string(::getpid()));
+    if (contiguous_mib > size_mib)
+    {
+        std::fprintf(stderr, "The contiguous edit does not fit in the file\n");
+        return 1;
+    }
+
+    create_file(path, size);
+    std::printf("%ju MiB file, %ju byte chunks, dirty bytes scanned line by line\n", size_mib, CHUNK_SIZE);
+
+    std::mt19937_64             rng(7);
+    std::vector<std::uintmax_t> offsets(scattered);
+    for (auto& offset : offsets)
+        offset = rng() % size;
+    run("scattered", "overlay", path, offsets, 0, size);
+#ifdef HEXIT_HAS_IO_URING
+    run<UringHandler>("scattered", "uring", path, offsets, 0, size);
+#endif
+
+    offsets.resize(contiguous_mib * 1024 * 1024);
+    for (std::uintmax_t i = 0; i < offsets.size(); ++i)
+        offsets[i] = i;
+    run("contiguous", "overlay", path, offsets, 0, offsets.size());
+
+    read(path, false);
+    read(path, true);
+    fs::remove(path);
+
+    return 0;
+}
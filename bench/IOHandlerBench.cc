@@ -0,0 +1,194 @@
+// Compares the fstream based FileHandler against the descriptor based PosixFileHandler.
+//
+// Usage: IOHandlerBench [file size in MiB] [chunk size in bytes]
+//
+// Every run reads the whole file in chunks, either sequentially or in a random order,
+// with a cold page cache (the file gets evicted with POSIX_FADV_DONTNEED before the run)
+// or a warm one. The threaded runs split the chunks between several readers that share
+// a single handler through read_at(), which FileHandler has to serialize. The batched runs
+// submit the chunks in batches of URING_QUEUE_DEPTH requests.
+#include "FileHandler.h"
+#include "PosixFileHandler.h"
+#include "config.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <numeric>
+#include <random>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#ifdef HEXIT_HAS_IO_URING
+#include "UringHandler.h"
+#endif
+
+using namespace Hexit;
+namespace
+{
+namespace fs = std::filesystem;
+
+constexpr std::size_t THREADS = 4;
+
+void create_file(const fs::path& path, std::uintmax_t size)
+{
+    std::mt19937_64           rng(42);
+    std::vector<std::uint8_t> block(1024 * 1024);
+    std::ofstream             file(path, std::ios::binary);
+    for (std::uintmax_t written = 0; written < size; written += block.size())
+    {
+        for (auto& byte : block)
+            byte = static_cast<std::uint8_t>(rng());
+        file.write(reinterpret_cast<const char*>(block.data()),
+                   static_cast<std::streamsize>(std::min<std::uintmax_t>(block.size(), size - written)));
+    }
+}
+
+void evict(const fs::path& path)
+{
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return;
+    ::fdatasync(fd);
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    ::close(fd);
+}
+
+// Reads the given chunks with seek() followed by read(), the way ChunkCache used to.
+bool read_sequential_api(IOHandler& handler, const std::vector<std::uintmax_t>& chunks, std::uintmax_t chunk_size)
+{
+    std::vector<std::uint8_t> buffer(chunk_size);
+    for (auto chunk : chunks)
+    {
+        const std::uintmax_t bytes = std::min(chunk_size, handler.size() - chunk * chunk_size);
+        if (!handler.seek(chunk * chunk_size) || !handler.read(buffer.data(), bytes))
+            return false;
+    }
+    return true;
+}
+
+bool read_positional(IOHandler& handler, const std::vector<std::uintmax_t>& chunks, std::uintmax_t chunk_size, std::size_t threads)
+{
+    std::vector<std::thread> workers;
+    std::vector<int>         results(threads, 0);
+    for (std::size_t t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([&, t]()
+                             {
+                                 std::vector<std::uint8_t> buffer(chunk_size);
+                                 for (std::size_t i = t; i < chunks.size(); i += threads)
+                                 {
+                                     const std::uintmax_t bytes = std::min(chunk_size, handler.size() - chunks[i] * chunk_size);
+                                     if (!handler.read_at(chunks[i] * chunk_size, buffer.data(), bytes))
+                                         return;
+                                 }
+                                 results[t] = 1; });
+    }
+    for (auto& worker : workers)
+        worker.join();
+
+    return std::all_of(results.begin(), results.end(), [](int result)
+                       { return result == 1; });
+}
+
+bool read_batched(IOHandler& handler, const std::vector<std::uintmax_t>& chunks, std::uintmax_t chunk_size)
+{
+    std::vector<std::uint8_t>       buffer(URING_QUEUE_DEPTH * chunk_size);
+    std::vector<IOHandler::Request> requests;
+    for (std::size_t first = 0; first < chunks.size(); first += URING_QUEUE_DEPTH)
+    {
+        requests.clear();
+        for (std::size_t i = first; i < std::min<std::size_t>(first + URING_QUEUE_DEPTH, chunks.size()); ++i)
+        {
+            const std::uintmax_t bytes = std::min(chunk_size, handler.size() - chunks[i] * chunk_size);
+            requests.push_back({ chunks[i] * chunk_size, buffer.data() + (i - first) * chunk_size, bytes, false });
+        }
+        if (!handler.submit_batch(requests))
+            return false;
+    }
+    return true;
+}
+
+template <typename Handler>
+void run(const char* name, const fs::path& path, std::uintmax_t chunk_size)
+{
+    Handler handler(true);
+    if (!handler.open(path))
+    {
+        std::fprintf(stderr, "Could not open %s\n", path.c_str());
+        return;
+    }
+
+    const std::uintmax_t        total_chunks = (handler.size() + chunk_size - 1) / chunk_size;
+    std::vector<std::uintmax_t> sequential(total_chunks);
+    std::iota(sequential.begin(), sequential.end(), 0u);
+    std::vector<std::uintmax_t> random = sequential;
+    std::shuffle(random.begin(), random.end(), std::mt19937_64(7));
+
+    struct Case
+    {
+        const char*                        m_pattern;
+        const std::vector<std::uintmax_t>* m_chunks;
+        std::size_t                        m_threads;
+        bool                               m_batched;
+    };
+    const Case cases[] = {
+        { "sequential", &sequential, 0, false },
+        { "random", &random, 0, false },
+        { "random", &random, THREADS, false },
+        { "random", &random, 1, true },
+    };
+
+    for (const auto& test : cases)
+    {
+        for (const bool cold : { true, false })
+        {
+            if (cold)
+                evict(path);
+            else
+                read_positional(handler, *test.m_chunks, chunk_size, 1);
+
+            const auto start = std::chrono::steady_clock::now();
+            bool       ok    = false;
+            if (test.m_batched)
+                ok = read_batched(handler, *test.m_chunks, chunk_size);
+            else if (test.m_threads == 0)
+                ok = read_sequential_api(handler, *test.m_chunks, chunk_size);
+            else
+                ok = read_positional(handler, *test.m_chunks, chunk_size, test.m_threads);
+            const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            std::printf("%-18s %-10s %-8s %-5s %10.1f MiB/s %8.2f us/chunk%s\n",
+                        name,
+                        test.m_pattern,
+                        test.m_batched ? "batched" : test.m_threads == 0 ? "1" : std::to_string(test.m_threads).c_str(),
+                        cold ? "cold" : "warm",
+                        static_cast<double>(handler.size()) / (1024.0 * 1024.0) / elapsed,
+                        elapsed * 1e6 / static_cast<double>(test.m_chunks->size()),
+                        ok ? "" : " (read error)");
+        }
+    }
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+    const std::uintmax_t size_mib   = argc > 1 ? std::stoull(argv[1]) : 256u;
+    const std::uintmax_t chunk_size = argc > 2 ? std::stoull(argv[2]) : 4096u;
+    const fs::path       path       = fs::temp_directory_path() / ("hexit_io_bench_" + std::to_string(::getpid()));
+
+    create_file(path, size_mib * 1024 * 1024);
+    std::printf("%ju MiB file, %ju byte chunks\n", size_mib, chunk_size);
+    std::printf("%-18s %-10s %-8s %-5s %16s %17s\n", "handler", "pattern", "readers", "cache", "throughput", "latency");
+    run<FileHandler>("FileHandler", path, chunk_size);
+    run<PosixFileHandler>("PosixFileHandler", path, chunk_size);
+#ifdef HEXIT_HAS_IO_URING
+    run<UringHandler>("UringHandler", path, chunk_size);
+#endif
+    fs::remove(path);
+
+    return 0;
+}
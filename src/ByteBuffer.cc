@@ -1,112 +1,1286 @@
 #include "ByteBuffer.h"
 #include "IOHandler.h"
+#include "PosixFileHandler.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <fcntl.h>
+#include <linux/fs.h>
 #include <string>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
 
 namespace Hexit
 {
-ByteBuffer::ByteBuffer(IOHandler& handler)
-    : size(handler.size())
-    , m_cache(handler)
+namespace
 {
+bool write_all(int fd, const std::uint8_t* data, std::uintmax_t size)
+{
+    while (size > 0)
+    {
+        const ssize_t count = ::write(fd, data, size);
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count <= 0)
+            return false;
+
+        data += count;
+        size -= static_cast<std::uintmax_t>(count);
+    }
+
+    return true;
+}
+
+bool pwrite_all(int fd, const std::uint8_t* data, std::uintmax_t size, std::uintmax_t offset)
+{
+    while (size > 0)
+    {
+        const ssize_t count = ::pwrite(fd, data, size, static_cast<off_t>(offset));
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count <= 0)
+            return false;
+
+        data += count;
+        size -= static_cast<std::uintmax_t>(count);
+        offset += static_cast<std::uintmax_t>(count);
+    }
+
+    return true;
+}
+
+// Kernel copies get split into slices of this size, so that their progress can be followed and they can be cancelled.
+constexpr std::uintmax_t COPY_SLICE = 64 * COPY_BUFFER_SIZE;
+
+// Lets the kernel copy the file, which shares the extents on some file systems and copies them on the server
+// for network file systems. Returns false if the kernel cannot copy between the two files.
+bool copy_range(int source, int target, std::uintmax_t size, std::atomic<std::uintmax_t>& done, const std::atomic<bool>& cancel)
+{
+    loff_t in  = 0;
+    loff_t out = 0;
+    while (size > 0 && !cancel)
+    {
+        const ssize_t count = ::copy_file_range(source, &in, target, &out, std::min(size, COPY_SLICE), 0);
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count <= 0)
+            return false;
+
+        size -= static_cast<std::uintmax_t>(count);
+        done += static_cast<std::uintmax_t>(count);
+    }
+
+    return size == 0;
+}
+
+bool copy_stream(int source, int target, std::uintmax_t size, std::atomic<std::uintmax_t>& done, const std::atomic<bool>& cancel)
+{
+    std::vector<std::uint8_t> buffer(COPY_BUFFER_SIZE);
+    std::uintmax_t            offset = 0;
+    while (offset < size && !cancel)
+    {
+        const ssize_t count = ::pread(source, buffer.data(), std::min<std::uintmax_t>(buffer.size(), size - offset), static_cast<off_t>(offset));
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count <= 0 || !pwrite_all(target, buffer.data(), static_cast<std::uintmax_t>(count), offset))
+            return false;
+
+        offset += static_cast<std::uintmax_t>(count);
+        done += static_cast<std::uintmax_t>(count);
+    }
+
+    return offset == size;
 }
 
-// No bounds checking is performed by the operator at all.
-// is_ok() method should get called to check if an I/O error has occured.
-std::uint8_t ByteBuffer::operator[](std::uintmax_t byte_id)
+// Mark the ORIGINAL and ADD pieces whose bytes a copy references more than once, either as the source or as the
+// copy itself. Overwriting one of those bytes gives it a piece of its own, so that the other copies keep their value.
+constexpr std::uint32_t SHARED = 1;
+constexpr std::uint32_t COPIED = 2;
+
+// Copies count bytes of the pattern repeated over and over, starting offset bytes into the repetition.
+void fill_pattern(const std::vector<std::uint8_t>& pattern, std::uintmax_t offset, std::uint8_t* data, std::uintmax_t count)
 {
-    const std::uintmax_t chunk_id    = byte_id / ChunkCache::capacity;
-    const std::uintmax_t relative_id = byte_id - ChunkCache::capacity * chunk_id;
-    const auto&         recent      = m_cache.recent();
-    const auto&         fallback    = m_cache.fallback();
+    if (pattern.size() == 1)
+    {
+        std::fill_n(data, count, pattern.front());
+        return;
+    }
 
-    if (recent.m_id == chunk_id)
-        return recent.m_data[relative_id];
-    else if (fallback.m_id == chunk_id)
-        return fallback.m_data[relative_id];
+    for (std::uintmax_t phase = offset % pattern.size(), length = 0; count > 0; phase = 0, data += length, count -= length)
+    {
+        length = std::min(count, pattern.size() - phase);
+        std::copy_n(pattern.data() + phase, length, data);
+    }
+}
+
+// The lowest count bits set.
+inline std::uint64_t low_bits(std::uintmax_t count)
+{
+    return count >= 64 ? ~std::uint64_t { 0 } : (std::uint64_t { 1 } << count) - 1;
+}
+
+// True if the piece holds the bytes of the original file that are at its logical offset anyway.
+inline bool is_in_place(const PieceTable::Piece& piece, std::uintmax_t logical)
+{
+    return piece.m_source == PieceTable::Source::ORIGINAL && piece.m_offset == logical;
+}
+
+// Copies the file into the empty target file the cheapest way the file system allows.
+SaveMethod copy_file(const fs::path& path, int target, std::uintmax_t size, std::atomic<std::uintmax_t>& done, const std::atomic<bool>& cancel)
+{
+    const int source = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (source < 0)
+        return SaveMethod::NONE;
+
+    // A failed attempt may leave a partial copy behind, which the next one overwrites.
+    const std::uintmax_t start  = done;
+    SaveMethod           method = SaveMethod::NONE;
+    if (::ioctl(target, FICLONE, source) == 0)
+    {
+        method = SaveMethod::REFLINK;
+        done += size;
+    }
+    else if (copy_range(source, target, size, done, cancel))
+        method = SaveMethod::COPY_RANGE;
+    else if (done = start; !cancel && copy_stream(source, target, size, done, cancel))
+        method = SaveMethod::STREAM;
+
+    ::close(source);
+    return method;
+}
+} // namespace
+
+const char* to_string(SaveMethod method)
+{
+    switch (method)
+    {
+    case SaveMethod::NONE:
+        return "none";
+    case SaveMethod::IN_PLACE:
+        return "in place";
+    case SaveMethod::REWRITE:
+        return "rewrite";
+    case SaveMethod::REFLINK:
+        return "reflink clone";
+    case SaveMethod::COPY_RANGE:
+        return "kernel copy";
+    case SaveMethod::STREAM:
+        return "streamed copy";
+    }
+
+    return "unknown";
+}
+
+struct ByteBuffer::SaveJob
+{
+    // The bytes of a cached chunk from its first to its last modified one.
+    struct Span
+    {
+        std::uintmax_t            m_offset;
+        std::vector<std::uint8_t> m_bytes;
+    };
+
+    OverlayMap                            m_overlay; // The overwritten bytes being saved.
+    std::map<std::uintmax_t, Span>        m_spans;   // Written instead of the runs of the page, by chunk id.
+    PieceTable                            m_table;   // Copies of the pieces and their sources.
+    std::vector<std::uint8_t>             m_add;
+    std::vector<std::vector<std::uint8_t>>  m_patterns;
+    std::vector<std::shared_ptr<IOHandler>> m_pastes;
+    std::vector<std::uint8_t>             m_chunk;    // The last chunk of the original file read by read_piece().
+    std::uintmax_t                        m_chunk_id   = UINTMAX_MAX;
+    fs::path                              m_path;
+    std::uintmax_t                        m_size       = 0; // Size of the original file.
+    std::uintmax_t                        m_chunk_size = 0;
+    std::uintmax_t                        m_total      = 0; // Bytes to get through, m_done counts the ones done so far.
+    std::atomic<std::uintmax_t>           m_done       = { 0 };
+    std::atomic<bool>                     m_cancel     = { false };
+    std::atomic<bool>                     m_finished   = { false };
+    bool                                  m_pieces     = false; // The pieces get written along with the overwritten bytes.
+    bool                                  m_rewrite    = false; // The pieces get written into a new file.
+    bool                                  m_atomic     = false;
+    bool                                  m_ok         = false;
+    SaveMethod                            m_method     = SaveMethod::NONE;
+    std::string                           m_error;
+    std::chrono::steady_clock::time_point m_start;
+    std::thread                           m_worker;
+};
+
+ByteBuffer::ByteBuffer(IOHandler& handler, const CacheConfig& cache_config)
+    : m_handler(handler)
+    , m_cache(handler, cache_config)
+    , m_table(handler.size())
+    , m_pasted_index(0)
+    , m_pasted_chunk(UINTMAX_MAX)
+    , m_located({ { PieceTable::Source::ORIGINAL, 0, 0 }, 0 })
+    , m_save_method(SaveMethod::NONE)
+    , m_atomic_save(false)
+{
+}
+
+ByteBuffer::~ByteBuffer()
+{
+    if (m_job)
+        wait_save();
+}
+
+std::uint8_t ByteBuffer::read_byte(std::uintmax_t byte_id)
+{
+    m_statistics.m_byte_reads++;
+    // Until bytes get inserted or erased, logical offsets are offsets into the original file.
+    if (m_table.is_original())
+        return original_byte(byte_id);
+
+    const auto&          location = locate(byte_id);
+    const auto&          piece    = location.m_piece;
+    const std::uintmax_t offset   = piece.m_offset + byte_id - location.m_start;
+    switch (piece.m_source)
+    {
+    case PieceTable::Source::ADD:
+        return m_add[offset];
+    case PieceTable::Source::FILL:
+        return m_patterns[piece.m_index][offset % m_patterns[piece.m_index].size()];
+    case PieceTable::Source::PASTE:
+        return pasted_byte(piece.m_index, offset);
+    case PieceTable::Source::ORIGINAL:
+        break;
+    }
+
+    return original_byte(offset);
+}
+
+ChunkCache::DataChunk* ByteBuffer::original_chunk(std::uintmax_t chunk_id)
+{
+    if (auto* chunk = m_cache.find(chunk_id); chunk)
+        return chunk;
 
     // chunk miss, load from disk...
     if (!m_cache.load_chunk(chunk_id))
     {
         log_error("Error at ByteBuffer::operator[]: Could not load chunk with id " + std::to_string(chunk_id));
-        // Return a garbage value since an error occured.
-        return recent.m_data[relative_id];
+        return nullptr;
     }
 
+    // The bytes that are being saved may not have reached the file yet, the ones modified since then go on top.
     auto& new_chunk = m_cache.recent();
-    if (m_dirty_chunks.contains(chunk_id))
+    if (const auto* page = saving(chunk_id); page)
+        page->apply(new_chunk.m_data, new_chunk.m_count);
+    if (const auto* page = overlay(chunk_id); page)
+        page->apply(new_chunk.m_data, new_chunk.m_count);
+
+    return &new_chunk;
+}
+
+std::uint8_t ByteBuffer::original_byte(std::uintmax_t offset)
+{
+    const std::uintmax_t chunk_id    = offset / m_cache.chunk_size();
+    const std::uintmax_t relative_id = offset - m_cache.chunk_size() * chunk_id;
+
+    // Return a garbage value since an error occured.
+    const auto* chunk = original_chunk(chunk_id);
+    return chunk ? chunk->m_data[relative_id] : m_cache.recent().m_data[relative_id];
+}
+
+bool ByteBuffer::read_original(std::uintmax_t offset, std::uint8_t* data, std::uintmax_t count)
+{
+    const std::uintmax_t chunk_size = m_cache.chunk_size();
+    while (count > 0)
     {
-        for (auto& change : m_dirty_chunks[chunk_id])
-            new_chunk.m_data[change] = m_dirty_bytes[chunk_id * ChunkCache::capacity + change];
+        const std::uintmax_t chunk_id    = offset / chunk_size;
+        const std::uintmax_t relative_id = offset - chunk_id * chunk_size;
+        const auto*          chunk       = original_chunk(chunk_id);
+        if (!chunk)
+            return false;
+
+        const std::uintmax_t length = std::min(count, chunk->m_count - relative_id);
+        std::copy_n(chunk->m_data + relative_id, length, data);
+        data += length;
+        offset += length;
+        count -= length;
     }
 
-    return new_chunk.m_data[relative_id];
+    return true;
 }
 
-void ByteBuffer::set_byte(std::uintmax_t byte_id, std::uint8_t byte_value)
+bool ByteBuffer::read_range(std::uintmax_t byte_id, std::span<std::uint8_t> data)
 {
-    const std::uintmax_t chunk_id    = byte_id / ChunkCache::capacity;
-    const std::uintmax_t relative_id = byte_id - ChunkCache::capacity * chunk_id;
-    auto&               recent      = m_cache.recent();
-    auto&               fallback    = m_cache.fallback();
+    std::uintmax_t count = std::min<std::uintmax_t>(data.size(), size() - std::min(byte_id, size()));
+    std::uint8_t*  out   = data.data();
+    m_statistics.m_byte_reads += count;
+    if (m_table.is_original())
+        return read_original(byte_id, out, count);
 
-    if (recent.m_id == chunk_id)
-        recent.m_data[relative_id] = byte_value;
-    else
-        fallback.m_data[relative_id] = byte_value;
+    bool read = true;
+    while (count > 0)
+    {
+        const auto           location = locate(byte_id);
+        const auto&          piece    = location.m_piece;
+        const std::uintmax_t skip     = byte_id - location.m_start;
+        const std::uintmax_t offset   = piece.m_offset + skip;
+        const std::uintmax_t length   = std::min(count, piece.m_length - skip);
+        switch (piece.m_source)
+        {
+        case PieceTable::Source::ADD:
+            std::copy_n(m_add.data() + offset, length, out);
+            break;
+        case PieceTable::Source::FILL:
+            fill_pattern(m_patterns[piece.m_index], offset, out, length);
+            break;
+        case PieceTable::Source::PASTE:
+            if (!m_pastes[piece.m_index]->read_at(offset, out, length))
+            {
+                log_error("Error at ByteBuffer::read_range(): Could not read " + m_pastes[piece.m_index]->name().string());
+                read = false;
+            }
+            break;
+        case PieceTable::Source::ORIGINAL:
+            read = read_original(offset, out, length) && read;
+            break;
+        }
 
-    if (!m_dirty_bytes.contains(byte_id))
-        m_dirty_chunks[chunk_id].emplace_back(relative_id);
+        out += length;
+        byte_id += length;
+        count -= length;
+    }
 
-    m_dirty_bytes.insert_or_assign(byte_id, byte_value);
+    return read;
 }
 
-void ByteBuffer::save()
+bool ByteBuffer::read_direct(std::uintmax_t byte_id, std::uint8_t* data, std::uintmax_t count) const
 {
-    if (!has_dirty() || m_cache.is_read_only())
-        return;
+    if (m_job || byte_id > size() || count > size() - byte_id)
+        return false;
 
-    for (const auto& [chunk_id, changes] : m_dirty_chunks)
+    const std::uintmax_t chunk_size = m_cache.chunk_size();
+    for (const auto& piece : m_table.slice(byte_id, count))
     {
-        auto& recent   = m_cache.recent();
-        auto& fallback = m_cache.fallback();
-
-        if (recent.m_id == chunk_id)
+        switch (piece.m_source)
         {
-            if (!m_cache.save_chunk(recent))
+        case PieceTable::Source::ADD:
+            std::copy_n(m_add.data() + piece.m_offset, piece.m_length, data);
+            break;
+        case PieceTable::Source::FILL:
+            fill_pattern(m_patterns[piece.m_index], piece.m_offset, data, piece.m_length);
+            break;
+        case PieceTable::Source::PASTE:
+            if (!m_pastes[piece.m_index]->read_at(piece.m_offset, data, piece.m_length))
+                return false;
+            break;
+        case PieceTable::Source::ORIGINAL:
+            if (!m_handler.read_at(piece.m_offset, data, piece.m_length))
+                return false;
+
+            for (auto it = m_overlay.lower_bound(piece.m_offset / chunk_size); it != m_overlay.end() && it->first * chunk_size < piece.m_offset + piece.m_length; ++it)
             {
-                log_error("Error at ByteBuffer::save(): Could not save chunk with id " + std::to_string(chunk_id));
-                break;
+                const std::uintmax_t start = std::max(piece.m_offset, it->first * chunk_size);
+                const std::uintmax_t end   = std::min(piece.m_offset + piece.m_length, (it->first + 1) * chunk_size);
+                it->second.apply(data + (start - piece.m_offset), start - it->first * chunk_size, end - start);
             }
+            break;
+        }
+
+        data += piece.m_length;
+    }
+
+    return true;
+}
+
+std::uint8_t ByteBuffer::pasted_byte(std::uint32_t index, std::uintmax_t offset)
+{
+    const std::uintmax_t chunk_size = m_cache.chunk_size();
+    const std::uintmax_t chunk_id   = offset / chunk_size;
+    if (index != m_pasted_index || chunk_id != m_pasted_chunk)
+    {
+        auto&                handler = *m_pastes[index];
+        const std::uintmax_t bytes   = std::min(chunk_size, handler.size() - chunk_id * chunk_size);
+        m_pasted.resize(chunk_size);
+        m_pasted_index = index;
+        m_pasted_chunk = chunk_id;
+        if (!handler.read_at(chunk_id * chunk_size, m_pasted.data(), bytes))
+        {
+            log_error("Error at ByteBuffer::operator[]: Could not read " + handler.name().string());
+            m_pasted_chunk = UINTMAX_MAX;
         }
-        else if (fallback.m_id == chunk_id)
+    }
+
+    return m_pasted[offset - chunk_id * chunk_size];
+}
+
+bool ByteBuffer::set_byte(std::uintmax_t byte_id, std::uint8_t byte_value)
+{
+    if (!m_table.is_original())
+    {
+        const auto&          location = locate(byte_id);
+        const auto&          piece    = location.m_piece;
+        const std::uintmax_t offset   = piece.m_offset + byte_id - location.m_start;
+        if (piece.m_source == PieceTable::Source::ADD && piece.m_index == 0)
+        {
+            m_statistics.m_byte_writes++;
+            m_add[offset] = byte_value;
+            return true;
+        }
+
+        if (piece.m_source != PieceTable::Source::ORIGINAL || piece.m_index != 0)
+        {
+            // The byte gets split off the range into an inserted byte of its own, which changes the pieces.
+            if (m_job)
+                return false;
+
+            m_statistics.m_byte_writes++;
+            m_add.push_back(byte_value);
+            m_table.erase(byte_id, 1);
+            m_table.insert(byte_id, { PieceTable::Source::ADD, m_add.size() - 1, 1 });
+            m_located = { { PieceTable::Source::ORIGINAL, 0, 0 }, 0 };
+            return true;
+        }
+        byte_id = offset;
+    }
+
+    m_statistics.m_byte_writes++;
+
+    const std::uintmax_t chunk_id    = byte_id / m_cache.chunk_size();
+    const std::uintmax_t relative_id = byte_id - m_cache.chunk_size() * chunk_id;
+
+    // Chunks that are not cached will get patched the next time they are loaded.
+    if (auto* chunk = m_cache.find(chunk_id); chunk)
+        chunk->m_data[relative_id] = byte_value;
+
+    m_overlay.try_emplace(chunk_id, m_cache.chunk_size()).first->second.set(relative_id, byte_value);
+    return true;
+}
+
+bool ByteBuffer::insert_byte(std::uintmax_t byte_id, std::uint8_t byte_value)
+{
+    if (m_cache.is_read_only() || m_job || byte_id > size())
+        return false;
+
+    m_statistics.m_byte_writes++;
+    m_add.push_back(byte_value);
+    m_table.insert(byte_id, { PieceTable::Source::ADD, m_add.size() - 1, 1 });
+    m_located = { { PieceTable::Source::ORIGINAL, 0, 0 }, 0 };
+    return true;
+}
+
+bool ByteBuffer::erase_byte(std::uintmax_t byte_id)
+{
+    if (m_cache.is_read_only() || m_job || byte_id >= size() || size() == 1)
+        return false;
+
+    m_statistics.m_byte_writes++;
+    m_table.erase(byte_id, 1);
+    m_located = { { PieceTable::Source::ORIGINAL, 0, 0 }, 0 };
+    return true;
+}
+
+bool ByteBuffer::fill(std::uintmax_t byte_id, std::uintmax_t count, const std::vector<std::uint8_t>& pattern)
+{
+    count = std::min(count, size() - std::min(byte_id, size()));
+    if (m_cache.is_read_only() || m_job || count == 0 || pattern.empty())
+        return false;
+
+    // Filling with the same pattern again reuses it.
+    if (m_patterns.empty() || m_patterns.back() != pattern)
+        m_patterns.push_back(pattern);
+    return place(byte_id, { { PieceTable::Source::FILL, 0, count, static_cast<std::uint32_t>(m_patterns.size() - 1) } }, false);
+}
+
+bool ByteBuffer::paste(std::uintmax_t byte_id, std::span<const std::uint8_t> data, bool insert)
+{
+    if (m_cache.is_read_only() || m_job || data.empty() || byte_id > size())
+        return false;
+
+    m_add.insert(m_add.end(), data.begin(), data.end());
+    return place(byte_id, { { PieceTable::Source::ADD, m_add.size() - data.size(), data.size() } }, insert);
+}
+
+bool ByteBuffer::paste_file(std::uintmax_t byte_id, const fs::path& path, bool insert)
+{
+    if (m_cache.is_read_only() || m_job || byte_id > size())
+        return false;
+
+    auto handler = std::make_shared<PosixFileHandler>(true);
+    if (!handler->open(path) || handler->size() == 0)
+    {
+        log_error("Error at ByteBuffer::paste_file(): Could not read " + path.string());
+        return false;
+    }
+
+    m_pastes.push_back(handler);
+    return place(byte_id, { { PieceTable::Source::PASTE, 0, handler->size(), static_cast<std::uint32_t>(m_pastes.size() - 1) } }, insert);
+}
+
+bool ByteBuffer::copy(std::uintmax_t from, std::uintmax_t count, std::uintmax_t to, bool insert)
+{
+    if (m_cache.is_read_only() || m_job || from >= size() || to > size())
+        return false;
+
+    count       = std::min(count, size() - from);
+    auto source = m_table.slice(from, count);
+    auto pieces = source;
+    for (std::size_t i = 0; i < source.size(); ++i)
+    {
+        if (source[i].m_source == PieceTable::Source::ORIGINAL || source[i].m_source == PieceTable::Source::ADD)
         {
-            if (!m_cache.save_chunk(fallback))
+            source[i].m_index = std::max(source[i].m_index, SHARED);
+            pieces[i].m_index = COPIED;
+        }
+    }
+
+    // The source range now shares its bytes with the copy, so it gets marked as well.
+    m_table.erase(from, count);
+    std::uintmax_t position = from;
+    for (const auto& piece : source)
+    {
+        m_table.insert(position, piece);
+        position += piece.m_length;
+    }
+
+    return place(to, pieces, insert);
+}
+
+bool ByteBuffer::place(std::uintmax_t byte_id, const std::vector<PieceTable::Piece>& pieces, bool insert)
+{
+    m_statistics.m_byte_writes++;
+    if (!insert)
+    {
+        std::uintmax_t count = 0;
+        for (const auto& piece : pieces)
+            count += piece.m_length;
+        m_table.erase(byte_id, count);
+    }
+
+    for (const auto& piece : pieces)
+    {
+        m_table.insert(byte_id, piece);
+        byte_id += piece.m_length;
+    }
+
+    m_located = { { PieceTable::Source::ORIGINAL, 0, 0 }, 0 };
+    return true;
+}
+
+bool ByteBuffer::is_dirty(std::uintmax_t byte_id) const
+{
+    if (!m_table.is_original())
+    {
+        const auto& location = locate(byte_id);
+        const auto& piece    = location.m_piece;
+        if (piece.m_source != PieceTable::Source::ORIGINAL || piece.m_index == COPIED)
+            return true;
+        byte_id = piece.m_offset + byte_id - location.m_start;
+    }
+
+    const std::uintmax_t chunk_id    = byte_id / m_cache.chunk_size();
+    const std::uintmax_t relative_id = byte_id - chunk_id * m_cache.chunk_size();
+    const auto*          page        = overlay(chunk_id);
+    const auto*          saved_page  = saving(chunk_id);
+    return (page && page->is_dirty(relative_id)) || (saved_page && saved_page->is_dirty(relative_id));
+}
+
+std::uint64_t ByteBuffer::dirty_mask(std::uintmax_t byte_id, std::uintmax_t count) const
+{
+    if (m_table.is_original())
+        return original_mask(byte_id, count);
+
+    std::uint64_t mask = 0;
+    for (std::uintmax_t done = 0; done < count && byte_id + done < size();)
+    {
+        const auto&          location = locate(byte_id + done);
+        const auto&          piece    = location.m_piece;
+        const std::uintmax_t skip     = byte_id + done - location.m_start;
+        const std::uintmax_t length   = std::min(count - done, piece.m_length - skip);
+        if (piece.m_source != PieceTable::Source::ORIGINAL || piece.m_index == COPIED)
+            mask |= low_bits(length) << done;
+        else
+            mask |= original_mask(piece.m_offset + skip, length) << done;
+        done += length;
+    }
+    return mask;
+}
+
+std::uint64_t ByteBuffer::original_mask(std::uintmax_t offset, std::uintmax_t count) const
+{
+    if (m_overlay.empty() && !m_job)
+        return 0;
+
+    const std::uintmax_t chunk_size = m_cache.chunk_size();
+    std::uint64_t        mask       = 0;
+    for (std::uintmax_t done = 0; done < count;)
+    {
+        const std::uintmax_t chunk_id    = (offset + done) / chunk_size;
+        const std::uintmax_t relative_id = offset + done - chunk_id * chunk_size;
+        const std::uintmax_t length      = std::min(count - done, chunk_size - relative_id);
+        const auto*          page        = overlay(chunk_id);
+        const auto*          saved_page  = saving(chunk_id);
+        mask |= ((page ? page->mask(relative_id, length) : 0u) | (saved_page ? saved_page->mask(relative_id, length) : 0u)) << done;
+        done += length;
+    }
+    return mask;
+}
+
+const PieceTable::Location& ByteBuffer::locate(std::uintmax_t byte_id) const
+{
+    // Rendering and scanning access consecutive bytes, which mostly fall into the same piece.
+    if (byte_id < m_located.m_start || byte_id - m_located.m_start >= m_located.m_piece.m_length)
+        m_located = m_table.locate(byte_id);
+
+    return m_located;
+}
+
+bool ByteBuffer::fits_in_place() const
+{
+    if (m_table.size() != m_handler.size())
+        return false;
+
+    // The logical ranges that get written, in file order, and the ranges of the file that get read for them.
+    std::vector<std::pair<std::uintmax_t, std::uintmax_t>> written;
+    std::vector<std::pair<std::uintmax_t, std::uintmax_t>> read;
+    std::uintmax_t                                         logical = 0;
+    bool                                                   fits    = true;
+    m_table.for_each(
+        [&](const PieceTable::Piece& piece)
+        {
+            if (!is_in_place(piece, logical))
             {
-                log_error("Error at ByteBuffer::save(): Could not save chunk with id " + std::to_string(chunk_id));
-                break;
+                written.emplace_back(logical, logical + piece.m_length);
+                if (piece.m_source == PieceTable::Source::ORIGINAL)
+                    read.emplace_back(piece.m_offset, piece.m_offset + piece.m_length);
+                // A file pasted into itself would be read while it gets written.
+                else if (piece.m_source == PieceTable::Source::PASTE)
+                    fits = fits && m_pastes[piece.m_index]->name() != m_handler.name();
             }
+            logical += piece.m_length;
+            return true;
+        });
+
+    for (const auto& [first, last] : read)
+    {
+        // The first written range that ends after the read one starts, which overlaps it if it starts before its end.
+        const auto it = std::upper_bound(written.begin(), written.end(), first, [](std::uintmax_t offset, const auto& range)
+                                         { return offset < range.second; });
+        if (it != written.end() && it->first < last)
+            return false;
+    }
+
+    return fits;
+}
+
+const OverlayPage* ByteBuffer::saving(std::uintmax_t chunk_id) const
+{
+    if (!m_job)
+        return nullptr;
+
+    const auto it = m_job->m_overlay.find(chunk_id);
+    return it == m_job->m_overlay.end() ? nullptr : &it->second;
+}
+
+void ByteBuffer::save()
+{
+    if (start_save())
+        wait_save();
+}
+
+bool ByteBuffer::save_as(const fs::path& path, std::uintmax_t first, std::uintmax_t count)
+{
+    std::error_code ec;
+    if (m_job)
+        return false;
+    if (fs::equivalent(path, m_handler.name(), ec))
+    {
+        log_error("Error at ByteBuffer::save_as(): " + path.string() + " is the file being edited");
+        return false;
+    }
+
+    const int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        log_error("Error at ByteBuffer::save_as(): Could not create " + path.string());
+        return false;
+    }
+
+    const std::uintmax_t      last = first + std::min(count, size() - std::min(first, size()));
+    std::vector<std::uint8_t> buffer(COPY_BUFFER_SIZE);
+    bool                      written = true;
+    for (std::uintmax_t offset = first; written && offset < last; offset += buffer.size())
+    {
+        const std::uintmax_t length = std::min<std::uintmax_t>(buffer.size(), last - offset);
+        written                     = read_range(offset, std::span(buffer.data(), length)) && write_all(fd, buffer.data(), length);
+    }
+    written = written && ::fsync(fd) == 0;
+    ::close(fd);
+
+    if (!written)
+        log_error("Error at ByteBuffer::save_as(): Could not write " + path.string());
+    return written;
+}
+
+bool ByteBuffer::start_save()
+{
+    if (m_job || !has_dirty() || m_cache.is_read_only())
+        return false;
+
+    m_statistics.m_saves++;
+    m_job            = std::make_unique<SaveJob>();
+    auto& job        = *m_job;
+    job.m_path       = m_handler.name();
+    job.m_size       = m_handler.size();
+    job.m_chunk_size = m_cache.chunk_size();
+    job.m_pieces     = is_resized();
+    job.m_atomic     = m_atomic_save;
+    // A clone gets patched from the original file, so only the size has to stay the same for it.
+    job.m_rewrite    = job.m_pieces && (job.m_atomic ? m_table.size() != m_handler.size() : !fits_in_place());
+    job.m_start      = std::chrono::steady_clock::now();
+    // The overwritten bytes move into the job, the ones overwritten from now on start a new overlay.
+    job.m_overlay.swap(m_overlay);
+    if (job.m_pieces)
+    {
+        job.m_table    = m_table;
+        job.m_add      = m_add;
+        job.m_patterns = m_patterns;
+        job.m_pastes   = m_pastes;
+    }
+
+    if (job.m_rewrite)
+        job.m_total = m_table.size();
+    else
+    {
+        for (auto& [chunk_id, page] : job.m_overlay)
+        {
+            job.m_total += page.count();
+            const auto* chunk = m_cache.peek(chunk_id);
+            if (!chunk)
+                continue;
+
+            // A cached chunk already holds the modified bytes along with the ones between them. Copying
+            // those lets all of its runs go out with a single write, and the worker never has to look at
+            // the cache.
+            std::uintmax_t first = UINTMAX_MAX;
+            std::uintmax_t last  = 0;
+            std::uintmax_t runs  = 0;
+            page.for_each_run(
+                [&](std::uintmax_t offset, std::uint8_t*, std::uintmax_t length)
+                {
+                    first = std::min(first, offset);
+                    last  = offset + length;
+                    runs++;
+                });
+            if (runs > 1)
+                job.m_spans.emplace(chunk_id, SaveJob::Span { first, { chunk->m_data + first, chunk->m_data + last } });
+        }
+
+        if (job.m_atomic)
+            job.m_total += job.m_size;
+        if (job.m_pieces)
+        {
+            std::uintmax_t logical = 0;
+            m_table.for_each(
+                [&](const PieceTable::Piece& piece)
+                {
+                    if (!is_in_place(piece, logical))
+                        job.m_total += piece.m_length;
+                    logical += piece.m_length;
+                    return true;
+                });
+        }
+    }
+
+    job.m_worker = std::thread(&ByteBuffer::run_save, this, std::ref(job));
+    return true;
+}
+
+bool ByteBuffer::poll_save()
+{
+    if (!m_job || !m_job->m_finished.load(std::memory_order_acquire))
+        return false;
+
+    finish_save();
+    return true;
+}
+
+bool ByteBuffer::refresh()
+{
+    const std::uintmax_t old_size = m_handler.size();
+    if (m_job || !m_handler.refresh())
+        return false;
+
+    m_cache.grow(old_size);
+    if (m_table.is_original())
+        m_table.reset(m_handler.size());
+    else
+        m_table.insert(m_table.size(), { PieceTable::Source::ORIGINAL, old_size, m_handler.size() - old_size });
+    m_located = { { PieceTable::Source::ORIGINAL, 0, 0 }, 0 };
+    return true;
+}
+
+void ByteBuffer::wait_save()
+{
+    if (m_job)
+        finish_save();
+}
+
+void ByteBuffer::cancel_save()
+{
+    if (m_job)
+        m_job->m_cancel = true;
+}
+
+double ByteBuffer::save_progress() const
+{
+    if (!m_job || m_job->m_total == 0)
+        return m_job ? 0.0 : 1.0;
+
+    return std::min(1.0, static_cast<double>(m_job->m_done.load()) / static_cast<double>(m_job->m_total));
+}
+
+void ByteBuffer::run_save(SaveJob& job)
+{
+    if (job.m_rewrite)
+        job.m_ok = save_rewrite(job);
+    else if (job.m_atomic)
+        job.m_ok = save_atomic(job);
+    else
+        job.m_ok = save_in_place(job);
+
+    job.m_finished.store(true, std::memory_order_release);
+}
+
+bool ByteBuffer::write_overlay(SaveJob& job, const std::function<bool(const std::vector<ChunkCache::Extent>&)>& writer)
+{
+    // Only the modified bytes get written. Runs of them are merged into extents, also across the borders of
+    // the chunks, and the extents are handed to the writer in batches of SAVE_BATCH. A chunk with more than
+    // SAVE_MAX_RUNS runs goes out as a single extent instead: from its first to its last modified byte if it
+    // is cached, as a whole read from the file along with the other chunks of the batch if not.
+    struct Run
+    {
+        std::uintmax_t m_offset;
+        std::uint8_t*  m_data;
+        std::uintmax_t m_length;
+    };
+
+    // A page to apply over the chunk that got read into the buffer.
+    struct Patch
+    {
+        const OverlayPage* m_page;
+        std::uint8_t*      m_data;
+        std::uintmax_t     m_count;
+    };
+
+    std::vector<ChunkCache::Extent> extents;
+    std::vector<IOHandler::Request> reads;
+    std::vector<Patch>              patches;
+    std::vector<std::uint8_t>       buffer; // Holds the bytes of the reads.
+    std::vector<Run>                runs;
+    std::uintmax_t                  used    = 0; // Bytes of the buffer taken by the reads.
+    std::uintmax_t                  pending = 0; // Modified bytes in the batch.
+    bool                            written = true;
+    extents.reserve(SAVE_BATCH);
+    const auto flush = [&]()
+    {
+        if (!reads.empty() && written && !job.m_cancel && !m_handler.submit_batch(reads))
+        {
+            job.m_error = "Error at ByteBuffer::save(): Could not read the bytes from offset " + std::to_string(reads.front().m_offset) + " to " + std::to_string(reads.back().m_offset + reads.back().m_size - 1);
+            written     = false;
+        }
+        for (std::uintmax_t i = 0; written && i < patches.size(); ++i)
+            patches[i].m_page->apply(patches[i].m_data, patches[i].m_count);
+
+        // A cancelled save stops between two batches.
+        written = written && !job.m_cancel && writer(extents);
+        job.m_done += pending;
+        extents.clear();
+        reads.clear();
+        patches.clear();
+        used    = 0;
+        pending = 0;
+    };
+
+    const auto append = [&](std::uintmax_t offset, std::uint8_t* data, std::uintmax_t length)
+    {
+        if (!extents.empty() && extents.back().m_offset + extents.back().m_size == offset)
+        {
+            auto& extent = extents.back();
+            extent.m_size += length;
+            if (extent.m_buffers.back().data() + extent.m_buffers.back().size() == data)
+                extent.m_buffers.back() = { extent.m_buffers.back().data(), extent.m_buffers.back().size() + length };
+            else
+                extent.m_buffers.emplace_back(data, length);
+            return;
+        }
+
+        if (extents.size() == SAVE_BATCH)
+            flush();
+        extents.push_back({ offset, length, { { data, length } } });
+    };
+
+    for (auto& [chunk_id, page] : job.m_overlay)
+    {
+        if (!written)
+            break;
+
+        const std::uintmax_t base = chunk_id * job.m_chunk_size;
+        pending += page.count();
+        if (auto span = job.m_spans.find(chunk_id); span != job.m_spans.end())
+        {
+            append(base + span->second.m_offset, span->second.m_bytes.data(), span->second.m_bytes.size());
+            continue;
+        }
+
+        runs.clear();
+        page.for_each_run([&](std::uintmax_t offset, std::uint8_t* data, std::uintmax_t length)
+                          { runs.push_back({ offset, data, length }); });
+        if (runs.size() <= SAVE_MAX_RUNS)
+        {
+            for (const auto& run : runs)
+                append(base + run.m_offset, run.m_data, run.m_length);
+            continue;
         }
+
+        // The whole chunk gets read before the batch is written, into a buffer that it frees, so that neighbouring
+        // chunks go out as one read and one write.
+        const std::uintmax_t size = std::min(job.m_chunk_size, job.m_size - base);
+        if (buffer.empty())
+            buffer.resize(std::max(COPY_BUFFER_SIZE, job.m_chunk_size));
+        if (used + size > buffer.size() || extents.size() == SAVE_BATCH)
+            flush();
+        std::uint8_t* data = buffer.data() + used;
+        if (!reads.empty() && reads.back().m_offset + reads.back().m_size == base && reads.back().m_data + reads.back().m_size == data)
+            reads.back().m_size += size;
         else
+            reads.push_back({ base, data, size, false });
+        patches.push_back({ &page, data, size });
+        append(base, data, size);
+        used += size;
+    }
+
+    if (!extents.empty())
+        flush();
+
+    return written;
+}
+
+bool ByteBuffer::read_piece(SaveJob& job, const PieceTable::Piece& piece, std::uintmax_t skip, std::uint8_t* data, std::uintmax_t count)
+{
+    std::uintmax_t offset = piece.m_offset + skip;
+    switch (piece.m_source)
+    {
+    case PieceTable::Source::ADD:
+        std::copy_n(job.m_add.data() + offset, count, data);
+        return true;
+    case PieceTable::Source::FILL:
+        fill_pattern(job.m_patterns[piece.m_index], offset, data, count);
+        return true;
+    case PieceTable::Source::PASTE:
+        return job.m_pastes[piece.m_index]->read_at(offset, data, count);
+    case PieceTable::Source::ORIGINAL:
+        break;
+    }
+
+    // Chunks of the original file are read past the cache, which keeps getting used while the save runs.
+    const std::uintmax_t chunk_size = job.m_chunk_size;
+    job.m_chunk.resize(chunk_size);
+    while (count > 0)
+    {
+        const std::uintmax_t id    = offset / chunk_size;
+        const std::uintmax_t first = offset - id * chunk_size;
+        const std::uintmax_t bytes = std::min(chunk_size, job.m_size - id * chunk_size);
+        if (id != job.m_chunk_id)
         {
-            if (!m_cache.load_chunk(chunk_id))
+            job.m_chunk_id = UINTMAX_MAX;
+            if (!m_handler.read_at(id * chunk_size, job.m_chunk.data(), bytes))
+                return false;
+
+            if (const auto page = job.m_overlay.find(id); page != job.m_overlay.end())
+                page->second.apply(job.m_chunk.data(), bytes);
+            job.m_chunk_id = id;
+        }
+
+        const std::uintmax_t length = std::min(count, bytes - first);
+        std::copy_n(job.m_chunk.data() + first, length, data);
+        data += length;
+        offset += length;
+        count -= length;
+    }
+
+    return true;
+}
+
+bool ByteBuffer::write_pieces(SaveJob& job, const std::function<bool(std::uintmax_t, std::uint8_t*, std::uintmax_t)>& writer)
+{
+    std::vector<std::uint8_t> buffer(COPY_BUFFER_SIZE);
+    std::uintmax_t            logical = 0;
+    bool                      written = true;
+    job.m_table.for_each(
+        [&](const PieceTable::Piece& piece)
+        {
+            for (std::uintmax_t skip = 0; written && skip < piece.m_length && !is_in_place(piece, logical);)
+            {
+                const std::uintmax_t count = std::min<std::uintmax_t>(buffer.size(), piece.m_length - skip);
+                written                    = !job.m_cancel && read_piece(job, piece, skip, buffer.data(), count) && writer(logical + skip, buffer.data(), count);
+                job.m_done += count;
+                skip += count;
+            }
+            logical += piece.m_length;
+            return written;
+        });
+
+    return written;
+}
+
+bool ByteBuffer::save_in_place(SaveJob& job)
+{
+    const auto failed = [&](std::uintmax_t first, std::uintmax_t last)
+    {
+        job.m_error = "Error at ByteBuffer::save(): Could not save the bytes from offset " + std::to_string(first) + " to " + std::to_string(last);
+        return false;
+    };
+
+    // The pieces go on top of the overwritten bytes, which only matter where they are not covered by a piece.
+    return write_overlay(
+               job,
+               [&](const std::vector<ChunkCache::Extent>& extents)
+               {
+                   return m_cache.save_extents(extents) || failed(extents.front().m_offset, extents.back().m_offset + extents.back().m_size - 1);
+               })
+        && (!job.m_pieces
+            || write_pieces(
+                job,
+                [&](std::uintmax_t offset, std::uint8_t* data, std::uintmax_t count)
+                {
+                    return m_cache.save_extents({ { offset, count, { { data, count } } } }) || failed(offset, offset + count - 1);
+                }));
+}
+
+bool ByteBuffer::save_atomic(SaveJob& job)
+{
+    std::string temp;
+    const int   fd = create_temporary(job, temp);
+    if (fd < 0)
+        return false;
+
+    const auto patch = [fd](const std::vector<ChunkCache::Extent>& extents)
+    {
+        for (const auto& extent : extents)
+        {
+            std::uintmax_t offset = extent.m_offset;
+            for (const auto& buffer : extent.m_buffers)
             {
-                log_error("Error at ByteBuffer::save(): Could not load chunk with id " + std::to_string(chunk_id));
-                break;
+                if (!pwrite_all(fd, buffer.data(), buffer.size(), offset))
+                    return false;
+                offset += buffer.size();
             }
+        }
+        return true;
+    };
+
+    const auto patch_piece = [fd](std::uintmax_t offset, std::uint8_t* data, std::uintmax_t count)
+    { return pwrite_all(fd, data, count, offset); };
+
+    // The modified bytes get written into a copy of the file. On file systems that share extents between files
+    // the copy costs next to nothing, so the save stays proportional to the number of modified bytes.
+    job.m_method = copy_file(job.m_path, fd, job.m_size, job.m_done, job.m_cancel);
+    return replace_original(job, fd, temp, job.m_method != SaveMethod::NONE && write_overlay(job, patch) && (!job.m_pieces || write_pieces(job, patch_piece)));
+}
+
+bool ByteBuffer::save_rewrite(SaveJob& job)
+{
+    std::string temp;
+    const int   fd = create_temporary(job, temp);
+    if (fd < 0)
+        return false;
 
-            auto& chunk = m_cache.recent();
-            for (auto& change : changes)
-                chunk.m_data[change] = m_dirty_bytes[chunk_id * ChunkCache::capacity + change];
+    // The pieces get streamed into the temporary file through a buffer of a chunk, which gathers small pieces
+    // into a single write.
+    std::vector<std::uint8_t> output(job.m_chunk_size);
+    std::uintmax_t            used    = 0;
+    bool                      written = true;
+    const auto                flush   = [&]()
+    {
+        written = written && !job.m_cancel && write_all(fd, output.data(), used);
+        job.m_done += used;
+        used = 0;
+    };
 
-            if (!m_cache.save_chunk(chunk))
+    job.m_table.for_each(
+        [&](const PieceTable::Piece& piece)
+        {
+            for (std::uintmax_t skip = 0; written && skip < piece.m_length;)
             {
-                log_error("Error at ByteBuffer::save(): Could not save chunk with id " + std::to_string(chunk_id));
-                break;
+                const std::uintmax_t count = std::min(output.size() - used, piece.m_length - skip);
+                written                    = read_piece(job, piece, skip, output.data() + used, count);
+                used += count;
+                skip += count;
+                if (used == output.size())
+                    flush();
             }
+            return written;
+        });
+    flush();
+
+    job.m_method = SaveMethod::REWRITE;
+    return replace_original(job, fd, temp, written);
+}
+
+int ByteBuffer::create_temporary(SaveJob& job, std::string& temp)
+{
+    temp         = (job.m_path.parent_path() / std::string(".").append(job.m_path.filename().string()).append(".XXXXXX")).string();
+    const int fd = ::mkstemp(temp.data());
+    if (fd < 0)
+        job.m_error = "Error at ByteBuffer::save(): Could not create a temporary file next to " + job.m_path.string();
+
+    return fd;
+}
+
+bool ByteBuffer::replace_original(SaveJob& job, int fd, const std::string& temp, bool written)
+{
+    // The copy takes over the owner, group and mode of the original. Only root may give a file away, anyone else
+    // keeps owning the copy, and the mode follows the owner change since that clears the setuid bits. The rename
+    // replaces a symlink or a hard link with a regular file, the file it pointed to or shared stays as it was.
+    struct stat original;
+    written = written
+        && !job.m_cancel
+        && ::stat(job.m_path.c_str(), &original) == 0
+        && (::fchown(fd, original.st_uid, original.st_gid) == 0 || errno == EPERM)
+        && ::fchmod(fd, original.st_mode & 07777) == 0
+        && ::fsync(fd) == 0;
+    ::close(fd);
+
+    if (!written || ::rename(temp.c_str(), job.m_path.c_str()) != 0)
+    {
+        ::unlink(temp.c_str());
+        if (!job.m_cancel)
+            job.m_error = "Error at ByteBuffer::save(): Could not write " + job.m_path.string();
+        return false;
+    }
+
+    // The rename itself only survives a crash once the directory has been synced.
+    if (const int dir = ::open(job.m_path.parent_path().c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC); dir >= 0)
+    {
+        ::fsync(dir);
+        ::close(dir);
+    }
+
+    return true;
+}
+
+void ByteBuffer::finish_save()
+{
+    m_job->m_worker.join();
+    // The job stays in place until the end, so that reads still see the bytes it was saving.
+    auto& job = *m_job;
+    m_statistics.m_save_ns += static_cast<std::uintmax_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - job.m_start).count());
+    if (!job.m_error.empty())
+        log_error(job.m_error);
+
+    if (!job.m_ok)
+    {
+        // The bytes that were being saved are still modified, the ones overwritten since then go on top of them.
+        for (auto& [chunk_id, page] : m_overlay)
+        {
+            auto& merged = job.m_overlay.try_emplace(chunk_id, job.m_chunk_size).first->second;
+            page.for_each_run(
+                [&](std::uintmax_t offset, std::uint8_t* data, std::uintmax_t length)
+                {
+                    for (std::uintmax_t i = 0; i < length; ++i)
+                        merged.set(offset + i, data[i]);
+                });
         }
+        m_overlay.swap(job.m_overlay);
+        m_job.reset();
+        return;
+    }
+
+    m_save_method = job.m_method == SaveMethod::NONE ? SaveMethod::IN_PLACE : job.m_method;
+    if (!job.m_pieces && !job.m_atomic)
+    {
+        m_job.reset();
+        return;
+    }
+
+    OverlayMap rebased;
+    if (job.m_pieces)
+    {
+        // The pieces of the new file are the logical bytes at the time the save started. Bytes can only get
+        // overwritten while a save runs, those of the original file and the inserted ones that changed since
+        // then are moved over to their logical offsets.
+        const std::uintmax_t chunk_size = job.m_chunk_size;
+        const auto           set        = [&](std::uintmax_t offset, std::uint8_t value)
+        { rebased.try_emplace(offset / chunk_size, chunk_size).first->second.set(offset % chunk_size, value); };
+
+        std::uintmax_t logical = 0;
+        m_table.for_each(
+            [&](const PieceTable::Piece& piece)
+            {
+                if (piece.m_source == PieceTable::Source::ADD)
+                {
+                    // Inserted bytes shared by a copy cannot change while a save runs.
+                    for (std::uintmax_t i = 0; i < piece.m_length; ++i)
+                    {
+                        if (m_add[piece.m_offset + i] != job.m_add[piece.m_offset + i])
+                            set(logical + i, m_add[piece.m_offset + i]);
+                    }
+                }
+                else if (piece.m_source == PieceTable::Source::ORIGINAL)
+                {
+                    const std::uintmax_t end = piece.m_offset + piece.m_length;
+                    for (auto it = m_overlay.lower_bound(piece.m_offset / chunk_size); it != m_overlay.end() && it->first * chunk_size < end; ++it)
+                    {
+                        it->second.for_each_run(
+                            [&](std::uintmax_t offset, std::uint8_t* data, std::uintmax_t length)
+                            {
+                                for (std::uintmax_t i = 0; i < length; ++i)
+                                {
+                                    const std::uintmax_t original = it->first * chunk_size + offset + i;
+                                    if (original >= piece.m_offset && original < end)
+                                        set(logical + original - piece.m_offset, data[i]);
+                                }
+                            });
+                    }
+                }
+                logical += piece.m_length;
+                return true;
+            });
     }
+    else
+        rebased.swap(m_overlay);
+
+    const fs::path path     = job.m_path;
+    const bool     replaced = job.m_rewrite || job.m_atomic;
+    m_job.reset();
+    if (replaced)
+        reopen(path);
+    else
+        reset_pieces();
+    m_overlay.swap(rebased);
+}
 
-    m_dirty_bytes.clear();
-    m_dirty_chunks.clear();
+bool ByteBuffer::reopen(const fs::path& path)
+{
+    // The prefetcher must not read from the handler while it gets reopened.
+    m_cache.wait_prefetch();
+    m_handler.close();
+    const bool reopened = m_handler.open(path);
+    reset_pieces();
+    if (!reopened)
+    {
+        log_error("Error at ByteBuffer::save(): Could not reopen " + path.string());
+        return false;
+    }
+
+    return true;
+}
+
+void ByteBuffer::reset_pieces()
+{
+    m_cache.reset();
+    m_table.reset(m_handler.size());
+    m_add.clear();
+    m_patterns.clear();
+    m_pastes.clear();
+    m_overlay.clear();
+    m_pasted_chunk = UINTMAX_MAX;
+    m_located      = { { PieceTable::Source::ORIGINAL, 0, 0 }, 0 };
 }
 } // namespace Hexit
@@ -2,31 +2,160 @@
 #define BYTE_BUFFER_H
 
 #include "ChunkCache.h"
+#include "OverlayPage.h"
+#include "PieceTable.h"
+#include <functional>
 #include <map>
+#include <memory>
+#include <span>
 #include <string>
-#include <unordered_map>
 #include <vector>
 
 namespace Hexit
 {
+// How the last save got the changes into the file.
+enum class SaveMethod : std::uint8_t
+{
+    NONE,       // Nothing has been saved yet.
+    IN_PLACE,   // The modified bytes were written into the file.
+    REWRITE,    // The whole file was written into a temporary file that replaced it.
+    REFLINK,    // A clone sharing the unmodified extents with the file was patched and replaced it.
+    COPY_RANGE, // A copy made by the kernel was patched and replaced the file.
+    STREAM,     // A copy streamed through a buffer was patched and replaced the file.
+};
+
+const char* to_string(SaveMethod method);
+
+// The contents of the file along with the changes made to it. Bytes are overwritten in place, inserted and
+// erased bytes are tracked by a piece table that maps the logical offsets onto the original file. Filled,
+// pasted and copied ranges are pieces of the table as well, so they take the same memory whatever their length.
 class ByteBuffer
 {
 public:
-    explicit ByteBuffer(IOHandler& handler);
+    explicit ByteBuffer(IOHandler& handler, const CacheConfig& cache_config = {});
+
+    // Waits for a background save to finish.
+    ~ByteBuffer();
 
     ByteBuffer(const ByteBuffer&) = delete;
 
     ByteBuffer& operator=(const ByteBuffer&) = delete;
 
-    std::uint8_t operator[](std::uintmax_t byte_id);
+    // No bounds checking is performed, is_ok() tells whether an I/O error has occured. Bytes of the most
+    // recently used chunk are served inline as long as no bytes have been inserted or erased.
+    inline std::uint8_t operator[](std::uintmax_t byte_id)
+    {
+        if (m_table.is_original())
+        {
+            if (const auto* byte = m_cache.recent_byte(byte_id); byte)
+            {
+                m_statistics.m_byte_reads++;
+                return *byte;
+            }
+        }
+
+        return read_byte(byte_id);
+    }
+
+    // Copies the bytes starting at byte_id into data, whole runs at a time. Bytes past the end of the buffer
+    // are left alone. Returns false if an I/O error has occured.
+    bool read_range(std::uintmax_t byte_id, std::span<std::uint8_t> data);
+
+    // Reads count bytes starting at byte_id straight from the handler and the pieces, past the cache. Several
+    // threads may call it at the same time, as long as the buffer does not get modified or saved meanwhile.
+    // Errors are only reported through the return value.
+    bool read_direct(std::uintmax_t byte_id, std::uint8_t* data, std::uintmax_t count) const;
+
+    // Returns false if the byte belongs to a filled, pasted or copied range while a background save is running.
+    bool set_byte(std::uintmax_t byte_id, std::uint8_t byte_value);
+
+    // Inserts a byte before byte_id, byte_id equal to size() appends it. Returns false for read only handlers
+    // and while a background save is running.
+    bool insert_byte(std::uintmax_t byte_id, std::uint8_t byte_value);
+
+    // Erases the byte, the last byte that is left cannot be erased. Returns false for read only handlers
+    // and while a background save is running.
+    bool erase_byte(std::uintmax_t byte_id);
+
+    // Overwrites count bytes starting at byte_id with the pattern repeated over and over, clamped to the end
+    // of the buffer. Like the other range operations it returns false for read only handlers and while a
+    // background save is running.
+    bool fill(std::uintmax_t byte_id, std::uintmax_t count, const std::vector<std::uint8_t>& pattern);
+
+    // Overwrites the bytes starting at byte_id with the data, or inserts the data before them. Overwriting
+    // past the end of the buffer grows it.
+    bool paste(std::uintmax_t byte_id, std::span<const std::uint8_t> data, bool insert = false);
+
+    // Same as paste() with the contents of a file, which get read from the file when needed. The file must
+    // not change until the buffer has been saved.
+    bool paste_file(std::uintmax_t byte_id, const fs::path& path, bool insert = false);
 
-    void set_byte(std::uintmax_t byte_id, std::uint8_t byte_value);
+    // Copies count bytes starting at from over the bytes starting at to, or inserts them before those.
+    bool copy(std::uintmax_t from, std::uintmax_t count, std::uintmax_t to, bool insert = false);
 
+    // Overwritten bytes are written in place, or into a copy of the file that then replaces it if atomic saves
+    // are enabled. Ranges that were filled, pasted or moved by a copy get written the same way as long as the
+    // size of the file stays the same. Once bytes have been inserted or erased, or a copy reads from a range that
+    // gets overwritten, the whole file gets rewritten into a temporary file next to it, which then replaces the
+    // original. Blocks until the save has finished.
     void save();
 
-    inline bool is_dirty(std::uintmax_t byte_id) const { return m_dirty_bytes.contains(byte_id); }
+    // Writes count bytes from first on, all of them by default, including the changes, into a new file at path,
+    // which works for read only handlers as well. The buffer stays on its handler and keeps its changes. Blocks
+    // until written, returns false while a background save runs or if path is the file of the handler.
+    bool save_as(const fs::path& path, std::uintmax_t first = 0, std::uintmax_t count = UINTMAX_MAX);
+
+    // Starts saving the changes made so far on a background thread. Bytes can still be read and overwritten
+    // while the save runs, the new changes are kept for the next save. Returns false if there is nothing to
+    // save or a save is already running.
+    bool start_save();
+
+    // Finishes the background save once it is done, returns false while it is still running.
+    bool poll_save();
+
+    // Blocks until the background save is done and finishes it.
+    void wait_save();
+
+    // Asks the background save to stop early, the changes it was saving are kept. It still has to be finished.
+    void cancel_save();
+
+    inline bool is_saving() const { return m_job != nullptr; }
+
+    // The share of the background save that is done, from 0 to 1.
+    double save_progress() const;
+
+    // A crash during an atomic save leaves either the old or the new version of the file behind, never a mix.
+    inline void set_atomic_save(bool atomic) { m_atomic_save = atomic; }
+
+    inline bool is_atomic_save() const { return m_atomic_save; }
+
+    inline SaveMethod save_method() const { return m_save_method; }
+
+    bool is_dirty(std::uintmax_t byte_id) const;
+
+    // The dirty bits of up to 64 bytes starting at byte_id, the bit of the first byte is the lowest one. Matches
+    // read_range(), the bits are gathered a piece and a chunk at a time.
+    std::uint64_t dirty_mask(std::uintmax_t byte_id, std::uintmax_t count) const;
+
+    inline bool has_dirty() const { return !m_table.is_original() || !m_overlay.empty() || m_job; }
+
+    // True once bytes have been inserted or erased, or ranges edited, since the last save.
+    inline bool is_resized() const { return !m_table.is_original(); }
+
+    inline std::uintmax_t size() const { return m_table.size(); }
+
+    // Appends the bytes that arrived at a streaming handler since the last refresh, after all the edits made
+    // so far. Returns true if the buffer grew, never while a save runs.
+    bool refresh();
 
-    inline bool has_dirty() const { return m_dirty_bytes.size() != 0; }
+    // True if refresh() would grow the buffer.
+    inline bool has_pending() const { return !m_job && m_handler.has_pending(); }
+
+    // True while the handler may still receive more bytes.
+    inline bool is_streaming() const { return m_handler.is_streaming(); }
+
+    // True if the handler stopped receiving bytes because of an error.
+    inline bool is_incomplete() const { return m_handler.is_incomplete(); }
 
     inline bool is_read_only() const { return m_cache.is_read_only(); }
 
@@ -34,22 +163,114 @@ public:
 
     const std::string& error_msg() const { return m_error_msg; }
 
-    const std::uintmax_t size;
+    inline const ChunkCache& cache() const { return m_cache; }
+
+    inline const BufferStatistics& statistics() const { return m_statistics; }
 
 private:
+    // Ordered by chunk id, so that saving writes the chunks in the order of the file.
+    typedef std::map<std::uintmax_t, OverlayPage> OverlayMap;
+
+    // The changes that a background save writes, frozen for as long as it runs.
+    struct SaveJob;
+
+    inline const OverlayPage* overlay(std::uintmax_t chunk_id) const
+    {
+        const auto it = m_overlay.find(chunk_id);
+        return it == m_overlay.end() ? nullptr : &it->second;
+    }
+
+    // The page of the chunk that is being saved in the background, if any.
+    const OverlayPage* saving(std::uintmax_t chunk_id) const;
+
+    // The out of line part of operator[].
+    std::uint8_t read_byte(std::uintmax_t byte_id);
+
+    // The cached chunk of the original file, which gets loaded and patched with the changes made to it if
+    // needed. nullptr on failure.
+    ChunkCache::DataChunk* original_chunk(std::uintmax_t chunk_id);
+
+    // Reads a byte of the original file, including the changes made to it.
+    std::uint8_t original_byte(std::uintmax_t offset);
+
+    bool read_original(std::uintmax_t offset, std::uint8_t* data, std::uintmax_t count);
+
+    // The dirty bits of up to 64 overwritten bytes of the original file.
+    std::uint64_t original_mask(std::uintmax_t offset, std::uintmax_t count) const;
+
+    // Reads a byte of a pasted file through a buffer of a chunk.
+    std::uint8_t pasted_byte(std::uint32_t index, std::uintmax_t offset);
+
+    // Replaces the bytes starting at byte_id with the pieces, or inserts the pieces before them.
+    bool place(std::uintmax_t byte_id, const std::vector<PieceTable::Piece>& pieces, bool insert);
+
+    // True if the pieces can be written over the original file, which needs the size to stay the same and
+    // no piece to read bytes of the file that another one overwrites.
+    bool fits_in_place() const;
+
+    // The piece that holds the logical byte, the last piece that got located is kept around.
+    const PieceTable::Location& locate(std::uintmax_t byte_id) const;
+
+    // The following methods run on the thread of the background save. They only read the job and
+    // write through the handler, errors are kept in the job until the save gets finished.
+    void run_save(SaveJob& job);
+
+    // Reads count bytes of the piece, starting skip bytes into it.
+    bool read_piece(SaveJob& job, const PieceTable::Piece& piece, std::uintmax_t skip, std::uint8_t* data, std::uintmax_t count);
+
+    // Hands the pieces that do not sit at their offset in the original file to the writer, in slices of COPY_BUFFER_SIZE.
+    bool write_pieces(SaveJob& job, const std::function<bool(std::uintmax_t, std::uint8_t*, std::uintmax_t)>& writer);
+
+    // Hands the runs of modified bytes to the writer in file order, merged into extents and in batches of SAVE_BATCH.
+    // Chunks with many runs get read whole through the handler, so that the bytes between them go along.
+    bool write_overlay(SaveJob& job, const std::function<bool(const std::vector<ChunkCache::Extent>&)>& writer);
+
+    bool save_in_place(SaveJob& job);
+
+    // Patches a copy of the file, which then replaces the original file.
+    bool save_atomic(SaveJob& job);
+
+    // Writes the pieces into a temporary file, which then replaces the original file.
+    bool save_rewrite(SaveJob& job);
+
+    // Creates an empty temporary file next to the original one, -1 on failure.
+    static int create_temporary(SaveJob& job, std::string& temp);
+
+    // Gives the temporary file the owner and mode of the original file, syncs and closes it and renames it over the
+    // original file. The temporary file is removed instead if written is false.
+    static bool replace_original(SaveJob& job, int fd, const std::string& temp, bool written);
+
+    // Back on the thread of the buffer, applies the outcome of the finished background save.
+    void finish_save();
+
+    // Reopens the handler on the file that replaced the original one.
+    bool reopen(const fs::path& path);
+
+    // Drops the cached chunks and the pieces, once they have been saved.
+    void reset_pieces();
+
     inline void log_error(const std::string& err)
     {
         m_error_msg.reserve(err.size());
         m_error_msg = err;
     }
 
-    typedef std::unordered_map<std::uintmax_t, std::uint8_t>      DirtyByteMap;
-    typedef std::map<std::uintmax_t, std::vector<std::uintmax_t>> DirtyChunkMap;
-
-    DirtyByteMap  m_dirty_bytes;
-    DirtyChunkMap m_dirty_chunks;
-    ChunkCache    m_cache;
-    std::string   m_error_msg;
+    IOHandler&                              m_handler;
+    OverlayMap                              m_overlay; // The overwritten bytes of the original file, one page per chunk.
+    ChunkCache                              m_cache;
+    PieceTable                              m_table;
+    std::vector<std::uint8_t>               m_add; // The inserted bytes, referenced by the ADD pieces.
+    std::vector<std::vector<std::uint8_t>>  m_patterns; // Referenced by the FILL pieces.
+    std::vector<std::shared_ptr<IOHandler>> m_pastes; // The pasted files, referenced by the PASTE pieces.
+    std::vector<std::uint8_t>               m_pasted; // A chunk of a pasted file, read by operator[].
+    std::uint32_t                           m_pasted_index;
+    std::uintmax_t                          m_pasted_chunk;
+    mutable PieceTable::Location            m_located;
+    std::string                             m_error_msg;
+    BufferStatistics                        m_statistics;
+    SaveMethod                              m_save_method;
+    bool                                    m_atomic_save;
+    std::unique_ptr<SaveJob>                m_job; // The running background save.
 };
 } // mamespace Hexit
 #endif // BYTE_BUFFER_H
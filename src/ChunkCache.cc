@@ -1,34 +1,136 @@
 #include "ChunkCache.h"
 #include "IOHandler.h"
+#include "Prefetcher.h"
 
 namespace Hexit
 {
-ChunkCache::ChunkCache(IOHandler& handler)
+namespace
+{
+// The requested number of slots, reduced to what fits in the budget.
+std::uintmax_t initial_slots(const CacheConfig& config)
+{
+    const std::uintmax_t slots      = config.m_slots > 0 ? config.m_slots : 1u;
+    const std::uintmax_t chunk_size = config.m_chunk_size > 0 ? config.m_chunk_size : CHUNK_SIZE;
+    if (!config.m_budget)
+        return slots;
+
+    return std::clamp(config.m_budget->limit() / chunk_size, std::uintmax_t { 1 }, slots);
+}
+} // namespace
+
+ChunkCache::ChunkCache(IOHandler& handler, const CacheConfig& config)
     : m_handler(handler)
-    , m_total_chunks(handler.size() / capacity)
-    , m_id(1)
+    , m_chunk_size(config.m_chunk_size > 0 ? config.m_chunk_size : CHUNK_SIZE)
+    , m_total_chunks(handler.size() / m_chunk_size)
+    , m_budget(config.m_budget)
+    , m_min_slots(initial_slots(config))
+    , m_chunks(m_min_slots)
+    , m_loads_since_check(0)
+    , m_pressure(false)
+    , m_read_ahead(config.m_read_ahead)
 {
-    if (m_handler.size() % capacity)
+    if (m_handler.size() % m_chunk_size)
         m_total_chunks++;
+
+    // Chunks of mapped files point directly into the mapping, so no storage is needed for them.
+    if (!m_handler.mapping())
+    {
+        for (auto& chunk : m_chunks)
+        {
+            chunk.m_storage.resize(m_chunk_size);
+            chunk.m_data = chunk.m_storage.data();
+        }
+    }
+
+    m_index.reserve(m_chunks.size());
+    // Mapped files are read ahead by the kernel, they only need to be given a hint.
+    if (m_read_ahead > 0 && !m_handler.mapping())
+        m_prefetcher = std::make_unique<Prefetcher>(m_handler, m_chunk_size, m_read_ahead);
 }
 
+ChunkCache::~ChunkCache() = default;
+
 bool ChunkCache::load_chunk(std::uintmax_t chunk_id)
 {
-    if (!m_handler.seek(chunk_id * capacity))
+    if (m_budget)
+        adapt_size(chunk_id);
+
+    const std::uintmax_t bytes_to_read = chunk_bytes(chunk_id);
+    auto                 target        = claim_slot(chunk_id);
+
+    bool loaded = false;
+    if (auto* mapping = m_handler.mapping(); mapping)
+    {
+        target->m_data = mapping + chunk_id * m_chunk_size;
+        loaded         = true;
+    }
+    else if (m_prefetcher && m_prefetcher->take(chunk_id, *target))
+    {
+        m_statistics.m_prefetch_hits++;
+        loaded = true;
+    }
+    else
+        loaded = m_handler.read_at(chunk_id * m_chunk_size, target->m_data, bytes_to_read);
+
+    if (!loaded)
+    {
+        release_slot(target);
         return false;
+    }
 
-    std::uintmax_t bytes_to_read = capacity;
-    if (chunk_id == (m_total_chunks - 1) && m_handler.size() % capacity)
-        bytes_to_read = m_handler.size() % capacity;
+    target->m_id    = chunk_id;
+    target->m_count = bytes_to_read;
+    m_index.insert_or_assign(chunk_id, target);
+    m_chunks.splice(m_chunks.begin(), m_chunks, target);
+    m_statistics.m_loads++;
 
-    auto& target_cache = m_chunks[1 - m_id];
-    if (!m_handler.read(target_cache.m_data, bytes_to_read))
+    if (m_read_ahead > 0)
+        read_ahead(chunk_id);
+
+    return true;
+}
+
+bool ChunkCache::load_chunks(const std::vector<std::uintmax_t>& chunk_ids)
+{
+    if (chunk_ids.size() > m_chunks.size())
         return false;
 
-    target_cache.m_id    = chunk_id;
-    target_cache.m_count = bytes_to_read;
-    m_id                 = 1 - m_id;
+    std::vector<IOHandler::Request>  requests;
+    std::vector<ChunkList::iterator> targets;
+    std::uintmax_t                   claimed = 0;
+    for (auto chunk_id : chunk_ids)
+    {
+        if (find(chunk_id))
+            continue;
+
+        auto target = claim_slot(chunk_id);
+        if (auto* mapping = m_handler.mapping(); mapping)
+            target->m_data = mapping + chunk_id * m_chunk_size;
+        else if (m_prefetcher && m_prefetcher->take(chunk_id, *target))
+            m_statistics.m_prefetch_hits++;
+        else
+        {
+            requests.push_back({ chunk_id * m_chunk_size, target->m_data, chunk_bytes(chunk_id), false });
+            targets.push_back(target);
+        }
 
+        // The slot is claimed right away, so that the following chunks do not evict it.
+        target->m_id    = chunk_id;
+        target->m_count = chunk_bytes(chunk_id);
+        m_index.insert_or_assign(chunk_id, target);
+        m_chunks.splice(m_chunks.begin(), m_chunks, target);
+        claimed++;
+    }
+
+    if (!requests.empty() && !m_handler.submit_batch(requests))
+    {
+        // There is no telling which of the requests failed.
+        for (auto target : targets)
+            release_slot(target);
+        return false;
+    }
+
+    m_statistics.m_loads += claimed;
     return true;
 }
 
@@ -37,9 +139,245 @@ bool ChunkCache::save_chunk(const DataChunk& chunk)
     if (m_handler.read_only())
         return false;
 
-    if (!m_handler.seek(chunk.m_id * ChunkCache::capacity))
+    const bool saved = m_handler.write_at(chunk.m_id * m_chunk_size, chunk.m_data, chunk.m_count);
+    m_statistics.m_saves++;
+    // A prefetched copy of the chunk would be stale after the write.
+    if (m_prefetcher)
+        m_prefetcher->discard(chunk.m_id);
+
+    return saved;
+}
+
+bool ChunkCache::save_chunks(const std::vector<const DataChunk*>& chunks)
+{
+    if (m_handler.read_only())
+        return false;
+
+    std::vector<IOHandler::Request> requests;
+    requests.reserve(chunks.size());
+    for (const auto* chunk : chunks)
+        requests.push_back({ chunk->m_id * m_chunk_size, chunk->m_data, chunk->m_count, true });
+
+    const bool saved = m_handler.submit_batch(requests);
+    m_statistics.m_saves += chunks.size();
+    if (m_prefetcher)
+    {
+        for (const auto* chunk : chunks)
+            m_prefetcher->discard(chunk->m_id);
+    }
+
+    return saved;
+}
+
+bool ChunkCache::save_extents(const std::vector<Extent>& extents)
+{
+    if (m_handler.read_only())
         return false;
 
-    return m_handler.write(chunk.m_data, chunk.m_count);
+    std::vector<IOHandler::Request> requests;
+    bool                            saved = true;
+    for (const auto& extent : extents)
+    {
+        if (extent.m_buffers.size() == 1)
+            requests.push_back({ extent.m_offset, extent.m_buffers.front().data(), extent.m_size, true });
+        else
+            saved = m_handler.write_vectored_at(extent.m_offset, extent.m_buffers) && saved;
+    }
+
+    if (!requests.empty())
+        saved = m_handler.submit_batch(requests) && saved;
+    m_statistics.m_saves += extents.size();
+
+    if (m_prefetcher)
+    {
+        for (const auto& extent : extents)
+        {
+            const std::uintmax_t last = (extent.m_offset + extent.m_size - 1) / m_chunk_size;
+            for (std::uintmax_t chunk_id = extent.m_offset / m_chunk_size; chunk_id <= last; ++chunk_id)
+                m_prefetcher->discard(chunk_id);
+        }
+    }
+
+    return saved;
+}
+
+void ChunkCache::wait_prefetch()
+{
+    if (m_prefetcher)
+        m_prefetcher->wait_idle();
+}
+
+void ChunkCache::reset()
+{
+    wait_prefetch();
+    for (auto& chunk : m_chunks)
+    {
+        chunk.m_id    = UINTMAX_MAX;
+        chunk.m_count = 0;
+    }
+
+    m_index.clear();
+    m_ghosts.clear();
+    m_ghost_index.clear();
+    m_scan         = ScanDetector();
+    m_total_chunks = m_handler.size() / m_chunk_size;
+    if (m_handler.size() % m_chunk_size)
+        m_total_chunks++;
+
+    if (m_prefetcher)
+        m_prefetcher = std::make_unique<Prefetcher>(m_handler, m_chunk_size, m_read_ahead);
+}
+
+ChunkCache::DataChunk* ChunkCache::lookup(std::uintmax_t chunk_id)
+{
+    auto it = m_index.find(chunk_id);
+    if (it == m_index.end())
+    {
+        m_statistics.m_misses++;
+        return nullptr;
+    }
+
+    m_statistics.m_hits++;
+    m_chunks.splice(m_chunks.begin(), m_chunks, it->second);
+    return &m_chunks.front();
+}
+
+ChunkCache::ChunkList::iterator ChunkCache::claim_slot(std::uintmax_t chunk_id)
+{
+    if (auto it = m_index.find(chunk_id); it != m_index.end())
+        return it->second;
+
+    auto target = std::prev(m_chunks.end());
+    if (target->m_id != UINTMAX_MAX)
+    {
+        m_index.erase(target->m_id);
+        m_statistics.m_evictions++;
+        if (m_budget)
+        {
+            m_ghosts.push_front(target->m_id);
+            m_ghost_index.insert_or_assign(target->m_id, m_ghosts.begin());
+            trim_ghosts();
+        }
+    }
+
+    return target;
+}
+
+void ChunkCache::release_slot(ChunkList::iterator slot)
+{
+    if (slot->m_id != UINTMAX_MAX)
+        m_index.erase(slot->m_id);
+
+    slot->m_id    = UINTMAX_MAX;
+    slot->m_count = 0;
+    m_chunks.splice(m_chunks.end(), m_chunks, slot);
+}
+
+void ChunkCache::adapt_size(std::uintmax_t chunk_id)
+{
+    if (++m_loads_since_check >= PRESSURE_CHECK_INTERVAL)
+    {
+        m_loads_since_check = 0;
+        m_pressure          = m_budget->under_pressure();
+        if (m_pressure)
+            shrink(std::max(m_min_slots, m_chunks.size() / 2));
+    }
+
+    // Loading a chunk that got evicted recently means that a larger cache would have kept it.
+    auto ghost = m_ghost_index.find(chunk_id);
+    if (ghost == m_ghost_index.end())
+        return;
+
+    m_ghosts.erase(ghost->second);
+    m_ghost_index.erase(ghost);
+    if (m_pressure || m_chunks.size() >= max_slots())
+        return;
+
+    // The new slot is empty, so it is the one that the chunk gets loaded into.
+    auto& slot = m_chunks.emplace_back();
+    if (!m_handler.mapping())
+    {
+        slot.m_storage.resize(m_chunk_size);
+        slot.m_data = slot.m_storage.data();
+    }
+}
+
+void ChunkCache::shrink(std::uintmax_t slots)
+{
+    while (m_chunks.size() > slots)
+    {
+        if (m_chunks.back().m_id != UINTMAX_MAX)
+        {
+            m_index.erase(m_chunks.back().m_id);
+            m_statistics.m_evictions++;
+        }
+        m_chunks.pop_back();
+    }
+
+    trim_ghosts();
+}
+
+void ChunkCache::trim_ghosts()
+{
+    // Evicted chunks are remembered for as long as a cache of up to three times the
+    // current size would have kept them, as far as the budget allows it to grow.
+    const std::uintmax_t capacity = std::min(2 * m_chunks.size(), max_slots() - m_chunks.size());
+    while (m_ghosts.size() > capacity)
+    {
+        m_ghost_index.erase(m_ghosts.back());
+        m_ghosts.pop_back();
+    }
+}
+
+void ChunkCache::grow(std::uintmax_t old_size)
+{
+    m_total_chunks = m_handler.size() / m_chunk_size;
+    if (m_handler.size() % m_chunk_size)
+        m_total_chunks++;
+
+    if (old_size % m_chunk_size == 0)
+        return;
+
+    const std::uintmax_t last = old_size / m_chunk_size;
+    if (m_prefetcher)
+        m_prefetcher->discard(last);
+    if (const auto it = m_index.find(last); it != m_index.end())
+        release_slot(it->second);
+}
+
+std::uintmax_t ChunkCache::chunk_bytes(std::uintmax_t chunk_id) const
+{
+    if (chunk_id == (m_total_chunks - 1) && m_handler.size() % m_chunk_size)
+        return m_handler.size() % m_chunk_size;
+
+    return m_chunk_size;
+}
+
+void ChunkCache::read_ahead(std::uintmax_t chunk_id)
+{
+    const int direction = m_scan.observe(chunk_id);
+    if (direction == 0)
+        return;
+
+    std::vector<Prefetcher::Request> requests;
+    std::uintmax_t                   next = chunk_id;
+    for (std::uintmax_t i = 0; i < m_read_ahead; ++i)
+    {
+        if ((direction > 0 && next + 1 >= m_total_chunks) || (direction < 0 && next == 0))
+            break;
+
+        next = direction > 0 ? next + 1 : next - 1;
+        if (!m_index.contains(next))
+            requests.push_back({ next, chunk_bytes(next) });
+    }
+
+    if (m_prefetcher)
+        m_prefetcher->request(requests);
+    else if (!requests.empty())
+    {
+        const auto first = direction > 0 ? requests.front() : requests.back();
+        const auto last  = direction > 0 ? requests.back() : requests.front();
+        m_handler.will_need(first.m_id * m_chunk_size, (last.m_id - first.m_id) * m_chunk_size + last.m_count);
+    }
 }
 } // namespace Hexit
@@ -2,48 +2,189 @@
 #define CHUNK_CACHE_H
 
 #include "IOHandler.h"
+#include "MemoryBudget.h"
+#include "ScanDetector.h"
+#include "Statistics.h"
+#include "config.h"
+#include <algorithm>
 #include <cstdint>
 #include <filesystem>
+#include <list>
+#include <memory>
+#include <span>
+#include <unordered_map>
+#include <vector>
 
 namespace Hexit
 {
 namespace fs = std::filesystem;
 
+class Prefetcher;
+
+struct CacheConfig
+{
+    std::uintmax_t m_chunk_size = CHUNK_SIZE;  // Size of a chunk in bytes.
+    std::uintmax_t m_slots      = CACHE_SLOTS; // Number of chunks kept in memory, at least one slot is always allocated.
+    std::uintmax_t m_read_ahead = 0;           // Number of chunks prefetched ahead of sequential scans, zero disables prefetching.
+    // Lets the cache grow past m_slots while chunks get reused, as far as the budget allows, and shrink
+    // back under memory pressure. The cache keeps a fixed size without one.
+    const MemoryBudget* m_budget = nullptr;
+};
+
 class ChunkCache
 {
 public:
-    static constexpr std::uintmax_t capacity = 1024u;
-
     struct DataChunk
     {
-        std::uintmax_t m_id             = { UINTMAX_MAX };
-        std::uintmax_t m_count          = { 0 };
-        std::uint8_t   m_data[capacity] = { 0 };
+        std::uintmax_t            m_id    = { UINTMAX_MAX };
+        std::uintmax_t            m_count = { 0 };
+        std::uint8_t*             m_data  = { nullptr }; // Points either to m_storage or into the mapping of the handler.
+        std::vector<std::uint8_t> m_storage;
     };
 
-    explicit ChunkCache(IOHandler& handler);
+    explicit ChunkCache(IOHandler& handler, const CacheConfig& config = {});
+
+    ~ChunkCache();
 
     ChunkCache(const ChunkCache&) = delete;
 
     ChunkCache& operator=(const ChunkCache&) = delete;
 
+    // Loads the chunk into the least recently used slot, which then becomes the most recently used one.
     bool load_chunk(std::uintmax_t chunk_id);
 
     bool save_chunk(const DataChunk& chunk);
 
+    // Loads all the given chunks that are not cached yet with a single batch, they become the most recently
+    // used ones in the given order. No more than slots() chunks can be loaded at once.
+    bool load_chunks(const std::vector<std::uintmax_t>& chunk_ids);
+
+    // Writes all the given chunks with a single batch.
+    bool save_chunks(const std::vector<const DataChunk*>& chunks);
+
+    // A contiguous range of bytes of the file, gathered from several buffers.
+    struct Extent
+    {
+        std::uintmax_t                       m_offset;
+        std::uintmax_t                       m_size;
+        std::vector<std::span<std::uint8_t>> m_buffers;
+    };
+
+    // Writes the given extents, which must not overlap, without loading any chunks. Extents made up of
+    // a single buffer get written with a single batch, the others with a vectored write each.
+    // It only touches the handler and the prefetcher, so a background save may call it while the
+    // cache keeps getting used, as long as nothing else saves at the same time.
+    bool save_extents(const std::vector<Extent>& extents);
+
+    // Returns the cached chunk and marks it as the most recently used one, nullptr in case of a cache miss.
+    inline DataChunk* find(std::uintmax_t chunk_id)
+    {
+        if (m_chunks.front().m_id == chunk_id)
+        {
+            m_statistics.m_hits++;
+            return &m_chunks.front();
+        }
+
+        return lookup(chunk_id);
+    }
+
+    // The byte at offset if the most recently used chunk holds it, nullptr otherwise. Lets readers that go
+    // byte by byte skip the division and the lookup of find() while they stay within a chunk.
+    inline std::uint8_t* recent_byte(std::uintmax_t offset)
+    {
+        DataChunk&           chunk    = m_chunks.front();
+        const std::uintmax_t relative = offset - chunk.m_id * m_chunk_size;
+        if (relative >= chunk.m_count)
+            return nullptr;
+
+        m_statistics.m_hits++;
+        return chunk.m_data + relative;
+    }
+
+    // Returns the cached chunk without marking it as used or counting the lookup, nullptr if it is not cached.
+    inline const DataChunk* peek(std::uintmax_t chunk_id) const
+    {
+        const auto it = m_index.find(chunk_id);
+        return it == m_index.end() ? nullptr : &*it->second;
+    }
+
+    // Blocks until the prefetcher has served all of its pending requests.
+    void wait_prefetch();
+
+    // Forgets all the cached and prefetched chunks, once the handler has been reopened with new contents.
+    // The prefetcher must be idle while the handler gets reopened, see wait_prefetch().
+    void reset();
+
+    // Takes in the bytes appended to the handler since it had old_size bytes. The cached chunks stay valid,
+    // except for the last one if it was only partly filled.
+    void grow(std::uintmax_t old_size);
+
     inline std::uintmax_t total_chunks() const { return m_total_chunks; }
 
-    inline DataChunk& recent() { return m_chunks[m_id]; }
+    inline std::uintmax_t chunk_size() const { return m_chunk_size; }
+
+    inline std::uintmax_t slots() const { return m_chunks.size(); }
 
-    inline DataChunk& fallback() { return m_chunks[1 - m_id]; }
+    // The number of slots the cache may grow to.
+    inline std::uintmax_t max_slots() const
+    {
+        return m_budget ? std::max(m_min_slots, m_budget->limit() / m_chunk_size) : m_chunks.size();
+    }
+
+    // Memory held by the chunks in bytes, chunks of mapped files take up none.
+    inline std::uintmax_t footprint() const { return m_handler.mapping() ? 0u : m_chunks.size() * m_chunk_size; }
+
+    inline DataChunk& recent() { return m_chunks.front(); }
 
     inline bool is_read_only() const { return m_handler.read_only(); }
 
+    // Number of slots that hold a chunk.
+    inline std::uintmax_t used_slots() const { return m_index.size(); }
+
+    inline const CacheStatistics& statistics() const { return m_statistics; }
+
 private:
-    IOHandler&    m_handler;
-    std::uintmax_t m_total_chunks;
-    DataChunk     m_chunks[2];
-    std::uint8_t  m_id; // id of the most recently used chunk.
+    typedef std::list<DataChunk>                                    ChunkList;
+    typedef std::unordered_map<std::uintmax_t, ChunkList::iterator> ChunkIndex;
+    typedef std::list<std::uintmax_t>                               GhostList;
+    typedef std::unordered_map<std::uintmax_t, GhostList::iterator> GhostIndex;
+
+    DataChunk* lookup(std::uintmax_t chunk_id);
+
+    // Evicts the least recently used chunk, unless chunk_id is already cached, and returns its slot.
+    ChunkList::iterator claim_slot(std::uintmax_t chunk_id);
+
+    // Marks the slot as empty and makes it the first candidate for eviction.
+    void release_slot(ChunkList::iterator slot);
+
+    std::uintmax_t chunk_bytes(std::uintmax_t chunk_id) const;
+
+    // Grows the cache on reuse of recently evicted chunks and shrinks it under memory pressure.
+    void adapt_size(std::uintmax_t chunk_id);
+
+    // Drops the least recently used slots until only the given number of them is left.
+    void shrink(std::uintmax_t slots);
+
+    // Forgets the evicted chunks that are too old to justify growing the cache.
+    void trim_ghosts();
+
+    void read_ahead(std::uintmax_t chunk_id);
+
+    IOHandler&                  m_handler;
+    const std::uintmax_t        m_chunk_size;
+    std::uintmax_t              m_total_chunks;
+    const MemoryBudget*         m_budget;
+    const std::uintmax_t        m_min_slots; // The cache never shrinks below it.
+    ChunkList                   m_chunks; // Ordered from the most to the least recently used chunk.
+    ChunkIndex                  m_index;
+    GhostList                   m_ghosts; // Ids of recently evicted chunks, ordered from the most to the least recent.
+    GhostIndex                  m_ghost_index;
+    std::uintmax_t              m_loads_since_check;
+    bool                        m_pressure;
+    const std::uintmax_t        m_read_ahead;
+    ScanDetector                m_scan;
+    std::unique_ptr<Prefetcher> m_prefetcher;
+    CacheStatistics             m_statistics;
 };
 } // namespace Hexit
 #endif // CHUNK_CACHE_H
@@ -1,4 +1,5 @@
 #include "FileHandler.h"
+#include <sys/stat.h>
 
 namespace Hexit
 {
@@ -42,6 +43,8 @@ bool FileHandler::read(std::uint8_t* o_buffer, std::uintmax_t buffer_size)
     if (buffer_size == 0)
         return true;
 
+    ScopedTimer timer(m_statistics.m_io_ns);
+    m_statistics.count_read(buffer_size);
     m_stream.read(reinterpret_cast<char*>(o_buffer), buffer_size);
 
     return static_cast<std::uintmax_t>(m_stream.gcount()) == buffer_size;
@@ -55,6 +58,8 @@ bool FileHandler::write(const std::uint8_t* i_buffer, std::uintmax_t buffer_size
     if (!m_stream.is_open())
         return false;
 
+    ScopedTimer timer(m_statistics.m_io_ns);
+    m_statistics.count_write(buffer_size);
     // operator bool is explicit...
     return static_cast<bool>(
         m_stream.write(reinterpret_cast<const char*>(i_buffer), buffer_size));
@@ -67,4 +72,13 @@ bool FileHandler::seek(std::uintmax_t offset)
 
     return static_cast<bool>(m_stream.seekg(offset));
 }
+
+std::uintmax_t FileHandler::block_size() const
+{
+    struct stat st;
+    if (!m_stream.is_open() || ::stat(m_name.c_str(), &st) != 0 || st.st_blksize <= 0)
+        return 0;
+
+    return static_cast<std::uintmax_t>(st.st_blksize);
+}
 } // namepsace Hexit
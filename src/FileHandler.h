@@ -23,6 +23,8 @@ public:
 
     bool seek(std::uintmax_t offset) override;
 
+    std::uintmax_t block_size() const override;
+
 private:
     std::fstream m_stream;
 };
@@ -0,0 +1,34 @@
+#include "Frame.h"
+
+namespace Hexit
+{
+void Frame::resize(std::uintmax_t lines)
+{
+    if (lines != m_lines.size())
+        m_lines.assign(lines, {});
+}
+
+void Frame::invalidate()
+{
+    m_lines.assign(m_lines.size(), {});
+}
+
+std::uint64_t Frame::update(std::uintmax_t line, std::uintmax_t offset, const Line& cells)
+{
+    if (line >= m_lines.size())
+        return ALL_CELLS;
+
+    Drawn&        drawn   = m_lines[line];
+    std::uint64_t changed = 0;
+    if (drawn.m_offset != offset || drawn.m_cells[0].m_style == Style::NONE)
+        changed = ALL_CELLS;
+    else
+    {
+        for (std::uint32_t i = 0; i < BYTES_PER_LINE; ++i)
+            changed |= std::uint64_t { drawn.m_cells[i] != cells[i] } << i;
+    }
+
+    drawn = { offset, cells };
+    return changed;
+}
+} // namespace Hexit
@@ -0,0 +1,63 @@
+#ifndef FRAME_H
+#define FRAME_H
+
+#include "config.h"
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace Hexit
+{
+// The cells of the hex lines as they were last drawn, so that drawing a line again only touches the cells
+// that changed since. ncurses already sends only the changed characters of the screen to the terminal, the
+// frame saves building the rest of them. Whatever clears the screen has to invalidate() the frame.
+class Frame
+{
+public:
+    static_assert(BYTES_PER_LINE <= 64, "The changes of a line have to fit in 64 bits");
+
+    static constexpr std::uint64_t ALL_CELLS = BYTES_PER_LINE == 64 ? ~std::uint64_t { 0 } : (std::uint64_t { 1 } << BYTES_PER_LINE) - 1;
+
+    enum class Style : std::uint8_t
+    {
+        NONE,        // Never drawn.
+        PLAIN,
+        DIRTY,
+        HIT,
+        CURSOR,      // The cursor in ASCII mode, over the whole byte.
+        CURSOR_HIGH, // The cursor in HEX mode, over the high nibble.
+        CURSOR_LOW,  // The cursor in HEX mode, over the low nibble.
+        PADDING,     // Past the end of the buffer.
+    };
+
+    struct Cell
+    {
+        std::uint8_t m_byte;
+        Style        m_style;
+
+        inline bool operator==(const Cell&) const = default;
+    };
+
+    using Line = std::array<Cell, BYTES_PER_LINE>;
+
+    // Keeps the given number of lines from now on, dropping the cells if it changes.
+    void resize(std::uintmax_t lines);
+
+    // Drops the cells, so that every one of them gets drawn again.
+    void invalidate();
+
+    // Stores the cells of a line that shows the bytes from offset on, and returns one bit per cell that differs
+    // from the one drawn before. A line that showed another offset before changes completely.
+    std::uint64_t update(std::uintmax_t line, std::uintmax_t offset, const Line& cells);
+
+private:
+    struct Drawn
+    {
+        std::uintmax_t m_offset;
+        Line           m_cells;
+    };
+
+    std::vector<Drawn> m_lines;
+};
+} // namespace Hexit
+#endif // FRAME_H
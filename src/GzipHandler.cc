@@ -0,0 +1,510 @@
+#include "GzipHandler.h"
+#include "Utilities.h"
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <fcntl.h>
+#include <fstream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace Hexit
+{
+namespace
+{
+// Inflate never looks further back than this.
+constexpr std::uintmax_t WINDOW_SIZE = 32768;
+// Identifies the format of the cached indexes, which are kept in the native byte order.
+constexpr char INDEX_MAGIC[8] = { 'H', 'X', 'G', 'Z', 'I', 'D', 'X', '1' };
+
+ssize_t pread_some(int fd, void* data, std::uintmax_t size, std::uintmax_t offset)
+{
+    ssize_t count = 0;
+    do
+        count = ::pread(fd, data, size, static_cast<off_t>(offset));
+    while (count < 0 && errno == EINTR);
+    return count;
+}
+} // namespace
+
+GzipHandler::GzipHandler(const fs::path& index_directory, std::uintmax_t span)
+    : IOHandler(true)
+    , m_index_directory(index_directory)
+    , m_span(std::max(span, WINDOW_SIZE))
+    , m_fd(-1)
+    , m_offset(0u)
+    , m_compressed_size(0u)
+    , m_mtime(0)
+    , m_cached(false)
+    , m_inflated(0u)
+    , m_finished(true)
+    , m_stop(false)
+    , m_stream()
+    , m_stream_active(false)
+    , m_stream_raw(false)
+    , m_stream_out(0u)
+    , m_stream_in(0u)
+{
+}
+
+GzipHandler::~GzipHandler()
+{
+    close();
+}
+
+bool GzipHandler::open(const fs::path& path)
+{
+    if (m_fd >= 0)
+        return false;
+
+    m_fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (m_fd < 0)
+        return false;
+
+    struct stat  status;
+    std::uint8_t magic[2] = { 0, 0 };
+    if (::fstat(m_fd, &status) != 0
+        || pread_some(m_fd, magic, sizeof(magic), 0) != sizeof(magic)
+        || magic[0] != 0x1F
+        || magic[1] != 0x8B)
+    {
+        close();
+        return false;
+    }
+
+    m_name            = path;
+    m_offset          = 0;
+    m_compressed_size = static_cast<std::uintmax_t>(status.st_size);
+    m_mtime           = static_cast<std::int64_t>(status.st_mtim.tv_sec) * 1000000000 + status.st_mtim.tv_nsec;
+    m_input.resize(GZIP_INPUT_SIZE);
+    m_discard.resize(WINDOW_SIZE);
+    m_cached = load_index();
+    if (!m_cached)
+    {
+        m_inflated = 0;
+        m_finished = false;
+        m_stop     = false;
+        m_builder  = std::thread(&GzipHandler::build_index, this);
+
+        // Like standard input, the file gets shown as soon as there is something to show.
+        std::unique_lock<std::mutex> lock(m_index_lock);
+        m_progress.wait(lock, [this]()
+                        { return m_inflated > 0 || m_finished; });
+    }
+
+    refresh();
+    if (m_size == 0)
+    {
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+void GzipHandler::close()
+{
+    m_stop = true;
+    if (m_builder.joinable())
+        m_builder.join();
+
+    std::lock_guard<std::mutex> lock(m_lock);
+    if (m_stream_active)
+        inflateEnd(&m_stream);
+    if (m_fd >= 0)
+        ::close(m_fd);
+
+    {
+        std::lock_guard<std::mutex> index_lock(m_index_lock);
+        m_checkpoints.clear();
+    }
+    m_fd            = -1;
+    m_stream_active = false;
+    m_cached        = false;
+    m_inflated      = 0;
+    m_finished      = true;
+    m_size          = 0;
+    m_offset        = 0;
+    m_name          = "";
+}
+
+bool GzipHandler::read(std::uint8_t* o_buffer, std::uintmax_t buffer_size)
+{
+    return read_at(m_offset, o_buffer, buffer_size);
+}
+
+bool GzipHandler::write(const std::uint8_t* i_buffer, std::uintmax_t buffer_size)
+{
+    static_cast<void>(i_buffer);
+    static_cast<void>(buffer_size);
+    return false;
+}
+
+bool GzipHandler::seek(std::uintmax_t offset)
+{
+    if (m_size == 0 || offset >= m_size)
+        return false;
+
+    m_offset = offset;
+    return true;
+}
+
+bool GzipHandler::read_at(std::uintmax_t offset, std::uint8_t* o_buffer, std::uintmax_t buffer_size)
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    if (!o_buffer
+        || m_size == 0
+        || (buffer_size + offset) > m_size)
+        return false;
+
+    // Sequential reads carry on with the stream, which only restarts when the read goes back or the next
+    // checkpoint is closer than it.
+    if (!m_stream_active || offset < m_stream_out || offset - m_stream_out > m_span)
+    {
+        Checkpoint checkpoint;
+        bool       found = false;
+        {
+            std::lock_guard<std::mutex> index_lock(m_index_lock);
+            const auto                  it = std::upper_bound(m_checkpoints.begin(),
+                                                              m_checkpoints.end(),
+                                                              offset,
+                                                              [](std::uintmax_t value, const Checkpoint& point)
+                                                              { return value < point.m_out; });
+            if (it != m_checkpoints.begin())
+            {
+                checkpoint = *std::prev(it);
+                found      = true;
+            }
+        }
+
+        if ((!m_stream_active || offset < m_stream_out || (found && checkpoint.m_out > m_stream_out))
+            && !restart(found ? &checkpoint : nullptr))
+            return false;
+    }
+
+    if (!inflate_to(nullptr, offset - m_stream_out) || !inflate_to(o_buffer, buffer_size))
+    {
+        inflateEnd(&m_stream);
+        m_stream_active = false;
+        return false;
+    }
+
+    m_statistics.count_read(buffer_size);
+    return true;
+}
+
+bool GzipHandler::refresh()
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    const std::uintmax_t        inflated = m_inflated.load(std::memory_order_acquire);
+    if (inflated == m_size)
+        return false;
+
+    m_size = inflated;
+    return true;
+}
+
+bool GzipHandler::is_streaming() const
+{
+    return !m_finished.load(std::memory_order_acquire) || m_inflated.load(std::memory_order_acquire) != m_size;
+}
+
+std::uintmax_t GzipHandler::checkpoints() const
+{
+    std::lock_guard<std::mutex> lock(m_index_lock);
+    return m_checkpoints.size();
+}
+
+fs::path GzipHandler::index_path(const fs::path& path) const
+{
+    return cache_file(m_index_directory, path, "gzindex");
+}
+
+fs::path GzipHandler::default_index_directory()
+{
+    return cache_directory();
+}
+
+void GzipHandler::build_index()
+{
+    z_stream           stream {};
+    std::vector<Bytef> input(GZIP_INPUT_SIZE);
+    std::vector<Bytef> window(WINDOW_SIZE, 0);
+    std::vector<Bytef> linear(WINDOW_SIZE);
+    std::uintmax_t     read     = 0; // Offset of the next compressed byte to read.
+    std::uintmax_t     consumed = 0;
+    std::uintmax_t     inflated = 0;
+    std::uintmax_t     last     = 0; // Output offset of the last checkpoint.
+    bool               complete = false;
+    const auto         publish  = [this](std::uintmax_t total)
+    {
+        if (m_inflated.load(std::memory_order_relaxed) == 0)
+        {
+            std::lock_guard<std::mutex> lock(m_index_lock);
+            m_inflated.store(total, std::memory_order_release);
+            m_progress.notify_all();
+        }
+        else
+            m_inflated.store(total, std::memory_order_release);
+    };
+
+    if (inflateInit2(&stream, 15 + 16) != Z_OK)
+        m_stop = true;
+
+    while (!m_stop)
+    {
+        if (stream.avail_in == 0)
+        {
+            const ssize_t count = pread_some(m_fd, input.data(), input.size(), read);
+            if (count <= 0)
+                break;
+
+            read += static_cast<std::uintmax_t>(count);
+            stream.next_in  = input.data();
+            stream.avail_in = static_cast<uInt>(count);
+        }
+
+        // The output goes round the window, which then always holds the last 32 KiB of it.
+        if (stream.avail_out == 0)
+        {
+            stream.next_out  = window.data();
+            stream.avail_out = WINDOW_SIZE;
+        }
+
+        // Z_BLOCK stops at the end of every deflate block, the only places where inflate can resume.
+        const uInt in  = stream.avail_in;
+        const uInt out = stream.avail_out;
+        const int  ret = inflate(&stream, Z_BLOCK);
+        consumed += in - stream.avail_in;
+        inflated += out - stream.avail_out;
+        if (ret == Z_STREAM_END)
+        {
+            // Another member may follow. Anything else after the end is ignored, the way gzip does.
+            publish(inflated);
+            if (stream.avail_in == 0)
+            {
+                const ssize_t count = pread_some(m_fd, input.data(), input.size(), read);
+                read += static_cast<std::uintmax_t>(std::max<ssize_t>(count, 0));
+                stream.next_in  = input.data();
+                stream.avail_in = static_cast<uInt>(std::max<ssize_t>(count, 0));
+            }
+            if (stream.avail_in == 0 || stream.next_in[0] != 0x1F || inflateReset(&stream) != Z_OK)
+            {
+                complete = true;
+                break;
+            }
+            continue;
+        }
+
+        if (ret != Z_OK && ret != Z_BUF_ERROR)
+            break;
+
+        publish(inflated);
+        if ((stream.data_type & 128) && !(stream.data_type & 64) && (inflated == 0 || inflated - last >= m_span))
+        {
+            const std::uintmax_t left = stream.avail_out;
+            std::copy(window.begin() + static_cast<std::ptrdiff_t>(WINDOW_SIZE - left), window.end(), linear.begin());
+            std::copy(window.begin(), window.begin() + static_cast<std::ptrdiff_t>(WINDOW_SIZE - left), linear.begin() + static_cast<std::ptrdiff_t>(left));
+
+            Checkpoint checkpoint { inflated, consumed, static_cast<std::uint8_t>(stream.data_type & 7), {} };
+            uLongf     size = compressBound(WINDOW_SIZE);
+            checkpoint.m_window.resize(size);
+            if (compress2(checkpoint.m_window.data(), &size, linear.data(), WINDOW_SIZE, Z_BEST_SPEED) != Z_OK)
+                break;
+            checkpoint.m_window.resize(size);
+
+            std::lock_guard<std::mutex> lock(m_index_lock);
+            m_checkpoints.push_back(std::move(checkpoint));
+            last = inflated;
+        }
+    }
+
+    inflateEnd(&stream);
+    // A truncated or corrupt file shows as far as it could be inflated, its index does not get cached.
+    if (complete && !m_stop)
+        save_index();
+
+    std::lock_guard<std::mutex> lock(m_index_lock);
+    m_finished.store(true, std::memory_order_release);
+    m_progress.notify_all();
+}
+
+bool GzipHandler::load_index()
+{
+    if (m_index_directory.empty())
+        return false;
+
+    std::ifstream file(index_path(m_name), std::ios::binary);
+    if (!file)
+        return false;
+
+    const std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    std::size_t       position = sizeof(INDEX_MAGIC);
+    std::uintmax_t    size     = 0;
+    std::int64_t      mtime    = 0;
+    std::uintmax_t    span     = 0;
+    std::uintmax_t    total    = 0;
+    std::uintmax_t    count    = 0;
+    std::uintmax_t    length   = 0;
+    if (data.compare(0, sizeof(INDEX_MAGIC), INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0
+        || !get(data, position, size)
+        || !get(data, position, mtime)
+        || !get(data, position, span)
+        || !get(data, position, total)
+        || !get(data, position, length)
+        || data.size() - position < length
+        || data.compare(position, length, fs::absolute(m_name).lexically_normal().string()) != 0
+        || size != m_compressed_size
+        || mtime != m_mtime
+        || span != m_span)
+        return false;
+
+    position += length;
+    std::vector<Checkpoint> checkpoints;
+    if (!get(data, position, count))
+        return false;
+    for (std::uintmax_t i = 0; i < count; ++i)
+    {
+        Checkpoint checkpoint;
+        if (!get(data, position, checkpoint.m_out)
+            || !get(data, position, checkpoint.m_in)
+            || !get(data, position, checkpoint.m_bits)
+            || !get(data, position, length)
+            || data.size() - position < length
+            || checkpoint.m_in > m_compressed_size
+            || checkpoint.m_bits > 7)
+            return false;
+
+        checkpoint.m_window.assign(data.begin() + static_cast<std::ptrdiff_t>(position), data.begin() + static_cast<std::ptrdiff_t>(position + length));
+        position += length;
+        checkpoints.push_back(std::move(checkpoint));
+    }
+
+    std::lock_guard<std::mutex> lock(m_index_lock);
+    m_checkpoints.swap(checkpoints);
+    m_inflated = total;
+    return true;
+}
+
+bool GzipHandler::save_index() const
+{
+    if (m_index_directory.empty())
+        return false;
+
+    std::string       data(INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    const std::string name = fs::absolute(m_name).lexically_normal().string();
+    put(data, m_compressed_size);
+    put(data, m_mtime);
+    put(data, m_span);
+    put(data, m_inflated.load());
+    put(data, static_cast<std::uintmax_t>(name.size()));
+    data.append(name);
+    {
+        std::lock_guard<std::mutex> lock(m_index_lock);
+        put(data, static_cast<std::uintmax_t>(m_checkpoints.size()));
+        for (const auto& checkpoint : m_checkpoints)
+        {
+            put(data, checkpoint.m_out);
+            put(data, checkpoint.m_in);
+            put(data, checkpoint.m_bits);
+            put(data, static_cast<std::uintmax_t>(checkpoint.m_window.size()));
+            data.append(reinterpret_cast<const char*>(checkpoint.m_window.data()), checkpoint.m_window.size());
+        }
+    }
+
+    return write_file_atomically(index_path(m_name), data);
+}
+
+bool GzipHandler::restart(const Checkpoint* checkpoint)
+{
+    if (m_stream_active)
+        inflateEnd(&m_stream);
+
+    m_stream        = {};
+    m_stream_active = false;
+    if (!checkpoint)
+    {
+        m_stream_raw = false;
+        m_stream_in  = 0;
+        m_stream_out = 0;
+        return (m_stream_active = inflateInit2(&m_stream, 15 + 16) == Z_OK);
+    }
+
+    // The checkpoints sit inside the deflate data of a member, past its gzip header.
+    if (inflateInit2(&m_stream, -15) != Z_OK)
+        return false;
+
+    m_stream_active = true;
+    m_stream_raw    = true;
+    m_stream_in     = checkpoint->m_in;
+    m_stream_out    = checkpoint->m_out;
+    if (checkpoint->m_bits > 0)
+    {
+        std::uint8_t byte = 0;
+        if (pread_some(m_fd, &byte, 1, --m_stream_in) != 1)
+            return false;
+
+        m_stream_in++;
+        inflatePrime(&m_stream, checkpoint->m_bits, byte >> (8 - checkpoint->m_bits));
+    }
+
+    uLongf size = WINDOW_SIZE;
+    return uncompress(m_discard.data(), &size, checkpoint->m_window.data(), checkpoint->m_window.size()) == Z_OK
+        && inflateSetDictionary(&m_stream, m_discard.data(), static_cast<uInt>(size)) == Z_OK;
+}
+
+bool GzipHandler::inflate_to(std::uint8_t* data, std::uintmax_t count)
+{
+    while (count > 0)
+    {
+        if (m_stream.avail_in == 0 && !fill_input())
+            return false;
+
+        const std::uintmax_t limit = data ? UINT_MAX : m_discard.size();
+        m_stream.next_out          = data ? data : m_discard.data();
+        m_stream.avail_out         = static_cast<uInt>(std::min(count, limit));
+        const uInt out             = m_stream.avail_out;
+        const int  ret             = inflate(&m_stream, Z_NO_FLUSH);
+        const uInt produced        = out - m_stream.avail_out;
+        m_stream_out += produced;
+        count -= produced;
+        if (data)
+            data += produced;
+
+        if (ret == Z_STREAM_END)
+        {
+            // The next member starts with a gzip header, a raw stream first has to skip the trailer of its own.
+            for (std::uintmax_t trailer = m_stream_raw ? 8 : 0; trailer > 0;)
+            {
+                if (m_stream.avail_in == 0 && !fill_input())
+                    return false;
+
+                const uInt skip = static_cast<uInt>(std::min<std::uintmax_t>(trailer, m_stream.avail_in));
+                m_stream.next_in += skip;
+                m_stream.avail_in -= skip;
+                trailer -= skip;
+            }
+
+            m_stream_raw = false;
+            if (inflateReset2(&m_stream, 15 + 16) != Z_OK)
+                return false;
+        }
+        else if (ret != Z_OK && ret != Z_BUF_ERROR)
+            return false;
+    }
+
+    return true;
+}
+
+bool GzipHandler::fill_input()
+{
+    const ssize_t count = pread_some(m_fd, m_input.data(), m_input.size(), m_stream_in);
+    if (count <= 0)
+        return false;
+
+    m_stream_in += static_cast<std::uintmax_t>(count);
+    m_stream.next_in  = m_input.data();
+    m_stream.avail_in = static_cast<uInt>(count);
+    return true;
+}
+} // namespace Hexit
@@ -0,0 +1,107 @@
+#ifndef GZIP_HANDLER_H
+#define GZIP_HANDLER_H
+
+#include "IOHandler.h"
+#include "config.h"
+#include <atomic>
+#include <condition_variable>
+#include <string>
+#include <thread>
+#include <vector>
+#include <zlib.h>
+
+namespace Hexit
+{
+// Presents the decompressed contents of a gzip file, read only. A background thread inflates the file once
+// and records a checkpoint every GZIP_CHECKPOINT_SPAN bytes of output: the position in the compressed file
+// along with the 32 KiB of output that precede it, which is all inflate needs to resume there. Reads inflate
+// from the closest checkpoint before them, and sequential reads carry on with the stream of the previous one.
+// Like standard input, size() grows on refresh() while the index is being built. The finished index gets
+// cached in index_directory, keyed by the path, size and modification time of the file, so that reopening
+// the file skips the first pass. An empty index_directory disables the cache.
+class GzipHandler : public IOHandler
+{
+public:
+    explicit GzipHandler(const fs::path& index_directory = default_index_directory(), std::uintmax_t span = GZIP_CHECKPOINT_SPAN);
+
+    ~GzipHandler();
+
+    // Returns once the first bytes have been inflated, false if the file is not gzip compressed or empty.
+    bool open(const fs::path& path) override;
+
+    void close() override;
+
+    bool read(std::uint8_t* o_buffer, std::uintmax_t buffer_size) override;
+
+    bool write(const std::uint8_t* i_buffer, std::uintmax_t buffer_size) override;
+
+    bool seek(std::uintmax_t offset) override;
+
+    bool read_at(std::uintmax_t offset, std::uint8_t* o_buffer, std::uintmax_t buffer_size) override;
+
+    bool refresh() override;
+
+    bool is_streaming() const override;
+
+    // True if the index was loaded from the cache instead of being built.
+    inline bool is_index_cached() const { return m_cached; }
+
+    // The number of checkpoints recorded so far.
+    std::uintmax_t checkpoints() const;
+
+    // Where the index of the file at path gets cached.
+    fs::path index_path(const fs::path& path) const;
+
+    // $XDG_CACHE_HOME/hexit, or ~/.cache/hexit, empty if neither is set.
+    static fs::path default_index_directory();
+
+private:
+    struct Checkpoint
+    {
+        std::uintmax_t     m_out;    // Offset of the decompressed byte it resumes at.
+        std::uintmax_t     m_in;     // Offset of the first compressed byte that is not fully consumed.
+        std::uint8_t       m_bits;   // Bits of the byte before m_in that still belong to the stream.
+        std::vector<Bytef> m_window; // The output that precedes it, compressed with deflate.
+    };
+
+    // Inflates the whole file and records the checkpoints, on the background thread.
+    void build_index();
+
+    bool load_index();
+
+    bool save_index() const;
+
+    // Restarts the read stream at the given checkpoint, or at the start of the file if there is none.
+    bool restart(const Checkpoint* checkpoint);
+
+    // Inflates count bytes with the read stream, into data or into m_discard if data is nullptr.
+    bool inflate_to(std::uint8_t* data, std::uintmax_t count);
+
+    // Refills the input of the read stream, false at the end of the file.
+    bool fill_input();
+
+    const fs::path              m_index_directory;
+    const std::uintmax_t        m_span;
+    int                         m_fd;
+    std::uintmax_t              m_offset;
+    std::uintmax_t              m_compressed_size;
+    std::int64_t                m_mtime;
+    bool                        m_cached;
+    std::vector<Checkpoint>     m_checkpoints; // Guarded by m_index_lock.
+    mutable std::mutex          m_index_lock;
+    std::atomic<std::uintmax_t> m_inflated; // The output of the first pass so far.
+    std::atomic<bool>           m_finished;
+    std::atomic<bool>           m_stop;
+    std::condition_variable     m_progress; // Signalled by the first pass, along with m_index_lock.
+    std::thread                 m_builder;
+    // The read stream, guarded by m_lock.
+    z_stream                    m_stream;
+    bool                        m_stream_active;
+    bool                        m_stream_raw; // Inflating raw deflate data after a restart at a checkpoint.
+    std::uintmax_t              m_stream_out; // Offset of the next decompressed byte.
+    std::uintmax_t              m_stream_in;  // Offset of the next compressed byte to read.
+    std::vector<Bytef>          m_input;
+    std::vector<Bytef>          m_discard;
+};
+} // namespace Hexit
+#endif // GZIP_HANDLER_H
@@ -0,0 +1,309 @@
+#include "HitIndex.h"
+#include <algorithm>
+
+namespace Hexit
+{
+HitIndex::HitIndex(Searcher::Reader reader, unsigned threads)
+    : m_reader(std::move(reader))
+    , m_threads(threads ? threads : std::max(1u, std::thread::hardware_concurrency()))
+    , m_count(0)
+    , m_last(0)
+    , m_scanned(0)
+    , m_positions(0)
+    , m_claimed(0)
+    , m_running(0)
+    , m_stop(false)
+    , m_failed(false)
+    , m_full(false)
+{
+}
+
+HitIndex::~HitIndex()
+{
+    stop();
+}
+
+void HitIndex::start(const Searcher::Pattern& pattern, std::uintmax_t size)
+{
+    clear();
+    m_pattern = pattern;
+    resume(size);
+}
+
+void HitIndex::resume(std::uintmax_t size)
+{
+    if (m_pattern.empty() || is_running() || failed() || is_full())
+        return;
+
+    join();
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_positions = size >= m_pattern.size() ? size - m_pattern.size() + 1 : 0;
+    if (m_scanned >= m_positions)
+        return;
+
+    // Blocks that were done past one the last stop interrupted get scanned again.
+    m_done.clear();
+    const std::uintmax_t blocks  = (m_positions - m_scanned + SEARCH_BLOCK_SIZE - 1) / SEARCH_BLOCK_SIZE;
+    const unsigned       threads = static_cast<unsigned>(std::min<std::uintmax_t>(m_threads, blocks));
+    m_claimed                    = m_scanned;
+    m_stop                       = false;
+    m_running                    = threads;
+    for (unsigned i = 0; i < threads; ++i)
+        m_workers.emplace_back(&HitIndex::run, this);
+}
+
+void HitIndex::stop()
+{
+    m_stop = true;
+    join();
+}
+
+void HitIndex::invalidate(std::uintmax_t byte_id)
+{
+    if (m_pattern.empty())
+        return;
+
+    stop();
+    std::lock_guard<std::mutex> lock(m_lock);
+    // A hit covers the pattern size bytes from its offset on.
+    const std::uintmax_t cut = byte_id >= m_pattern.size() - 1 ? byte_id - (m_pattern.size() - 1) : 0;
+    const std::uintmax_t hit = first_at(cut);
+    m_scanned                = std::min(m_scanned, cut);
+    m_failed                 = false;
+    m_full                   = false;
+    if (hit == m_count)
+        return;
+
+    if (hit == 0)
+    {
+        m_heads.clear();
+        m_deltas.clear();
+    }
+    else
+    {
+        const Cursor cursor = seek(hit - 1);
+        m_deltas.resize(hit % HIT_INDEX_BLOCK ? cursor.m_position : m_heads[hit / HIT_INDEX_BLOCK].m_position);
+        m_heads.resize((hit + HIT_INDEX_BLOCK - 1) / HIT_INDEX_BLOCK);
+        m_last = cursor.m_offset;
+    }
+    m_count = hit;
+}
+
+void HitIndex::clear()
+{
+    stop();
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_pattern = {};
+    m_heads.clear();
+    m_deltas.clear();
+    m_done.clear();
+    m_count     = 0;
+    m_last      = 0;
+    m_scanned   = 0;
+    m_positions = 0;
+    m_claimed   = 0;
+    m_failed    = false;
+    m_full      = false;
+}
+
+bool HitIndex::is_complete() const
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    return !m_pattern.empty() && m_scanned >= m_positions;
+}
+
+std::uintmax_t HitIndex::count() const
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    return m_count;
+}
+
+std::uintmax_t HitIndex::scanned() const
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    return m_scanned;
+}
+
+std::uintmax_t HitIndex::memory() const
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    return m_heads.size() * sizeof(Head) + m_deltas.size();
+}
+
+bool HitIndex::at(std::uintmax_t n, std::uintmax_t& o_offset) const
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    if (n >= m_count)
+        return false;
+
+    o_offset = seek(n).m_offset;
+    return true;
+}
+
+std::uintmax_t HitIndex::lower_bound(std::uintmax_t offset) const
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    return first_at(offset);
+}
+
+std::uint64_t HitIndex::mask(std::uintmax_t first, std::uint32_t count) const
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    const std::uintmax_t size = m_pattern.size();
+    if (size == 0)
+        return 0;
+    const std::uintmax_t hit = first_at(first >= size - 1 ? first - (size - 1) : 0);
+    if (hit == m_count)
+        return 0;
+
+    std::uint64_t mask = 0;
+    for (Cursor cursor = seek(hit); cursor.m_offset < first + count; next(cursor))
+    {
+        const std::uintmax_t begin = std::max(cursor.m_offset, first) - first;
+        const std::uintmax_t end   = std::min(cursor.m_offset + size, first + count) - first;
+        for (std::uintmax_t i = begin; i < end; ++i)
+            mask |= std::uint64_t { 1 } << i;
+        if (cursor.m_hit + 1 == m_count)
+            break;
+    }
+    return mask;
+}
+
+void HitIndex::run()
+{
+    const std::uintmax_t        overlap = m_pattern.size() - 1;
+    std::vector<std::uint8_t>   buffer;
+    std::vector<std::uintmax_t> hits;
+    while (!m_stop)
+    {
+        std::uintmax_t start = 0;
+        std::uintmax_t end   = 0;
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+            if (m_claimed >= m_positions)
+                break;
+            start     = m_claimed;
+            end       = std::min(start + SEARCH_BLOCK_SIZE, m_positions);
+            m_claimed = end;
+        }
+
+        // The block holds the bytes of the matches that start at its positions.
+        buffer.resize(end - start + overlap);
+        if (!m_reader(start, buffer.data(), buffer.size()))
+        {
+            m_failed = true;
+            m_stop   = true;
+            break;
+        }
+
+        hits.clear();
+        for (std::uintmax_t position = 0; position < end - start;)
+        {
+            const std::uintmax_t match = Searcher::scan(buffer.data() + position, buffer.size() - position, m_pattern, true);
+            if (match == buffer.size() - position)
+                break;
+            hits.push_back(start + position + match);
+            position += match + 1;
+        }
+
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_done[start] = { end, std::move(hits) };
+        hits          = {};
+        publish();
+    }
+
+    m_running.fetch_sub(1, std::memory_order_release);
+}
+
+void HitIndex::publish()
+{
+    for (auto it = m_done.begin(); it != m_done.end() && it->first == m_scanned; it = m_done.erase(it))
+    {
+        for (const auto offset : it->second.m_hits)
+        {
+            append(offset);
+            if (m_heads.size() * sizeof(Head) + m_deltas.size() >= HIT_INDEX_MEMORY_LIMIT)
+            {
+                // The hits still cover every position before the last one of them.
+                m_scanned = offset + 1;
+                m_full    = true;
+                m_stop    = true;
+                m_done.clear();
+                return;
+            }
+        }
+        m_scanned = it->second.m_end;
+    }
+}
+
+void HitIndex::append(std::uintmax_t offset)
+{
+    if (m_count % HIT_INDEX_BLOCK == 0)
+        m_heads.push_back({ offset, m_deltas.size() });
+    else
+    {
+        // Seven bits at a time, the high bit marks that more of them follow.
+        std::uintmax_t delta = offset - m_last;
+        for (; delta >= 0x80; delta >>= 7)
+            m_deltas.push_back(static_cast<std::uint8_t>(delta | 0x80));
+        m_deltas.push_back(static_cast<std::uint8_t>(delta));
+    }
+
+    m_last = offset;
+    m_count++;
+}
+
+std::uintmax_t HitIndex::first_at(std::uintmax_t offset) const
+{
+    // The last block that starts at or before offset holds the hit, unless it is the first one of the next block.
+    const auto head = std::upper_bound(m_heads.begin(), m_heads.end(), offset, [](std::uintmax_t value, const Head& head)
+                                       { return value < head.m_offset; });
+    if (head == m_heads.begin())
+        return 0;
+
+    for (Cursor cursor = seek(static_cast<std::uintmax_t>(head - m_heads.begin() - 1) * HIT_INDEX_BLOCK);; next(cursor))
+    {
+        if (cursor.m_offset >= offset)
+            return cursor.m_hit;
+        if (cursor.m_hit + 1 == m_count)
+            return m_count;
+    }
+}
+
+HitIndex::Cursor HitIndex::seek(std::uintmax_t n) const
+{
+    const Head& head = m_heads[n / HIT_INDEX_BLOCK];
+    Cursor      cursor { n - n % HIT_INDEX_BLOCK, head.m_offset, head.m_position };
+    while (cursor.m_hit < n)
+        next(cursor);
+    return cursor;
+}
+
+void HitIndex::next(Cursor& cursor) const
+{
+    if (++cursor.m_hit % HIT_INDEX_BLOCK == 0)
+    {
+        const Head& head  = m_heads[cursor.m_hit / HIT_INDEX_BLOCK];
+        cursor.m_offset   = head.m_offset;
+        cursor.m_position = head.m_position;
+        return;
+    }
+
+    std::uintmax_t delta = 0;
+    for (unsigned shift = 0;; shift += 7)
+    {
+        const std::uint8_t byte = m_deltas[cursor.m_position++];
+        delta |= static_cast<std::uintmax_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+            break;
+    }
+    cursor.m_offset += delta;
+}
+
+void HitIndex::join()
+{
+    for (auto& worker : m_workers)
+        worker.join();
+    m_workers.clear();
+}
+} // namespace Hexit
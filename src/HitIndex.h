@@ -0,0 +1,142 @@
+#ifndef HIT_INDEX_H
+#define HIT_INDEX_H
+
+#include "Searcher.h"
+#include "config.h"
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Hexit
+{
+// Finds every match of a pattern on background threads and keeps their offsets in order. The threads claim
+// blocks of SEARCH_BLOCK_SIZE positions like Searcher does, and the hits of a block get appended once the
+// blocks before it are done, so the hits found so far always cover the positions before scanned(). The
+// offsets are delta encoded: every HIT_INDEX_BLOCK hits keep an absolute offset, the ones in between the
+// distance to the previous hit as a variable length integer. Once they take HIT_INDEX_MEMORY_LIMIT bytes
+// the scan stops. The reader must not be called while the bytes change, see stop() and invalidate().
+class HitIndex
+{
+public:
+    // Zero threads uses one per core.
+    explicit HitIndex(Searcher::Reader reader, unsigned threads = 0);
+
+    ~HitIndex();
+
+    HitIndex(const HitIndex&) = delete;
+
+    HitIndex& operator=(const HitIndex&) = delete;
+
+    // Drops the hits and starts finding the ones of pattern within the given number of bytes.
+    void start(const Searcher::Pattern& pattern, std::uintmax_t size);
+
+    // Continues a stopped scan over the given number of bytes, unless it is complete, failed or full.
+    void resume(std::uintmax_t size);
+
+    // Blocks until the threads have stopped, the hits found so far are kept.
+    void stop();
+
+    // Stops the scan and drops the hits that could include byte_id or any byte after it, which resume()
+    // then finds again. The bytes before byte_id are expected to stay the same.
+    void invalidate(std::uintmax_t byte_id);
+
+    // Stops the scan and drops the pattern along with its hits.
+    void clear();
+
+    inline bool is_active() const { return !m_pattern.empty(); }
+
+    inline const Searcher::Pattern& pattern() const { return m_pattern; }
+
+    // True while the threads are scanning.
+    inline bool is_running() const { return m_running.load(std::memory_order_acquire) > 0; }
+
+    // True once every position has been scanned.
+    bool is_complete() const;
+
+    // True if the scan stopped because the reader failed.
+    inline bool failed() const { return m_failed.load(std::memory_order_acquire); }
+
+    // True if the scan stopped because the hits reached HIT_INDEX_MEMORY_LIMIT.
+    inline bool is_full() const { return m_full.load(std::memory_order_acquire); }
+
+    std::uintmax_t count() const;
+
+    // The positions before it have all been scanned.
+    std::uintmax_t scanned() const;
+
+    // Bytes taken by the encoded offsets.
+    std::uintmax_t memory() const;
+
+    // The offset of hit n, counted from zero, false if there are not that many.
+    bool at(std::uintmax_t n, std::uintmax_t& o_offset) const;
+
+    // The number of the first hit at or after offset, count() if there is none.
+    std::uintmax_t lower_bound(std::uintmax_t offset) const;
+
+    // One bit per byte from first on that belongs to a hit, count must not exceed 64.
+    std::uint64_t mask(std::uintmax_t first, std::uint32_t count) const;
+
+private:
+    struct Head
+    {
+        std::uintmax_t m_offset;   // Offset of the first hit of the block.
+        std::uintmax_t m_position; // Where the deltas of the following hits start in m_deltas.
+    };
+
+    struct Block
+    {
+        std::uintmax_t              m_end; // The position past the last one of the block.
+        std::vector<std::uintmax_t> m_hits;
+    };
+
+    // Walks the hits from a given one on, guarded by m_lock.
+    struct Cursor
+    {
+        std::uintmax_t m_hit;
+        std::uintmax_t m_offset;
+        std::uintmax_t m_position; // Where the delta of the next hit starts.
+    };
+
+    // Scans the blocks until there are none left or the scan stops, on the background threads.
+    void run();
+
+    // Appends the hits of the blocks that are done in order, guarded by m_lock.
+    void publish();
+
+    void append(std::uintmax_t offset);
+
+    // The number of the first hit at or after offset, guarded by m_lock.
+    std::uintmax_t first_at(std::uintmax_t offset) const;
+
+    // A cursor at hit n, which must exist.
+    Cursor seek(std::uintmax_t n) const;
+
+    // Moves the cursor to the next hit, which must exist.
+    void next(Cursor& cursor) const;
+
+    // Joins the threads, which must have been told to stop or be done.
+    void join();
+
+    Searcher::Reader                m_reader;
+    const unsigned                  m_threads;
+    Searcher::Pattern               m_pattern; // Only changes while the threads are stopped.
+    mutable std::mutex              m_lock;    // Guards everything below up to m_claimed.
+    std::vector<Head>               m_heads;
+    std::vector<std::uint8_t>       m_deltas;
+    std::uintmax_t                  m_count;
+    std::uintmax_t                  m_last; // Offset of the last hit.
+    std::uintmax_t                  m_scanned;
+    std::uintmax_t                  m_positions; // Positions to scan, the size minus the pattern size plus one.
+    std::map<std::uintmax_t, Block> m_done; // The blocks done out of order, by their first position.
+    std::uintmax_t                  m_claimed; // Start of the next block to scan.
+    std::atomic<unsigned>           m_running;
+    std::atomic<bool>               m_stop;
+    std::atomic<bool>               m_failed;
+    std::atomic<bool>               m_full;
+    std::vector<std::thread>        m_workers;
+};
+} // namespace Hexit
+#endif // HIT_INDEX_H
@@ -1,8 +1,12 @@
 #ifndef IO_HANDLER_H
 #define IO_HANDLER_H
 
+#include "Statistics.h"
 #include <cstdint>
 #include <filesystem>
+#include <mutex>
+#include <span>
+#include <vector>
 
 namespace Hexit
 {
@@ -33,16 +37,110 @@ public:
 
     virtual bool seek(std::uintmax_t offset) = 0;
 
+    // Positional counterparts of read() and write() that leave the current offset alone. Unlike
+    // seek(), read() and write(), they can be called concurrently from different threads.
+    // The default implementations serialize the calls to seek() followed by read() or write().
+    virtual bool read_at(std::uintmax_t offset, std::uint8_t* o_buffer, std::uintmax_t buffer_size)
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        return seek(offset) && read(o_buffer, buffer_size);
+    }
+
+    virtual bool write_at(std::uintmax_t offset, const std::uint8_t* i_buffer, std::uintmax_t buffer_size)
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        return seek(offset) && write(i_buffer, buffer_size);
+    }
+
+    // Fills the buffers in turn with the consecutive bytes that start at offset.
+    virtual bool read_vectored_at(std::uintmax_t offset, const std::vector<std::span<std::uint8_t>>& buffers)
+    {
+        for (const auto& buffer : buffers)
+        {
+            if (!read_at(offset, buffer.data(), buffer.size()))
+                return false;
+            offset += buffer.size();
+        }
+        return true;
+    }
+
+    // Writes the buffers in turn as consecutive bytes that start at offset.
+    virtual bool write_vectored_at(std::uintmax_t offset, const std::vector<std::span<std::uint8_t>>& buffers)
+    {
+        for (const auto& buffer : buffers)
+        {
+            if (!write_at(offset, buffer.data(), buffer.size()))
+                return false;
+            offset += buffer.size();
+        }
+        return true;
+    }
+
+    // A single positional read or write of a batch.
+    struct Request
+    {
+        std::uintmax_t m_offset;
+        std::uint8_t*  m_data;
+        std::uintmax_t m_size;
+        bool           m_write;
+    };
+
+    // Serves all the requests of a batch, in no particular order, and returns once all of them have completed.
+    // Returns false if any of them failed. Handlers that can keep several requests in flight override it.
+    virtual bool submit_batch(const std::vector<Request>& requests)
+    {
+        for (const auto& request : requests)
+        {
+            const bool done = request.m_write
+                ? write_at(request.m_offset, request.m_data, request.m_size)
+                : read_at(request.m_offset, request.m_data, request.m_size);
+            if (!done)
+                return false;
+        }
+        return true;
+    }
+
+    // Base address of a private, writable mapping of the whole input, nullptr if the handler does not map it.
+    // Changes made through the mapping never reach the underlying storage, write() has to be used for that.
+    virtual std::uint8_t* mapping() { return nullptr; }
+
+    // The preferred I/O block size of the underlying storage, zero if unknown.
+    virtual std::uintmax_t block_size() const { return 0; }
+
+    // Hints that the given byte range is about to get read, handlers may use it to start fetching it early.
+    virtual void will_need(std::uintmax_t offset, std::uintmax_t size)
+    {
+        static_cast<void>(offset);
+        static_cast<void>(size);
+    }
+
+    // Handlers whose input is still arriving take in the bytes that have arrived so far, which grows size().
+    // Returns true if it grew. Must be called by the thread that uses size().
+    virtual bool refresh() { return false; }
+
+    // True if bytes have arrived that refresh() would take in.
+    virtual bool has_pending() const { return false; }
+
+    // True while more of the input may still arrive.
+    virtual bool is_streaming() const { return false; }
+
+    // True if the input stopped arriving because reading or keeping it failed, before its end.
+    virtual bool is_incomplete() const { return false; }
+
     inline const fs::path& name() const { return m_name; };
 
     inline std::uintmax_t size() const { return m_size; };
 
     inline bool read_only() const { return m_read_only; }
 
+    inline const IOStatistics& statistics() const { return m_statistics; }
+
 protected:
-    bool          m_read_only;
-    fs::path      m_name;
+    bool           m_read_only;
+    fs::path       m_name;
     std::uintmax_t m_size;
+    std::mutex     m_lock; // Serializes the default positional methods.
+    IOStatistics   m_statistics;
 };
 } // namespace Hexit
 #endif // IO_HANDLER_H
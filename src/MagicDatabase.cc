@@ -0,0 +1,305 @@
+#include "MagicDatabase.h"
+#include <algorithm>
+#include <charconv>
+#include <fstream>
+#include <sstream>
+
+namespace Hexit
+{
+namespace
+{
+// Starts a cached database, a new layout needs a new one.
+constexpr char CACHE_MAGIC[8] = { 'H', 'X', 'M', 'A', 'G', 'I', 'C', '1' };
+
+template <typename T>
+bool parse_integer(const std::string& str, T& o_value)
+{
+    const bool  hex   = str.compare(0, 2, "0x") == 0 || str.compare(0, 2, "0X") == 0;
+    const char* first = str.data() + (hex ? 2 : 0);
+    const char* last  = str.data() + str.size();
+    const auto  res   = std::from_chars(first, last, o_value, hex ? 16 : 10);
+    return first != last && res.ec == std::errc() && res.ptr == last;
+}
+
+void put_string(std::string& out, const std::string& str)
+{
+    put(out, static_cast<std::uintmax_t>(str.size()));
+    out.append(str);
+}
+
+bool get_string(const std::string& in, std::size_t& position, std::string& o_str)
+{
+    std::uintmax_t length = 0;
+    if (!get(in, position, length) || in.size() - position < length)
+        return false;
+
+    o_str.assign(in, position, length);
+    position += length;
+    return true;
+}
+} // namespace
+
+MagicDatabase::MagicDatabase(const fs::path& cache_directory)
+    : m_cache_directory(cache_directory)
+    , m_cached(false)
+{
+}
+
+bool MagicDatabase::load(const fs::path& path)
+{
+    m_entries.clear();
+    m_groups.clear();
+    m_cached = false;
+    m_error.clear();
+
+    std::error_code      ec;
+    const std::uintmax_t size  = fs::file_size(path, ec);
+    const std::int64_t   mtime = static_cast<std::int64_t>(fs::last_write_time(path, ec).time_since_epoch().count());
+    if (ec)
+    {
+        m_error = "Could not open " + path.string();
+        return false;
+    }
+    if (load_cache(path, size, mtime))
+    {
+        m_cached = true;
+        return true;
+    }
+
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+    {
+        m_error = "Could not open " + path.string();
+        return false;
+    }
+    if (!parse(std::string((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>())))
+    {
+        m_entries.clear();
+        return false;
+    }
+
+    compile();
+    save_cache(path, size, mtime);
+    return true;
+}
+
+std::string_view MagicDatabase::get_type(const Searcher::Reader& reader, std::uintmax_t size) const
+{
+    const Entry*              best  = nullptr;
+    std::uint32_t             index = 0;
+    std::vector<std::uint8_t> buffer;
+    for (const auto& group : m_groups)
+    {
+        if (group.m_offset >= size)
+            break;
+
+        // Only as many bytes as the longest signature at the offset takes, or as there are.
+        buffer.resize(std::min(group.m_length, size - group.m_offset));
+        if (!reader(group.m_offset, buffer.data(), buffer.size()))
+            continue;
+
+        // The first entry that matches is the best one of the group. The list already matches the first byte.
+        const std::uint8_t first = buffer[0];
+        for (std::uint32_t i = group.m_start[first]; i < group.m_start[first + 1]; ++i)
+        {
+            const std::uint32_t id      = group.m_order[i];
+            const Entry&        entry   = m_entries[id];
+            const auto&         pattern = entry.m_pattern;
+            bool                match   = pattern.size() <= buffer.size();
+            for (std::uintmax_t j = 1; match && j < pattern.size(); ++j)
+                match = (buffer[j] & pattern.m_mask[j]) == pattern.m_value[j];
+            if (!match)
+                continue;
+
+            if (!best || entry.m_priority > best->m_priority || (entry.m_priority == best->m_priority && id < index))
+            {
+                best  = &entry;
+                index = id;
+            }
+            break;
+        }
+    }
+
+    return best ? std::string_view(best->m_type) : std::string_view();
+}
+
+fs::path MagicDatabase::cache_path(const fs::path& path) const
+{
+    return cache_file(m_cache_directory, path, "magic");
+}
+
+bool MagicDatabase::parse(const std::string& text)
+{
+    std::istringstream lines(text);
+    std::string        line;
+    for (std::uintmax_t number = 1; std::getline(lines, line); ++number)
+    {
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+
+        std::istringstream fields(line);
+        std::string        offset;
+        std::string        priority;
+        std::string        bytes;
+        Entry              entry { 0, {}, 0, {} };
+        if (!(fields >> offset) || offset[0] == '#')
+            continue;
+
+        std::getline(fields >> priority >> entry.m_type, bytes);
+        if (!parse_integer(offset, entry.m_offset) || !parse_integer(priority, entry.m_priority) || entry.m_type.empty()
+            || !Searcher::Pattern::parse(bytes, entry.m_pattern))
+        {
+            m_error = "Invalid signature on line " + std::to_string(number);
+            return false;
+        }
+        m_entries.push_back(std::move(entry));
+    }
+
+    return true;
+}
+
+void MagicDatabase::compile()
+{
+    std::vector<std::pair<std::uintmax_t, std::uint32_t>> offsets;
+    for (std::uint32_t id = 0; id < m_entries.size(); ++id)
+        offsets.emplace_back(m_entries[id].m_offset, id);
+    std::sort(offsets.begin(), offsets.end());
+
+    for (std::uintmax_t first = 0, last = 0; first < offsets.size(); first = last)
+    {
+        Group group { offsets[first].first, 0, {}, {} };
+        for (last = first; last < offsets.size() && offsets[last].first == group.m_offset; ++last)
+            ;
+
+        // By priority, the earlier line first if they tie.
+        std::vector<std::uint32_t> ids;
+        for (std::uintmax_t i = first; i < last; ++i)
+            ids.push_back(offsets[i].second);
+        std::stable_sort(ids.begin(), ids.end(), [this](std::uint32_t a, std::uint32_t b)
+                         { return m_entries[a].m_priority > m_entries[b].m_priority; });
+
+        // An entry whose first byte has wildcards goes into the list of every byte it matches.
+        for (std::uint32_t byte = 0; byte < 256; ++byte)
+        {
+            group.m_start[byte] = static_cast<std::uint32_t>(group.m_order.size());
+            for (const auto id : ids)
+            {
+                const auto& pattern = m_entries[id].m_pattern;
+                if ((byte & pattern.m_mask[0]) == pattern.m_value[0])
+                    group.m_order.push_back(id);
+            }
+        }
+        group.m_start[256] = static_cast<std::uint32_t>(group.m_order.size());
+        for (const auto id : ids)
+            group.m_length = std::max(group.m_length, m_entries[id].m_pattern.size());
+        m_groups.push_back(std::move(group));
+    }
+}
+
+bool MagicDatabase::load_cache(const fs::path& path, std::uintmax_t size, std::int64_t mtime)
+{
+    if (m_cache_directory.empty())
+        return false;
+
+    std::ifstream file(cache_path(path), std::ios::binary);
+    if (!file)
+        return false;
+
+    const std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    std::size_t       position     = sizeof(CACHE_MAGIC);
+    std::uintmax_t    cached_size  = 0;
+    std::int64_t      cached_mtime = 0;
+    std::uintmax_t    count        = 0;
+    std::string       name;
+    if (data.compare(0, sizeof(CACHE_MAGIC), CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0
+        || !get(data, position, cached_size)
+        || !get(data, position, cached_mtime)
+        || !get_string(data, position, name)
+        || cached_size != size
+        || cached_mtime != mtime
+        || name != fs::absolute(path).lexically_normal().string()
+        || !get(data, position, count))
+        return false;
+
+    std::vector<Entry> entries(count);
+    for (auto& entry : entries)
+    {
+        std::uintmax_t length = 0;
+        if (!get(data, position, entry.m_offset)
+            || !get(data, position, entry.m_priority)
+            || !get_string(data, position, entry.m_type)
+            || !get(data, position, length)
+            || length == 0
+            || (data.size() - position) / 2 < length)
+            return false;
+
+        entry.m_pattern.m_value.assign(data.begin() + static_cast<std::ptrdiff_t>(position), data.begin() + static_cast<std::ptrdiff_t>(position + length));
+        position += length;
+        entry.m_pattern.m_mask.assign(data.begin() + static_cast<std::ptrdiff_t>(position), data.begin() + static_cast<std::ptrdiff_t>(position + length));
+        position += length;
+    }
+
+    std::vector<Group> groups;
+    if (!get(data, position, count))
+        return false;
+    for (std::uintmax_t i = 0; i < count; ++i)
+    {
+        Group          group {};
+        std::uintmax_t length = 0;
+        if (!get(data, position, group.m_offset)
+            || !get(data, position, group.m_length)
+            || !get(data, position, group.m_start)
+            || !get(data, position, length)
+            || (data.size() - position) / sizeof(std::uint32_t) < length
+            || group.m_start[256] != length
+            || !std::is_sorted(group.m_start.begin(), group.m_start.end()))
+            return false;
+
+        group.m_order.resize(length);
+        for (auto& id : group.m_order)
+        {
+            if (!get(data, position, id) || id >= entries.size())
+                return false;
+        }
+        groups.push_back(std::move(group));
+    }
+
+    m_entries.swap(entries);
+    m_groups.swap(groups);
+    return true;
+}
+
+bool MagicDatabase::save_cache(const fs::path& path, std::uintmax_t size, std::int64_t mtime) const
+{
+    if (m_cache_directory.empty())
+        return false;
+
+    std::string data(CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    put(data, size);
+    put(data, mtime);
+    put_string(data, fs::absolute(path).lexically_normal().string());
+    put(data, static_cast<std::uintmax_t>(m_entries.size()));
+    for (const auto& entry : m_entries)
+    {
+        put(data, entry.m_offset);
+        put(data, entry.m_priority);
+        put_string(data, entry.m_type);
+        put(data, static_cast<std::uintmax_t>(entry.m_pattern.size()));
+        data.append(entry.m_pattern.m_value.begin(), entry.m_pattern.m_value.end());
+        data.append(entry.m_pattern.m_mask.begin(), entry.m_pattern.m_mask.end());
+    }
+
+    put(data, static_cast<std::uintmax_t>(m_groups.size()));
+    for (const auto& group : m_groups)
+    {
+        put(data, group.m_offset);
+        put(data, group.m_length);
+        put(data, group.m_start);
+        put(data, static_cast<std::uintmax_t>(group.m_order.size()));
+        for (const auto id : group.m_order)
+            put(data, id);
+    }
+
+    return write_file_atomically(cache_path(path), data);
+}
+} // namespace Hexit
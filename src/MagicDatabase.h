@@ -0,0 +1,80 @@
+#ifndef MAGIC_DATABASE_H
+#define MAGIC_DATABASE_H
+
+#include "Searcher.h"
+#include "Utilities.h"
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Hexit
+{
+namespace fs = std::filesystem;
+
+// File signatures loaded from a text file, one per line: the offset, decimal or hexadecimal with 0x, the
+// priority, the type and the bytes in hex digits with ? for any nibble, e.g. "257 50 tar 75 73 74 61 72".
+// Empty lines and the ones starting with # are ignored. The signatures get grouped by their offset and,
+// within a group, sorted into one list per first byte, by priority. Matching reads the bytes at each offset
+// once, only as many as the longest signature there needs. The highest priority wins, the earlier line if
+// they tie. The compiled groups get cached in cache_directory, keyed by the path, size and modification
+// time of the file, so that large databases load quickly. An empty cache_directory disables the cache.
+class MagicDatabase
+{
+public:
+    explicit MagicDatabase(const fs::path& cache_directory = Hexit::cache_directory());
+
+    // Replaces the signatures with the ones of the file, false with error() telling why.
+    bool load(const fs::path& path);
+
+    // The type of the bytes that reader reads, out of size bytes in total, empty if no signature matches.
+    std::string_view get_type(const Searcher::Reader& reader, std::uintmax_t size) const;
+
+    // The number of signatures.
+    inline std::uintmax_t size() const { return m_entries.size(); }
+
+    // True if the signatures were loaded from the cache instead of being compiled.
+    inline bool is_cached() const { return m_cached; }
+
+    inline const std::string& error() const { return m_error; }
+
+    // Where the compiled form of the file at path gets cached.
+    fs::path cache_path(const fs::path& path) const;
+
+private:
+    struct Entry
+    {
+        std::uintmax_t    m_offset;
+        Searcher::Pattern m_pattern;
+        std::int32_t      m_priority;
+        std::string       m_type;
+    };
+
+    struct Group
+    {
+        std::uintmax_t                 m_offset;
+        std::uintmax_t                 m_length; // Bytes the longest of its signatures takes.
+        std::array<std::uint32_t, 257> m_start;  // The entries that can start with byte b are m_order[m_start[b], m_start[b + 1]).
+        std::vector<std::uint32_t>     m_order;  // Indexes into m_entries, by priority within each first byte.
+    };
+
+    // Parses the lines of the file into m_entries.
+    bool parse(const std::string& text);
+
+    // Sorts m_entries into m_groups.
+    void compile();
+
+    bool load_cache(const fs::path& path, std::uintmax_t size, std::int64_t mtime);
+
+    bool save_cache(const fs::path& path, std::uintmax_t size, std::int64_t mtime) const;
+
+    const fs::path     m_cache_directory;
+    std::vector<Entry> m_entries; // In the order of the lines of the file.
+    std::vector<Group> m_groups;  // By offset.
+    bool               m_cached;
+    std::string        m_error;
+};
+} // namespace Hexit
+#endif // MAGIC_DATABASE_H
@@ -0,0 +1,109 @@
+#include "MemoryBudget.h"
+#include "config.h"
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <limits>
+#include <string>
+
+namespace Hexit
+{
+namespace
+{
+// Reads a single number from a cgroup file, "max" and missing files read as UINTMAX_MAX.
+std::uintmax_t read_value(const fs::path& path)
+{
+    std::ifstream file(path);
+    std::string   value;
+    if (!(file >> value) || !std::all_of(value.begin(), value.end(), [](unsigned char uc)
+                                         { return std::isdigit(uc); }))
+        return UINTMAX_MAX;
+
+    return std::stoull(value);
+}
+
+// The headroom of a cgroup directory, given the names of its limit and usage files.
+std::uintmax_t headroom(const fs::path& directory, const char* limit_file, const char* usage_file)
+{
+    const std::uintmax_t limit = read_value(directory / limit_file);
+    if (limit == UINTMAX_MAX)
+        return UINTMAX_MAX;
+
+    const std::uintmax_t usage = read_value(directory / usage_file);
+    if (usage == UINTMAX_MAX)
+        return limit;
+
+    return usage < limit ? limit - usage : 0;
+}
+} // namespace
+
+MemoryBudget::MemoryBudget(std::uintmax_t limit, const fs::path& proc_root, const fs::path& cgroup_root)
+    : m_proc_root(proc_root)
+    , m_cgroup_root(cgroup_root)
+    , m_limit(limit)
+{
+    if (m_limit > 0)
+        return;
+
+    const std::uintmax_t memory = available();
+    m_limit                     = memory == UINTMAX_MAX ? DEFAULT_MEMORY_BUDGET : memory / MEMORY_BUDGET_SHARE;
+}
+
+std::uintmax_t MemoryBudget::available() const
+{
+    return std::min(mem_available(), cgroup_headroom());
+}
+
+bool MemoryBudget::under_pressure() const
+{
+    return available() < m_limit;
+}
+
+std::uintmax_t MemoryBudget::mem_available() const
+{
+    std::ifstream  meminfo(m_proc_root / "meminfo");
+    std::string    key;
+    std::uintmax_t kib = 0;
+    while (meminfo >> key >> kib)
+    {
+        if (key == "MemAvailable:")
+            return kib * 1024;
+        // Skip the unit.
+        meminfo.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+    }
+
+    return UINTMAX_MAX;
+}
+
+std::uintmax_t MemoryBudget::cgroup_headroom() const
+{
+    std::ifstream  cgroups(m_proc_root / "self" / "cgroup");
+    std::string    line;
+    std::uintmax_t room = UINTMAX_MAX;
+    while (std::getline(cgroups, line))
+    {
+        // Each line reads hierarchy-id:controllers:path, the unified (v2) hierarchy has the id 0 and no controllers.
+        const auto first  = line.find(':');
+        const auto second = line.find(':', first + 1);
+        if (first == std::string::npos || second == std::string::npos)
+            continue;
+
+        const std::string controllers = line.substr(first + 1, second - first - 1);
+        const fs::path    relative    = fs::path(line.substr(second + 1)).relative_path();
+        // Inside a cgroup namespace the path of the process is not visible, the root is its own cgroup then.
+        if (controllers.empty())
+        {
+            const fs::path directory = fs::exists(m_cgroup_root / relative / "memory.max") ? m_cgroup_root / relative : m_cgroup_root;
+            room                     = std::min(room, headroom(directory, "memory.max", "memory.current"));
+        }
+        else if (controllers.find("memory") != std::string::npos)
+        {
+            const fs::path base      = m_cgroup_root / "memory";
+            const fs::path directory = fs::exists(base / relative / "memory.limit_in_bytes") ? base / relative : base;
+            room                     = std::min(room, headroom(directory, "memory.limit_in_bytes", "memory.usage_in_bytes"));
+        }
+    }
+
+    return room;
+}
+} // namespace Hexit
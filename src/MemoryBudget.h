@@ -0,0 +1,42 @@
+#ifndef MEMORY_BUDGET_H
+#define MEMORY_BUDGET_H
+
+#include <cstdint>
+#include <filesystem>
+
+namespace Hexit
+{
+namespace fs = std::filesystem;
+
+// The amount of memory the chunk cache may use. Unless it is given explicitly, it gets derived
+// from MemAvailable and from the memory limit of the cgroup the process runs in.
+class MemoryBudget
+{
+public:
+    // A limit of zero detects the budget from the system.
+    explicit MemoryBudget(std::uintmax_t limit       = 0,
+                          const fs::path& proc_root   = "/proc",
+                          const fs::path& cgroup_root = "/sys/fs/cgroup");
+
+    // The budget in bytes.
+    inline std::uintmax_t limit() const { return m_limit; }
+
+    // The memory that is still available to the process, bounded by the cgroup limit. UINTMAX_MAX if unknown.
+    std::uintmax_t available() const;
+
+    // True once less memory is left available than the budget allows the cache to use.
+    bool under_pressure() const;
+
+private:
+    // MemAvailable in bytes, UINTMAX_MAX if unknown.
+    std::uintmax_t mem_available() const;
+
+    // Memory left below the limit of the cgroup, UINTMAX_MAX if there is no limit.
+    std::uintmax_t cgroup_headroom() const;
+
+    const fs::path m_proc_root;
+    const fs::path m_cgroup_root;
+    std::uintmax_t m_limit;
+};
+} // namespace Hexit
+#endif // MEMORY_BUDGET_H
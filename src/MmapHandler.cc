@@ -0,0 +1,159 @@
+#include "MmapHandler.h"
+#include "Utilities.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace Hexit
+{
+MmapHandler::MmapHandler(bool read_only)
+    : IOHandler(read_only)
+    , m_mapping(nullptr)
+    , m_offset(0u)
+    , m_fd(-1)
+{
+}
+
+MmapHandler::~MmapHandler()
+{
+    close();
+}
+
+bool MmapHandler::open(const fs::path& path)
+{
+    if (!fs::exists(path) || m_fd >= 0)
+        return false;
+
+    m_fd = ::open(path.c_str(), m_read_only ? O_RDONLY : O_RDWR);
+    if (m_fd < 0)
+        return false;
+
+    struct stat st;
+    if (::fstat(m_fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size <= 0)
+    {
+        close();
+        return false;
+    }
+
+    // A private mapping lets the chunks get patched with unsaved changes without touching the file.
+    const auto size = static_cast<std::size_t>(st.st_size);
+    void*      addr = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, m_fd, 0);
+    if (addr == MAP_FAILED)
+    {
+        close();
+        return false;
+    }
+
+    m_mapping = static_cast<std::uint8_t*>(addr);
+    m_size    = size;
+    m_offset  = 0;
+    m_name    = fs::canonical(path);
+
+    return true;
+}
+
+void MmapHandler::close()
+{
+    if (m_mapping)
+        ::munmap(m_mapping, m_size);
+
+    if (m_fd >= 0)
+        ::close(m_fd);
+
+    m_mapping = nullptr;
+    m_fd      = -1;
+    m_offset  = 0;
+    m_name    = "";
+    m_size    = 0;
+}
+
+bool MmapHandler::read(std::uint8_t* o_buffer, std::uintmax_t buffer_size)
+{
+    if (!read_at(m_offset, o_buffer, buffer_size))
+        return false;
+
+    m_offset += buffer_size;
+    return true;
+}
+
+bool MmapHandler::write(const std::uint8_t* i_buffer, std::uintmax_t buffer_size)
+{
+    if (!write_at(m_offset, i_buffer, buffer_size))
+        return false;
+
+    m_offset += buffer_size;
+    return true;
+}
+
+bool MmapHandler::seek(std::uintmax_t offset)
+{
+    if (!m_mapping || offset >= m_size)
+        return false;
+
+    m_offset = offset;
+    return true;
+}
+
+bool MmapHandler::read_at(std::uintmax_t offset, std::uint8_t* o_buffer, std::uintmax_t buffer_size)
+{
+    if (!o_buffer || !m_mapping || (offset + buffer_size) > m_size)
+        return false;
+
+    m_statistics.count_read(buffer_size);
+    if (buffer_size != 0)
+        std::memcpy(o_buffer, m_mapping + offset, buffer_size);
+
+    return true;
+}
+
+bool MmapHandler::write_at(std::uintmax_t offset, const std::uint8_t* i_buffer, std::uintmax_t buffer_size)
+{
+    if (m_read_only)
+        return true;
+
+    if (!i_buffer || m_fd < 0 || (offset + buffer_size) > m_size)
+        return false;
+
+    // The mapping is private, so the data has to go through the file descriptor.
+    ScopedTimer timer(m_statistics.m_io_ns);
+    m_statistics.count_write(buffer_size);
+    while (buffer_size > 0)
+    {
+        const ssize_t written = ::pwrite(m_fd, i_buffer, buffer_size, static_cast<off_t>(offset));
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written <= 0)
+            return false;
+
+        i_buffer += written;
+        offset += static_cast<std::uintmax_t>(written);
+        buffer_size -= static_cast<std::uintmax_t>(written);
+    }
+
+    return true;
+}
+
+std::uintmax_t MmapHandler::block_size() const
+{
+    struct stat st;
+    if (m_fd < 0 || ::fstat(m_fd, &st) != 0 || st.st_blksize <= 0)
+        return 0;
+
+    return static_cast<std::uintmax_t>(st.st_blksize);
+}
+
+void MmapHandler::will_need(std::uintmax_t offset, std::uintmax_t size)
+{
+    if (!m_mapping || offset >= m_size)
+        return;
+
+    // madvise expects a page aligned address.
+    const std::uintmax_t page  = page_size();
+    const std::uintmax_t start = offset / page * page;
+    const std::uintmax_t end   = std::min(offset + size, m_size);
+    ::madvise(m_mapping + start, end - start, MADV_WILLNEED);
+}
+} // namespace Hexit
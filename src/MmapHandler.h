@@ -0,0 +1,44 @@
+#ifndef MMAP_HANDLER_H
+#define MMAP_HANDLER_H
+
+#include "IOHandler.h"
+
+namespace Hexit
+{
+// Maps the whole file into memory, so that chunks can point directly into the mapping instead of
+// getting copied. Only regular, non-empty files can be opened, anything else should use PosixFileHandler.
+// The file must not shrink while it is mapped.
+class MmapHandler : public IOHandler
+{
+public:
+    explicit MmapHandler(bool read_only = false);
+
+    ~MmapHandler();
+
+    bool open(const fs::path& path) override;
+
+    void close() override;
+
+    bool read(std::uint8_t* o_buffer, std::uintmax_t buffer_size) override;
+
+    bool write(const std::uint8_t* i_buffer, std::uintmax_t buffer_size) override;
+
+    bool seek(std::uintmax_t offset) override;
+
+    bool read_at(std::uintmax_t offset, std::uint8_t* o_buffer, std::uintmax_t buffer_size) override;
+
+    bool write_at(std::uintmax_t offset, const std::uint8_t* i_buffer, std::uintmax_t buffer_size) override;
+
+    std::uint8_t* mapping() override { return m_mapping; }
+
+    std::uintmax_t block_size() const override;
+
+    void will_need(std::uintmax_t offset, std::uintmax_t size) override;
+
+private:
+    std::uint8_t*  m_mapping;
+    std::uintmax_t m_offset;
+    int            m_fd;
+};
+} // namespace Hexit
+#endif // MMAP_HANDLER_H
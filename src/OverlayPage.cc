@@ -0,0 +1,166 @@
+#include "OverlayPage.h"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+namespace Hexit
+{
+namespace
+{
+// A list entry takes up five bytes, the dense form 9/8 of a byte for every byte of the chunk.
+constexpr std::uintmax_t DENSE_SHARE = 5;
+} // namespace
+
+OverlayPage::OverlayPage(std::uintmax_t chunk_size)
+    : m_size(chunk_size)
+    , m_count(0u)
+    , m_dense(false)
+{
+}
+
+void OverlayPage::set(std::uintmax_t offset, std::uint8_t value)
+{
+    if (!m_dense)
+    {
+        const auto it    = std::lower_bound(m_offsets.begin(), m_offsets.end(), offset);
+        const auto index = it - m_offsets.begin();
+        if (it != m_offsets.end() && *it == offset)
+        {
+            m_values[static_cast<std::size_t>(index)] = value;
+            return;
+        }
+
+        if (m_offsets.size() < m_size / DENSE_SHARE)
+        {
+            m_offsets.insert(it, static_cast<std::uint32_t>(offset));
+            m_values.insert(m_values.begin() + index, value);
+            return;
+        }
+
+        densify();
+    }
+
+    std::uint64_t& word = m_dirty[offset / 64];
+    const auto     bit  = std::uint64_t { 1 } << (offset % 64);
+    if (!(word & bit))
+        m_count++;
+    word |= bit;
+    m_bytes[offset] = value;
+}
+
+bool OverlayPage::is_dirty(std::uintmax_t offset) const
+{
+    if (m_dense)
+        return (m_dirty[offset / 64] >> (offset % 64)) & 1u;
+
+    return std::binary_search(m_offsets.begin(), m_offsets.end(), offset);
+}
+
+std::uint64_t OverlayPage::mask(std::uintmax_t offset, std::uintmax_t count) const
+{
+    count = std::min<std::uintmax_t>(count, 64);
+    if (!m_dense)
+    {
+        std::uint64_t bits = 0;
+        for (auto it = std::lower_bound(m_offsets.begin(), m_offsets.end(), offset); it != m_offsets.end() && *it < offset + count; ++it)
+            bits |= std::uint64_t { 1 } << (*it - offset);
+        return bits;
+    }
+
+    const std::uintmax_t word  = offset / 64;
+    const std::uintmax_t shift = offset % 64;
+    std::uint64_t        bits  = m_dirty[word] >> shift;
+    if (shift > 0 && word + 1 < m_dirty.size())
+        bits |= m_dirty[word + 1] << (64 - shift);
+    if (count < 64)
+        bits &= (std::uint64_t { 1 } << count) - 1;
+
+    return bits;
+}
+
+void OverlayPage::apply(std::uint8_t* data, std::uintmax_t first, std::uintmax_t count) const
+{
+    const std::uintmax_t end = std::min(first + count, m_size);
+    if (!m_dense)
+    {
+        auto i = static_cast<std::size_t>(std::lower_bound(m_offsets.begin(), m_offsets.end(), first) - m_offsets.begin());
+        for (; i < m_offsets.size() && m_offsets[i] < end; ++i)
+            data[m_offsets[i] - first] = m_values[i];
+        return;
+    }
+
+    for (std::uintmax_t word = first / 64; word * 64 < end; ++word)
+    {
+        std::uint64_t        bits  = m_dirty[word];
+        const std::uintmax_t start = word * 64;
+        // Fully modified runs get copied as a whole, untouched ones skipped.
+        if (bits == UINT64_MAX && start >= first && start + 64 <= end)
+        {
+            std::memcpy(data + (start - first), m_bytes.data() + start, 64);
+            continue;
+        }
+
+        while (bits)
+        {
+            const std::uintmax_t offset = start + static_cast<std::uintmax_t>(std::countr_zero(bits));
+            if (offset >= end)
+                break;
+            if (offset >= first)
+                data[offset - first] = m_bytes[offset];
+            bits &= bits - 1;
+        }
+    }
+}
+
+void OverlayPage::for_each_run(const std::function<void(std::uintmax_t, std::uint8_t*, std::uintmax_t)>& visitor)
+{
+    if (!m_dense)
+    {
+        // Consecutive offsets have their values next to each other as well.
+        for (std::size_t first = 0, last = 0; first < m_offsets.size(); first = last)
+        {
+            for (last = first + 1; last < m_offsets.size() && m_offsets[last] == m_offsets[last - 1] + 1; ++last)
+                ;
+            visitor(m_offsets[first], m_values.data() + first, last - first);
+        }
+        return;
+    }
+
+    for (std::uintmax_t first = find_bit(0, true); first < m_size;)
+    {
+        const std::uintmax_t last = find_bit(first, false);
+        visitor(first, m_bytes.data() + first, last - first);
+        first = find_bit(last, true);
+    }
+}
+
+std::uintmax_t OverlayPage::find_bit(std::uintmax_t from, bool dirty) const
+{
+    while (from < m_size)
+    {
+        const std::uint64_t word = (dirty ? m_dirty[from / 64] : ~m_dirty[from / 64]) >> (from % 64);
+        if (word)
+            return std::min(m_size, from + static_cast<std::uintmax_t>(std::countr_zero(word)));
+        from = (from / 64 + 1) * 64;
+    }
+
+    return m_size;
+}
+
+void OverlayPage::densify()
+{
+    m_bytes.resize(m_size);
+    m_dirty.resize((m_size + 63) / 64);
+    for (std::size_t i = 0; i < m_offsets.size(); ++i)
+    {
+        m_bytes[m_offsets[i]] = m_values[i];
+        m_dirty[m_offsets[i] / 64] |= std::uint64_t { 1 } << (m_offsets[i] % 64);
+    }
+
+    m_count = m_offsets.size();
+    m_dense = true;
+    // Release the memory of the list.
+    std::vector<std::uint32_t>().swap(m_offsets);
+    std::vector<std::uint8_t>().swap(m_values);
+}
+} // namespace Hexit
@@ -0,0 +1,56 @@
+#ifndef OVERLAY_PAGE_H
+#define OVERLAY_PAGE_H
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace Hexit
+{
+// The modified bytes of a single chunk. A page starts out as a sorted list of the modified offsets and
+// their values, and switches to a copy of the chunk along with a bitmap of the modified bytes once that
+// takes up less memory. A few scattered edits then cost a few bytes each, while a contiguous edit costs
+// about 9/8 of the bytes it modifies and gets applied with plain copies.
+class OverlayPage
+{
+public:
+    explicit OverlayPage(std::uintmax_t chunk_size);
+
+    void set(std::uintmax_t offset, std::uint8_t value);
+
+    bool is_dirty(std::uintmax_t offset) const;
+
+    // The dirty bits of up to 64 bytes starting at offset, the bit of the first byte is the lowest one.
+    std::uint64_t mask(std::uintmax_t offset, std::uintmax_t count) const;
+
+    // Copies the modified bytes over the first count bytes of the chunk data.
+    inline void apply(std::uint8_t* data, std::uintmax_t count) const { apply(data, 0, count); }
+
+    // Copies the modified bytes among the count bytes from offset first on over data, which holds those bytes.
+    void apply(std::uint8_t* data, std::uintmax_t first, std::uintmax_t count) const;
+
+    // Calls the visitor with the offset, the data and the length of each run of consecutive modified bytes, in order.
+    void for_each_run(const std::function<void(std::uintmax_t, std::uint8_t*, std::uintmax_t)>& visitor);
+
+    // Number of modified bytes.
+    inline std::uintmax_t count() const { return m_dense ? m_count : m_offsets.size(); }
+
+    inline bool is_dense() const { return m_dense; }
+
+private:
+    // Moves the sorted list into the copy of the chunk and the bitmap.
+    void densify();
+
+    // The first offset at or after from whose dirty bit equals dirty, the chunk size if there is none.
+    std::uintmax_t find_bit(std::uintmax_t from, bool dirty) const;
+
+    const std::uintmax_t       m_size;
+    std::vector<std::uint32_t> m_offsets; // Sorted, m_values holds the byte at the same index.
+    std::vector<std::uint8_t>  m_values;
+    std::vector<std::uint8_t>  m_bytes;
+    std::vector<std::uint64_t> m_dirty; // One bit per byte of m_bytes.
+    std::uintmax_t             m_count;
+    bool                       m_dense;
+};
+} // namespace Hexit
+#endif // OVERLAY_PAGE_H
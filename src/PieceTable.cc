@@ -0,0 +1,244 @@
+#include "PieceTable.h"
+#include <algorithm>
+
+namespace Hexit
+{
+PieceTable::PieceTable(std::uintmax_t original_size)
+    : m_root(NIL)
+    , m_original(true)
+{
+    reset(original_size);
+}
+
+void PieceTable::reset(std::uintmax_t original_size)
+{
+    m_nodes.clear();
+    m_free.clear();
+    m_root     = NIL;
+    m_original = true;
+    if (original_size > 0)
+        m_root = allocate({ Source::ORIGINAL, 0, original_size }, static_cast<std::uint32_t>(m_random()));
+}
+
+PieceTable::Location PieceTable::locate(std::uintmax_t position) const
+{
+    std::uintmax_t start = 0;
+    std::uint32_t  node  = m_root;
+    while (node != NIL)
+    {
+        const Node&          current    = m_nodes[node];
+        const std::uintmax_t left_total = total(current.m_left);
+        if (position < left_total)
+            node = current.m_left;
+        else if (position < left_total + current.m_piece.m_length)
+            return { current.m_piece, start + left_total };
+        else
+        {
+            start += left_total + current.m_piece.m_length;
+            position -= left_total + current.m_piece.m_length;
+            node = current.m_right;
+        }
+    }
+
+    return { { Source::ORIGINAL, 0, 0 }, start };
+}
+
+void PieceTable::insert(std::uintmax_t position, const Piece& piece)
+{
+    if (piece.m_length == 0)
+        return;
+
+    m_original = false;
+    if (extend(m_root, position, piece))
+        return;
+
+    std::uint32_t left  = NIL;
+    std::uint32_t right = NIL;
+    split(m_root, position, left, right);
+    const std::uint32_t node = allocate(piece, static_cast<std::uint32_t>(m_random()));
+    m_root                   = merge(merge(left, node), right);
+}
+
+void PieceTable::erase(std::uintmax_t position, std::uintmax_t count)
+{
+    if (count == 0 || position >= size())
+        return;
+
+    m_original           = false;
+    std::uint32_t left   = NIL;
+    std::uint32_t middle = NIL;
+    std::uint32_t right  = NIL;
+    split(m_root, position, left, middle);
+    split(middle, count, middle, right);
+    release(middle);
+    m_root = merge(left, right);
+}
+
+void PieceTable::for_each(const std::function<bool(const Piece&)>& visitor) const
+{
+    // In-order traversal with an explicit stack, since the treap can get deep enough to make recursion costly.
+    std::vector<std::uint32_t> stack;
+    std::uint32_t              node = m_root;
+    while (node != NIL || !stack.empty())
+    {
+        for (; node != NIL; node = m_nodes[node].m_left)
+            stack.push_back(node);
+
+        node = stack.back();
+        stack.pop_back();
+        if (!visitor(m_nodes[node].m_piece))
+            return;
+        node = m_nodes[node].m_right;
+    }
+}
+
+std::vector<PieceTable::Piece> PieceTable::slice(std::uintmax_t position, std::uintmax_t count) const
+{
+    std::vector<Piece> pieces;
+    while (count > 0 && position < size())
+    {
+        auto                 location = locate(position);
+        const std::uintmax_t skip     = position - location.m_start;
+        location.m_piece.m_offset += skip;
+        location.m_piece.m_length = std::min(count, location.m_piece.m_length - skip);
+        pieces.push_back(location.m_piece);
+        position += location.m_piece.m_length;
+        count -= location.m_piece.m_length;
+    }
+
+    return pieces;
+}
+
+void PieceTable::update(std::uint32_t node)
+{
+    Node& current   = m_nodes[node];
+    current.m_total = total(current.m_left) + current.m_piece.m_length + total(current.m_right);
+}
+
+std::uint32_t PieceTable::allocate(const Piece& piece, std::uint32_t priority)
+{
+    const Node node = { piece, piece.m_length, priority, NIL, NIL };
+    if (m_free.empty())
+    {
+        m_nodes.push_back(node);
+        return static_cast<std::uint32_t>(m_nodes.size() - 1);
+    }
+
+    const std::uint32_t index = m_free.back();
+    m_free.pop_back();
+    m_nodes[index] = node;
+    return index;
+}
+
+void PieceTable::release(std::uint32_t node)
+{
+    std::vector<std::uint32_t> pending { node };
+    while (!pending.empty())
+    {
+        const std::uint32_t current = pending.back();
+        pending.pop_back();
+        if (current == NIL)
+            continue;
+
+        pending.push_back(m_nodes[current].m_left);
+        pending.push_back(m_nodes[current].m_right);
+        m_free.push_back(current);
+    }
+}
+
+void PieceTable::split(std::uint32_t node, std::uintmax_t position, std::uint32_t& left, std::uint32_t& right)
+{
+    if (node == NIL)
+    {
+        left = right = NIL;
+        return;
+    }
+
+    const std::uintmax_t left_total = total(m_nodes[node].m_left);
+    const std::uintmax_t length     = m_nodes[node].m_piece.m_length;
+    // Splitting a piece allocates a node, so no references into m_nodes may be held across the recursion.
+    if (position <= left_total)
+    {
+        std::uint32_t rest = NIL;
+        split(m_nodes[node].m_left, position, left, rest);
+        m_nodes[node].m_left = rest;
+        update(node);
+        right = node;
+    }
+    else if (position >= left_total + length)
+    {
+        std::uint32_t rest = NIL;
+        split(m_nodes[node].m_right, position - left_total - length, rest, right);
+        m_nodes[node].m_right = rest;
+        update(node);
+        left = node;
+    }
+    else
+    {
+        // The position falls inside the piece. The tail becomes a node of its own that takes over the right
+        // subtree, sharing the priority of the head keeps both of them valid treaps.
+        const std::uintmax_t head = position - left_total;
+        Piece                tail = m_nodes[node].m_piece;
+        tail.m_offset += head;
+        tail.m_length = length - head;
+
+        const std::uint32_t next       = allocate(tail, m_nodes[node].m_priority);
+        m_nodes[next].m_right          = m_nodes[node].m_right;
+        m_nodes[node].m_right          = NIL;
+        m_nodes[node].m_piece.m_length = head;
+        update(next);
+        update(node);
+        left  = node;
+        right = next;
+    }
+}
+
+std::uint32_t PieceTable::merge(std::uint32_t left, std::uint32_t right)
+{
+    if (left == NIL)
+        return right;
+    if (right == NIL)
+        return left;
+
+    if (m_nodes[left].m_priority >= m_nodes[right].m_priority)
+    {
+        const std::uint32_t merged = merge(m_nodes[left].m_right, right);
+        m_nodes[left].m_right      = merged;
+        update(left);
+        return left;
+    }
+
+    const std::uint32_t merged = merge(left, m_nodes[right].m_left);
+    m_nodes[right].m_left      = merged;
+    update(right);
+    return right;
+}
+
+bool PieceTable::extend(std::uint32_t node, std::uintmax_t position, const Piece& piece)
+{
+    if (node == NIL || position == 0)
+        return false;
+
+    Node&                current    = m_nodes[node];
+    const std::uintmax_t left_total = total(current.m_left);
+    const std::uintmax_t end        = left_total + current.m_piece.m_length;
+    bool                 extended   = false;
+    if (position <= left_total)
+        extended = extend(current.m_left, position, piece);
+    else if (position > end)
+        extended = extend(current.m_right, position - end, piece);
+    else if (position == end
+             && current.m_piece.m_source == piece.m_source
+             && current.m_piece.m_index == piece.m_index
+             && current.m_piece.m_offset + current.m_piece.m_length == piece.m_offset)
+    {
+        current.m_piece.m_length += piece.m_length;
+        extended = true;
+    }
+
+    if (extended)
+        update(node);
+
+    return extended;
+}
+} // namespace Hexit
@@ -0,0 +1,105 @@
+#ifndef PIECE_TABLE_H
+#define PIECE_TABLE_H
+
+#include <cstdint>
+#include <functional>
+#include <random>
+#include <vector>
+
+namespace Hexit
+{
+// Describes the logical contents of a buffer as a sequence of pieces, each one referencing a range of the
+// original file, of an append-only buffer that holds the inserted bytes, of a repeated fill pattern or of
+// a file that got pasted. The meaning of the sources is up to the owner of the table. The pieces are
+// kept in an implicit treap ordered by their logical position, so that locating a byte, inserting and
+// erasing take O(log n) in the number of pieces, independently of the size of the file.
+class PieceTable
+{
+public:
+    enum class Source : std::uint8_t
+    {
+        ORIGINAL,
+        ADD,
+        FILL,  // The offset runs through the pattern m_index, wrapping around at its end.
+        PASTE, // The offset is one into the pasted file m_index.
+    };
+
+    struct Piece
+    {
+        Source         m_source;
+        std::uintmax_t m_offset; // Offset of the first byte in the source.
+        std::uintmax_t m_length;
+        std::uint32_t  m_index = 0; // Tells apart the fill patterns and pasted files, flags the other sources.
+    };
+
+    // The piece that holds a logical byte, along with the logical offset it starts at.
+    struct Location
+    {
+        Piece          m_piece;
+        std::uintmax_t m_start;
+    };
+
+    explicit PieceTable(std::uintmax_t original_size = 0);
+
+    // Drops all the pieces and references the whole original file again.
+    void reset(std::uintmax_t original_size);
+
+    inline std::uintmax_t size() const { return total(m_root); }
+
+    inline std::uintmax_t piece_count() const { return m_nodes.size() - m_free.size(); }
+
+    // True as long as no bytes have been inserted or erased since the last reset.
+    inline bool is_original() const { return m_original; }
+
+    // No bounds checking is performed, position has to be less than size().
+    Location locate(std::uintmax_t position) const;
+
+    // Inserts the piece before the byte at position, position equal to size() appends it.
+    // The piece gets merged into the preceding one if it continues it in the same source.
+    void insert(std::uintmax_t position, const Piece& piece);
+
+    // Erases count bytes starting at position, the range gets clamped to the end of the table.
+    void erase(std::uintmax_t position, std::uintmax_t count);
+
+    // Calls the visitor for each piece in logical order, until it returns false.
+    void for_each(const std::function<bool(const Piece&)>& visitor) const;
+
+    // The pieces that make up count bytes starting at position, trimmed to the range.
+    std::vector<Piece> slice(std::uintmax_t position, std::uintmax_t count) const;
+
+private:
+    static constexpr std::uint32_t NIL = UINT32_MAX;
+
+    struct Node
+    {
+        Piece          m_piece;
+        std::uintmax_t m_total; // Length of all the pieces in the subtree.
+        std::uint32_t  m_priority;
+        std::uint32_t  m_left;
+        std::uint32_t  m_right;
+    };
+
+    inline std::uintmax_t total(std::uint32_t node) const { return node == NIL ? 0 : m_nodes[node].m_total; }
+
+    void update(std::uint32_t node);
+
+    std::uint32_t allocate(const Piece& piece, std::uint32_t priority);
+
+    void release(std::uint32_t node);
+
+    // Splits the tree into the first position bytes and the rest, splitting a piece in two if needed.
+    void split(std::uint32_t node, std::uintmax_t position, std::uint32_t& left, std::uint32_t& right);
+
+    std::uint32_t merge(std::uint32_t left, std::uint32_t right);
+
+    // Grows the piece that ends right at position, if the given piece continues it.
+    bool extend(std::uint32_t node, std::uintmax_t position, const Piece& piece);
+
+    std::vector<Node>          m_nodes;
+    std::vector<std::uint32_t> m_free; // Released nodes that can be reused.
+    std::uint32_t              m_root;
+    std::minstd_rand           m_random;
+    bool                       m_original;
+};
+} // namespace Hexit
+#endif // PIECE_TABLE_H
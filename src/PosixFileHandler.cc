@@ -0,0 +1,216 @@
+#include "PosixFileHandler.h"
+#include <cerrno>
+#include <climits>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace Hexit
+{
+PosixFileHandler::PosixFileHandler(bool read_only)
+    : IOHandler(read_only)
+    , m_offset(0u)
+    , m_fd(-1)
+{
+}
+
+PosixFileHandler::~PosixFileHandler()
+{
+    close();
+}
+
+bool PosixFileHandler::open(const fs::path& path)
+{
+    if (!fs::exists(path) || m_fd >= 0)
+        return false;
+
+    m_fd = ::open(path.c_str(), m_read_only ? O_RDONLY : O_RDWR);
+    if (m_fd < 0)
+        return false;
+
+    // lseek also reports the size of block devices.
+    const off_t size = ::lseek(m_fd, 0, SEEK_END);
+    if (size < 0)
+    {
+        close();
+        return false;
+    }
+
+    m_size   = static_cast<std::uintmax_t>(size);
+    m_offset = 0;
+    m_name   = fs::canonical(path);
+
+    return true;
+}
+
+void PosixFileHandler::close()
+{
+    if (m_fd >= 0)
+    {
+        ::close(m_fd);
+        m_fd     = -1;
+        m_offset = 0;
+        m_name   = "";
+        m_size   = 0;
+    }
+}
+
+bool PosixFileHandler::read(std::uint8_t* o_buffer, std::uintmax_t buffer_size)
+{
+    if (!read_at(m_offset, o_buffer, buffer_size))
+        return false;
+
+    m_offset += buffer_size;
+    return true;
+}
+
+bool PosixFileHandler::write(const std::uint8_t* i_buffer, std::uintmax_t buffer_size)
+{
+    if (!write_at(m_offset, i_buffer, buffer_size))
+        return false;
+
+    m_offset += buffer_size;
+    return true;
+}
+
+bool PosixFileHandler::seek(std::uintmax_t offset)
+{
+    if (m_fd < 0 || offset >= m_size)
+        return false;
+
+    m_offset = offset;
+    return true;
+}
+
+bool PosixFileHandler::read_at(std::uintmax_t offset, std::uint8_t* o_buffer, std::uintmax_t buffer_size)
+{
+    if (!o_buffer || m_fd < 0)
+        return false;
+
+    ScopedTimer timer(m_statistics.m_io_ns);
+    m_statistics.count_read(buffer_size);
+    while (buffer_size > 0)
+    {
+        const ssize_t count = ::pread(m_fd, o_buffer, buffer_size, static_cast<off_t>(offset));
+        if (count < 0 && errno == EINTR)
+            continue;
+        // Reading past the end of the file is an error, just like for the other handlers.
+        if (count <= 0)
+            return false;
+
+        o_buffer += count;
+        offset += static_cast<std::uintmax_t>(count);
+        buffer_size -= static_cast<std::uintmax_t>(count);
+    }
+
+    return true;
+}
+
+bool PosixFileHandler::write_at(std::uintmax_t offset, const std::uint8_t* i_buffer, std::uintmax_t buffer_size)
+{
+    if (m_read_only)
+        return true;
+
+    if (!i_buffer || m_fd < 0)
+        return false;
+
+    ScopedTimer timer(m_statistics.m_io_ns);
+    m_statistics.count_write(buffer_size);
+    while (buffer_size > 0)
+    {
+        const ssize_t count = ::pwrite(m_fd, i_buffer, buffer_size, static_cast<off_t>(offset));
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count <= 0)
+            return false;
+
+        i_buffer += count;
+        offset += static_cast<std::uintmax_t>(count);
+        buffer_size -= static_cast<std::uintmax_t>(count);
+    }
+
+    return true;
+}
+
+bool PosixFileHandler::read_vectored_at(std::uintmax_t offset, const std::vector<std::span<std::uint8_t>>& buffers)
+{
+    return transfer_vectored(offset, buffers, false);
+}
+
+bool PosixFileHandler::write_vectored_at(std::uintmax_t offset, const std::vector<std::span<std::uint8_t>>& buffers)
+{
+    if (m_read_only)
+        return true;
+
+    return transfer_vectored(offset, buffers, true);
+}
+
+bool PosixFileHandler::transfer_vectored(std::uintmax_t offset, const std::vector<std::span<std::uint8_t>>& buffers, bool write)
+{
+    if (m_fd < 0)
+        return false;
+
+    std::vector<iovec> iov;
+    std::uintmax_t     total = 0;
+    iov.reserve(buffers.size());
+    for (const auto& buffer : buffers)
+    {
+        if (!buffer.empty())
+            iov.push_back({ buffer.data(), buffer.size() });
+        total += buffer.size();
+    }
+
+    ScopedTimer timer(m_statistics.m_io_ns);
+    if (write)
+        m_statistics.count_write(total);
+    else
+        m_statistics.count_read(total);
+
+    // The transfer may stop short, in which case the rest of the interrupted iovec is transferred on its own.
+    std::size_t first = 0;
+    while (first < iov.size())
+    {
+        const int     count = static_cast<int>(std::min<std::size_t>(iov.size() - first, IOV_MAX));
+        const ssize_t bytes = write
+            ? ::pwritev(m_fd, iov.data() + first, count, static_cast<off_t>(offset))
+            : ::preadv(m_fd, iov.data() + first, count, static_cast<off_t>(offset));
+        if (bytes < 0 && errno == EINTR)
+            continue;
+        if (bytes <= 0)
+            return false;
+
+        offset += static_cast<std::uintmax_t>(bytes);
+        std::size_t remaining = static_cast<std::size_t>(bytes);
+        while (first < iov.size() && remaining >= iov[first].iov_len)
+            remaining -= iov[first++].iov_len;
+
+        if (remaining > 0)
+        {
+            auto*             data = static_cast<std::uint8_t*>(iov[first].iov_base) + remaining;
+            const std::size_t left = iov[first].iov_len - remaining;
+            if (!(write ? write_at(offset, data, left) : read_at(offset, data, left)))
+                return false;
+            offset += left;
+            first++;
+        }
+    }
+
+    return true;
+}
+
+std::uintmax_t PosixFileHandler::block_size() const
+{
+    struct stat st;
+    if (m_fd < 0 || ::fstat(m_fd, &st) != 0 || st.st_blksize <= 0)
+        return 0;
+
+    return static_cast<std::uintmax_t>(st.st_blksize);
+}
+
+void PosixFileHandler::will_need(std::uintmax_t offset, std::uintmax_t size)
+{
+    if (m_fd >= 0)
+        ::posix_fadvise(m_fd, static_cast<off_t>(offset), static_cast<off_t>(size), POSIX_FADV_WILLNEED);
+}
+} // namespace Hexit
@@ -0,0 +1,50 @@
+#ifndef POSIX_FILE_HANDLER_H
+#define POSIX_FILE_HANDLER_H
+
+#include "IOHandler.h"
+
+namespace Hexit
+{
+// Accesses the file through a descriptor with pread/pwrite, so the positional methods
+// need no locking and can be used by several threads at the same time. seek(), read()
+// and write() keep an offset of their own on top of them.
+class PosixFileHandler : public IOHandler
+{
+public:
+    explicit PosixFileHandler(bool read_only = false);
+
+    ~PosixFileHandler();
+
+    bool open(const fs::path& path) override;
+
+    void close() override;
+
+    bool read(std::uint8_t* o_buffer, std::uintmax_t buffer_size) override;
+
+    bool write(const std::uint8_t* i_buffer, std::uintmax_t buffer_size) override;
+
+    bool seek(std::uintmax_t offset) override;
+
+    bool read_at(std::uintmax_t offset, std::uint8_t* o_buffer, std::uintmax_t buffer_size) override;
+
+    bool write_at(std::uintmax_t offset, const std::uint8_t* i_buffer, std::uintmax_t buffer_size) override;
+
+    bool read_vectored_at(std::uintmax_t offset, const std::vector<std::span<std::uint8_t>>& buffers) override;
+
+    bool write_vectored_at(std::uintmax_t offset, const std::vector<std::span<std::uint8_t>>& buffers) override;
+
+    std::uintmax_t block_size() const override;
+
+    void will_need(std::uintmax_t offset, std::uintmax_t size) override;
+
+    inline int descriptor() const { return m_fd; }
+
+private:
+    // Reads or writes the buffers with preadv/pwritev.
+    bool transfer_vectored(std::uintmax_t offset, const std::vector<std::span<std::uint8_t>>& buffers, bool write);
+
+    std::uintmax_t m_offset;
+    int            m_fd;
+};
+} // namespace Hexit
+#endif // POSIX_FILE_HANDLER_H
@@ -0,0 +1,168 @@
+#include "Prefetcher.h"
+#include <algorithm>
+#include <cstring>
+#include <span>
+
+namespace Hexit
+{
+namespace
+{
+// The maximum number of adjacent chunks that get read with a single call.
+constexpr std::size_t MAX_BATCH = 8;
+}
+
+Prefetcher::Prefetcher(IOHandler& handler, std::uintmax_t chunk_size, std::uintmax_t depth)
+    : m_handler(handler)
+    , m_chunk_size(chunk_size)
+    , m_depth(depth)
+    , m_epoch(0)
+    , m_busy(false)
+    , m_stop(false)
+    , m_worker(&Prefetcher::run, this)
+{
+}
+
+Prefetcher::~Prefetcher()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_stop = true;
+    }
+    m_wake.notify_all();
+    m_worker.join();
+}
+
+void Prefetcher::request(const std::vector<Request>& requests)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_pending.clear();
+        for (const auto& request : requests)
+        {
+            if (find(request.m_id) == m_staged.end())
+                m_pending.push_back(request);
+        }
+
+        if (m_pending.empty())
+            return;
+    }
+
+    const auto [first, last] = std::minmax_element(requests.begin(),
+                                                   requests.end(),
+                                                   [](const Request& a, const Request& b)
+                                                   { return a.m_id < b.m_id; });
+    m_handler.will_need(first->m_id * m_chunk_size,
+                        (last->m_id - first->m_id) * m_chunk_size + last->m_count);
+    m_wake.notify_one();
+}
+
+bool Prefetcher::take(std::uintmax_t chunk_id, ChunkCache::DataChunk& target)
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    auto                        it = find(chunk_id);
+    if (it == m_staged.end())
+        return false;
+
+    std::memcpy(target.m_data, it->m_data, it->m_count);
+    target.m_id    = it->m_id;
+    target.m_count = it->m_count;
+    m_staged.erase(it);
+
+    return true;
+}
+
+void Prefetcher::discard(std::uintmax_t chunk_id)
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_epoch++;
+    if (auto it = find(chunk_id); it != m_staged.end())
+        m_staged.erase(it);
+}
+
+void Prefetcher::wait_idle()
+{
+    std::unique_lock<std::mutex> lock(m_lock);
+    m_idle.wait(lock, [this]
+                { return m_pending.empty() && !m_busy; });
+}
+
+void Prefetcher::run()
+{
+    std::unique_lock<std::mutex> lock(m_lock);
+    while (true)
+    {
+        m_wake.wait(lock, [this]
+                    { return m_stop || !m_pending.empty(); });
+        if (m_stop)
+            break;
+
+        // Batch the requests for adjacent chunks, so that they can be read with a single call.
+        std::vector<Request> batch;
+        while (!m_pending.empty() && batch.size() < MAX_BATCH)
+        {
+            const Request next = m_pending.front();
+            if (!batch.empty() && next.m_id != batch.back().m_id + 1 && next.m_id + 1 != batch.back().m_id)
+                break;
+
+            m_pending.pop_front();
+            if (find(next.m_id) == m_staged.end())
+                batch.push_back(next);
+        }
+
+        if (batch.empty())
+        {
+            if (m_pending.empty())
+                m_idle.notify_all();
+            continue;
+        }
+
+        std::sort(batch.begin(),
+                  batch.end(),
+                  [](const Request& a, const Request& b)
+                  { return a.m_id < b.m_id; });
+        const std::uintmax_t epoch = m_epoch;
+        m_busy                     = true;
+        lock.unlock();
+
+        std::list<ChunkCache::DataChunk>     chunks(batch.size());
+        std::vector<std::span<std::uint8_t>> buffers;
+        auto                                 request = batch.begin();
+        for (auto& chunk : chunks)
+        {
+            chunk.m_storage.resize(m_chunk_size);
+            chunk.m_data  = chunk.m_storage.data();
+            chunk.m_id    = request->m_id;
+            chunk.m_count = request->m_count;
+            buffers.emplace_back(chunk.m_data, chunk.m_count);
+            ++request;
+        }
+        const bool loaded = m_handler.read_vectored_at(batch.front().m_id * m_chunk_size, buffers);
+
+        lock.lock();
+        m_busy = false;
+        // Chunks that got written to while they were being read are dropped, they might be stale.
+        if (loaded && epoch == m_epoch)
+        {
+            m_staged.splice(m_staged.begin(), chunks);
+            while (m_staged.size() > m_depth)
+                m_staged.pop_back();
+        }
+        else if (!loaded)
+        {
+            // Leave any errors to be reported by the synchronous path.
+            m_pending.clear();
+        }
+
+        if (m_pending.empty())
+            m_idle.notify_all();
+    }
+}
+
+std::list<ChunkCache::DataChunk>::iterator Prefetcher::find(std::uintmax_t chunk_id)
+{
+    return std::find_if(m_staged.begin(),
+                        m_staged.end(),
+                        [chunk_id](const ChunkCache::DataChunk& chunk)
+                        { return chunk.m_id == chunk_id; });
+}
+} // namespace Hexit
@@ -0,0 +1,70 @@
+#ifndef PREFETCHER_H
+#define PREFETCHER_H
+
+#include "ChunkCache.h"
+#include "IOHandler.h"
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Hexit
+{
+// Loads the chunks that lie ahead of a scan on a background thread, so that
+// they are already in memory once they get requested.
+class Prefetcher
+{
+public:
+    struct Request
+    {
+        std::uintmax_t m_id;    // Id of the chunk to load.
+        std::uintmax_t m_count; // Number of bytes in the chunk.
+    };
+
+    // depth is the maximum number of chunks that get loaded ahead of the scan.
+    Prefetcher(IOHandler& handler, std::uintmax_t chunk_size, std::uintmax_t depth);
+
+    ~Prefetcher();
+
+    Prefetcher(const Prefetcher&) = delete;
+
+    Prefetcher& operator=(const Prefetcher&) = delete;
+
+    // Replaces any pending requests with the given ones, chunks that are already prefetched get skipped.
+    void request(const std::vector<Request>& requests);
+
+    // Copies the prefetched chunk into target, returns false if the chunk has not been prefetched.
+    bool take(std::uintmax_t chunk_id, ChunkCache::DataChunk& target);
+
+    // Drops the prefetched copy of a chunk, or any copy that is still being read, since it
+    // has just been written to. Must be called after the write has completed.
+    void discard(std::uintmax_t chunk_id);
+
+    // Blocks until all the pending requests have been served.
+    void wait_idle();
+
+    inline std::uintmax_t depth() const { return m_depth; }
+
+private:
+    void run();
+
+    std::list<ChunkCache::DataChunk>::iterator find(std::uintmax_t chunk_id);
+
+    IOHandler&                       m_handler;
+    const std::uintmax_t             m_chunk_size;
+    const std::uintmax_t             m_depth;
+    std::mutex                       m_lock; // Guards everything below.
+    std::list<ChunkCache::DataChunk> m_staged; // Ordered from the most to the least recently prefetched chunk.
+    std::deque<Request>              m_pending;
+    std::condition_variable          m_wake;
+    std::condition_variable          m_idle;
+    std::uintmax_t                   m_epoch; // Incremented on every discard, invalidates the reads in flight.
+    bool                             m_busy;
+    bool                             m_stop;
+    std::thread                      m_worker;
+};
+} // namespace Hexit
+#endif // PREFETCHER_H
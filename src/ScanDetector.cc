@@ -0,0 +1,29 @@
+#include "ScanDetector.h"
+
+namespace Hexit
+{
+namespace
+{
+// The number of consecutive sequential accesses that have to be observed before prefetching starts.
+constexpr std::uintmax_t SCAN_THRESHOLD = 2;
+}
+
+int ScanDetector::observe(std::uintmax_t chunk_id)
+{
+    int direction = 0;
+    if (m_last != UINTMAX_MAX && chunk_id == m_last + 1)
+        direction = 1;
+    else if (m_last != UINTMAX_MAX && m_last > 0 && chunk_id == m_last - 1)
+        direction = -1;
+
+    if (direction != 0 && direction == m_direction)
+        m_streak++;
+    else
+        m_streak = direction != 0 ? 1 : 0;
+
+    m_direction = direction;
+    m_last      = chunk_id;
+
+    return m_streak >= SCAN_THRESHOLD ? m_direction : 0;
+}
+} // namespace Hexit
@@ -0,0 +1,22 @@
+#ifndef SCAN_DETECTOR_H
+#define SCAN_DETECTOR_H
+
+#include <cstdint>
+
+namespace Hexit
+{
+// Detects sequential scans over the chunks of a file.
+class ScanDetector
+{
+public:
+    // Feeds the id of a requested chunk and returns the direction of the scan:
+    // 1 for a forward scan, -1 for a backward scan and 0 if the accesses do not look sequential.
+    int observe(std::uintmax_t chunk_id);
+
+private:
+    std::uintmax_t m_last      = { UINTMAX_MAX }; // Id of the last observed chunk.
+    std::uintmax_t m_streak    = { 0 };           // Number of consecutive sequential accesses.
+    int            m_direction = { 0 };
+};
+} // namespace Hexit
+#endif // SCAN_DETECTOR_H
@@ -4,16 +4,23 @@
 namespace Hexit
 {
 Scroller::Scroller(std::uintmax_t total_bytes, std::uintmax_t bytes_per_line)
-    : m_first_line(0u)
+    : m_bytes_per_line(bytes_per_line)
+    , m_first_line(0u)
     , m_last_line(0u)
     , m_total_lines(0u)
     , m_visible_lines(0u)
     , m_active_line(0u)
 {
-    if (total_bytes != 0 && bytes_per_line != 0)
+    set_total(total_bytes);
+}
+
+void Scroller::set_total(std::uintmax_t total_bytes)
+{
+    m_total_lines = 0u;
+    if (total_bytes != 0 && m_bytes_per_line != 0)
     {
-        m_total_lines = total_bytes / bytes_per_line;
-        if (total_bytes % bytes_per_line)
+        m_total_lines = total_bytes / m_bytes_per_line;
+        if (total_bytes % m_bytes_per_line)
             m_total_lines++;
     }
 }
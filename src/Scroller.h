@@ -10,6 +10,9 @@ class Scroller
 public:
     Scroller(std::uintmax_t total_bytes, std::uintmax_t bytes_per_line);
 
+    // Recomputes the number of lines once bytes have been inserted or erased, adjust_lines() has to follow.
+    void set_total(std::uintmax_t total_bytes);
+
     // No checks are performed by the method, the caller should make sure that the parameters are valid.
     void adjust_lines(std::uintmax_t visible_lines, std::uintmax_t current_line);
 
@@ -28,6 +31,7 @@ public:
     inline std::uint32_t active() const { return m_active_line; }
 
 private:
+    std::uintmax_t m_bytes_per_line;
     std::uintmax_t m_first_line;
     std::uintmax_t m_last_line;
     std::uintmax_t m_total_lines;
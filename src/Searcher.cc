@@ -0,0 +1,234 @@
+#include "Searcher.h"
+#include "Utilities.h"
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstring>
+#include <thread>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace Hexit
+{
+namespace
+{
+// The positions of the pattern that the candidates get filtered by: its first and its last byte that are
+// not wildcards, along with whether all of its bytes have to match exactly.
+struct Anchors
+{
+    std::uintmax_t m_first;
+    std::uintmax_t m_last;
+    bool           m_exact;
+
+    explicit Anchors(const Searcher::Pattern& pattern)
+        : m_first(0)
+        , m_last(0)
+        , m_exact(std::all_of(pattern.m_mask.begin(), pattern.m_mask.end(), [](std::uint8_t mask)
+                              { return mask == 0xFF; }))
+    {
+        const auto first = std::find_if(pattern.m_mask.begin(), pattern.m_mask.end(), [](std::uint8_t mask)
+                                        { return mask != 0; });
+        // A pattern of wildcards only matches anywhere, which the first byte filters just as well.
+        if (first == pattern.m_mask.end())
+            return;
+        const auto last = std::find_if(pattern.m_mask.rbegin(), pattern.m_mask.rend(), [](std::uint8_t mask)
+                                       { return mask != 0; });
+        m_first = static_cast<std::uintmax_t>(first - pattern.m_mask.begin());
+        m_last  = pattern.size() - 1 - static_cast<std::uintmax_t>(last - pattern.m_mask.rbegin());
+    }
+};
+
+inline bool matches_at(const std::uint8_t* data, const Searcher::Pattern& pattern, const Anchors& anchors)
+{
+    if (anchors.m_exact)
+        return std::memcmp(data, pattern.m_value.data(), pattern.size()) == 0;
+
+    for (std::uintmax_t i = anchors.m_first; i < anchors.m_last; ++i)
+    {
+        if ((data[i] & pattern.m_mask[i]) != pattern.m_value[i])
+            return false;
+    }
+    return true;
+}
+
+inline bool anchors_match(const std::uint8_t* data, const Searcher::Pattern& pattern, const Anchors& anchors)
+{
+    return (data[anchors.m_first] & pattern.m_mask[anchors.m_first]) == pattern.m_value[anchors.m_first]
+           && (data[anchors.m_last] & pattern.m_mask[anchors.m_last]) == pattern.m_value[anchors.m_last];
+}
+
+// The bits of the 16 positions from data on whose anchors match the ones of the pattern under their masks.
+inline std::uint32_t candidates(const std::uint8_t* data, const Searcher::Pattern& pattern, const Anchors& anchors)
+{
+#if defined(__SSE2__)
+    const __m128i first_value = _mm_set1_epi8(static_cast<char>(pattern.m_value[anchors.m_first]));
+    const __m128i first_mask  = _mm_set1_epi8(static_cast<char>(pattern.m_mask[anchors.m_first]));
+    const __m128i last_value  = _mm_set1_epi8(static_cast<char>(pattern.m_value[anchors.m_last]));
+    const __m128i last_mask   = _mm_set1_epi8(static_cast<char>(pattern.m_mask[anchors.m_last]));
+    const __m128i head        = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + anchors.m_first)), first_mask);
+    const __m128i tail        = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + anchors.m_last)), last_mask);
+    return static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(head, first_value), _mm_cmpeq_epi8(tail, last_value))));
+#else
+    std::uint32_t bits = 0;
+    for (std::uint32_t i = 0; i < 16; ++i)
+        bits |= static_cast<std::uint32_t>(anchors_match(data + i, pattern, anchors)) << i;
+    return bits;
+#endif
+}
+} // namespace
+
+Searcher::Pattern::Pattern(const std::vector<std::uint8_t>& bytes)
+    : m_value(bytes)
+    , m_mask(bytes.size(), 0xFF)
+{
+}
+
+bool Searcher::Pattern::parse(const std::string& str, Pattern& o_pattern)
+{
+    Pattern      pattern;
+    std::uint8_t value  = 0;
+    std::uint8_t mask   = 0;
+    bool         second = false; // The next digit is the low nibble of a byte.
+    for (const unsigned char chr : str)
+    {
+        if (chr == ' ' && !second)
+            continue;
+        if (chr != '?' && !std::isxdigit(chr))
+            return false;
+
+        value = static_cast<std::uint8_t>(value << 4 | (chr == '?' ? 0 : hex_char_to_int(chr)));
+        mask  = static_cast<std::uint8_t>(mask << 4 | (chr == '?' ? 0 : 0xF));
+        if ((second = !second))
+            continue;
+        pattern.m_value.push_back(value);
+        pattern.m_mask.push_back(mask);
+    }
+
+    if (second || pattern.empty())
+        return false;
+    o_pattern = std::move(pattern);
+    return true;
+}
+
+Searcher::Searcher(Reader reader, unsigned threads)
+    : m_reader(std::move(reader))
+    , m_threads(threads ? threads : std::max(1u, std::thread::hardware_concurrency()))
+    , m_failed(false)
+{
+}
+
+std::uintmax_t Searcher::scan(const std::uint8_t* data, std::uintmax_t size, const Pattern& pattern, bool forward)
+{
+    if (pattern.empty() || size < pattern.size())
+        return size;
+
+    // Positions past the last full group of 16 get checked one by one.
+    const Anchors        anchors(pattern);
+    const std::uintmax_t positions = size - pattern.size() + 1;
+    const std::uintmax_t groups    = positions / 16;
+    const auto           single    = [&](std::uintmax_t i)
+    { return anchors_match(data + i, pattern, anchors) && matches_at(data + i, pattern, anchors); };
+
+    if (forward)
+    {
+        for (std::uintmax_t group = 0; group < groups; ++group)
+        {
+            for (std::uint32_t bits = candidates(data + group * 16, pattern, anchors); bits; bits &= bits - 1)
+            {
+                const std::uintmax_t i = group * 16 + static_cast<std::uintmax_t>(std::countr_zero(bits));
+                if (matches_at(data + i, pattern, anchors))
+                    return i;
+            }
+        }
+        for (std::uintmax_t i = groups * 16; i < positions; ++i)
+        {
+            if (single(i))
+                return i;
+        }
+        return size;
+    }
+
+    for (std::uintmax_t i = positions; i > groups * 16; --i)
+    {
+        if (single(i - 1))
+            return i - 1;
+    }
+    for (std::uintmax_t group = groups; group > 0; --group)
+    {
+        for (std::uint32_t bits = candidates(data + (group - 1) * 16, pattern, anchors); bits;)
+        {
+            const std::uint32_t  bit = 31u - static_cast<std::uint32_t>(std::countl_zero(bits));
+            const std::uintmax_t i   = (group - 1) * 16 + bit;
+            if (matches_at(data + i, pattern, anchors))
+                return i;
+            bits &= ~(1u << bit);
+        }
+    }
+    return size;
+}
+
+bool Searcher::find(const Pattern& pattern, std::uintmax_t first, std::uintmax_t last, bool forward, std::uintmax_t& o_offset)
+{
+    m_failed = false;
+    if (pattern.empty() || last < first || last - first < pattern.size())
+        return false;
+
+    // Blocks get claimed in the order of the search, the first one with a match ends it. Every block is read
+    // along with the bytes that a match starting at its end needs.
+    const std::uintmax_t        overlap = pattern.size() - 1;
+    const std::uintmax_t        blocks  = (last - first + SEARCH_BLOCK_SIZE - 1) / SEARCH_BLOCK_SIZE;
+    std::atomic<std::uintmax_t> next    = 0;
+    std::atomic<std::uintmax_t> best    = UINTMAX_MAX; // The order of the first block with a match.
+    std::atomic<bool>           failed  = false;
+    std::vector<std::uintmax_t> found(m_threads, UINTMAX_MAX);
+    const auto                  work = [&](unsigned thread)
+    {
+        std::vector<std::uint8_t> buffer(std::min(SEARCH_BLOCK_SIZE, last - first) + overlap);
+        for (std::uintmax_t order = next++; order < blocks && order < best && !failed; order = next++)
+        {
+            const std::uintmax_t block = forward ? order : blocks - 1 - order;
+            const std::uintmax_t start = first + block * SEARCH_BLOCK_SIZE;
+            const std::uintmax_t count = std::min(SEARCH_BLOCK_SIZE + overlap, last - start);
+            if (count < pattern.size())
+                continue;
+            if (!m_reader(start, buffer.data(), count))
+            {
+                failed = true;
+                return;
+            }
+
+            const std::uintmax_t match = scan(buffer.data(), count, pattern, forward);
+            if (match == count)
+                continue;
+
+            found[thread] = start + match;
+            for (std::uintmax_t current = best; order < current && !best.compare_exchange_weak(current, order);)
+                ;
+            return;
+        }
+    };
+
+    const unsigned           threads = static_cast<unsigned>(std::min<std::uintmax_t>(m_threads, blocks));
+    std::vector<std::thread> workers;
+    for (unsigned thread = 1; thread < threads; ++thread)
+        workers.emplace_back(work, thread);
+    work(0);
+    for (auto& worker : workers)
+        worker.join();
+
+    m_failed = failed;
+    if (m_failed || best == UINTMAX_MAX)
+        return false;
+
+    // The match of the first block is the first or the last one among all of them, depending on the direction.
+    std::uintmax_t result = forward ? UINTMAX_MAX : 0;
+    for (const auto offset : found)
+    {
+        if (offset != UINTMAX_MAX)
+            result = forward ? std::min(result, offset) : std::max(result, offset);
+    }
+    o_offset = result;
+    return true;
+}
+} // namespace Hexit
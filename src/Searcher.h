@@ -0,0 +1,65 @@
+#ifndef SEARCHER_H
+#define SEARCHER_H
+
+#include "config.h"
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace Hexit
+{
+// Finds a byte pattern in a range of bytes with several threads. The range gets split into blocks of
+// SEARCH_BLOCK_SIZE that the threads claim in the order of the search, each one reading its block along
+// with the pattern size minus one bytes past it, so that matches across the borders of the blocks are
+// found as well. Threads stop claiming blocks past the first one with a match. Within a block, the
+// candidates are the positions whose first and last byte that are not wildcards match the ones of the
+// pattern, compared under their masks 16 positions at a time, which then get verified.
+class Searcher
+{
+public:
+    // Reads count bytes at the given offset into the buffer, called from several threads at once.
+    typedef std::function<bool(std::uintmax_t, std::uint8_t*, std::uintmax_t)> Reader;
+
+    // A byte matches if the bits of its mask equal the value, a mask of zero makes it a wildcard.
+    struct Pattern
+    {
+        std::vector<std::uint8_t> m_value; // The bits outside of the mask are zero.
+        std::vector<std::uint8_t> m_mask;
+
+        Pattern() = default;
+
+        // Every byte has to match exactly.
+        explicit Pattern(const std::vector<std::uint8_t>& bytes);
+
+        inline std::uintmax_t size() const { return m_value.size(); }
+
+        inline bool empty() const { return m_value.empty(); }
+
+        // Pairs of hex digits in which ? stands for any nibble, spaces between them are ignored, like
+        // "DE AD ?? EF" or "4? 00 ?F". False for an odd number of digits or anything else.
+        static bool parse(const std::string& str, Pattern& o_pattern);
+    };
+
+    // Zero threads uses one per core.
+    explicit Searcher(Reader reader, unsigned threads = 0);
+
+    // Finds the match that lies within [first, last) and starts closest to first if forward, or to last
+    // otherwise. Returns false if there is none or the reader failed, see failed().
+    bool find(const Pattern& pattern, std::uintmax_t first, std::uintmax_t last, bool forward, std::uintmax_t& o_offset);
+
+    // True if the reader failed during the last search.
+    inline bool failed() const { return m_failed; }
+
+    inline unsigned threads() const { return m_threads; }
+
+    // The position of the first or the last match within data, size if there is none.
+    static std::uintmax_t scan(const std::uint8_t* data, std::uintmax_t size, const Pattern& pattern, bool forward);
+
+private:
+    Reader   m_reader;
+    unsigned m_threads;
+    bool     m_failed;
+};
+} // namespace Hexit
+#endif // SEARCHER_H
@@ -1,67 +1,137 @@
 #include "SignatureReader.h"
 #include <algorithm>
-#include <cstring>
 
 namespace Hexit
 {
-SignatureReader::SignatureReader()
+namespace
 {
-    m_signatures.push_back({ { 0x30, 0x26, 0xB2, 0x75, 0x8E, 0x66, 0xCF, 0x11, 0xA6, 0xD9, 0x00, 0xAA, 0x00, 0x62, 0xCE, 0x6C }, "asf", {} });
-    m_signatures.push_back({ { 0xFF, 0xD8, 0xFF, 0xE0, 0x00, 0x10, 0x4A, 0x46, 0x49, 0x46, 0x00, 0x01 }, "jpg", {} });
-    m_signatures.push_back({ { 0xFF, 0xD8, 0xFF, 0xE1, 0x45, 0x78, 0x69, 0x66, 0x00, 0x00 }, "jpg", { 4, 5 } });
-    m_signatures.push_back({ { 0x89, 0x50, 0x4E, 0x47, 0x0D, 0x0A, 0x1A, 0x0A }, "png", {} });
-    m_signatures.push_back({ { 0x52, 0x49, 0x46, 0x46, 0x57, 0x41, 0x56, 0x45 }, "wav", { 4, 5, 6, 7 } });
-    m_signatures.push_back({ { 0x21, 0x3C, 0x61, 0x72, 0x63, 0x68, 0x3E, 0x0A }, "deb", {} });
-    m_signatures.push_back({ { 0x42, 0x4C, 0x45, 0x4E, 0x44, 0x45, 0x52 }, "blend", {} });
-    m_signatures.push_back({ { 0x47, 0x49, 0x46, 0x38, 0x37, 0x61 }, "gif", {} });
-    m_signatures.push_back({ { 0x47, 0x49, 0x46, 0x38, 0x39, 0x61 }, "gif", {} });
-    m_signatures.push_back({ { 0x37, 0x7A, 0xBC, 0xAF, 0x27, 0x1C }, "7z", {} });
-    m_signatures.push_back({ { 0xFD, 0x37, 0x7A, 0x58, 0x5A, 0x00 }, "xz", {} });
-    m_signatures.push_back({ { 0x25, 0x50, 0x44, 0x46, 0x2D }, "pdf", {} });
-    m_signatures.push_back({ { 0xFF, 0xD8, 0xFF, 0xDB }, "jpg", {} });
-    m_signatures.push_back({ { 0xFF, 0xD8, 0xFF, 0xEE }, "jpg", {} });
-    m_signatures.push_back({ { 0xFF, 0xD8, 0xFF, 0xE0 }, "jpg", {} });
-    m_signatures.push_back({ { 0x50, 0x4B, 0x03, 0x04 }, "zip", {} });
-    m_signatures.push_back({ { 0x50, 0x4B, 0x05, 0x06 }, "zip", {} });
-    m_signatures.push_back({ { 0x50, 0x4B, 0x07, 0x08 }, "zip", {} });
-    m_signatures.push_back({ { 0x4F, 0x67, 0x67, 0x53 }, "ogg", {} });
-    m_signatures.push_back({ { 0x66, 0x4C, 0x61, 0x43 }, "flac", {} });
-    m_signatures.push_back({ { 0x1A, 0x45, 0xDF, 0xA3 }, "mkv", {} });
-    m_signatures.push_back({ { 0x00, 0x61, 0x73, 0x6D }, "wasm", {} });
-    m_signatures.push_back({ { 0x00, 0x00, 0x01, 0xBA }, "mpeg", {} });
-    m_signatures.push_back({ { 0x00, 0x00, 0x01, 0xB3 }, "mpeg", {} });
-    m_signatures.push_back({ { 0x4E, 0x45, 0x53, 0x1A }, "nes", {} });
-    m_signatures.push_back({ { 0x49, 0x44, 0x33 }, "mp3", {} });
-    m_signatures.push_back({ { 0x4E, 0x45, 0x53 }, "nes", {} });
-    m_signatures.push_back({ { 0x1F, 0x8B }, "gz", {} });
-    m_signatures.push_back({ { 0xFF, 0xFB }, "mp3", {} });
-    m_signatures.push_back({ { 0xFF, 0xF3 }, "mp3", {} });
-    m_signatures.push_back({ { 0xFF, 0xF2 }, "mp3", {} });
-    m_signatures.push_back({ { 0x42, 0x4D }, "bmp", {} });
+using Signature = SignatureReader::Signature;
+
+constexpr std::uint8_t hex_digit(char c)
+{
+    if (c >= '0' && c <= '9')
+        return static_cast<std::uint8_t>(c - '0');
+    if (c >= 'A' && c <= 'F')
+        return static_cast<std::uint8_t>(c - 'A' + 10);
+    throw "Invalid hex digit in a signature";
 }
 
-std::string SignatureReader::get_type(const std::vector<std::uint8_t>& query)
+// A signature from its bytes in hex digits separated by spaces, ?? for a byte that is skipped. Invalid input
+// fails the compilation, since the table is constexpr.
+constexpr Signature make(std::string_view bytes, std::string_view type)
 {
-    for (const auto& signature : m_signatures)
+    Signature signature { {}, {}, 0, type };
+    for (std::uintmax_t i = 0; i < bytes.size(); i += 3)
     {
-        std::uintmax_t signature_size = signature.m_buffer.size() + signature.m_skip.size();
-        if ((query.size() < signature_size) || (signature.m_skip.size() >= signature.m_buffer.size()))
-            continue;
+        if (signature.m_size == SignatureReader::SIGNATURE_WORDS * 8 || i + 2 > bytes.size())
+            throw "Signature too long or cut off";
 
-        std::uintmax_t i = 0, j = 0;
-        bool           match = false;
-        while ((i < signature_size) && (j < signature.m_buffer.size()))
+        const std::uintmax_t shift = signature.m_size % 8 * 8;
+        if (bytes[i] != '?')
         {
-            if (signature.m_skip.contains(i))
-                i++;
-            else if (match = (query[i++] == signature.m_buffer[j++]); !match)
-                break;
+            signature.m_value[signature.m_size / 8] |= std::uint64_t { static_cast<std::uint8_t>(hex_digit(bytes[i]) << 4 | hex_digit(bytes[i + 1])) } << shift;
+            signature.m_mask[signature.m_size / 8] |= std::uint64_t { 0xFF } << shift;
         }
+        signature.m_size++;
+    }
+
+    // The dispatch goes by the first byte.
+    if (signature.m_size == 0 || signature.mask(0) == 0)
+        throw "Signature without a first byte";
+    return signature;
+}
+
+constexpr std::array SIGNATURES = {
+    make("30 26 B2 75 8E 66 CF 11 A6 D9 00 AA 00 62 CE 6C", "asf"),
+    make("FF D8 FF E0 00 10 4A 46 49 46 00 01", "jpg"),
+    make("FF D8 FF E1 ?? ?? 45 78 69 66 00 00", "jpg"),
+    make("89 50 4E 47 0D 0A 1A 0A", "png"),
+    make("52 49 46 46 ?? ?? ?? ?? 57 41 56 45", "wav"),
+    make("21 3C 61 72 63 68 3E 0A", "deb"),
+    make("42 4C 45 4E 44 45 52", "blend"),
+    make("47 49 46 38 37 61", "gif"),
+    make("47 49 46 38 39 61", "gif"),
+    make("37 7A BC AF 27 1C", "7z"),
+    make("FD 37 7A 58 5A 00", "xz"),
+    make("25 50 44 46 2D", "pdf"),
+    make("FF D8 FF DB", "jpg"),
+    make("FF D8 FF EE", "jpg"),
+    make("FF D8 FF E0", "jpg"),
+    make("50 4B 03 04", "zip"),
+    make("50 4B 05 06", "zip"),
+    make("50 4B 07 08", "zip"),
+    make("4F 67 67 53", "ogg"),
+    make("66 4C 61 43", "flac"),
+    make("1A 45 DF A3", "mkv"),
+    make("00 61 73 6D", "wasm"),
+    make("00 00 01 BA", "mpeg"),
+    make("00 00 01 B3", "mpeg"),
+    make("4E 45 53 1A", "nes"),
+    make("49 44 33", "mp3"),
+    make("4E 45 53", "nes"),
+    make("1F 8B", "gz"),
+    make("FF FB", "mp3"),
+    make("FF F3", "mp3"),
+    make("FF F2", "mp3"),
+    make("42 4D", "bmp"),
+};
+static_assert(SIGNATURES.size() <= UINT8_MAX, "The dispatch table holds signature indexes in bytes");
 
-        if ((j == signature.m_buffer.size()) && match)
+// The indexes of the signatures sorted by their first byte, keeping their order otherwise.
+struct Dispatch
+{
+    std::array<std::uint8_t, 257>               m_start; // The signatures starting with byte b are m_order[m_start[b], m_start[b + 1]).
+    std::array<std::uint8_t, SIGNATURES.size()> m_order;
+};
+
+constexpr Dispatch make_dispatch()
+{
+    Dispatch dispatch {};
+    for (const auto& signature : SIGNATURES)
+        dispatch.m_start[signature.value(0) + 1]++;
+    for (std::uintmax_t byte = 1; byte < dispatch.m_start.size(); ++byte)
+        dispatch.m_start[byte] += dispatch.m_start[byte - 1];
+
+    std::array<std::uint8_t, 256> next {};
+    for (std::uintmax_t i = 0; i < SIGNATURES.size(); ++i)
+    {
+        const std::uint8_t first = SIGNATURES[i].value(0);
+        dispatch.m_order[dispatch.m_start[first] + next[first]++] = static_cast<std::uint8_t>(i);
+    }
+    return dispatch;
+}
+
+constexpr Dispatch DISPATCH = make_dispatch();
+} // namespace
+
+std::string_view SignatureReader::get_type(const std::uint8_t* query, std::uintmax_t size)
+{
+    if (size == 0)
+        return "unk";
+
+    std::array<std::uint64_t, SIGNATURE_WORDS> words {};
+    const std::uintmax_t                        count = std::min<std::uintmax_t>(size, SIGNATURE_WORDS * 8);
+    for (std::uintmax_t i = 0; i < count; ++i)
+        words[i / 8] |= std::uint64_t { query[i] } << (i % 8 * 8);
+
+    for (std::uintmax_t i = DISPATCH.m_start[query[0]]; i < DISPATCH.m_start[query[0] + 1]; ++i)
+    {
+        const Signature& signature = SIGNATURES[DISPATCH.m_order[i]];
+        if (signature.m_size > size)
+            continue;
+
+        bool match = true;
+        for (std::uintmax_t word = 0; match && word < SIGNATURE_WORDS; ++word)
+            match = (words[word] & signature.m_mask[word]) == signature.m_value[word];
+        if (match)
             return signature.m_type;
     }
 
     return "unk";
 }
+
+std::span<const SignatureReader::Signature> SignatureReader::signatures()
+{
+    return SIGNATURES;
+}
 } // namespace Hexit
@@ -1,34 +1,44 @@
 #ifndef SIGNATURE_READER_H
 #define SIGNATURE_READER_H
 
+#include <array>
 #include <cstdint>
-#include <set>
-#include <string>
+#include <span>
+#include <string_view>
 #include <vector>
 
 namespace Hexit
 {
+// Tells the type of a file by the bytes at its start. The signatures are constexpr data, which gets sorted
+// by the first byte at compile time, so a query only compares the few signatures that start with its first
+// byte, a word at a time. Nothing gets allocated.
 class SignatureReader
 {
 public:
-    SignatureReader();
-    ~SignatureReader() = default;
+    static constexpr std::uintmax_t SIGNATURE_WORDS = 2; // Signatures are at most 8 times as many bytes.
 
-    std::string get_type(const std::vector<std::uint8_t>& query);
-
-private:
     struct Signature
     {
-        std::vector<std::uint8_t> m_buffer; // Byte values to compare.
-        std::string               m_type;   // Name of the file type.
-        std::set<std::uintmax_t>  m_skip;   // A set of byte indexes in the query whose value should not be taken into account.
-                                            // For example, the signature for a WAV file is: 0x52 0x49 0x46 0x46 ?? ?? ?? ?? 0x57 0x41 0x56 0x45
-                                            // The fields of the corresponding Signature object should be:
-                                            // m_buffer: 0x52 0x49 0x46 0x46 0x57 0x41 0x56 0x45
-                                            // m_type: "wav"
-                                            // m_skip: 4,5,6,7
+        // The bytes in little endian order, 8 to a word. The mask bits of the bytes whose value should not be taken
+        // into account are 0. For example, the signature of a WAV file is: 0x52 0x49 0x46 0x46 ?? ?? ?? ?? 0x57 0x41
+        // 0x56 0x45, where the mask of the bytes 4 to 7 is 0x00 and the one of the other bytes 0xFF.
+        std::array<std::uint64_t, SIGNATURE_WORDS> m_value;
+        std::array<std::uint64_t, SIGNATURE_WORDS> m_mask;
+        std::uint8_t                                m_size; // Number of bytes, skipped ones included.
+        std::string_view                            m_type; // Name of the file type.
+
+        inline constexpr std::uint8_t value(std::uintmax_t i) const { return static_cast<std::uint8_t>(m_value[i / 8] >> (i % 8 * 8)); }
+
+        inline constexpr std::uint8_t mask(std::uintmax_t i) const { return static_cast<std::uint8_t>(m_mask[i / 8] >> (i % 8 * 8)); }
     };
-    std::vector<Signature> m_signatures;
+
+    // The type of the file that starts with the bytes of query, "unk" if none of the signatures match.
+    static std::string_view get_type(const std::uint8_t* query, std::uintmax_t size);
+
+    static inline std::string_view get_type(const std::vector<std::uint8_t>& query) { return get_type(query.data(), query.size()); }
+
+    // In the order they are tried in, the first one that matches wins.
+    static std::span<const Signature> signatures();
 };
 } // namespace Hexit
 #endif // SIGNATURE_READER_H
@@ -0,0 +1,184 @@
+#include "SignatureScanner.h"
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <thread>
+
+namespace Hexit
+{
+namespace
+{
+constexpr std::uint32_t NO_STATE = UINT32_MAX;
+} // namespace
+
+SignatureScanner::SignatureScanner(Searcher::Reader reader, unsigned threads)
+    : m_reader(std::move(reader))
+    , m_threads(threads ? threads : std::max(1u, std::thread::hardware_concurrency()))
+    , m_longest(0)
+{
+    m_next.emplace_back().fill(NO_STATE);
+    m_outputs.emplace_back();
+
+    for (const auto& signature : SignatureReader::signatures())
+    {
+        Searcher::Pattern pattern;
+        for (std::uintmax_t i = 0; i < signature.m_size; ++i)
+        {
+            pattern.m_value.push_back(signature.value(i));
+            pattern.m_mask.push_back(signature.mask(i));
+        }
+
+        // The longest run of bytes that have to match.
+        Keyword keyword { static_cast<std::uint32_t>(m_patterns.size()), 0, 0 };
+        for (std::uintmax_t start = 0, end = 0; start < pattern.size(); start = end + 1)
+        {
+            for (end = start; end < pattern.size() && pattern.m_mask[end]; ++end)
+                ;
+            if (end - start > keyword.m_length)
+                keyword = { keyword.m_signature, start, end - start };
+        }
+
+        m_longest = std::max(m_longest, pattern.size());
+        m_patterns.push_back(std::move(pattern));
+        add_keyword(keyword);
+    }
+
+    build();
+}
+
+bool SignatureScanner::scan(std::uintmax_t first, std::uintmax_t last)
+{
+    m_hits.clear();
+    if (last <= first || m_longest == 0)
+        return true;
+
+    const std::uintmax_t          blocks = (last - first + SEARCH_BLOCK_SIZE - 1) / SEARCH_BLOCK_SIZE;
+    std::vector<std::vector<Hit>> found(blocks);
+    std::atomic<std::uintmax_t>   next   = 0;
+    std::atomic<bool>             failed = false;
+    const auto                    work   = [&]
+    {
+        std::vector<std::uint8_t> buffer;
+        for (std::uintmax_t block = next++; block < blocks && !failed; block = next++)
+        {
+            const std::uintmax_t start = first + block * SEARCH_BLOCK_SIZE;
+            buffer.resize(std::min(SEARCH_BLOCK_SIZE + m_longest - 1, last - start));
+            if (!m_reader(start, buffer.data(), buffer.size()))
+            {
+                failed = true;
+                return;
+            }
+            scan_block(buffer.data(), buffer.size(), std::min(SEARCH_BLOCK_SIZE, last - start), start, found[block]);
+        }
+    };
+
+    const unsigned           threads = static_cast<unsigned>(std::min<std::uintmax_t>(m_threads, blocks));
+    std::vector<std::thread> workers;
+    for (unsigned thread = 1; thread < threads; ++thread)
+        workers.emplace_back(work);
+    work();
+    for (auto& worker : workers)
+        worker.join();
+
+    if (failed)
+        return false;
+    for (const auto& hits : found)
+        m_hits.insert(m_hits.end(), hits.begin(), hits.end());
+    return true;
+}
+
+std::uintmax_t SignatureScanner::lower_bound(std::uintmax_t offset) const
+{
+    const auto hit = std::lower_bound(m_hits.begin(), m_hits.end(), offset, [](const Hit& hit, std::uintmax_t value)
+                                      { return hit.m_offset < value; });
+    return static_cast<std::uintmax_t>(hit - m_hits.begin());
+}
+
+void SignatureScanner::scan_block(const std::uint8_t* data, std::uintmax_t size, std::uintmax_t positions, std::uintmax_t offset, std::vector<Hit>& o_hits) const
+{
+    // Keywords that end past here belong to signatures that start past the positions.
+    const std::uintmax_t end   = std::min(size, positions + m_longest - 1);
+    std::uint32_t        state = 0;
+    o_hits.clear();
+    for (std::uintmax_t i = 0; i < end; ++i)
+    {
+        state = m_next[state][data[i]];
+        for (const auto id : m_outputs[state])
+        {
+            const Keyword& keyword = m_keywords[id];
+            const auto&    pattern = m_patterns[keyword.m_signature];
+            if (i + 1 < keyword.m_start + keyword.m_length)
+                continue;
+
+            const std::uintmax_t position = i + 1 - keyword.m_length - keyword.m_start;
+            if (position >= positions || position + pattern.size() > size)
+                continue;
+
+            bool match = true;
+            for (std::uintmax_t j = 0; match && j < pattern.size(); ++j)
+                match = (data[position + j] & pattern.m_mask[j]) == pattern.m_value[j];
+            if (match)
+                o_hits.push_back({ offset + position, keyword.m_signature });
+        }
+    }
+
+    // Keywords end in the order of the bytes, not in the one of the signatures they belong to.
+    std::sort(o_hits.begin(), o_hits.end(), [](const Hit& a, const Hit& b)
+              { return a.m_offset < b.m_offset || (a.m_offset == b.m_offset && a.m_signature < b.m_signature); });
+    o_hits.erase(std::unique(o_hits.begin(), o_hits.end(), [](const Hit& a, const Hit& b)
+                             { return a.m_offset == b.m_offset; }),
+                 o_hits.end());
+}
+
+void SignatureScanner::add_keyword(const Keyword& keyword)
+{
+    const auto&   pattern = m_patterns[keyword.m_signature];
+    std::uint32_t state   = 0;
+    for (std::uintmax_t i = keyword.m_start; i < keyword.m_start + keyword.m_length; ++i)
+    {
+        if (m_next[state][pattern.m_value[i]] == NO_STATE)
+        {
+            m_next[state][pattern.m_value[i]] = static_cast<std::uint32_t>(m_next.size());
+            m_next.emplace_back().fill(NO_STATE);
+            m_outputs.emplace_back();
+        }
+        state = m_next[state][pattern.m_value[i]];
+    }
+
+    m_outputs[state].push_back(static_cast<std::uint32_t>(m_keywords.size()));
+    m_keywords.push_back(keyword);
+}
+
+void SignatureScanner::build()
+{
+    // Breadth first, so that the state a suffix falls back to is complete before the ones that fall back to it.
+    std::vector<std::uint32_t> fallback(m_next.size(), 0);
+    std::deque<std::uint32_t>  pending;
+    for (auto& next : m_next[0])
+    {
+        if (next == NO_STATE)
+            next = 0;
+        else
+            pending.push_back(next);
+    }
+
+    while (!pending.empty())
+    {
+        const std::uint32_t state = pending.front();
+        pending.pop_front();
+        const auto& inherited = m_outputs[fallback[state]];
+        m_outputs[state].insert(m_outputs[state].end(), inherited.begin(), inherited.end());
+        for (std::uint32_t byte = 0; byte < 256; ++byte)
+        {
+            auto& next = m_next[state][byte];
+            if (next == NO_STATE)
+                next = m_next[fallback[state]][byte];
+            else
+            {
+                fallback[next] = m_next[fallback[state]][byte];
+                pending.push_back(next);
+            }
+        }
+    }
+}
+} // namespace Hexit
@@ -0,0 +1,72 @@
+#ifndef SIGNATURE_SCANNER_H
+#define SIGNATURE_SCANNER_H
+
+#include "Searcher.h"
+#include "SignatureReader.h"
+#include "config.h"
+#include <array>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace Hexit
+{
+// Finds the signatures of SignatureReader anywhere in a range of bytes, to tell the files embedded in it. The
+// longest run of each signature without skipped bytes becomes a keyword of an Aho-Corasick automaton, which
+// the bytes stream through once. Every keyword it finds then gets verified along with the rest of its
+// signature. Like Searcher, threads claim blocks of SEARCH_BLOCK_SIZE positions that get read along with the
+// bytes that a signature starting at their end needs. Where several signatures match at the same offset,
+// the first one in the order of SignatureReader wins.
+class SignatureScanner
+{
+public:
+    struct Hit
+    {
+        std::uintmax_t m_offset;
+        std::uint32_t  m_signature; // Index into the signatures of SignatureReader.
+    };
+
+    // Zero threads uses one per core.
+    explicit SignatureScanner(Searcher::Reader reader, unsigned threads = 0);
+
+    // Replaces the hits with the ones within [first, last), false if the reader failed.
+    bool scan(std::uintmax_t first, std::uintmax_t last);
+
+    // Sorted by their offsets.
+    inline const std::vector<Hit>& hits() const { return m_hits; }
+
+    inline std::string_view type(const Hit& hit) const { return SignatureReader::signatures()[hit.m_signature].m_type; }
+
+    // The index of the first hit at or after offset, the number of hits if there is none.
+    std::uintmax_t lower_bound(std::uintmax_t offset) const;
+
+    // The hits of data, whose first size - longest signature + 1 positions get checked.
+    void scan_block(const std::uint8_t* data, std::uintmax_t size, std::uintmax_t positions, std::uintmax_t offset, std::vector<Hit>& o_hits) const;
+
+    // The length of the longest signature.
+    inline std::uintmax_t longest() const { return m_longest; }
+
+private:
+    struct Keyword
+    {
+        std::uint32_t  m_signature;
+        std::uintmax_t m_start;  // Offset of the keyword within its signature.
+        std::uintmax_t m_length;
+    };
+
+    void add_keyword(const Keyword& keyword);
+
+    // Links every state to the ones its bytes lead to, falling back along the longest proper suffixes.
+    void build();
+
+    Searcher::Reader                            m_reader;
+    const unsigned                              m_threads;
+    std::vector<Searcher::Pattern>              m_patterns; // The signatures with their skipped bytes as wildcards.
+    std::vector<Keyword>                        m_keywords;
+    std::vector<std::array<std::uint32_t, 256>> m_next; // The automaton, state 0 is the root.
+    std::vector<std::vector<std::uint32_t>>     m_outputs; // The keywords that end at each state.
+    std::uintmax_t                              m_longest;
+    std::vector<Hit>                            m_hits;
+};
+} // namespace Hexit
+#endif // SIGNATURE_SCANNER_H
@@ -0,0 +1,78 @@
+#ifndef STATISTICS_H
+#define STATISTICS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace Hexit
+{
+// Counters of an IOHandler. The prefetcher updates them from its own thread, hence the atomics.
+struct IOStatistics
+{
+    std::atomic<std::uintmax_t> m_reads         = { 0 }; // Number of read requests served.
+    std::atomic<std::uintmax_t> m_writes        = { 0 }; // Number of write requests served.
+    std::atomic<std::uintmax_t> m_bytes_read    = { 0 };
+    std::atomic<std::uintmax_t> m_bytes_written = { 0 };
+    std::atomic<std::uintmax_t> m_io_ns         = { 0 }; // Time spent waiting for reads and writes.
+
+    inline void count_read(std::uintmax_t bytes)
+    {
+        m_reads.fetch_add(1, std::memory_order_relaxed);
+        m_bytes_read.fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    inline void count_write(std::uintmax_t bytes)
+    {
+        m_writes.fetch_add(1, std::memory_order_relaxed);
+        m_bytes_written.fetch_add(bytes, std::memory_order_relaxed);
+    }
+};
+
+// Counters of a ChunkCache, only ever updated by the thread that owns the cache, except for the saves.
+struct CacheStatistics
+{
+    std::uintmax_t              m_hits          = { 0 }; // Lookups of chunks that were cached.
+    std::uintmax_t              m_misses        = { 0 }; // Lookups of chunks that were not cached.
+    std::uintmax_t              m_loads         = { 0 }; // Chunks loaded into the cache, including the prefetched ones.
+    std::uintmax_t              m_prefetch_hits = { 0 }; // Chunks that were loaded from the prefetcher.
+    std::uintmax_t              m_evictions     = { 0 };
+    std::atomic<std::uintmax_t> m_saves         = { 0 }; // Chunks and extents written back, also by background saves.
+};
+
+// Counters of a ByteBuffer.
+struct BufferStatistics
+{
+    std::uintmax_t m_byte_reads  = { 0 };
+    std::uintmax_t m_byte_writes = { 0 };
+    std::uintmax_t m_saves       = { 0 };
+    std::uintmax_t m_save_ns     = { 0 }; // Time spent in save().
+};
+
+// Adds the time elapsed during its lifetime to the given counter, in nanoseconds.
+template <typename Counter>
+class ScopedTimer
+{
+public:
+    explicit ScopedTimer(Counter& counter)
+        : m_counter(counter)
+        , m_start(std::chrono::steady_clock::now())
+    {
+    }
+
+    ~ScopedTimer()
+    {
+        const auto elapsed = std::chrono::steady_clock::now() - m_start;
+        m_counter += static_cast<std::uintmax_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+    }
+
+    ScopedTimer(const ScopedTimer&) = delete;
+
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+    Counter&                              m_counter;
+    std::chrono::steady_clock::time_point m_start;
+};
+} // namespace Hexit
+#endif // STATISTICS_H
@@ -1,44 +1,199 @@
 #include "StdInHandler.h"
+#include "config.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
 #include <cstring>
-#include <iostream>
-#include <iterator>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <unistd.h>
 
 namespace Hexit
 {
-bool StdInHandler::open(const fs::path& path)
+namespace
+{
+bool write_all(int fd, const std::uint8_t* data, std::uintmax_t size)
+{
+    while (size > 0)
+    {
+        const ssize_t count = ::write(fd, data, size);
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count <= 0)
+            return false;
+
+        data += count;
+        size -= static_cast<std::uintmax_t>(count);
+    }
+
+    return true;
+}
+
+bool pread_all(int fd, std::uint8_t* data, std::uintmax_t size, std::uintmax_t offset)
+{
+    while (size > 0)
+    {
+        const ssize_t count = ::pread(fd, data, size, static_cast<off_t>(offset));
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count <= 0)
+            return false;
+
+        data += count;
+        size -= static_cast<std::uintmax_t>(count);
+        offset += static_cast<std::uintmax_t>(count);
+    }
+
+    return true;
+}
+
+// An unnamed file in the temporary directory, so that the spilled input lives on disk and is gone once
+// closed. Falls back to a memfd, which can at least be swapped out, if the file system lacks O_TMPFILE.
+int open_spill_file()
 {
-    std::cin.unsetf(std::ios_base::skipws);
-    m_data.insert(m_data.begin(),
-                  std::istream_iterator<std::uint8_t>(std::cin),
-                  std::istream_iterator<std::uint8_t>());
+    std::error_code ec;
+    const fs::path  directory = fs::temp_directory_path(ec);
+    const int       fd        = ec ? -1 : ::open(directory.c_str(), O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+    return fd >= 0 ? fd : ::memfd_create("hexit-stdin", MFD_CLOEXEC);
+}
+} // namespace
+
+StdInHandler::StdInHandler(bool read_only, std::uintmax_t memory_limit)
+    : IOHandler(read_only)
+    , m_memory_limit((memory_limit + STDIN_BLOCK_SIZE - 1) / STDIN_BLOCK_SIZE * STDIN_BLOCK_SIZE)
+    , m_spill(-1)
+    , m_offset(0u)
+    , m_input(-1)
+    , m_wake(-1)
+    , m_received(0u)
+    , m_finished(true)
+    , m_failed(false)
+{
+}
 
-    if (m_data.empty())
+StdInHandler::~StdInHandler()
+{
+    close();
+}
+
+bool StdInHandler::open(const fs::path& path)
+{
+    const int input = ::dup(STDIN_FILENO);
+    if (input < 0)
         return false;
 
-    m_size   = m_data.size();
-    m_offset = 0;
-    m_name   = path;
     // reopen the tty device to allow ncurses to read from stdin
-    return freopen("/dev/tty", "rw", stdin) != nullptr;
+    if (!std::freopen("/dev/tty", "rw", stdin))
+    {
+        ::close(input);
+        return false;
+    }
+
+    return open_input(input, path);
+}
+
+bool StdInHandler::open_input(int fd, const fs::path& path)
+{
+    if (m_reader.joinable())
+    {
+        ::close(fd);
+        return false;
+    }
+
+    m_wake = ::eventfd(0, EFD_CLOEXEC);
+    if (m_wake < 0)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    m_input    = fd;
+    m_name     = path;
+    m_offset   = 0;
+    m_received = 0;
+    m_finished = false;
+    m_failed   = false;
+    m_reader   = std::thread(&StdInHandler::run, this);
+
+    // The UI starts as soon as there is something to show, whatever the size of the input.
+    {
+        std::unique_lock<std::mutex> lock(m_arrival_lock);
+        m_arrival.wait(lock, [this]()
+                       { return m_received > 0 || m_finished; });
+    }
+
+    refresh();
+    if (m_size == 0)
+    {
+        close();
+        return false;
+    }
+
+    return true;
 }
 
 void StdInHandler::close()
 {
-    m_offset = 0;
-    m_name   = "";
-    m_size   = 0;
-    m_data.clear();
+    if (m_reader.joinable())
+    {
+        const std::uint64_t stop = 1;
+        static_cast<void>(::write(m_wake, &stop, sizeof(stop)));
+        m_reader.join();
+    }
+
+    if (m_wake >= 0)
+        ::close(m_wake);
+    if (m_input >= 0)
+        ::close(m_input);
+    if (m_spill >= 0)
+        ::close(m_spill);
+
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_spill    = -1;
+    m_input    = -1;
+    m_wake     = -1;
+    m_offset   = 0;
+    m_name     = "";
+    m_size     = 0;
+    m_received = 0;
+    m_blocks.clear();
 }
 
 bool StdInHandler::read(std::uint8_t* o_buffer, std::uintmax_t buffer_size)
 {
+    return read_at(m_offset, o_buffer, buffer_size);
+}
+
+bool StdInHandler::read_at(std::uintmax_t offset, std::uint8_t* o_buffer, std::uintmax_t buffer_size)
+{
+    std::lock_guard<std::mutex> lock(m_lock);
     if (!o_buffer
-        || m_data.empty()
-        || (buffer_size + m_offset) > m_size)
+        || m_size == 0
+        || (buffer_size + offset) > m_size)
         return false;
 
-    if (buffer_size != 0)
-        std::memcpy(o_buffer, m_data.data() + m_offset, buffer_size);
+    m_statistics.count_read(buffer_size);
+    if (m_spill >= 0 && offset + buffer_size > m_memory_limit)
+    {
+        // The tail of the range lies in the temporary file, which starts where the blocks end.
+        const std::uintmax_t first = std::max(offset, m_memory_limit);
+        if (!pread_all(m_spill, o_buffer + (first - offset), offset + buffer_size - first, first - m_memory_limit))
+            return false;
+        buffer_size = first - offset;
+    }
+
+    while (buffer_size > 0)
+    {
+        const std::uintmax_t block  = offset / STDIN_BLOCK_SIZE;
+        const std::uintmax_t first  = offset - block * STDIN_BLOCK_SIZE;
+        const std::uintmax_t length = std::min(buffer_size, STDIN_BLOCK_SIZE - first);
+        std::memcpy(o_buffer, m_blocks[block].get() + first, length);
+        o_buffer += length;
+        offset += length;
+        buffer_size -= length;
+    }
 
     return true;
 }
@@ -52,10 +207,118 @@ bool StdInHandler::write(const std::uint8_t* i_buffer, std::uintmax_t buffer_siz
 
 bool StdInHandler::seek(std::uintmax_t offset)
 {
-    if (m_data.empty() || offset >= m_size)
+    if (m_size == 0 || offset >= m_size)
         return false;
 
     m_offset = offset;
     return true;
 }
+
+bool StdInHandler::refresh()
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    const std::uintmax_t        received = m_received.load(std::memory_order_acquire);
+    if (received == m_size)
+        return false;
+
+    m_size = received;
+    return true;
+}
+
+bool StdInHandler::is_streaming() const
+{
+    return !m_finished.load(std::memory_order_acquire) || received() != m_size;
+}
+
+bool StdInHandler::spill()
+{
+    const int fd = open_spill_file();
+    if (fd < 0)
+        return false;
+
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_spill.store(fd, std::memory_order_release);
+    return true;
+}
+
+void StdInHandler::run()
+{
+    std::uint8_t*                   block    = nullptr;
+    std::uintmax_t                  blocks   = 0;
+    std::uintmax_t                  received = 0;
+    pollfd                          fds[2]   = { { m_input, POLLIN, 0 }, { m_wake, POLLIN, 0 } };
+    std::unique_ptr<std::uint8_t[]> spilled; // The block the input goes through once it spills.
+    const auto                      publish = [this](std::uintmax_t total)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_arrival_lock);
+            m_received.store(total, std::memory_order_release);
+        }
+        m_arrival.notify_all();
+    };
+    bool failed = false;
+    while (true)
+    {
+        if (::poll(fds, 2, -1) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            failed = true;
+            break;
+        }
+
+        if (fds[1].revents != 0)
+            break;
+
+        // Past the memory limit the input goes through a single block into the temporary file, unless that
+        // cannot be created. The blocks fill up one after the other, so the input reaches the limit exactly.
+        if (received == m_memory_limit && !spilled && spill())
+            spilled = std::make_unique_for_overwrite<std::uint8_t[]>(STDIN_BLOCK_SIZE);
+
+        if (spilled)
+        {
+            const ssize_t count = ::read(m_input, spilled.get(), STDIN_BLOCK_SIZE);
+            if (count < 0 && (errno == EINTR || errno == EAGAIN))
+                continue;
+            if (count <= 0 || !write_all(m_spill, spilled.get(), static_cast<std::uintmax_t>(count)))
+            {
+                failed = count != 0;
+                break;
+            }
+
+            received += static_cast<std::uintmax_t>(count);
+            publish(received);
+            continue;
+        }
+
+        // Blocks get allocated as they fill up, the bytes that are already in them never move.
+        if (received == blocks * STDIN_BLOCK_SIZE)
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+            m_blocks.push_back(std::make_unique_for_overwrite<std::uint8_t[]>(STDIN_BLOCK_SIZE));
+            block = m_blocks.back().get();
+            blocks++;
+        }
+
+        const std::uintmax_t offset = received % STDIN_BLOCK_SIZE;
+        const ssize_t        count  = ::read(m_input, block + offset, STDIN_BLOCK_SIZE - offset);
+        if (count < 0 && (errno == EINTR || errno == EAGAIN))
+            continue;
+        if (count <= 0)
+        {
+            failed = count < 0;
+            break;
+        }
+
+        received += static_cast<std::uintmax_t>(count);
+        publish(received);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_arrival_lock);
+        m_failed.store(failed, std::memory_order_release);
+        m_finished.store(true, std::memory_order_release);
+    }
+    m_arrival.notify_all();
+}
 } // namespace Hexit
@@ -2,23 +2,33 @@
 #define STDIN_HANDLER_H
 
 #include "IOHandler.h"
+#include "config.h"
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <thread>
 #include <vector>
 
 namespace Hexit
 {
+// Reads standard input on a background thread, so that its bytes can be shown while they are still
+// arriving. The bytes are kept in blocks of STDIN_BLOCK_SIZE that never move once allocated, and
+// size() only grows when refresh() takes in the bytes that have arrived so far. Past memory_limit,
+// rounded up to whole blocks, the input spills into an anonymous temporary file that is read with pread.
 class StdInHandler : public IOHandler
 {
 public:
-    explicit StdInHandler(bool read_only = false)
-        : IOHandler(read_only)
-        , m_offset(0u)
-    {
-    }
+    explicit StdInHandler(bool read_only = false, std::uintmax_t memory_limit = STDIN_MEMORY_LIMIT);
 
-    ~StdInHandler() = default;
+    ~StdInHandler();
 
+    // Starts reading standard input and reopens the terminal in its place, so that ncurses can read the keys.
+    // Returns once the first bytes have arrived, false if the input is empty.
     bool open(const fs::path& path) override;
 
+    // Same as open() for any readable descriptor, which the handler takes over.
+    bool open_input(int fd, const fs::path& path);
+
     void close() override;
 
     bool read(std::uint8_t* o_buffer, std::uintmax_t buffer_size) override;
@@ -27,9 +37,41 @@ public:
 
     bool seek(std::uintmax_t offset) override;
 
+    bool read_at(std::uintmax_t offset, std::uint8_t* o_buffer, std::uintmax_t buffer_size) override;
+
+    bool refresh() override;
+
+    inline bool has_pending() const override { return received() != m_size; }
+
+    bool is_streaming() const override;
+
+    inline bool is_incomplete() const override { return m_failed.load(std::memory_order_acquire); }
+
+    // Bytes that have arrived so far, including the ones refresh() has not taken in yet.
+    inline std::uintmax_t received() const { return m_received.load(std::memory_order_acquire); }
+
+    // True once the input has outgrown the memory limit.
+    inline bool is_spilled() const { return m_spill.load(std::memory_order_acquire) >= 0; }
+
 private:
-    std::vector<std::uint8_t> m_data;
-    std::uintmax_t            m_offset;
+    // Reads the input in blocks until EOF, an error or close(), on the background thread.
+    void run();
+
+    // Moves the reader over to the temporary file, false if it could not be created.
+    bool spill();
+
+    std::vector<std::unique_ptr<std::uint8_t[]>> m_blocks; // Guarded by m_lock, like m_size.
+    const std::uintmax_t                         m_memory_limit;
+    std::atomic<int>                             m_spill; // The temporary file, -1 until the input spills into it.
+    std::uintmax_t                               m_offset;
+    int                                          m_input; // The descriptor being read.
+    int                                          m_wake;  // Interrupts the reader on close().
+    std::atomic<std::uintmax_t>                  m_received;
+    std::atomic<bool>                            m_finished;
+    std::atomic<bool>                            m_failed; // Set along with m_finished if the input ended in an error.
+    std::mutex                                   m_arrival_lock;
+    std::condition_variable                      m_arrival; // Signalled whenever bytes arrive and at the end of the input.
+    std::thread                                  m_reader;
 };
 } // namespace Hexit
 #endif // STDIN_HANDLER_H
@@ -2,6 +2,10 @@
 #include "ByteBuffer.h"
 #include "Utilities.h"
 #include "config.h"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <charconv>
 #include <csignal>
 #include <cstdint>
 #include <cstdio>
@@ -9,37 +13,90 @@
 
 namespace Hexit
 {
-TerminalWindow::TerminalWindow(IOHandler& handler, const std::string& file_type, std::uintmax_t start_from_byte)
+namespace
+{
+template <typename... Args>
+std::string format_line(const char* format, Args... args)
+{
+    char line[128];
+    std::snprintf(line, sizeof(line), format, args...);
+    return line;
+}
+
+bool parse_number(const std::string& str, int base, std::uintmax_t& value)
+{
+    const auto [end, error] = std::from_chars(str.data(), str.data() + str.size(), value, base);
+    return !str.empty() && error == std::errc() && end == str.data() + str.size();
+}
+} // namespace
+
+TerminalWindow::TerminalWindow(IOHandler&         handler,
+                               const std::string& file_type,
+                               std::uintmax_t     start_from_byte,
+                               const CacheConfig& cache_config,
+                               bool               atomic_save)
     : m_scroller(handler.size(), BYTES_PER_LINE)
-    , m_data(handler)
+    , m_data(handler, cache_config)
+    , m_handler(handler)
     , m_name(handler.name().filename())
     , m_type(file_type)
     , m_byte(start_from_byte < handler.size() ? start_from_byte : handler.size() - 1)
+    , m_searcher([this](std::uintmax_t offset, std::uint8_t* data, std::uintmax_t count)
+                 { return m_data.read_direct(offset, data, count); })
+    , m_hits([this](std::uintmax_t offset, std::uint8_t* data, std::uintmax_t count)
+             { return m_data.read_direct(offset, data, count); })
+    , m_embedded([this](std::uintmax_t offset, std::uint8_t* data, std::uintmax_t count)
+                 { return m_data.read_direct(offset, data, count); })
     , m_mode(Mode::HEX)
     , m_prompt(Prompt::NONE)
+    , m_render_ns(0u)
+    , m_frames(0u)
+    , m_cells(0u)
     , m_nibble(0u)
     , m_update(true)
     , m_quit(false)
+    , m_insert(false)
+    , m_show_statistics(false)
+    , m_indexing(false)
 {
     std::snprintf(m_offset_format, sizeof(m_offset_format), "%%0%" PRIu32 PRIX64, LINE_OFFSET_LEN);
     m_input_buffer.reserve(LINE_OFFSET_LEN);
+    m_data.set_atomic_save(atomic_save);
     resize();
+    update_timeout();
 }
 
 TerminalWindow::~TerminalWindow()
 {
+    // A save that is still running gets completed, so that its errors can be reported.
+    m_data.wait_save();
     if (endwin(); !m_data.is_ok())
         std::cerr << m_data.error_msg() << std::endl;
 }
 
 void TerminalWindow::run()
 {
-    erase();
+    erase_screen();
     box(stdscr, 0, 0);
-    while (!m_quit && update_screen())
+    while (!m_quit)
     {
-        refresh();
+        {
+            ScopedTimer timer(m_render_ns);
+            if (!update_screen())
+                break;
+            refresh();
+            m_frames++;
+        }
+
         auto c = getch();
+        poll_save();
+        poll_input();
+        if (c != ERR && !m_message.empty())
+        {
+            m_message.clear();
+            m_update = true;
+            erase_screen();
+        }
         switch (c)
         {
         case KEY_UP:
@@ -62,14 +119,20 @@ void TerminalWindow::run()
             break;
         case KEY_RESIZE:
             resize();
-            erase();
+            erase_screen();
             break;
         case K_SAVE:
             prompt_save();
             break;
+        case K_SAVE_AS:
+            prompt_save_as();
+            break;
         case K_QUIT:
             prompt_quit();
             break;
+        case K_CANCEL:
+            cancel_save();
+            break;
         case K_HEX:
             toggle_hex_mode();
             break;
@@ -83,62 +146,140 @@ void TerminalWindow::run()
         case K_GO_TO:
             prompt_go_to_byte();
             break;
+        case K_STATS:
+            toggle_statistics();
+            break;
+        case K_FIND:
+            prompt_find();
+            break;
+        case K_NEXT:
+            if (m_prompt == Prompt::NONE)
+                find(m_byte + 1, true);
+            break;
+        case K_PREV:
+            if (m_prompt == Prompt::NONE)
+                find(m_byte, false);
+            break;
+        case K_HIT:
+            prompt_go_to_hit();
+            break;
+        case K_SCAN:
+            scan_embedded();
+            break;
+        case K_NEXT_EMB:
+            go_to_embedded(true);
+            break;
+        case K_PREV_EMB:
+            go_to_embedded(false);
+            break;
+        case K_CARVE:
+            prompt_carve();
+            break;
+        case K_FILL:
+        case K_PASTE:
+        case K_COPY:
+            prompt_range(c);
+            break;
+        case K_INSERT:
+        case KEY_IC:
+            toggle_insert_mode();
+            break;
+        case KEY_DC:
+            erase_byte(m_byte);
+            break;
         default:
             consume_input(c);
             break;
         }
+        update_hits();
     }
 }
 
 void TerminalWindow::draw_line(std::uint32_t line)
 {
     const std::uintmax_t line_abs      = m_scroller.first() + line;
-    std::uintmax_t       line_byte     = line_abs * BYTES_PER_LINE;
+    const std::uintmax_t line_byte     = line_abs * BYTES_PER_LINE;
     std::uint32_t        bytes_to_draw = BYTES_PER_LINE;
 
-    if (((m_scroller.total() - 1) == line_abs) && (m_data.size % BYTES_PER_LINE) > 0)
-        bytes_to_draw = m_data.size % BYTES_PER_LINE;
-    // Skip the first box border line.
-    line++;
-    // Draw the line byte offset.
-    mvprintw(line, 1, m_offset_format, line_byte);
-    for (std::uint32_t i = 0; i < BYTES_PER_LINE; ++i, ++line_byte)
+    if (((m_scroller.total() - 1) == line_abs) && (m_data.size() % BYTES_PER_LINE) > 0)
+        bytes_to_draw = m_data.size() % BYTES_PER_LINE;
+    std::array<std::uint8_t, BYTES_PER_LINE> bytes {};
+    m_data.read_range(line_byte, std::span(bytes.data(), bytes_to_draw));
+    const std::uint64_t dirty_mask = m_data.dirty_mask(line_byte, bytes_to_draw);
+    const std::uint64_t hit_mask   = m_hits.mask(line_byte, bytes_to_draw);
+    Frame::Line         cells;
+    for (std::uint32_t i = 0; i < BYTES_PER_LINE; ++i)
     {
-        const std::uint8_t bt           = m_data[line_byte];
-        const bool         is_dirty     = m_data.is_dirty(line_byte);
-        char               hexDigits[3] = { 0 };
-        std::sprintf(hexDigits, "%02X", bt);
-        if (line_byte == m_byte)
-        {
-            attron(A_REVERSE);
-            mvaddch(line, FIRST_ASCII + i, std::isprint(bt) ? bt : '.');
-            if (m_mode == Mode::HEX)
-            {
-                mvaddch(line, FIRST_HEX + i * 3 + m_nibble, hexDigits[m_nibble]);
-                attroff(A_REVERSE);
-                mvaddch(line, FIRST_HEX + i * 3 + 1 - m_nibble, hexDigits[1 - m_nibble]);
-            }
-            else
-            {
-                mvaddstr(line, FIRST_HEX + i * 3, hexDigits);
-                attroff(A_REVERSE);
-            }
-        }
-        else if (i < bytes_to_draw)
-        {
-            if (is_dirty)
-                attron(COLOR_PAIR(1) | A_REVERSE);
-            mvaddch(line, FIRST_ASCII + i, std::isprint(bt) ? bt : '.');
-            mvaddstr(line, FIRST_HEX + i * 3, hexDigits);
-            if (is_dirty)
-                attroff(COLOR_PAIR(1) | A_REVERSE);
-        }
-        else
-        {
-            // padding for the very last line.
-            mvaddch(line, FIRST_ASCII + i, ' ');
-            mvaddstr(line, FIRST_HEX + i * 3, "  ");
-        }
+        // Modified bytes stand out over the matches of a search, the padding of the very last line lies past the
+        // end of the buffer.
+        Frame::Style style = Frame::Style::PLAIN;
+        if (line_byte + i == m_byte)
+            style = m_mode == Mode::ASCII ? Frame::Style::CURSOR : m_nibble ? Frame::Style::CURSOR_LOW
+                                                                             : Frame::Style::CURSOR_HIGH;
+        else if (i >= bytes_to_draw)
+            style = Frame::Style::PADDING;
+        else if ((dirty_mask >> i) & 1u)
+            style = Frame::Style::DIRTY;
+        else if ((hit_mask >> i) & 1u)
+            style = Frame::Style::HIT;
+        cells[i] = { bytes[i], style };
+    }
+
+    // Only the cells that changed since the line was last drawn, below the first box border line.
+    const std::uint64_t changed = m_frame.update(line, line_byte, cells);
+    if (changed == Frame::ALL_CELLS)
+        mvprintw(static_cast<int>(line + 1), 1, m_offset_format, line_byte);
+    for (std::uint32_t i = 0; i < BYTES_PER_LINE; ++i)
+    {
+        if ((changed >> i) & 1u)
+            draw_cell(line + 1, i, cells[i]);
+    }
+    m_cells += static_cast<std::uintmax_t>(std::popcount(changed));
+}
+
+void TerminalWindow::draw_cell(std::uint32_t row, std::uint32_t column, const Frame::Cell& cell)
+{
+    constexpr char     DIGITS[] = "0123456789ABCDEF";
+    const char         hex[3]   = { DIGITS[cell.m_byte >> 4], DIGITS[cell.m_byte & 0xF], 0 };
+    const chtype       ascii    = std::isprint(cell.m_byte) ? cell.m_byte : '.';
+    const int          y        = static_cast<int>(row);
+    const int          x_ascii  = static_cast<int>(FIRST_ASCII + column);
+    const int          x_hex    = static_cast<int>(FIRST_HEX + column * 3);
+    const std::uint8_t nibble   = cell.m_style == Frame::Style::CURSOR_LOW;
+    const auto         draw     = [&](chtype attributes)
+    {
+        attron(attributes);
+        mvaddch(y, x_ascii, ascii);
+        mvaddstr(y, x_hex, hex);
+        attroff(attributes);
+    };
+
+    switch (cell.m_style)
+    {
+    case Frame::Style::DIRTY:
+        draw(COLOR_PAIR(1) | A_REVERSE);
+        break;
+    case Frame::Style::HIT:
+        draw(COLOR_PAIR(2) | A_REVERSE);
+        break;
+    case Frame::Style::CURSOR:
+        draw(A_REVERSE);
+        break;
+    case Frame::Style::CURSOR_HIGH:
+    case Frame::Style::CURSOR_LOW:
+        attron(A_REVERSE);
+        mvaddch(y, x_ascii, ascii);
+        mvaddch(y, x_hex + nibble, hex[nibble]);
+        attroff(A_REVERSE);
+        mvaddch(y, x_hex + 1 - nibble, hex[1 - nibble]);
+        break;
+    case Frame::Style::PADDING:
+        mvaddch(y, x_ascii, ' ');
+        mvaddstr(y, x_hex, "  ");
+        break;
+    default:
+        draw(0);
+        break;
     }
 }
 
@@ -159,6 +300,9 @@ bool TerminalWindow::update_screen()
         const std::uint32_t percentage  = static_cast<std::uint32_t>(static_cast<long double>(m_scroller.last() + 1) / m_scroller.total() * 100);
         const int           info_column = static_cast<int>(COLS - 8 - m_type.size());
         mvprintw(LINES - 1, info_column, "%s/%c/%d%%", m_type.data(), mode, percentage);
+        // The memory used by the chunk cache, which grows and shrinks with the access pattern.
+        mvprintw(LINES - 1, info_column - 7, "%6s", format_size(m_data.cache().footprint()).c_str());
+        mvaddstr(LINES - 1, info_column - 11, m_insert ? "INS" : "   ");
 
         if (m_prompt == Prompt::SAVE)
             mvaddstr(LINES - 1, 1, "Modified buffer, save?(y/n)");
@@ -166,6 +310,20 @@ bool TerminalWindow::update_screen()
             mvaddstr(LINES - 1, 1, "Modified buffer, quit?(y,n)");
         else if (m_prompt == Prompt::GO_TO_BYTE)
             mvprintw(LINES - 1, 1, "Goto byte: %s", m_input_buffer.c_str());
+        else if (m_prompt == Prompt::FILL)
+            mvprintw(LINES - 1, 1, "Fill count pattern: %s", m_input_buffer.c_str());
+        else if (m_prompt == Prompt::PASTE)
+            mvprintw(LINES - 1, 1, "Paste file: %s", m_input_buffer.c_str());
+        else if (m_prompt == Prompt::COPY)
+            mvprintw(LINES - 1, 1, "Copy offset count: %s", m_input_buffer.c_str());
+        else if (m_prompt == Prompt::SAVE_AS)
+            mvprintw(LINES - 1, 1, m_data.is_incomplete() ? "Save incomplete input as: %s" : "Save as: %s", m_input_buffer.c_str());
+        else if (m_prompt == Prompt::FIND)
+            mvprintw(LINES - 1, 1, "Find: %s", m_input_buffer.c_str());
+        else if (m_prompt == Prompt::GO_TO_HIT)
+            mvprintw(LINES - 1, 1, "Go to hit (1-%ju): %s", m_hits.count(), m_input_buffer.c_str());
+        else if (m_prompt == Prompt::CARVE)
+            mvprintw(LINES - 1, 1, "Carve to: %s", m_input_buffer.c_str());
         m_update = false;
     }
     else
@@ -181,10 +339,29 @@ bool TerminalWindow::update_screen()
     // Draw the current byte offset.
     if (m_prompt == Prompt::NONE)
         mvprintw(LINES - 1, 1, m_offset_format, m_byte);
+    if (m_data.is_saving() && m_prompt == Prompt::NONE)
+        mvprintw(LINES - 1, static_cast<int>(LINE_OFFSET_LEN) + 2, "Saving %3d%%, ctrl+c cancels", static_cast<int>(m_data.save_progress() * 100));
+    else if (m_data.is_streaming() && m_prompt == Prompt::NONE)
+        mvprintw(LINES - 1, static_cast<int>(LINE_OFFSET_LEN) + 2, "Reading input, %s so far", format_size(m_data.size()).c_str());
+    else if (!m_message.empty() && m_prompt == Prompt::NONE)
+        mvaddstr(LINES - 1, static_cast<int>(LINE_OFFSET_LEN) + 2, m_message.c_str());
+    else if (m_hits.is_active() && m_prompt == Prompt::NONE)
+        mvprintw(LINES - 1, static_cast<int>(LINE_OFFSET_LEN) + 2, "%-28s", hits_status().c_str());
+    else if (m_data.is_incomplete() && m_prompt == Prompt::NONE)
+        mvprintw(LINES - 1, static_cast<int>(LINE_OFFSET_LEN) + 2, "Reading input failed after %s", format_size(m_data.size()).c_str());
+
+    if (m_show_statistics)
+        draw_statistics();
 
     return m_data.is_ok();
 }
 
+void TerminalWindow::erase_screen()
+{
+    erase();
+    m_frame.invalidate();
+}
+
 void TerminalWindow::resize()
 {
     // If the number of terminal lines is less than or equal to 2, we cannot display much :(
@@ -192,6 +369,7 @@ void TerminalWindow::resize()
         return;
 
     m_scroller.adjust_lines(static_cast<std::uintmax_t>(LINES - 2), m_byte / BYTES_PER_LINE);
+    m_frame.resize(m_scroller.visible());
     m_update = true;
 }
 
@@ -223,13 +401,13 @@ void TerminalWindow::move_down()
     if (m_prompt != Prompt::NONE)
         return;
 
-    const std::uintmax_t distance = m_data.size - m_byte;
+    const std::uintmax_t distance = m_data.size() - m_byte;
     m_update                      = m_scroller.move_down();
     if (distance > BYTES_PER_LINE)
         m_byte += BYTES_PER_LINE;
-    else if (distance > (m_data.size % BYTES_PER_LINE))
+    else if (distance > (m_data.size() % BYTES_PER_LINE))
     {
-        m_byte   = m_data.size - 1;
+        m_byte   = m_data.size() - 1;
         m_nibble = 0;
     }
 }
@@ -239,10 +417,10 @@ void TerminalWindow::page_down()
     if (m_prompt != Prompt::NONE)
         return;
 
-    if ((m_data.size - m_byte) > (BYTES_PER_LINE * m_scroller.visible()))
+    if ((m_data.size() - m_byte) > (BYTES_PER_LINE * m_scroller.visible()))
         m_byte += BYTES_PER_LINE * m_scroller.visible();
     else
-        m_byte = m_data.size - 1;
+        m_byte = m_data.size() - 1;
 
     resize();
 }
@@ -277,8 +455,8 @@ void TerminalWindow::move_right()
     const std::uintmax_t line_abs   = m_byte / BYTES_PER_LINE;
     std::uint32_t        line_bytes = BYTES_PER_LINE;
 
-    if ((line_abs == m_scroller.total() - 1) && (m_data.size % BYTES_PER_LINE) > 0)
-        line_bytes = m_data.size % BYTES_PER_LINE;
+    if ((line_abs == m_scroller.total() - 1) && (m_data.size() % BYTES_PER_LINE) > 0)
+        line_bytes = m_data.size() % BYTES_PER_LINE;
 
     if (m_mode == Mode::HEX)
     {
@@ -301,30 +479,113 @@ void TerminalWindow::consume_input(int key)
 {
     if (m_prompt != Prompt::NONE)
         handle_prompt(key);
+    else if (m_insert && (key == KEY_BACKSPACE || key == 0x7F))
+    {
+        // Erases the byte before the cursor.
+        if (m_byte > 0 && erase_byte(m_byte - 1))
+            m_byte--;
+        m_nibble = 0;
+        update_size();
+    }
     else if (key >= 0 && key <= 0xFF)
         edit_byte(static_cast<std::uint8_t>(key));
 }
 
 void TerminalWindow::TerminalWindow::save()
 {
-    if (!m_data.has_dirty() || m_data.is_read_only())
+    // The save runs in the background, its progress gets shown until poll_save() finishes it. The hit index
+    // cannot read the buffer meanwhile and carries on afterwards.
+    m_hits.stop();
+    if (!m_data.start_save())
+        return;
+
+    update_timeout();
+    m_update = true;
+}
+
+void TerminalWindow::poll_save()
+{
+    if (!m_data.poll_save())
         return;
 
-    m_data.save();
+    update_timeout();
     m_update = true;
 }
 
+void TerminalWindow::cancel_save()
+{
+    m_data.cancel_save();
+}
+
+void TerminalWindow::poll_input()
+{
+    const bool streaming = m_data.is_streaming();
+    // The scan reads the pieces that the bytes get appended to, so it pauses while they are. The hits before
+    // them stay and update_hits() resumes the scan over the new size.
+    if (m_data.has_pending())
+    {
+        m_hits.stop();
+        if (m_data.refresh())
+            update_size();
+    }
+    // The last refresh ends the streaming, the status line and the timeout have to follow.
+    if (streaming && !m_data.is_streaming())
+    {
+        update_timeout();
+        m_update = true;
+    }
+}
+
+void TerminalWindow::update_hits()
+{
+    if (!m_data.is_saving())
+        m_hits.resume(m_data.size());
+
+    // The last refresh shows the final count.
+    const bool indexing = m_hits.is_running();
+    if (indexing || m_indexing)
+        m_update = true;
+    if (indexing != m_indexing)
+    {
+        m_indexing = indexing;
+        update_timeout();
+    }
+}
+
+void TerminalWindow::update_timeout()
+{
+    if (m_data.is_saving())
+        timeout(SAVE_REFRESH_MS);
+    else if (m_data.is_streaming())
+        timeout(INPUT_REFRESH_MS);
+    else if (m_hits.is_running())
+        timeout(SEARCH_REFRESH_MS);
+    else
+        timeout(m_show_statistics ? STATS_REFRESH_MS : -1);
+}
+
 void TerminalWindow::prompt_save()
 {
     if (!m_data.has_dirty()
         || m_prompt != Prompt::NONE
-        || m_data.is_read_only())
+        || m_data.is_read_only()
+        || m_data.is_saving())
         return;
 
     m_prompt = Prompt::SAVE;
     m_update = true;
 }
 
+void TerminalWindow::prompt_save_as()
+{
+    if (m_prompt != Prompt::NONE || m_data.is_saving())
+        return;
+
+    m_prompt = Prompt::SAVE_AS;
+    m_input_buffer.clear();
+    m_update = true;
+}
+
 void TerminalWindow::prompt_quit()
 {
     if (m_prompt != Prompt::NONE)
@@ -353,6 +614,221 @@ void TerminalWindow::prompt_go_to_byte()
     m_update = true;
 }
 
+void TerminalWindow::prompt_range(int key)
+{
+    if (m_prompt != Prompt::NONE || m_data.is_read_only() || m_data.is_saving())
+        return;
+
+    m_prompt = key == K_FILL ? Prompt::FILL : key == K_PASTE ? Prompt::PASTE
+                                                             : Prompt::COPY;
+    m_input_buffer.clear();
+    m_update = true;
+}
+
+bool TerminalWindow::edit_range()
+{
+    const int                 base  = m_mode == Mode::HEX ? 16 : 10;
+    const std::size_t         space = m_input_buffer.find(' ');
+    const std::string         first = m_input_buffer.substr(0, space);
+    const std::string         rest  = space == std::string::npos ? "" : m_input_buffer.substr(space + 1);
+    std::uintmax_t            count = 0;
+    std::uintmax_t            from  = 0;
+    std::vector<std::uint8_t> pattern;
+    // Ranges go in front of the cursor in insert mode and overwrite the bytes from the cursor on otherwise.
+    m_hits.invalidate(m_byte);
+    if (m_prompt == Prompt::PASTE)
+        return m_data.paste_file(m_byte, m_input_buffer, m_insert);
+    if (m_prompt == Prompt::COPY)
+        return parse_number(first, base, from) && parse_number(rest, base, count) && m_data.copy(from, count, m_byte, m_insert);
+
+    // The pattern is spelled in hex digits in HEX mode and taken as it is in ASCII mode.
+    if (m_mode == Mode::ASCII)
+        pattern.assign(rest.begin(), rest.end());
+    else if (!hex_string_to_bytes(rest, pattern))
+        return false;
+    return parse_number(first, base, count) && m_data.fill(m_byte, count, pattern);
+}
+
+void TerminalWindow::prompt_find()
+{
+    if (m_prompt != Prompt::NONE || m_data.is_saving())
+        return;
+
+    m_prompt = Prompt::FIND;
+    m_input_buffer.clear();
+    m_update = true;
+}
+
+void TerminalWindow::find_pattern()
+{
+    // The pattern is spelled in hex digits and wildcards in HEX mode and taken as it is in ASCII mode.
+    Searcher::Pattern pattern(std::vector<std::uint8_t>(m_input_buffer.begin(), m_input_buffer.end()));
+    if (m_input_buffer.empty())
+    {
+        m_pattern = {};
+        m_hits.clear();
+    }
+    else if (m_mode == Mode::HEX && !Searcher::Pattern::parse(m_input_buffer, pattern))
+        m_message = "Invalid pattern";
+    else
+    {
+        m_pattern = std::move(pattern);
+        m_hits.start(m_pattern, m_data.size());
+        find(m_byte, true);
+    }
+}
+
+void TerminalWindow::find(std::uintmax_t from, bool forward)
+{
+    // The bytes being saved cannot be read past the cache.
+    if (m_pattern.empty() || m_data.is_saving())
+        return;
+
+    // Matches before from are the ones that start before it, so the ranges overlap by the pattern size minus one.
+    const std::uintmax_t size    = m_data.size();
+    const std::uintmax_t border  = std::min(size, from + m_pattern.size() - 1);
+    std::uintmax_t       offset  = 0;
+    bool                 found   = false;
+    bool                 wrapped = false;
+    if (m_hits.is_complete())
+    {
+        // The first hit at from or after it, and the last one before it.
+        const std::uintmax_t count = m_hits.count();
+        std::uintmax_t       hit   = m_hits.lower_bound(from);
+        wrapped                    = forward ? hit == count : hit == 0;
+        if (forward)
+            hit = wrapped ? 0 : hit;
+        else
+            hit = wrapped ? count - 1 : hit - 1;
+        found = count > 0 && m_hits.at(hit, offset);
+    }
+    else if (forward)
+    {
+        found = m_searcher.find(m_pattern, from, size, true, offset);
+        if (!found && !m_searcher.failed())
+            found = wrapped = m_searcher.find(m_pattern, 0, border, true, offset);
+    }
+    else
+    {
+        found = m_searcher.find(m_pattern, 0, border, false, offset);
+        if (!found && !m_searcher.failed())
+            found = wrapped = m_searcher.find(m_pattern, std::min(from, size), size, false, offset);
+    }
+
+    if (m_searcher.failed())
+        m_message = "Search failed";
+    else if (!found)
+        m_message = "Not found";
+    else
+    {
+        if (wrapped)
+            m_message = forward ? "Search wrapped to the start" : "Search wrapped to the end";
+        m_byte   = offset;
+        m_nibble = 0;
+    }
+    resize();
+}
+
+void TerminalWindow::prompt_go_to_hit()
+{
+    if (m_prompt != Prompt::NONE || m_hits.count() == 0)
+        return;
+
+    m_prompt = Prompt::GO_TO_HIT;
+    m_input_buffer.clear();
+    m_update = true;
+}
+
+void TerminalWindow::go_to_hit()
+{
+    std::uintmax_t hit    = 0;
+    std::uintmax_t offset = 0;
+    if (!parse_number(m_input_buffer, 10, hit) || hit == 0 || !m_hits.at(hit - 1, offset))
+    {
+        m_message = "No such hit";
+        return;
+    }
+
+    m_byte   = offset;
+    m_nibble = 0;
+}
+
+std::string TerminalWindow::hits_status() const
+{
+    const std::uintmax_t count = m_hits.count();
+    if (m_hits.failed())
+        return "Search failed";
+    if (m_hits.is_running())
+        return format_line("%ju hits, searching %d%%", count, static_cast<int>(100.0 * static_cast<double>(m_hits.scanned()) / static_cast<double>(m_data.size())));
+    if (m_hits.is_full())
+        return format_line("%ju+ hits", count);
+
+    // The number of the hit under the cursor, if there is one.
+    std::uintmax_t       offset = 0;
+    const std::uintmax_t hit    = m_hits.lower_bound(m_byte);
+    if (m_hits.at(hit, offset) && offset == m_byte)
+        return format_line("Hit %ju of %ju", hit + 1, count);
+    return format_line("%ju hits", count);
+}
+
+void TerminalWindow::scan_embedded()
+{
+    // The bytes being saved cannot be read past the cache.
+    if (m_prompt != Prompt::NONE || m_data.is_saving())
+        return;
+
+    if (!m_embedded.scan(0, m_data.size()))
+        m_message = "Scan failed";
+    else if (m_embedded.hits().empty())
+        m_message = "No embedded files";
+    else
+        m_message = format_line("%zu embedded files", m_embedded.hits().size());
+    m_update = true;
+}
+
+void TerminalWindow::go_to_embedded(bool forward)
+{
+    const auto& hits = m_embedded.hits();
+    if (m_prompt != Prompt::NONE || hits.empty())
+        return;
+
+    // The first file after the cursor, or the last one before it.
+    std::uintmax_t index = m_embedded.lower_bound(forward ? m_byte + 1 : m_byte);
+    if (forward)
+        index = index == hits.size() ? 0 : index;
+    else
+        index = index == 0 ? hits.size() - 1 : index - 1;
+
+    m_byte    = std::min(hits[index].m_offset, m_data.size() - 1);
+    m_nibble  = 0;
+    m_message = format_line("%s, %ju of %zu", std::string(m_embedded.type(hits[index])).c_str(), index + 1, hits.size());
+    resize();
+}
+
+void TerminalWindow::prompt_carve()
+{
+    if (m_prompt != Prompt::NONE || m_data.is_saving() || m_embedded.lower_bound(m_byte + 1) == 0)
+        return;
+
+    m_prompt = Prompt::CARVE;
+    m_input_buffer.clear();
+    m_update = true;
+}
+
+void TerminalWindow::carve()
+{
+    const auto&          hits  = m_embedded.hits();
+    const std::uintmax_t index = m_embedded.lower_bound(m_byte + 1);
+    if (index == 0 || m_input_buffer.empty())
+        return;
+
+    // The buffer may have shrunk since the scan.
+    const std::uintmax_t first = hits[index - 1].m_offset;
+    const std::uintmax_t last  = index < hits.size() ? hits[index].m_offset : std::max(first, m_data.size());
+    if (!m_data.save_as(m_input_buffer, first, last - first))
+        m_message = "Carve failed";
+}
+
 void TerminalWindow::toggle_ascii_mode()
 {
     if (m_mode == Mode::ASCII || m_prompt != Prompt::NONE)
@@ -372,8 +848,77 @@ void TerminalWindow::toggle_hex_mode()
     m_update = true;
 }
 
+void TerminalWindow::toggle_insert_mode()
+{
+    if (m_prompt != Prompt::NONE || m_data.is_read_only())
+        return;
+
+    m_insert = !m_insert;
+    m_update = true;
+}
+
+bool TerminalWindow::erase_byte(std::uintmax_t byte_id)
+{
+    if (m_prompt != Prompt::NONE)
+        return false;
+
+    m_hits.invalidate(byte_id);
+    if (!m_data.erase_byte(byte_id))
+        return false;
+
+    if (m_byte >= m_data.size())
+        m_byte = m_data.size() - 1;
+    update_size();
+    return true;
+}
+
+void TerminalWindow::insert_byte(std::uint8_t chr)
+{
+    m_hits.invalidate(m_byte);
+    if (m_mode == Mode::ASCII && std::isprint(chr))
+    {
+        if (m_data.insert_byte(m_byte, chr))
+            m_byte++;
+    }
+    else if (m_mode == Mode::HEX && std::isxdigit(chr))
+    {
+        // The first nibble inserts a new byte, the second one completes it and moves past it.
+        if (m_nibble == 0)
+        {
+            if (m_data.insert_byte(m_byte, update_nibble(0, chr, 0)))
+                m_nibble = 1;
+        }
+        else
+        {
+            m_data.set_byte(m_byte, update_nibble(1, chr, m_data[m_byte]));
+            m_byte++;
+            m_nibble = 0;
+        }
+    }
+    else
+        return;
+
+    update_size();
+}
+
+void TerminalWindow::update_size()
+{
+    // Lines that are no longer part of the buffer have to be cleared.
+    const std::uintmax_t lines = m_scroller.total();
+    m_scroller.set_total(m_data.size());
+    if (m_scroller.total() < lines)
+        erase_screen();
+    resize();
+}
+
 void TerminalWindow::edit_byte(std::uint8_t chr)
 {
+    if (m_insert)
+    {
+        insert_byte(chr);
+        return;
+    }
+
     std::uint8_t new_value;
     if (m_mode == Mode::ASCII && std::isprint(chr))
         new_value = chr;
@@ -387,6 +932,7 @@ void TerminalWindow::edit_byte(std::uint8_t chr)
     if (!m_data.has_dirty())
         m_update = true;
 
+    m_hits.invalidate(m_byte);
     m_data.set_byte(m_byte, new_value);
 }
 
@@ -404,10 +950,10 @@ void TerminalWindow::handle_prompt(int key)
                 else if (m_mode == Mode::HEX)
                     go_to_byte = std::stoull(m_input_buffer, nullptr, 16);
 
-                if (go_to_byte < m_data.size)
+                if (go_to_byte < m_data.size())
                     m_byte = go_to_byte;
                 else
-                    m_byte = m_data.size - 1;
+                    m_byte = m_data.size() - 1;
                 m_input_buffer.clear();
             }
             m_prompt = Prompt::NONE;
@@ -430,6 +976,42 @@ void TerminalWindow::handle_prompt(int key)
             }
         }
     }
+    else if (m_prompt == Prompt::FILL || m_prompt == Prompt::PASTE || m_prompt == Prompt::COPY || m_prompt == Prompt::SAVE_AS || m_prompt == Prompt::FIND
+             || m_prompt == Prompt::GO_TO_HIT || m_prompt == Prompt::CARVE)
+    {
+        if (key == '\n')
+        {
+            if (m_prompt == Prompt::FIND)
+                find_pattern();
+            else if (m_prompt == Prompt::GO_TO_HIT)
+                go_to_hit();
+            else if (m_prompt == Prompt::CARVE)
+                carve();
+            else if (m_prompt != Prompt::SAVE_AS)
+            {
+                if (!edit_range())
+                    m_message = m_prompt == Prompt::FILL ? "Fill failed" : m_prompt == Prompt::PASTE ? "Paste failed"
+                                                                                                      : "Copy failed";
+            }
+            else if (!m_input_buffer.empty() && !m_data.save_as(m_input_buffer))
+                m_message = "Save failed";
+            m_prompt = Prompt::NONE;
+            m_input_buffer.clear();
+            erase_screen();
+            update_size();
+        }
+        else if ((key == KEY_BACKSPACE) && !m_input_buffer.empty())
+        {
+            m_input_buffer.pop_back();
+            m_update = true;
+            erase_screen();
+        }
+        else if ((m_input_buffer.size() < MAX_PROMPT_LEN) && (key >= 0 && key <= 0xFF) && isprint(key))
+        {
+            m_input_buffer.push_back(static_cast<char>(key));
+            m_update = true;
+        }
+    }
     else
     {
         switch (key)
@@ -458,4 +1040,71 @@ void TerminalWindow::handle_prompt(int key)
         }
     }
 }
+
+void TerminalWindow::toggle_statistics()
+{
+    m_show_statistics = !m_show_statistics;
+    // Keep the overlay live while it is shown by waking up periodically.
+    update_timeout();
+    if (!m_show_statistics)
+        erase_screen();
+    m_update = true;
+}
+
+void TerminalWindow::draw_statistics()
+{
+    const auto lines = statistics();
+    int        width = 0;
+    for (const auto& line : lines)
+        width = std::max(width, static_cast<int>(line.size()));
+
+    width += 4;
+    const int height = static_cast<int>(lines.size()) + 2;
+    const int top    = (LINES - height) / 2;
+    const int left   = (COLS - width) / 2;
+    // The overlay does not fit in the terminal.
+    if (top < 1 || left < 1)
+        return;
+
+    for (int row = 0; row < height; ++row)
+        mvhline(top + row, left, ' ', width);
+    mvhline(top, left + 1, ACS_HLINE, width - 2);
+    mvhline(top + height - 1, left + 1, ACS_HLINE, width - 2);
+    mvvline(top + 1, left, ACS_VLINE, height - 2);
+    mvvline(top + 1, left + width - 1, ACS_VLINE, height - 2);
+    mvaddch(top, left, ACS_ULCORNER);
+    mvaddch(top, left + width - 1, ACS_URCORNER);
+    mvaddch(top + height - 1, left, ACS_LLCORNER);
+    mvaddch(top + height - 1, left + width - 1, ACS_LRCORNER);
+    mvaddstr(top, left + 2, "Statistics");
+    for (std::size_t i = 0; i < lines.size(); ++i)
+        mvaddstr(top + 1 + static_cast<int>(i), left + 2, lines[i].c_str());
+}
+
+std::vector<std::string> TerminalWindow::statistics() const
+{
+    const auto&          cache   = m_data.cache().statistics();
+    const auto&          buffer  = m_data.statistics();
+    const auto&          io      = m_handler.statistics();
+    const std::uintmax_t lookups = cache.m_hits + cache.m_misses;
+    const double         hit_pct = lookups > 0 ? 100.0 * static_cast<double>(cache.m_hits) / static_cast<double>(lookups) : 0.0;
+    constexpr double     MIB     = 1024.0 * 1024.0;
+    constexpr double     MS      = 1000000.0;
+
+    return {
+        format_line("Cache:   %ju/%ju slots of %ju bytes, up to %ju slots", m_data.cache().used_slots(), m_data.cache().slots(), m_data.cache().chunk_size(), m_data.cache().max_slots()),
+        format_line("Lookups: %ju hits, %ju misses (%.2f%% hit rate)", cache.m_hits, cache.m_misses, hit_pct),
+        format_line("Chunks:  %ju loaded, %ju prefetched, %ju evicted, %ju saved", cache.m_loads, cache.m_prefetch_hits, cache.m_evictions, cache.m_saves.load()),
+        format_line("Reads:   %ju requests, %.2f MiB", io.m_reads.load(), static_cast<double>(io.m_bytes_read.load()) / MIB),
+        format_line("Writes:  %ju requests, %.2f MiB", io.m_writes.load(), static_cast<double>(io.m_bytes_written.load()) / MIB),
+        format_line("Buffer:  %ju byte reads, %ju byte edits, %ju saves", buffer.m_byte_reads, buffer.m_byte_writes, buffer.m_saves),
+        format_line("Saving:  %s, last save %s", m_data.is_atomic_save() ? "atomic" : "in place", to_string(m_data.save_method())),
+        format_line("Time:    %.2f ms I/O, %.2f ms saving, %.2f ms rendering %ju frames, %ju cells",
+                    static_cast<double>(io.m_io_ns.load()) / MS,
+                    static_cast<double>(buffer.m_save_ns) / MS,
+                    static_cast<double>(m_render_ns) / MS,
+                    m_frames,
+                    m_cells),
+    };
+}
 } // namespace Hexit
@@ -2,18 +2,27 @@
 #define TERMINAL_WINDOW_H
 
 #include "ByteBuffer.h"
+#include "Frame.h"
+#include "HitIndex.h"
 #include "Scroller.h"
+#include "Searcher.h"
+#include "SignatureScanner.h"
 #include <cinttypes>
 #include <cstdint>
 #include <ncurses.h>
 #include <string>
+#include <vector>
 
 namespace Hexit
 {
 class TerminalWindow
 {
 public:
-    TerminalWindow(IOHandler& handler, const std::string& file_type, std::uintmax_t go_to_byte = 0);
+    TerminalWindow(IOHandler&         handler,
+                   const std::string& file_type,
+                   std::uintmax_t     go_to_byte   = 0,
+                   const CacheConfig& cache_config = {},
+                   bool               atomic_save  = false);
 
     TerminalWindow(const TerminalWindow&) = delete;
 
@@ -23,9 +32,18 @@ public:
 
     void run();
 
+    // A summary of the cache, buffer and I/O statistics, one line per entry.
+    std::vector<std::string> statistics() const;
+
 private:
+    // Draws the cells of a line that changed since it was last drawn.
     void draw_line(std::uint32_t line);
 
+    void draw_cell(std::uint32_t row, std::uint32_t column, const Frame::Cell& cell);
+
+    // Clears the screen, every cell gets drawn again.
+    void erase_screen();
+
     bool update_screen();
 
     void resize();
@@ -46,20 +64,89 @@ private:
 
     void save();
 
+    // Finishes the background save once it is done.
+    void poll_save();
+
+    void cancel_save();
+
+    // Shows the bytes that arrived at a streaming handler since the last key press or timeout.
+    void poll_input();
+
+    // Keeps the hit index going unless a save is running, and shows the hits it finds in the meantime.
+    void update_hits();
+
+    // Wakes up getch() periodically while the statistics overlay or the progress of a save is shown, and while
+    // the input is still arriving or the hits are being indexed.
+    void update_timeout();
+
     void prompt_save();
 
+    // Asks for the path of a new file to write the buffer into, which also works for standard input.
+    void prompt_save_as();
+
     void prompt_quit();
 
     void prompt_go_to_byte();
 
+    // Asks for the input of a fill, paste or copy, which then applies at the cursor.
+    void prompt_range(int key);
+
+    // Applies the fill, paste or copy entered into the prompt, in the number base of the mode.
+    bool edit_range();
+
+    // Asks for a pattern to find, in hex digits with ? for any nibble in HEX mode and as text in ASCII mode.
+    void prompt_find();
+
+    // Finds the pattern entered into the prompt from the cursor on and starts indexing all of its matches.
+    // An empty prompt drops the pattern.
+    void find_pattern();
+
+    // Moves the cursor to the closest match of m_pattern from the given byte on in the given direction,
+    // wrapping around at the end of the buffer. Uses the hit index once it is complete.
+    void find(std::uintmax_t from, bool forward);
+
+    void prompt_go_to_hit();
+
+    // Moves the cursor to the match whose number, counted from one, was entered into the prompt.
+    void go_to_hit();
+
+    // The status line text of the hit index.
+    std::string hits_status() const;
+
+    // Finds the signatures of the embedded files throughout the buffer. Blocks until done, the list stays as it
+    // is until the next scan.
+    void scan_embedded();
+
+    // Moves the cursor to the next or previous embedded file, wrapping around at the ends of the list.
+    void go_to_embedded(bool forward);
+
+    void prompt_carve();
+
+    // Writes the embedded file at or before the cursor into the path entered into the prompt. It ends where the
+    // next embedded file starts, or at the end of the buffer.
+    void carve();
+
     void toggle_ascii_mode();
 
     void toggle_hex_mode();
 
     void edit_byte(std::uint8_t chr);
 
+    void toggle_insert_mode();
+
+    void insert_byte(std::uint8_t chr);
+
+    bool erase_byte(std::uintmax_t byte_id);
+
+    // Brings the scroller up to date after bytes have been inserted or erased.
+    void update_size();
+
     void handle_prompt(int key);
 
+    void toggle_statistics();
+
+    void draw_statistics();
+
     enum class Mode : std::uint8_t
     {
         HEX,
@@ -71,21 +158,41 @@ private:
         NONE,
         SAVE,
         QUIT,
-        GO_TO_BYTE
+        GO_TO_BYTE,
+        FILL,    // count pattern
+        PASTE,   // path
+        COPY,    // offset count
+        SAVE_AS, // path
+        FIND,    // pattern
+        GO_TO_HIT,
+        CARVE, // path
     };
 
-    Scroller          m_scroller;
-    ByteBuffer        m_data;
-    const std::string m_name;
-    const std::string m_type;
-    std::string       m_input_buffer;
-    std::uintmax_t    m_byte;
-    char              m_offset_format[16];
-    Mode              m_mode;
-    Prompt            m_prompt;
-    std::uint8_t      m_nibble;
-    bool              m_update;
-    bool              m_quit;
+    Scroller                  m_scroller;
+    Frame                     m_frame; // The hex lines as last drawn.
+    ByteBuffer                m_data;
+    const IOHandler&          m_handler;
+    const std::string         m_name;
+    const std::string         m_type;
+    std::string               m_input_buffer;
+    std::string               m_message; // Shown on the status line until the next key press.
+    std::uintmax_t            m_byte;
+    Searcher                  m_searcher;
+    HitIndex                  m_hits;
+    SignatureScanner          m_embedded;
+    Searcher::Pattern         m_pattern; // The last pattern searched for.
+    char                      m_offset_format[16];
+    Mode                      m_mode;
+    Prompt                    m_prompt;
+    std::uintmax_t            m_render_ns; // Time spent drawing the screen.
+    std::uintmax_t            m_frames;
+    std::uintmax_t            m_cells; // Cells drawn, over all the frames.
+    std::uint8_t              m_nibble;
+    bool                      m_update;
+    bool                      m_quit;
+    bool                      m_insert; // Typed bytes get inserted instead of overwriting the ones under the cursor.
+    bool                      m_show_statistics;
+    bool                      m_indexing; // The hit index was running when last checked.
 };
 } // namespace Hexit
 #endif // TERMINAL_WINDOW_H
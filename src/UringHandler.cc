@@ -0,0 +1,250 @@
+#include "UringHandler.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace Hexit
+{
+namespace
+{
+// The kernel caps a single read or write at slightly less than 2 GiB, larger requests are served synchronously.
+constexpr std::uintmax_t MAX_RING_REQUEST = 0x7FFFF000;
+
+// The states of the requests of a batch.
+constexpr std::uint8_t QUEUED    = 0;
+constexpr std::uint8_t IN_FLIGHT = 1;
+constexpr std::uint8_t DONE      = 2;
+
+inline std::uint32_t load_acquire(std::uint32_t* value)
+{
+    return std::atomic_ref<std::uint32_t>(*value).load(std::memory_order_acquire);
+}
+
+inline void store_release(std::uint32_t* value, std::uint32_t new_value)
+{
+    std::atomic_ref<std::uint32_t>(*value).store(new_value, std::memory_order_release);
+}
+} // namespace
+
+UringHandler::UringHandler(bool read_only, std::uint32_t queue_depth)
+    : PosixFileHandler(read_only)
+    , m_ring_fd(-1)
+    , m_entries(0)
+    , m_sq_ring(nullptr)
+    , m_cq_ring(nullptr)
+    , m_sq_ring_size(0)
+    , m_cq_ring_size(0)
+    , m_sqes(nullptr)
+    , m_sqes_size(0)
+    , m_sq_head(nullptr)
+    , m_sq_tail(nullptr)
+    , m_sq_mask(nullptr)
+    , m_sq_array(nullptr)
+    , m_cq_head(nullptr)
+    , m_cq_tail(nullptr)
+    , m_cq_mask(nullptr)
+    , m_cqes(nullptr)
+{
+    setup_ring(queue_depth);
+}
+
+UringHandler::~UringHandler()
+{
+    teardown_ring();
+}
+
+bool UringHandler::submit_batch(const std::vector<Request>& requests)
+{
+    std::unique_lock<std::mutex> lock(m_ring_lock);
+    // A single request gains nothing from the ring.
+    if (m_ring_fd < 0 || descriptor() < 0 || requests.size() < 2)
+    {
+        lock.unlock();
+        return PosixFileHandler::submit_batch(requests);
+    }
+
+    ScopedTimer               timer(m_statistics.m_io_ns);
+    std::vector<iovec>        iov(requests.size());
+    std::vector<std::uint8_t> state(requests.size(), QUEUED);
+    std::size_t               next      = 0;
+    std::size_t               in_flight = 0;
+    bool                      ok        = true;
+    // Takes the completions the kernel has posted so far off the completion queue.
+    const auto reap = [&]()
+    {
+        std::uint32_t       head    = *m_cq_head;
+        const std::uint32_t cq_tail = load_acquire(m_cq_tail);
+        for (; head != cq_tail; ++head)
+        {
+            const io_uring_cqe&  cqe  = m_cqes[head & *m_cq_mask];
+            const std::size_t    id   = static_cast<std::size_t>(cqe.user_data);
+            const std::uintmax_t done = cqe.res > 0 ? static_cast<std::uintmax_t>(cqe.res) : 0u;
+            // Short reads and writes, as well as failed requests, get another chance through the synchronous path.
+            if (done < requests[id].m_size)
+                ok = finish_sync(requests[id], done) && ok;
+            state[id] = DONE;
+            --in_flight;
+        }
+        store_release(m_cq_head, head);
+    };
+    while (next < requests.size() || in_flight > 0)
+    {
+        // Top up the submission queue.
+        std::uint32_t tail = *m_sq_tail;
+        for (; next < requests.size() && in_flight < m_entries; ++next)
+        {
+            const auto& request = requests[next];
+            if ((request.m_write && m_read_only) || request.m_size == 0)
+            {
+                state[next] = DONE;
+                continue;
+            }
+
+            if (request.m_size > MAX_RING_REQUEST)
+            {
+                ok          = finish_sync(request, 0) && ok;
+                state[next] = DONE;
+                continue;
+            }
+
+            const std::uint32_t index = tail & *m_sq_mask;
+            io_uring_sqe&       sqe   = m_sqes[index];
+            std::memset(&sqe, 0, sizeof(sqe));
+            iov[next]         = { request.m_data, request.m_size };
+            sqe.opcode        = request.m_write ? IORING_OP_WRITEV : IORING_OP_READV;
+            sqe.fd            = descriptor();
+            sqe.off           = request.m_offset;
+            sqe.addr          = reinterpret_cast<std::uintptr_t>(&iov[next]);
+            sqe.len           = 1;
+            sqe.user_data     = next;
+            m_sq_array[index] = index;
+            state[next]       = IN_FLIGHT;
+            if (request.m_write)
+                m_statistics.count_write(request.m_size);
+            else
+                m_statistics.count_read(request.m_size);
+            ++tail;
+            ++in_flight;
+        }
+        store_release(m_sq_tail, tail);
+
+        if (in_flight == 0)
+            break;
+
+        const std::uint32_t to_submit = tail - load_acquire(m_sq_head);
+        if (::syscall(__NR_io_uring_enter, m_ring_fd, to_submit, 1, IORING_ENTER_GETEVENTS, nullptr, 0) < 0
+            && errno != EINTR && errno != EAGAIN && errno != EBUSY)
+        {
+            // The ring is unusable from now on. The entries the kernel has not taken are withdrawn, the ones it
+            // has still write to or read from the buffers, so they have to complete before the ring goes away.
+            const std::uint32_t head = load_acquire(m_sq_head);
+            for (std::uint32_t i = head; i != tail; ++i)
+            {
+                state[m_sqes[i & *m_sq_mask].user_data] = QUEUED;
+                --in_flight;
+            }
+            store_release(m_sq_tail, head);
+            while (in_flight > 0)
+            {
+                reap();
+                if (in_flight > 0 && ::syscall(__NR_io_uring_enter, m_ring_fd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0) < 0
+                    && errno != EINTR && errno != EAGAIN && errno != EBUSY)
+                    break;
+            }
+
+            // Whatever was never submitted, or could not be waited for, is served synchronously.
+            teardown_ring();
+            for (std::size_t i = 0; i < requests.size(); ++i)
+            {
+                if (state[i] != DONE)
+                    ok = finish_sync(requests[i], 0) && ok;
+            }
+            return ok;
+        }
+
+        reap();
+    }
+
+    return ok;
+}
+
+bool UringHandler::setup_ring(std::uint32_t queue_depth)
+{
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    const long fd = ::syscall(__NR_io_uring_setup, queue_depth, &params);
+    if (fd < 0)
+        return false;
+
+    m_ring_fd      = static_cast<int>(fd);
+    m_entries      = params.sq_entries;
+    m_sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(std::uint32_t);
+    m_cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    m_sqes_size    = params.sq_entries * sizeof(io_uring_sqe);
+
+    // Newer kernels share a single mapping between both rings.
+    const bool single_mapping = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mapping)
+        m_sq_ring_size = m_cq_ring_size = std::max(m_sq_ring_size, m_cq_ring_size);
+
+    m_sq_ring = ::mmap(nullptr, m_sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring_fd, IORING_OFF_SQ_RING);
+    m_cq_ring = single_mapping
+        ? m_sq_ring
+        : ::mmap(nullptr, m_cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring_fd, IORING_OFF_CQ_RING);
+    void* sqes = ::mmap(nullptr, m_sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring_fd, IORING_OFF_SQES);
+    if (m_sq_ring == MAP_FAILED || m_cq_ring == MAP_FAILED || sqes == MAP_FAILED)
+    {
+        m_sq_ring = m_sq_ring == MAP_FAILED ? nullptr : m_sq_ring;
+        m_cq_ring = m_cq_ring == MAP_FAILED ? nullptr : m_cq_ring;
+        m_sqes    = sqes == MAP_FAILED ? nullptr : static_cast<io_uring_sqe*>(sqes);
+        teardown_ring();
+        return false;
+    }
+
+    auto* sq_ring = static_cast<std::uint8_t*>(m_sq_ring);
+    auto* cq_ring = static_cast<std::uint8_t*>(m_cq_ring);
+    m_sqes        = static_cast<io_uring_sqe*>(sqes);
+    m_sq_head     = reinterpret_cast<std::uint32_t*>(sq_ring + params.sq_off.head);
+    m_sq_tail     = reinterpret_cast<std::uint32_t*>(sq_ring + params.sq_off.tail);
+    m_sq_mask     = reinterpret_cast<std::uint32_t*>(sq_ring + params.sq_off.ring_mask);
+    m_sq_array    = reinterpret_cast<std::uint32_t*>(sq_ring + params.sq_off.array);
+    m_cq_head     = reinterpret_cast<std::uint32_t*>(cq_ring + params.cq_off.head);
+    m_cq_tail     = reinterpret_cast<std::uint32_t*>(cq_ring + params.cq_off.tail);
+    m_cq_mask     = reinterpret_cast<std::uint32_t*>(cq_ring + params.cq_off.ring_mask);
+    m_cqes        = reinterpret_cast<io_uring_cqe*>(cq_ring + params.cq_off.cqes);
+
+    return true;
+}
+
+void UringHandler::teardown_ring()
+{
+    if (m_sqes)
+        ::munmap(m_sqes, m_sqes_size);
+    if (m_cq_ring && m_cq_ring != m_sq_ring)
+        ::munmap(m_cq_ring, m_cq_ring_size);
+    if (m_sq_ring)
+        ::munmap(m_sq_ring, m_sq_ring_size);
+    if (m_ring_fd >= 0)
+        ::close(m_ring_fd);
+
+    m_ring_fd = -1;
+    m_entries = 0;
+    m_sq_ring = nullptr;
+    m_cq_ring = nullptr;
+    m_sqes    = nullptr;
+}
+
+bool UringHandler::finish_sync(const Request& request, std::uintmax_t done)
+{
+    if (request.m_write)
+        return write_at(request.m_offset + done, request.m_data + done, request.m_size - done);
+
+    return read_at(request.m_offset + done, request.m_data + done, request.m_size - done);
+}
+} // namespace Hexit
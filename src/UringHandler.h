@@ -0,0 +1,56 @@
+#ifndef URING_HANDLER_H
+#define URING_HANDLER_H
+
+#include "PosixFileHandler.h"
+#include "config.h"
+#include <cstdint>
+#include <mutex>
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+namespace Hexit
+{
+// Serves batches through an io_uring instance set up with raw system calls, keeping up to
+// queue_depth requests in flight. Single requests still go through pread/pwrite, and so does
+// everything in case the kernel refuses to set up the ring (old kernels, seccomp filters).
+class UringHandler : public PosixFileHandler
+{
+public:
+    explicit UringHandler(bool read_only = false, std::uint32_t queue_depth = URING_QUEUE_DEPTH);
+
+    ~UringHandler();
+
+    bool submit_batch(const std::vector<Request>& requests) override;
+
+    // Returns false if the ring could not be set up and batches fall back to synchronous I/O.
+    inline bool uring_active() const { return m_ring_fd >= 0; }
+
+private:
+    bool setup_ring(std::uint32_t queue_depth);
+
+    void teardown_ring();
+
+    // Completes the given part of a request that the ring did not serve.
+    bool finish_sync(const Request& request, std::uintmax_t done);
+
+    int            m_ring_fd;
+    std::uint32_t  m_entries;
+    void*          m_sq_ring;
+    void*          m_cq_ring;
+    std::size_t    m_sq_ring_size;
+    std::size_t    m_cq_ring_size;
+    io_uring_sqe*  m_sqes;
+    std::size_t    m_sqes_size;
+    std::uint32_t* m_sq_head;
+    std::uint32_t* m_sq_tail;
+    std::uint32_t* m_sq_mask;
+    std::uint32_t* m_sq_array;
+    std::uint32_t* m_cq_head;
+    std::uint32_t* m_cq_tail;
+    std::uint32_t* m_cq_mask;
+    io_uring_cqe*  m_cqes;
+    std::mutex     m_ring_lock; // A single batch at a time owns the ring.
+};
+} // namespace Hexit
+#endif // URING_HANDLER_H
@@ -1,7 +1,12 @@
 #include "Utilities.h"
+#include <cstdio>
+#include <cstdlib>
 #include <filesystem>
+#include <fstream>
+#include <functional>
 #include <iostream>
 #include <string_view>
+#include <unistd.h>
 
 namespace Hexit
 {
@@ -13,6 +18,13 @@ bool validate_args(std::uintmax_t argc, const char* const* const argv)
     bool           help   = false;
     bool           file   = false;
     bool           offset = false;
+    bool           chunk  = false;
+    bool           mmap   = false;
+    bool           stats  = false;
+    bool           memory = false;
+    bool           atomic = false;
+    bool           gunzip = false;
+    bool           magic  = false;
     for (; i < argc && argv[i];)
     {
         std::string_view sarg(argv[i]);
@@ -23,6 +35,34 @@ bool validate_args(std::uintmax_t argc, const char* const* const argv)
             ++i;
             help = true;
         }
+        else if (sarg == "--mmap" || sarg == "-m")
+        {
+            if (mmap)
+                break;
+            ++i;
+            mmap = true;
+        }
+        else if (sarg == "--stats")
+        {
+            if (stats)
+                break;
+            ++i;
+            stats = true;
+        }
+        else if (sarg == "--atomic-save" || sarg == "-a")
+        {
+            if (atomic)
+                break;
+            ++i;
+            atomic = true;
+        }
+        else if (sarg == "--gunzip" || sarg == "-z")
+        {
+            if (gunzip)
+                break;
+            ++i;
+            gunzip = true;
+        }
         else if (sarg == "--offset" || sarg == "-o")
         {
             if (offset || ((i + 1) >= argc) || !argv[i + 1])
@@ -32,6 +72,33 @@ bool validate_args(std::uintmax_t argc, const char* const* const argv)
             ++i;
             offset = true;
         }
+        else if (sarg == "--chunk-size" || sarg == "-c")
+        {
+            if (chunk || ((i + 1) >= argc) || !argv[i + 1])
+                break;
+            if (++i; !is_hex_string(argv[i]) && !is_dec_string(argv[i]))
+                break;
+            ++i;
+            chunk = true;
+        }
+        else if (sarg == "--max-memory")
+        {
+            if (memory || ((i + 1) >= argc) || !argv[i + 1])
+                break;
+            if (++i; !is_size_string(argv[i]))
+                break;
+            ++i;
+            memory = true;
+        }
+        else if (sarg == "--magic")
+        {
+            if (magic || ((i + 1) >= argc) || !argv[i + 1])
+                break;
+            if (++i; !fs::exists(argv[i]))
+                break;
+            ++i;
+            magic = true;
+        }
         else if (sarg == "--file" || sarg == "-f")
         {
             if (file || ((i + 1) >= argc) || !argv[i + 1])
@@ -81,4 +148,93 @@ std::uintmax_t str_to_int(const char* const str)
 
     return 0u;
 }
+
+std::uintmax_t str_to_size(const char* const str)
+{
+    if (!str || !is_size_string(str))
+        return 0;
+
+    const std::string_view size(str);
+    std::uintmax_t         shift = 0;
+    switch (size.back())
+    {
+    case 'k':
+    case 'K':
+        shift = 10;
+        break;
+    case 'm':
+    case 'M':
+        shift = 20;
+        break;
+    case 'g':
+    case 'G':
+        shift = 30;
+        break;
+    default:
+        return std::stoull(str, nullptr);
+    }
+
+    return std::stoull(std::string(size.substr(0, size.size() - 1)), nullptr) << shift;
+}
+
+std::string format_size(std::uintmax_t bytes)
+{
+    constexpr const char* suffixes = "KMGTPE";
+    if (bytes < 1024)
+        return std::to_string(bytes) + 'B';
+
+    double      value  = static_cast<double>(bytes) / 1024.0;
+    std::size_t suffix = 0;
+    for (; value >= 1024.0 && suffix < 5; ++suffix)
+        value /= 1024.0;
+
+    char formatted[16];
+    std::snprintf(formatted, sizeof(formatted), value < 10.0 ? "%.1f%c" : "%.0f%c", value, suffixes[suffix]);
+    return formatted;
+}
+
+fs::path cache_directory()
+{
+    if (const char* cache = std::getenv("XDG_CACHE_HOME"); cache && *cache)
+        return fs::path(cache) / "hexit";
+    if (const char* home = std::getenv("HOME"); home && *home)
+        return fs::path(home) / ".cache" / "hexit";
+
+    return {};
+}
+
+fs::path cache_file(const fs::path& directory, const fs::path& path, const char* extension)
+{
+    std::error_code ec;
+    const fs::path  absolute = fs::absolute(path, ec).lexically_normal();
+    char            name[64];
+    std::snprintf(name, sizeof(name), "%016zx.%s", std::hash<std::string>()(absolute.string()), extension);
+    return directory / name;
+}
+
+bool write_file_atomically(const fs::path& path, const std::string& data)
+{
+    std::error_code ec;
+    const fs::path  temp = path.string() + "." + std::to_string(::getpid());
+    fs::create_directories(path.parent_path(), ec);
+    {
+        std::ofstream file(temp, std::ios::binary);
+        if (!file.write(data.data(), static_cast<std::streamsize>(data.size())))
+        {
+            fs::remove(temp, ec);
+            return false;
+        }
+    }
+
+    fs::rename(temp, path, ec);
+    if (ec)
+        fs::remove(temp, ec);
+    return !ec;
+}
+
+std::uintmax_t page_size()
+{
+    const long size = sysconf(_SC_PAGESIZE);
+    return size > 0 ? static_cast<std::uintmax_t>(size) : 4096u;
+}
 } // namespace Hexit
@@ -4,7 +4,11 @@
 #include <algorithm>
 #include <cctype>
 #include <cstdint>
+#include <cstring>
+#include <filesystem>
 #include <string>
+#include <string_view>
+#include <vector>
 
 namespace Hexit
 {
@@ -54,6 +58,41 @@ inline bool is_dec_string(const std::string& str)
                                        { return std::isdigit(uc); });
 }
 
+// Converts pairs of hex digits into the bytes they spell, false for an odd number of digits or anything else.
+inline bool hex_string_to_bytes(const std::string& str, std::vector<std::uint8_t>& bytes)
+{
+    if (str.empty() || str.size() % 2 != 0 || !is_hex_string(str) || str[1] == 'x' || str[1] == 'X')
+        return false;
+
+    bytes.clear();
+    for (std::size_t i = 0; i < str.size(); i += 2)
+        bytes.push_back(static_cast<std::uint8_t>(hex_char_to_int(str[i]) << 4 | hex_char_to_int(str[i + 1])));
+    return true;
+}
+
+// A decimal number of bytes, optionally followed by one of the binary K, M or G suffixes.
+inline bool is_size_string(const std::string& str)
+{
+    if (!str.empty() && std::string_view("kKmMgG").find(str.back()) != std::string_view::npos)
+        return is_dec_string(str.substr(0, str.size() - 1));
+
+    return is_dec_string(str);
+}
+
+// Rounds the chunk size up to a multiple of the page size, a zero chunk size results in a single page.
+inline std::uintmax_t align_chunk_size(std::uintmax_t chunk_size, std::uintmax_t page_size)
+{
+    if (page_size == 0)
+        return chunk_size;
+    if (chunk_size == 0)
+        return page_size;
+
+    return (chunk_size + page_size - 1) / page_size * page_size;
+}
+
+// The size of a virtual memory page in bytes.
+std::uintmax_t page_size();
+
 bool validate_args(std::uintmax_t argc, const char* const* const argv);
 
 const char* get_arg(int argc, const char* const* const argv, const std::string& arg, const std::string& alt_arg = "");
@@ -61,5 +100,41 @@ const char* get_arg(int argc, const char* const* const argv, const std::string&
 bool get_flag(int argc, const char* const* const argv, const std::string& flag);
 
 std::uintmax_t str_to_int(const char* const str);
+
+// Converts a size string to the number of bytes, zero if the string is not a valid size.
+std::uintmax_t str_to_size(const char* const str);
+
+// Formats a number of bytes with a binary suffix, e.g. 1.5M.
+std::string format_size(std::uintmax_t bytes);
+
+// $XDG_CACHE_HOME/hexit, or ~/.cache/hexit, empty if neither is set.
+std::filesystem::path cache_directory();
+
+// The file in directory that caches what was derived from the file at path, named by a hash of its absolute
+// path and extension.
+std::filesystem::path cache_file(const std::filesystem::path& directory, const std::filesystem::path& path, const char* extension);
+
+// Writes data under a temporary name in the directory of path, created if missing, and renames it to path,
+// so that the file is either complete or missing.
+bool write_file_atomically(const std::filesystem::path& path, const std::string& data);
+
+// Appends the bytes of value to a cache file, in the native byte order.
+template <typename T>
+void put(std::string& out, const T& value)
+{
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+// Reads a value put() into a cache file, false if it is cut off.
+template <typename T>
+bool get(const std::string& in, std::size_t& position, T& value)
+{
+    if (in.size() - position < sizeof(value))
+        return false;
+
+    std::memcpy(&value, in.data() + position, sizeof(value));
+    position += sizeof(value);
+    return true;
+}
 } // namespace Hexit
 #endif // UTILITIES_H
@@ -14,6 +14,53 @@ inline constexpr std::uint32_t HEX_PADDING = 2;
 inline constexpr std::uint32_t LINE_OFFSET_LEN = sizeof(std::uintmax_t) * 2;
 inline constexpr std::uint32_t FIRST_HEX       = LINE_OFFSET_LEN + 1 + HEX_PADDING;
 inline constexpr std::uint32_t FIRST_ASCII     = FIRST_HEX + BYTES_PER_LINE * 3 - 1 + ASCII_PADDING;
+// The default size of a file chunk in bytes, used when the storage does not report a preferred block size.
+inline constexpr std::uintmax_t CHUNK_SIZE = 4096;
+// The largest chunk size that gets picked automatically from the preferred block size of the storage.
+inline constexpr std::uintmax_t MAX_AUTO_CHUNK_SIZE = 1024 * 1024;
+// The number of file chunks that are kept in memory.
+inline constexpr std::uintmax_t CACHE_SLOTS = 64;
+// The number of chunks that get loaded in the background ahead of a sequential scan.
+inline constexpr std::uintmax_t READ_AHEAD = 8;
+// The maximum number of requests that the io_uring handler keeps in flight.
+inline constexpr std::uint32_t URING_QUEUE_DEPTH = 64;
+// The number of extents of modified bytes that get written with a single batch on save.
+inline constexpr std::uintmax_t SAVE_BATCH = 4096;
+// Uncached chunks with more runs of modified bytes than this get read and written whole on save.
+inline constexpr std::uintmax_t SAVE_MAX_RUNS = 2;
+// The size of the buffer that files get copied through on an atomic save, when the file system cannot copy them itself.
+inline constexpr std::uintmax_t COPY_BUFFER_SIZE = 1024 * 1024;
+// The share of the available memory that the chunk cache may grow into, unless a budget is given.
+inline constexpr std::uintmax_t MEMORY_BUDGET_SHARE = 4;
+// The memory budget used when the available memory cannot be determined.
+inline constexpr std::uintmax_t DEFAULT_MEMORY_BUDGET = 256 * 1024 * 1024;
+// The number of chunk loads between two checks for memory pressure.
+inline constexpr std::uintmax_t PRESSURE_CHECK_INTERVAL = 64;
+// How often the statistics overlay gets refreshed while no key is pressed, in milliseconds.
+inline constexpr int STATS_REFRESH_MS = 500;
+// How often the progress of a background save gets refreshed, in milliseconds.
+inline constexpr int SAVE_REFRESH_MS = 100;
+// How often the bytes of standard input that arrived in the meantime get shown, in milliseconds.
+inline constexpr int INPUT_REFRESH_MS = 100;
+// How often the hits that a search has found so far get shown, in milliseconds.
+inline constexpr int SEARCH_REFRESH_MS = 100;
+// Standard input is read in blocks of this size.
+inline constexpr std::uintmax_t STDIN_BLOCK_SIZE = 1024 * 1024;
+// Standard input is kept in memory up to this size, the rest of it goes into an anonymous temporary file.
+inline constexpr std::uintmax_t STDIN_MEMORY_LIMIT = 64 * 1024 * 1024;
+// Decompressed bytes between two checkpoints of the index of a gzip file. Each of them keeps 32 KiB of
+// output, compressed, so that inflate can resume there.
+inline constexpr std::uintmax_t GZIP_CHECKPOINT_SPAN = 8 * 1024 * 1024;
+// Compressed bytes read at once from a gzip file.
+inline constexpr std::uintmax_t GZIP_INPUT_SIZE = 64 * 1024;
+// Bytes each thread of a search scans at once.
+inline constexpr std::uintmax_t SEARCH_BLOCK_SIZE = 4 * 1024 * 1024;
+// Hits of a search between two absolute offsets in the hit index, the ones in between are delta encoded.
+inline constexpr std::uintmax_t HIT_INDEX_BLOCK = 64;
+// The hit index stops growing once its offsets take this many bytes.
+inline constexpr std::uintmax_t HIT_INDEX_MEMORY_LIMIT = 256 * 1024 * 1024;
+// Longest input of the prompts that take a range or a path.
+inline constexpr std::uint32_t MAX_PROMPT_LEN = 255;
 
 // Special key sequences.
 inline constexpr int CTRL_Q = 'q' & 0x1F;
@@ -22,14 +69,44 @@ inline constexpr int CTRL_X = 'x' & 0x1F;
 inline constexpr int CTRL_A = 'a' & 0x1F;
 inline constexpr int CTRL_Z = 'z' & 0x1F;
 inline constexpr int CTRL_G = 'g' & 0x1F;
+inline constexpr int CTRL_T = 't' & 0x1F;
+inline constexpr int CTRL_E = 'e' & 0x1F;
+inline constexpr int CTRL_C = 'c' & 0x1F;
+inline constexpr int CTRL_F = 'f' & 0x1F;
+inline constexpr int CTRL_P = 'p' & 0x1F;
+inline constexpr int CTRL_Y = 'y' & 0x1F;
+inline constexpr int CTRL_W = 'w' & 0x1F;
+inline constexpr int CTRL_K = 'k' & 0x1F;
+inline constexpr int CTRL_N = 'n' & 0x1F;
+inline constexpr int CTRL_B = 'b' & 0x1F;
+inline constexpr int CTRL_O = 'o' & 0x1F;
+inline constexpr int CTRL_R = 'r' & 0x1F;
+inline constexpr int CTRL_D = 'd' & 0x1F;
+inline constexpr int CTRL_U = 'u' & 0x1F;
+inline constexpr int CTRL_V = 'v' & 0x1F;
 
 // Feel free to map the controls to the keys of your choice :)
-inline constexpr int K_QUIT  = CTRL_Q; // Quit
-inline constexpr int K_SAVE  = CTRL_S; // Save
-inline constexpr int K_HEX   = CTRL_X; // HEX mode
-inline constexpr int K_ASCII = CTRL_A; // ASCII mode
-inline constexpr int K_SUSP  = CTRL_Z; // Suspend
-inline constexpr int K_GO_TO = CTRL_G; // Go to byte
+inline constexpr int K_QUIT     = CTRL_Q; // Quit
+inline constexpr int K_SAVE     = CTRL_S; // Save
+inline constexpr int K_HEX      = CTRL_X; // HEX mode
+inline constexpr int K_ASCII    = CTRL_A; // ASCII mode
+inline constexpr int K_SUSP     = CTRL_Z; // Suspend
+inline constexpr int K_GO_TO    = CTRL_G; // Go to byte
+inline constexpr int K_STATS    = CTRL_T; // Statistics overlay
+inline constexpr int K_INSERT   = CTRL_E; // Insert mode
+inline constexpr int K_CANCEL   = CTRL_C; // Cancel a running save
+inline constexpr int K_FILL     = CTRL_F; // Fill a range with a pattern
+inline constexpr int K_PASTE    = CTRL_P; // Paste a file
+inline constexpr int K_COPY     = CTRL_Y; // Copy a range to the cursor
+inline constexpr int K_SAVE_AS  = CTRL_W; // Save into a new file
+inline constexpr int K_FIND     = CTRL_K; // Find a pattern
+inline constexpr int K_NEXT     = CTRL_N; // Next match
+inline constexpr int K_PREV     = CTRL_B; // Previous match
+inline constexpr int K_HIT      = CTRL_O; // Go to a match by its number
+inline constexpr int K_SCAN     = CTRL_R; // Scan for embedded files
+inline constexpr int K_NEXT_EMB = CTRL_D; // Next embedded file
+inline constexpr int K_PREV_EMB = CTRL_U; // Previous embedded file
+inline constexpr int K_CARVE    = CTRL_V; // Carve the embedded file at the cursor
 } // namespace Hexit
 
 #endif // HEXIT_CONFIG_H
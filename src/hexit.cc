@@ -1,12 +1,22 @@
-#include "FileHandler.h"
+#include "MagicDatabase.h"
+#include "MemoryBudget.h"
+#include "MmapHandler.h"
+#include "PosixFileHandler.h"
 #include "SignatureReader.h"
 #include "StdInHandler.h"
 #include "TerminalWindow.h"
 #include "Utilities.h"
+#include "config.h"
 #include <algorithm>
 #include <iostream>
 #include <ncurses.h>
 #include <string>
+#ifdef HEXIT_HAS_IO_URING
+#include "UringHandler.h"
+#endif
+#ifdef HEXIT_HAS_ZLIB
+#include "GzipHandler.h"
+#endif
 
 using namespace Hexit;
 namespace
@@ -17,9 +27,24 @@ inline void print_help(const char* bin)
     std::cerr << bin << " -f (--file) <file> [options]\n\n";
     std::cerr << "Display the hex dump of a file.\n\n";
     std::cerr << "If no file is given via the -f flag, then hexit will read bytes from standard input\n";
-    std::cerr << "until EOF is reached. When displaying the hex dump of standard input, saving will do nothing.\n\n";
+    std::cerr << "until EOF is reached. The bytes are shown as soon as they arrive, while the rest of the input is\n";
+    std::cerr << "still being read. Standard input cannot be saved in place, ctrl+w saves it into a new file.\n\n";
     std::cerr << "Options:\n";
     std::cerr << "-o (--offset) <offset>: Hexadecimal or decimal byte offset to seek during startup.\n";
+    std::cerr << "-m (--mmap): Map the file into memory instead of reading it in chunks. Files that cannot be mapped\n";
+    std::cerr << "             are read in chunks.\n";
+    std::cerr << "-c (--chunk-size) <size>: Hexadecimal or decimal size of the chunks that get loaded from the file,\n";
+    std::cerr << "                          rounded up to the page size. Detected from the storage by default.\n";
+    std::cerr << "--max-memory <size>: Memory the chunk cache may grow into, e.g. 512M. Defaults to a share of the memory\n";
+    std::cerr << "                     available to the process, as limited by its cgroup.\n";
+    std::cerr << "-a (--atomic-save): Save overwritten bytes into a copy of the file that then replaces it, so that a crash\n";
+    std::cerr << "                    cannot leave a partially saved file behind. The copy shares the unmodified data with\n";
+    std::cerr << "                    the file where the file system supports it.\n";
+    std::cerr << "--stats: Print the cache and I/O statistics on exit. Press ctrl+t to show them while running.\n";
+    std::cerr << "-z (--gunzip): Show the decompressed contents of a gzip file, read only. The index that allows seeking\n";
+    std::cerr << "               in it gets built while the file is shown, and cached in ~/.cache/hexit.\n";
+    std::cerr << "--magic <file>: Tell the file type by the signatures in file before the built in ones. One per line:\n";
+    std::cerr << "                offset priority type bytes, e.g. \"257 50 tar 75 73 74 61 72\", ? for any nibble.\n";
 }
 
 inline bool init_ncurses()
@@ -32,16 +57,33 @@ inline bool init_ncurses()
         && start_color() != ERR
         && use_default_colors() != ERR
         && init_pair(1, COLOR_GREEN, COLOR_BLACK) != ERR
+        && init_pair(2, COLOR_YELLOW, COLOR_BLACK) != ERR
         && keypad(stdscr, true) != ERR;
 }
 
-int get_type(IOHandler& handler, std::string& file_type)
+int get_type(IOHandler& handler, const char* const magic_path, std::string& file_type)
 {
     if (handler.size() == 0)
         return 1;
 
+    // The signatures of the database come first, the built in ones tell the rest.
+    if (magic_path)
+    {
+        MagicDatabase database;
+        if (!database.load(magic_path))
+        {
+            std::cerr << database.error() << '\n';
+            return 1;
+        }
+
+        file_type = database.get_type([&handler](std::uintmax_t offset, std::uint8_t* data, std::uintmax_t count)
+                                      { return handler.read_at(offset, data, count); },
+                                      handler.size());
+        if (!file_type.empty())
+            return 0;
+    }
+
     std::vector<std::uint8_t> query;
-    SignatureReader           reader;
     std::uintmax_t            bytes_to_copy = std::min(handler.size(), static_cast<std::uintmax_t>(32u));
     query.resize(bytes_to_copy);
 
@@ -51,13 +93,29 @@ int get_type(IOHandler& handler, std::string& file_type)
         return 1;
     }
 
-    file_type = reader.get_type(query);
+    file_type = SignatureReader::get_type(query);
     return 0;
 }
 
+std::uintmax_t get_chunk_size(const IOHandler& handler, const char* const requested_size)
+{
+    std::uintmax_t chunk_size = str_to_int(requested_size);
+    if (chunk_size == 0)
+        chunk_size = std::min(handler.block_size(), MAX_AUTO_CHUNK_SIZE);
+    if (chunk_size == 0)
+        chunk_size = CHUNK_SIZE;
+
+    return align_chunk_size(chunk_size, page_size());
+}
+
 int start_hexit(IOHandler&        handler,
                 const char* const starting_offset,
-                const char* const input_path)
+                const char* const chunk_size,
+                const char* const input_path,
+                const char* const max_memory,
+                const char* const magic_path,
+                bool              atomic_save,
+                bool              print_statistics)
 {
     if (input_path && !handler.open(input_path))
     {
@@ -66,15 +124,30 @@ int start_hexit(IOHandler&        handler,
     }
 
     std::string file_type;
-    if (get_type(handler, file_type) != 0)
+    if (get_type(handler, magic_path, file_type) != 0)
         return 1;
 
     if (!init_ncurses())
         return 1;
 
-    TerminalWindow win(handler, file_type, str_to_int(starting_offset));
-    win.run();
-    // ~TerminalWindow de-initializes ncurses
+    const MemoryBudget budget(str_to_size(max_memory));
+    CacheConfig        cache_config;
+    cache_config.m_chunk_size = get_chunk_size(handler, chunk_size);
+    cache_config.m_read_ahead = READ_AHEAD;
+    cache_config.m_budget     = &budget;
+
+    std::vector<std::string> statistics;
+    {
+        TerminalWindow win(handler, file_type, str_to_int(starting_offset), cache_config, atomic_save);
+        win.run();
+        if (print_statistics)
+            statistics = win.statistics();
+        // ~TerminalWindow de-initializes ncurses
+    }
+
+    for (const auto& line : statistics)
+        std::cout << line << '\n';
+
     return 0;
 }
 }
@@ -91,8 +164,15 @@ int main(int argc, char** argv)
     auto help            = get_flag(argc - 1, argv + 1, "-h") || get_flag(argc - 1, argv + 1, "--help");
     auto input_file      = get_arg(argc - 1, argv + 1, "-f", "--file");
     auto starting_offset = get_arg(argc - 1, argv + 1, "-o", "--offset");
+    auto chunk_size      = get_arg(argc - 1, argv + 1, "-c", "--chunk-size");
+    auto use_mmap        = get_flag(argc - 1, argv + 1, "-m") || get_flag(argc - 1, argv + 1, "--mmap");
+    auto show_stats      = get_flag(argc - 1, argv + 1, "--stats");
+    auto max_memory      = get_arg(argc - 1, argv + 1, "--max-memory");
+    auto atomic_save     = get_flag(argc - 1, argv + 1, "-a") || get_flag(argc - 1, argv + 1, "--atomic-save");
+    auto gunzip          = get_flag(argc - 1, argv + 1, "-z") || get_flag(argc - 1, argv + 1, "--gunzip");
+    auto magic_path      = get_arg(argc - 1, argv + 1, "--magic");
 
-    if (help || (!input_file && !starting_offset && argc > 1))
+    if (help || (!input_file && !starting_offset && !chunk_size && !use_mmap && !show_stats && !max_memory && !atomic_save && !gunzip && !magic_path && argc > 1))
     {
         print_help(*argv);
         return 1;
@@ -101,11 +181,28 @@ int main(int argc, char** argv)
     if (!input_file)
     {
         StdInHandler handler(true);
-        return start_hexit(handler, starting_offset, "stdin");
+        return start_hexit(handler, starting_offset, chunk_size, "stdin", max_memory, magic_path, atomic_save, show_stats);
     }
-    else
+
+    if (gunzip)
     {
-        FileHandler handler;
-        return start_hexit(handler, starting_offset, input_file);
+#ifdef HEXIT_HAS_ZLIB
+        GzipHandler gzip_handler;
+        return start_hexit(gzip_handler, starting_offset, chunk_size, input_file, max_memory, magic_path, atomic_save, show_stats);
+#else
+        std::cerr << "hexit was built without zlib, gzip files cannot be decompressed\n";
+        return 1;
+#endif
     }
+
+    if (MmapHandler mapped_handler; use_mmap && mapped_handler.open(input_file))
+        return start_hexit(mapped_handler, starting_offset, chunk_size, nullptr, max_memory, magic_path, atomic_save, show_stats);
+
+    // Files that cannot be mapped (pipes, special files) are read in chunks.
+#ifdef HEXIT_HAS_IO_URING
+    UringHandler handler;
+#else
+    PosixFileHandler handler;
+#endif
+    return start_hexit(handler, starting_offset, chunk_size, input_file, max_memory, magic_path, atomic_save, show_stats);
 }
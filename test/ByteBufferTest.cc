@@ -1,10 +1,15 @@
 #include "ByteBuffer.h"
 #include "IOHandlerMock.h"
+#include "PosixFileHandler.h"
 #include <array>
 #include <filesystem>
 #include <fstream>
 #include <gtest/gtest.h>
 #include <string>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
 
 namespace
 {
@@ -12,7 +17,7 @@ namespace fs = std::filesystem;
 using namespace Hexit;
 
 const std::string       file_name("test/path/to/somewhere");
-constexpr std::uintmax_t expected_size_bytes = IOHandlerMock::chunk_count * ChunkCache::capacity;
+constexpr std::uintmax_t expected_size_bytes = IOHandlerMock::chunk_count * CHUNK_SIZE;
 
 // In case of an io error, is_ok should return true and error_msg() should contain
 // an error message.
@@ -21,7 +26,7 @@ TEST(ByteBufferTest, RandomAccessError)
     IOHandlerMock handler;
     ASSERT_TRUE(handler.open(file_name));
     ByteBuffer buffer(handler);
-    EXPECT_EQ(buffer.size, expected_size_bytes);
+    EXPECT_EQ(buffer.size(), expected_size_bytes);
     handler.mock_io_fail(true);
     EXPECT_TRUE(buffer.error_msg().empty());
     EXPECT_TRUE(buffer.is_ok());
@@ -39,16 +44,16 @@ TEST(ByteBufferTest, DataCaching)
     const auto               size = handler.size();
     ByteBuffer               buffer(handler);
     constexpr std::uintmax_t first_chunk_id = 2, last_chunkc_id = 3;
-    for (std::uintmax_t i = ChunkCache::capacity * first_chunk_id;
-         (i < ChunkCache::capacity * (last_chunkc_id + 1)) && (i < size);
+    for (std::uintmax_t i = CHUNK_SIZE * first_chunk_id;
+         (i < CHUNK_SIZE * (last_chunkc_id + 1)) && (i < size);
          ++i)
     {
         // Access each byte to trigger the caching mechanism.
         buffer[i];
     }
     // Accessing again the bytes from the first chunk, should not cause any loading.
-    for (std::uintmax_t i = ChunkCache::capacity * first_chunk_id;
-         (i < ChunkCache::capacity * last_chunkc_id) && (i < size);
+    for (std::uintmax_t i = CHUNK_SIZE * first_chunk_id;
+         (i < CHUNK_SIZE * last_chunkc_id) && (i < size);
          ++i)
     {
         buffer[i];
@@ -126,6 +131,26 @@ TEST(ByteBufferTest, ByteReadReverse)
         ASSERT_EQ(buffer[i], expectation[i]);
 }
 
+// The chunk size is a runtime setting, every chunk size should expose the same bytes,
+// including sizes that leave a partially filled chunk at the end of the file.
+TEST(ByteBufferTest, ByteReadChunkSizes)
+{
+    IOHandlerMock handler;
+    ASSERT_TRUE(handler.open(file_name));
+    const auto    size        = handler.size();
+    std::uint8_t* expectation = handler.data();
+    for (std::uintmax_t chunk_size : { 512u, 10000u, 65536u })
+    {
+        ByteBuffer buffer(handler, { .m_chunk_size = chunk_size });
+        for (std::uintmax_t i = 0; i < size; ++i)
+            ASSERT_EQ(buffer[i], expectation[i]);
+        buffer.set_byte(size - 1, static_cast<std::uint8_t>(expectation[size - 1] + 1));
+        buffer.save();
+        EXPECT_TRUE(buffer.is_ok());
+    }
+    EXPECT_EQ(handler.load_count(), size / 512 + size / 10000 + 1 + size / 65536 + 1);
+}
+
 // Setting bytes using ByteBuffer will not update the actual data
 // until save() gets called.
 TEST(ByteBufferTest, SaveBytes)
@@ -140,10 +165,10 @@ TEST(ByteBufferTest, SaveBytes)
     std::array<std::uintmax_t, 9> dirty_ids { 0, 10, 50, 80, 100, 140, 150, 200, 249 };
     for (auto id : dirty_ids)
     {
-        std::uintmax_t from = id * ChunkCache::capacity;
-        std::uintmax_t to   = from + ChunkCache::capacity;
+        std::uintmax_t from = id * CHUNK_SIZE;
+        std::uintmax_t to   = from + CHUNK_SIZE;
         if (to >= size)
-            to = from + size % ChunkCache::capacity;
+            to = from + size % CHUNK_SIZE;
 
         const auto old_value = raw_data[from];
         for (; from < to; ++from)
@@ -155,25 +180,72 @@ TEST(ByteBufferTest, SaveBytes)
     }
 
     EXPECT_EQ(handler.load_count(), dirty_ids.size());
+    // All the dirty chunks are still cached, so no extra loading should be needed.
     buffer.save();
-    EXPECT_EQ(handler.load_count(), 2 * dirty_ids.size());
+    EXPECT_EQ(handler.load_count(), dirty_ids.size());
 
     for (auto id : dirty_ids)
     {
-        std::uintmax_t from = id * ChunkCache::capacity;
-        std::uintmax_t to   = from + ChunkCache::capacity;
+        std::uintmax_t from = id * CHUNK_SIZE;
+        std::uintmax_t to   = from + CHUNK_SIZE;
         if (to >= size)
-            to = from + size % ChunkCache::capacity;
+            to = from + size % CHUNK_SIZE;
 
         const std::uint8_t old_value = raw_data[from] - 1;
         // save all the dirty bytes
-        for (from = id * ChunkCache::capacity; from < to; ++from)
+        for (from = id * CHUNK_SIZE; from < to; ++from)
         {
             EXPECT_EQ(raw_data[from], buffer[from]);
             EXPECT_EQ(raw_data[from], old_value + 1);
         }
     }
-    EXPECT_EQ(handler.load_count(), 3 * dirty_ids.size());
+    EXPECT_EQ(handler.load_count(), dirty_ids.size());
+}
+
+// Same as SaveBytes but with a cache that is too small to hold all the dirty chunks.
+// Only the modified bytes get written, so the evicted chunks do not get reloaded.
+TEST(ByteBufferTest, SaveEvictedBytes)
+{
+    IOHandlerMock handler;
+    ASSERT_TRUE(handler.open(file_name));
+    std::uint8_t*                 raw_data = handler.data();
+    ByteBuffer                    buffer(handler, { .m_slots = 2 });
+    std::array<std::uintmax_t, 4> dirty_ids { 3, 7, 11, 19 };
+    std::memset(raw_data, 0, handler.size());
+    for (auto id : dirty_ids)
+    {
+        const std::uintmax_t byte_id = id * CHUNK_SIZE + 5;
+        buffer.set_byte(byte_id, 0xAB);
+        EXPECT_EQ(buffer[byte_id], 0xAB);
+    }
+    EXPECT_EQ(handler.load_count(), dirty_ids.size());
+    buffer.save();
+    EXPECT_TRUE(buffer.is_ok());
+    EXPECT_FALSE(buffer.has_dirty());
+    EXPECT_EQ(handler.load_count(), dirty_ids.size());
+    EXPECT_EQ(handler.write_count(), dirty_ids.size());
+    for (auto id : dirty_ids)
+        EXPECT_EQ(raw_data[id * CHUNK_SIZE + 5], 0xAB);
+}
+
+// Bouncing between more than two chunks should not cause any reloading
+// as long as they all fit in the cache.
+TEST(ByteBufferTest, RevisitCachedChunks)
+{
+    IOHandlerMock handler;
+    ASSERT_TRUE(handler.open(file_name));
+    std::uint8_t*                 expectation = handler.data();
+    ByteBuffer                    buffer(handler, { .m_slots = 8 });
+    std::array<std::uintmax_t, 8> chunk_ids { 100, 3, 250, 17, 42, 0, 8, 199 };
+    for (std::uintmax_t round = 0; round < 16; ++round)
+    {
+        for (auto id : chunk_ids)
+        {
+            const std::uintmax_t byte_id = id * CHUNK_SIZE + round;
+            ASSERT_EQ(buffer[byte_id], expectation[byte_id]);
+        }
+    }
+    EXPECT_EQ(handler.load_count(), chunk_ids.size());
 }
 
 // Same as SaveBytes but this time the read only flag is set to true
@@ -190,10 +262,10 @@ TEST(ByteBufferTest, SaveAllBytesReadOnly)
     std::array<std::uintmax_t, 9> dirty_ids { 0, 10, 50, 80, 100, 140, 150, 200, 249 };
     for (auto id : dirty_ids)
     {
-        std::uintmax_t from = id * ChunkCache::capacity;
-        std::uintmax_t to   = from + ChunkCache::capacity;
+        std::uintmax_t from = id * CHUNK_SIZE;
+        std::uintmax_t to   = from + CHUNK_SIZE;
         if (to >= size)
-            to = from + size % ChunkCache::capacity;
+            to = from + size % CHUNK_SIZE;
 
         const auto old_value = buffer[from];
         for (; from < to; ++from)
@@ -204,7 +276,7 @@ TEST(ByteBufferTest, SaveAllBytesReadOnly)
         }
         // save all the dirty bytes
         buffer.save();
-        for (from = id * ChunkCache::capacity; from < to; ++from)
+        for (from = id * CHUNK_SIZE; from < to; ++from)
         {
             EXPECT_NE(raw_data[from], buffer[from]);
             EXPECT_NE(raw_data[from], old_value + 1);
@@ -233,4 +305,618 @@ TEST(ByteBufferTest, ErrorDuringSave)
     EXPECT_FALSE(buffer.error_msg().empty());
     EXPECT_FALSE(buffer.is_ok());
 }
+
+// Inserted and erased bytes shift the following ones, without touching the underlying IOHandler.
+TEST(ByteBufferTest, InsertErase)
+{
+    IOHandlerMock handler;
+    ASSERT_TRUE(handler.open(file_name));
+    const auto          size     = handler.size();
+    const std::uint8_t* raw_data = handler.data();
+    ByteBuffer          buffer(handler);
+
+    EXPECT_TRUE(buffer.insert_byte(CHUNK_SIZE, 0xAA));
+    EXPECT_TRUE(buffer.insert_byte(CHUNK_SIZE + 1, 0xBB));
+    EXPECT_EQ(buffer.size(), size + 2);
+    EXPECT_TRUE(buffer.has_dirty());
+    EXPECT_TRUE(buffer.is_resized());
+    EXPECT_EQ(buffer[CHUNK_SIZE - 1], raw_data[CHUNK_SIZE - 1]);
+    EXPECT_EQ(buffer[CHUNK_SIZE], 0xAA);
+    EXPECT_EQ(buffer[CHUNK_SIZE + 1], 0xBB);
+    EXPECT_EQ(buffer[CHUNK_SIZE + 2], raw_data[CHUNK_SIZE]);
+    EXPECT_TRUE(buffer.is_dirty(CHUNK_SIZE));
+    EXPECT_FALSE(buffer.is_dirty(CHUNK_SIZE + 2));
+
+    // Overwriting an inserted byte keeps it inserted, overwriting a shifted byte patches the original.
+    buffer.set_byte(CHUNK_SIZE + 1, 0xCC);
+    EXPECT_EQ(buffer[CHUNK_SIZE + 1], 0xCC);
+    buffer.set_byte(CHUNK_SIZE + 2, static_cast<std::uint8_t>(raw_data[CHUNK_SIZE] + 1));
+    EXPECT_TRUE(buffer.is_dirty(CHUNK_SIZE + 2));
+    EXPECT_EQ(buffer[CHUNK_SIZE + 2], static_cast<std::uint8_t>(raw_data[CHUNK_SIZE] + 1));
+
+    EXPECT_TRUE(buffer.erase_byte(0));
+    EXPECT_EQ(buffer.size(), size + 1);
+    EXPECT_EQ(buffer[0], raw_data[1]);
+    EXPECT_EQ(buffer[CHUNK_SIZE - 1], 0xAA);
+    EXPECT_FALSE(buffer.erase_byte(buffer.size()));
+    EXPECT_TRUE(buffer.insert_byte(buffer.size(), 0xDD));
+    EXPECT_EQ(buffer[size + 1], 0xDD);
+    EXPECT_TRUE(buffer.is_ok());
+
+    IOHandlerMock read_only(true);
+    ASSERT_TRUE(read_only.open(file_name));
+    ByteBuffer read_only_buffer(read_only);
+    EXPECT_FALSE(read_only_buffer.insert_byte(0, 0xAA));
+    EXPECT_FALSE(read_only_buffer.erase_byte(0));
+    EXPECT_FALSE(read_only_buffer.has_dirty());
+}
+
+// Saving inserted and erased bytes rewrites the file, which gets reopened afterwards.
+TEST(ByteBufferTest, SaveResized)
+{
+    const fs::path            path = fs::temp_directory_path() / ("hexit_resize_test_" + std::to_string(::getpid()));
+    std::vector<std::uint8_t> expectation(3 * CHUNK_SIZE + 11);
+    for (std::uintmax_t i = 0; i < expectation.size(); ++i)
+        expectation[i] = static_cast<std::uint8_t>(i * 7);
+    {
+        std::ofstream file(path, std::ios::binary);
+        file.write(reinterpret_cast<const char*>(expectation.data()), static_cast<std::streamsize>(expectation.size()));
+    }
+    fs::permissions(path, fs::perms::owner_read | fs::perms::owner_write | fs::perms::group_read);
+
+    PosixFileHandler handler;
+    ASSERT_TRUE(handler.open(path));
+    ByteBuffer buffer(handler, { .m_slots = 2, .m_read_ahead = 2 });
+    for (std::uintmax_t i = 0; i < expectation.size(); ++i)
+        ASSERT_EQ(buffer[i], expectation[i]);
+
+    buffer.set_byte(5, 0x55);
+    expectation[5] = 0x55;
+    for (std::uintmax_t i = 0; i < 3; ++i)
+    {
+        ASSERT_TRUE(buffer.insert_byte(CHUNK_SIZE + i, static_cast<std::uint8_t>(0xA0 + i)));
+        expectation.insert(expectation.begin() + static_cast<std::ptrdiff_t>(CHUNK_SIZE + i), static_cast<std::uint8_t>(0xA0 + i));
+    }
+    ASSERT_TRUE(buffer.erase_byte(2 * CHUNK_SIZE));
+    expectation.erase(expectation.begin() + 2 * CHUNK_SIZE);
+    ASSERT_TRUE(buffer.erase_byte(buffer.size() - 1));
+    expectation.pop_back();
+
+    buffer.save();
+    ASSERT_TRUE(buffer.is_ok()) << buffer.error_msg();
+    EXPECT_FALSE(buffer.has_dirty());
+    EXPECT_FALSE(buffer.is_resized());
+    EXPECT_EQ(buffer.save_method(), SaveMethod::REWRITE);
+    EXPECT_EQ(handler.size(), expectation.size());
+    EXPECT_EQ(buffer.size(), expectation.size());
+    EXPECT_EQ(fs::status(path).permissions() & fs::perms::all, fs::perms::owner_read | fs::perms::owner_write | fs::perms::group_read);
+
+    std::vector<std::uint8_t> contents(fs::file_size(path));
+    std::ifstream(path, std::ios::binary).read(reinterpret_cast<char*>(contents.data()), static_cast<std::streamsize>(contents.size()));
+    EXPECT_EQ(contents, expectation);
+    for (std::uintmax_t i = 0; i < expectation.size(); ++i)
+        ASSERT_EQ(buffer[i], expectation[i]);
+
+    // Overwrites after the rewrite go to the new file in place.
+    buffer.set_byte(0, 0x11);
+    buffer.save();
+    std::ifstream(path, std::ios::binary).read(reinterpret_cast<char*>(contents.data()), 1);
+    EXPECT_EQ(contents[0], 0x11);
+    fs::remove(path);
+}
+
+// Saving as a new file writes the logical bytes there and leaves the buffer and its file as they are.
+TEST(ByteBufferTest, SaveAs)
+{
+    const fs::path            path   = fs::temp_directory_path() / ("hexit_save_as_test_" + std::to_string(::getpid()));
+    const fs::path            target = path.string() + "_copy";
+    std::vector<std::uint8_t> original(2 * COPY_BUFFER_SIZE + 11);
+    for (std::uintmax_t i = 0; i < original.size(); ++i)
+        original[i] = static_cast<std::uint8_t>(i * 7);
+    {
+        std::ofstream file(path, std::ios::binary);
+        file.write(reinterpret_cast<const char*>(original.data()), static_cast<std::streamsize>(original.size()));
+    }
+
+    PosixFileHandler handler;
+    ASSERT_TRUE(handler.open(path));
+    ByteBuffer                buffer(handler);
+    std::vector<std::uint8_t> expectation = original;
+    buffer.set_byte(5, 0x55);
+    expectation[5] = 0x55;
+    ASSERT_TRUE(buffer.insert_byte(COPY_BUFFER_SIZE, 0xA0));
+    expectation.insert(expectation.begin() + COPY_BUFFER_SIZE, 0xA0);
+
+    ASSERT_TRUE(buffer.save_as(target)) << buffer.error_msg();
+    EXPECT_TRUE(buffer.has_dirty());
+    std::vector<std::uint8_t> contents(fs::file_size(target));
+    std::ifstream(target, std::ios::binary).read(reinterpret_cast<char*>(contents.data()), static_cast<std::streamsize>(contents.size()));
+    EXPECT_EQ(contents, expectation);
+    contents.resize(fs::file_size(path));
+    std::ifstream(path, std::ios::binary).read(reinterpret_cast<char*>(contents.data()), static_cast<std::streamsize>(contents.size()));
+    EXPECT_EQ(contents, original);
+
+    // A range of the bytes, which gets cut at the end of the buffer.
+    ASSERT_TRUE(buffer.save_as(target, 3, COPY_BUFFER_SIZE));
+    contents.resize(fs::file_size(target));
+    std::ifstream(target, std::ios::binary).read(reinterpret_cast<char*>(contents.data()), static_cast<std::streamsize>(contents.size()));
+    EXPECT_EQ(contents, std::vector<std::uint8_t>(expectation.begin() + 3, expectation.begin() + 3 + COPY_BUFFER_SIZE));
+    ASSERT_TRUE(buffer.save_as(target, expectation.size() - 4, 100));
+    EXPECT_EQ(fs::file_size(target), 4u);
+
+    // The file of the handler would get truncated before it is read.
+    EXPECT_FALSE(buffer.save_as(path));
+    EXPECT_EQ(fs::file_size(path), original.size());
+    fs::remove(path);
+    fs::remove(target);
+}
+
+// Filled, pasted and copied ranges are read from their pieces, without expanding them.
+TEST(ByteBufferTest, RangeEdits)
+{
+    IOHandlerMock handler;
+    ASSERT_TRUE(handler.open(file_name));
+    const auto          size     = handler.size();
+    const std::uint8_t* raw_data = handler.data();
+    ByteBuffer          buffer(handler);
+
+    const std::vector<std::uint8_t> pattern = { 0x01, 0x02, 0x03 };
+    ASSERT_TRUE(buffer.fill(10, 2 * CHUNK_SIZE, pattern));
+    EXPECT_EQ(buffer.size(), size);
+    EXPECT_EQ(buffer[9], raw_data[9]);
+    EXPECT_EQ(buffer[10], 0x01);
+    EXPECT_EQ(buffer[12], 0x03);
+    EXPECT_EQ(buffer[2 * CHUNK_SIZE + 9], pattern[(2 * CHUNK_SIZE - 1) % 3]);
+    EXPECT_EQ(buffer[2 * CHUNK_SIZE + 10], raw_data[2 * CHUNK_SIZE + 10]);
+    EXPECT_TRUE(buffer.is_dirty(CHUNK_SIZE));
+    EXPECT_FALSE(buffer.is_dirty(2 * CHUNK_SIZE + 10));
+
+    const std::array<std::uint8_t, 4> data = { 0xDE, 0xAD, 0xBE, 0xEF };
+    ASSERT_TRUE(buffer.paste(5, data, true));
+    EXPECT_EQ(buffer.size(), size + 4);
+    EXPECT_EQ(buffer[5], 0xDE);
+    EXPECT_EQ(buffer[9], raw_data[5]);
+    ASSERT_TRUE(buffer.paste(buffer.size() - 2, data));
+    EXPECT_EQ(buffer.size(), size + 6);
+    EXPECT_EQ(buffer[buffer.size() - 1], 0xEF);
+
+    // A copy keeps the bytes of the source, overwriting either of them afterwards leaves the other one alone.
+    const std::uintmax_t from = 3 * CHUNK_SIZE;
+    ASSERT_TRUE(buffer.copy(from + 4, 100, 0));
+    EXPECT_EQ(buffer.size(), size + 6);
+    EXPECT_EQ(buffer[0], raw_data[from]);
+    EXPECT_TRUE(buffer.is_dirty(0));
+    EXPECT_FALSE(buffer.is_dirty(from + 4));
+    ASSERT_TRUE(buffer.set_byte(0, static_cast<std::uint8_t>(raw_data[from] + 1)));
+    EXPECT_EQ(buffer[0], static_cast<std::uint8_t>(raw_data[from] + 1));
+    EXPECT_EQ(buffer[from + 4], raw_data[from]);
+    ASSERT_TRUE(buffer.set_byte(from + 5, 0x77));
+    EXPECT_EQ(buffer[1], raw_data[from + 1]);
+    EXPECT_EQ(buffer[from + 5], 0x77);
+
+    // Overwriting a filled byte splits it off the range.
+    ASSERT_TRUE(buffer.set_byte(CHUNK_SIZE, 0x99));
+    EXPECT_EQ(buffer[CHUNK_SIZE], 0x99);
+    EXPECT_EQ(buffer[CHUNK_SIZE + 1], pattern[(CHUNK_SIZE + 1 - 14) % 3]);
+    EXPECT_TRUE(buffer.is_dirty(CHUNK_SIZE + 1));
+    EXPECT_EQ(handler.write_count(), 0u);
+    EXPECT_TRUE(buffer.is_ok());
+
+    EXPECT_FALSE(buffer.fill(buffer.size(), 10, { 0x00 }));
+    EXPECT_FALSE(buffer.fill(0, 10, {}));
+    EXPECT_FALSE(buffer.copy(buffer.size(), 1, 0));
+    EXPECT_FALSE(buffer.paste_file(0, "/non/existent/file"));
+
+    IOHandlerMock read_only(true);
+    ASSERT_TRUE(read_only.open(file_name));
+    ByteBuffer read_only_buffer(read_only);
+    EXPECT_FALSE(read_only_buffer.fill(0, 10, { 0x00 }));
+    EXPECT_FALSE(read_only_buffer.paste(0, data));
+    EXPECT_FALSE(read_only_buffer.copy(0, 10, 20));
+}
+
+// Ranges that keep the size of the file get patched into it, a copy that reads bytes another range
+// overwrites forces a rewrite.
+TEST(ByteBufferTest, SaveRanges)
+{
+    const fs::path            path  = fs::temp_directory_path() / ("hexit_range_test_" + std::to_string(::getpid()));
+    const fs::path            paste = fs::temp_directory_path() / ("hexit_paste_test_" + std::to_string(::getpid()));
+    std::vector<std::uint8_t> expectation(4 * CHUNK_SIZE + 11);
+    for (std::uintmax_t i = 0; i < expectation.size(); ++i)
+        expectation[i] = static_cast<std::uint8_t>(i * 7);
+    std::vector<std::uint8_t> pasted(CHUNK_SIZE + 3);
+    for (std::uintmax_t i = 0; i < pasted.size(); ++i)
+        pasted[i] = static_cast<std::uint8_t>(i * 3 + 1);
+    const auto write = [](const fs::path& file, const std::vector<std::uint8_t>& bytes)
+    { std::ofstream(file, std::ios::binary).write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size())); };
+    const auto read = [](const fs::path& file)
+    {
+        std::vector<std::uint8_t> bytes(fs::file_size(file));
+        std::ifstream(file, std::ios::binary).read(reinterpret_cast<char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+        return bytes;
+    };
+    write(path, expectation);
+    write(paste, pasted);
+
+    PosixFileHandler handler;
+    ASSERT_TRUE(handler.open(path));
+    ByteBuffer buffer(handler, { .m_slots = 2, .m_read_ahead = 2 });
+
+    ASSERT_TRUE(buffer.fill(100, CHUNK_SIZE, { 0x00 }));
+    std::fill_n(expectation.begin() + 100, CHUNK_SIZE, 0x00);
+    ASSERT_TRUE(buffer.paste_file(2 * CHUNK_SIZE, paste));
+    std::copy(pasted.begin(), pasted.end(), expectation.begin() + 2 * CHUNK_SIZE);
+    ASSERT_TRUE(buffer.copy(4 * CHUNK_SIZE, 11, 50));
+    std::copy_n(expectation.begin() + 4 * CHUNK_SIZE, 11, expectation.begin() + 50);
+    buffer.set_byte(51, 0x42);
+    expectation[51] = 0x42;
+
+    buffer.save();
+    ASSERT_TRUE(buffer.is_ok()) << buffer.error_msg();
+    EXPECT_FALSE(buffer.has_dirty());
+    EXPECT_EQ(buffer.save_method(), SaveMethod::IN_PLACE);
+    EXPECT_EQ(read(path), expectation);
+    for (std::uintmax_t i = 0; i < expectation.size(); ++i)
+        ASSERT_EQ(buffer[i], expectation[i]);
+
+    // The copy reads bytes that get filled.
+    ASSERT_TRUE(buffer.copy(0, 200, 1000));
+    std::copy_n(std::vector<std::uint8_t>(expectation.begin(), expectation.begin() + 200).begin(), 200, expectation.begin() + 1000);
+    ASSERT_TRUE(buffer.fill(150, 10, { 0xAB, 0xCD }));
+    for (std::uintmax_t i = 0; i < 10; ++i)
+        expectation[150 + i] = i % 2 ? 0xCD : 0xAB;
+
+    buffer.save();
+    ASSERT_TRUE(buffer.is_ok()) << buffer.error_msg();
+    EXPECT_EQ(buffer.save_method(), SaveMethod::REWRITE);
+    EXPECT_EQ(read(path), expectation);
+
+    // A clone gets patched from the original file, whatever the pieces read.
+    buffer.set_atomic_save(true);
+    ASSERT_TRUE(buffer.copy(0, 200, 100));
+    std::copy_n(std::vector<std::uint8_t>(expectation.begin(), expectation.begin() + 200).begin(), 200, expectation.begin() + 100);
+    buffer.save();
+    ASSERT_TRUE(buffer.is_ok()) << buffer.error_msg();
+    EXPECT_NE(buffer.save_method(), SaveMethod::REWRITE);
+    EXPECT_EQ(read(path), expectation);
+
+    fs::remove(path);
+    fs::remove(paste);
+}
+
+// Ranges read across chunks and pieces hold the same bytes as reading them one by one.
+TEST(ByteBufferTest, ReadRange)
+{
+    IOHandlerMock handler;
+    ASSERT_TRUE(handler.open(file_name));
+    const std::uint8_t* raw_data = handler.data();
+    ByteBuffer          buffer(handler);
+
+    std::vector<std::uint8_t> range(3 * CHUNK_SIZE, 0xFF);
+    ASSERT_TRUE(buffer.read_range(CHUNK_SIZE / 2, range));
+    EXPECT_TRUE(std::equal(range.begin(), range.end(), raw_data + CHUNK_SIZE / 2));
+
+    // Bytes past the end of the buffer are left alone.
+    std::fill(range.begin(), range.end(), 0xFF);
+    ASSERT_TRUE(buffer.read_range(buffer.size() - 10, range));
+    EXPECT_TRUE(std::equal(range.begin(), range.begin() + 10, raw_data + buffer.size() - 10));
+    EXPECT_EQ(range[10], 0xFF);
+
+    const std::array<std::uint8_t, 3> data = { 0x10, 0x20, 0x30 };
+    buffer.set_byte(CHUNK_SIZE + 3, 0xEE);
+    ASSERT_TRUE(buffer.insert_byte(CHUNK_SIZE, 0xAA));
+    ASSERT_TRUE(buffer.fill(2 * CHUNK_SIZE - 7, 20, { 0x01, 0x02 }));
+    ASSERT_TRUE(buffer.paste(3 * CHUNK_SIZE, data, true));
+    ASSERT_TRUE(buffer.copy(0, 50, 3 * CHUNK_SIZE + 1));
+    for (std::uintmax_t start : { std::uintmax_t { 0 }, CHUNK_SIZE - 1, 2 * CHUNK_SIZE - 30 })
+    {
+        ASSERT_TRUE(buffer.read_range(start, range));
+        for (std::uintmax_t i = 0; i < range.size(); ++i)
+            ASSERT_EQ(range[i], buffer[start + i]) << start + i;
+
+        for (std::uintmax_t line = start; line < start + range.size(); line += BYTES_PER_LINE)
+        {
+            std::uint64_t mask = 0;
+            for (std::uintmax_t i = 0; i < BYTES_PER_LINE; ++i)
+                mask |= std::uint64_t { buffer.is_dirty(line + i) } << i;
+            ASSERT_EQ(buffer.dirty_mask(line, BYTES_PER_LINE), mask) << line;
+        }
+    }
+    EXPECT_TRUE(buffer.is_ok());
+}
+
+// Reads past the cache see the same bytes as the ones through it, from several threads at once.
+TEST(ByteBufferTest, ReadDirect)
+{
+    IOHandlerMock handler;
+    ASSERT_TRUE(handler.open(file_name));
+    ByteBuffer buffer(handler);
+    buffer.set_byte(5, 0xEE);
+    buffer.set_byte(CHUNK_SIZE + 3, 0xEE);
+    ASSERT_TRUE(buffer.insert_byte(CHUNK_SIZE, 0xAA));
+    ASSERT_TRUE(buffer.fill(2 * CHUNK_SIZE - 7, 20, { 0x01, 0x02 }));
+    ASSERT_TRUE(buffer.copy(0, 50, 3 * CHUNK_SIZE + 1));
+    buffer.set_byte(3 * CHUNK_SIZE + 10, 0xCC);
+
+    std::vector<std::uint8_t> expectation(buffer.size());
+    ASSERT_TRUE(buffer.read_range(0, expectation));
+    std::vector<std::thread> readers;
+    for (std::uintmax_t start : { std::uintmax_t { 0 }, CHUNK_SIZE - 1, 2 * CHUNK_SIZE - 30 })
+    {
+        readers.emplace_back(
+            [&, start]
+            {
+                std::vector<std::uint8_t> range(buffer.size() - start);
+                ASSERT_TRUE(buffer.read_direct(start, range.data(), range.size()));
+                EXPECT_TRUE(std::equal(range.begin(), range.end(), expectation.begin() + static_cast<std::ptrdiff_t>(start)));
+            });
+    }
+    for (auto& reader : readers)
+        reader.join();
+
+    std::uint8_t byte = 0;
+    EXPECT_FALSE(buffer.read_direct(buffer.size(), &byte, 1));
+    EXPECT_TRUE(buffer.read_direct(buffer.size(), &byte, 0));
+}
+
+TEST(ByteBufferTest, DirtyMask)
+{
+    IOHandlerMock handler;
+    ASSERT_TRUE(handler.open(file_name));
+    ByteBuffer buffer(handler);
+    buffer.set_byte(CHUNK_SIZE - 2, 0xAA);
+    buffer.set_byte(CHUNK_SIZE + 1, 0xBB);
+    EXPECT_EQ(buffer.dirty_mask(CHUNK_SIZE - 16, 16), 0b0100000000000000u);
+    // Lines that straddle two chunks.
+    EXPECT_EQ(buffer.dirty_mask(CHUNK_SIZE - 4, 8), 0b00100100u);
+    EXPECT_EQ(buffer.dirty_mask(0, 16), 0u);
+
+    ASSERT_TRUE(buffer.insert_byte(CHUNK_SIZE - 4, 0xCC));
+    EXPECT_EQ(buffer.dirty_mask(CHUNK_SIZE - 4, 8), 0b01001001u);
+}
+
+// Runs of modified bytes are written as extents, runs that cross the border of
+// two chunks end up in a single vectored write. The runs of a cached chunk, or
+// of an uncached one with many of them, get written along with the bytes between them.
+TEST(ByteBufferTest, SaveExtents)
+{
+    const fs::path            path = fs::temp_directory_path() / ("hexit_extent_test_" + std::to_string(::getpid()));
+    std::vector<std::uint8_t> expectation(8 * CHUNK_SIZE);
+    for (std::uintmax_t i = 0; i < expectation.size(); ++i)
+        expectation[i] = static_cast<std::uint8_t>(i * 3);
+    {
+        std::ofstream file(path, std::ios::binary);
+        file.write(reinterpret_cast<const char*>(expectation.data()), static_cast<std::streamsize>(expectation.size()));
+    }
+
+    PosixFileHandler handler;
+    ASSERT_TRUE(handler.open(path));
+    ByteBuffer buffer(handler, { .m_slots = 1 });
+    const auto edit = [&](std::uintmax_t from, std::uintmax_t to)
+    {
+        for (; from < to; ++from)
+        {
+            buffer.set_byte(from, static_cast<std::uint8_t>(~expectation[from]));
+            expectation[from] = static_cast<std::uint8_t>(~expectation[from]);
+        }
+    };
+    edit(CHUNK_SIZE - 2, CHUNK_SIZE + 2);
+    edit(3 * CHUNK_SIZE + 7, 3 * CHUNK_SIZE + 8);
+    edit(3 * CHUNK_SIZE + 20, 3 * CHUNK_SIZE + 22);
+    edit(5 * CHUNK_SIZE, 7 * CHUNK_SIZE + 100);
+    edit(8 * CHUNK_SIZE - 1, 8 * CHUNK_SIZE);
+    EXPECT_EQ(buffer[3 * CHUNK_SIZE + 20], expectation[3 * CHUNK_SIZE + 20]);
+
+    const auto reads = handler.statistics().m_reads.load();
+    buffer.save();
+    ASSERT_TRUE(buffer.is_ok()) << buffer.error_msg();
+    EXPECT_EQ(handler.statistics().m_reads, reads);
+    EXPECT_EQ(handler.statistics().m_writes, 4u);
+    EXPECT_EQ(handler.statistics().m_bytes_written, 4u + 15u + 2 * CHUNK_SIZE + 100u + 1u);
+    EXPECT_EQ(buffer.cache().statistics().m_saves, 4u);
+
+    std::vector<std::uint8_t> contents(fs::file_size(path));
+    std::ifstream(path, std::ios::binary).read(reinterpret_cast<char*>(contents.data()), static_cast<std::streamsize>(contents.size()));
+    EXPECT_EQ(contents, expectation);
+
+    // An uncached chunk with more than SAVE_MAX_RUNS runs gets read and written whole.
+    static_assert(SAVE_MAX_RUNS < 3);
+    edit(2 * CHUNK_SIZE + 10, 2 * CHUNK_SIZE + 11);
+    edit(2 * CHUNK_SIZE + 20, 2 * CHUNK_SIZE + 22);
+    edit(2 * CHUNK_SIZE + 30, 2 * CHUNK_SIZE + 31);
+    edit(6 * CHUNK_SIZE + 5, 6 * CHUNK_SIZE + 6);
+    const auto writes = handler.statistics().m_writes.load();
+    const auto bytes  = handler.statistics().m_bytes_written.load();
+    buffer.save();
+    ASSERT_TRUE(buffer.is_ok()) << buffer.error_msg();
+    EXPECT_EQ(handler.statistics().m_reads, reads + 1);
+    EXPECT_EQ(handler.statistics().m_writes, writes + 2);
+    EXPECT_EQ(handler.statistics().m_bytes_written, bytes + CHUNK_SIZE + 1u);
+    std::ifstream(path, std::ios::binary).read(reinterpret_cast<char*>(contents.data()), static_cast<std::streamsize>(contents.size()));
+    EXPECT_EQ(contents, expectation);
+    fs::remove(path);
+}
+
+// Atomic saves patch a copy of the file that replaces it, without touching the original file in the meantime.
+TEST(ByteBufferTest, SaveAtomic)
+{
+    const fs::path            path = fs::temp_directory_path() / ("hexit_atomic_test_" + std::to_string(::getpid()));
+    const fs::path            link = path.string() + ".link";
+    std::vector<std::uint8_t> expectation(5 * CHUNK_SIZE + 3);
+    for (std::uintmax_t i = 0; i < expectation.size(); ++i)
+        expectation[i] = static_cast<std::uint8_t>(i * 13);
+    {
+        std::ofstream file(path, std::ios::binary);
+        file.write(reinterpret_cast<const char*>(expectation.data()), static_cast<std::streamsize>(expectation.size()));
+    }
+    fs::permissions(path, fs::perms::owner_read | fs::perms::owner_write | fs::perms::others_read);
+    // The hard link keeps referring to the old version of the file.
+    fs::create_hard_link(path, link);
+    const std::vector<std::uint8_t> original = expectation;
+
+    PosixFileHandler handler;
+    ASSERT_TRUE(handler.open(path));
+    ByteBuffer buffer(handler, { .m_slots = 2 });
+    buffer.set_atomic_save(true);
+    EXPECT_EQ(buffer.save_method(), SaveMethod::NONE);
+
+    // A cached chunk, an evicted one and a run across the border of two chunks.
+    for (std::uintmax_t byte_id : { std::uintmax_t { 1 }, std::uintmax_t { 7 }, 3 * CHUNK_SIZE - 2, 3 * CHUNK_SIZE + 1, 5 * CHUNK_SIZE + 2 })
+    {
+        buffer.set_byte(byte_id, 0xEE);
+        expectation[byte_id] = 0xEE;
+    }
+    for (std::uintmax_t byte_id = 3 * CHUNK_SIZE - 1; byte_id < 3 * CHUNK_SIZE + 1; ++byte_id)
+    {
+        buffer.set_byte(byte_id, 0xDD);
+        expectation[byte_id] = 0xDD;
+    }
+    ASSERT_EQ(buffer[0], expectation[0]);
+
+    buffer.save();
+    ASSERT_TRUE(buffer.is_ok()) << buffer.error_msg();
+    EXPECT_FALSE(buffer.has_dirty());
+    EXPECT_TRUE(buffer.save_method() == SaveMethod::REFLINK
+                || buffer.save_method() == SaveMethod::COPY_RANGE
+                || buffer.save_method() == SaveMethod::STREAM)
+        << to_string(buffer.save_method());
+    EXPECT_EQ(fs::status(path).permissions() & fs::perms::all, fs::perms::owner_read | fs::perms::owner_write | fs::perms::others_read);
+    EXPECT_EQ(fs::hard_link_count(path), 1u);
+
+    const auto read_file = [](const fs::path& file)
+    {
+        std::vector<std::uint8_t> contents(fs::file_size(file));
+        std::ifstream(file, std::ios::binary).read(reinterpret_cast<char*>(contents.data()), static_cast<std::streamsize>(contents.size()));
+        return contents;
+    };
+    EXPECT_EQ(read_file(path), expectation);
+    EXPECT_EQ(read_file(link), original);
+    for (std::uintmax_t i = 0; i < expectation.size(); ++i)
+        ASSERT_EQ(buffer[i], expectation[i]);
+
+    // Without atomic saves the bytes get written in place again.
+    buffer.set_atomic_save(false);
+    buffer.set_byte(2, 0x22);
+    expectation[2] = 0x22;
+    buffer.save();
+    EXPECT_EQ(buffer.save_method(), SaveMethod::IN_PLACE);
+    EXPECT_EQ(read_file(path), expectation);
+    fs::remove(path);
+    fs::remove(link);
+}
+
+// The copy keeps the owner and group of the file it replaces, which only root can give away.
+TEST(ByteBufferTest, SaveAtomicOwner)
+{
+    if (::geteuid() != 0)
+        GTEST_SKIP() << "Changing the owner of a file takes root";
+
+    const fs::path path = fs::temp_directory_path() / ("hexit_owner_test_" + std::to_string(::getpid()));
+    std::ofstream(path, std::ios::binary) << std::string(CHUNK_SIZE, 'x');
+    ASSERT_EQ(::chown(path.c_str(), 65534, 65534), 0);
+
+    PosixFileHandler handler;
+    ASSERT_TRUE(handler.open(path));
+    ByteBuffer buffer(handler);
+    buffer.set_atomic_save(true);
+    buffer.set_byte(0, 'y');
+    buffer.save();
+    ASSERT_TRUE(buffer.is_ok()) << buffer.error_msg();
+
+    struct stat status;
+    ASSERT_EQ(::stat(path.c_str(), &status), 0);
+    EXPECT_EQ(status.st_uid, 65534u);
+    EXPECT_EQ(status.st_gid, 65534u);
+    fs::remove(path);
+}
+
+// Bytes can be read and overwritten while a save runs in the background, the new changes are left for the next save.
+TEST(ByteBufferTest, BackgroundSave)
+{
+    IOHandlerMock handler;
+    ASSERT_TRUE(handler.open(file_name));
+    std::uint8_t* raw_data = handler.data();
+    std::memset(raw_data, 0, handler.size());
+    ByteBuffer buffer(handler);
+    ASSERT_EQ(buffer[0], 0u);
+    ASSERT_EQ(buffer[CHUNK_SIZE], 0u);
+    buffer.set_byte(1, 0x11);
+    buffer.set_byte(7, 0x77);
+
+    handler.hold_writes(true);
+    ASSERT_TRUE(buffer.start_save());
+    EXPECT_TRUE(buffer.is_saving());
+    EXPECT_FALSE(buffer.start_save());
+    EXPECT_FALSE(buffer.poll_save());
+    EXPECT_TRUE(buffer.has_dirty());
+    EXPECT_TRUE(buffer.is_dirty(1));
+    EXPECT_EQ(buffer[7], 0x77);
+    EXPECT_LT(buffer.save_progress(), 1.0);
+
+    // Only cached chunks get touched while the writes are held.
+    buffer.set_byte(7, 0x70);
+    buffer.set_byte(CHUNK_SIZE + 2, 0x22);
+    EXPECT_FALSE(buffer.insert_byte(0, 0xFF));
+    EXPECT_FALSE(buffer.erase_byte(0));
+    EXPECT_EQ(buffer[7], 0x70);
+    EXPECT_EQ(buffer.dirty_mask(0, 8), 0b10000010u);
+
+    handler.hold_writes(false);
+    buffer.wait_save();
+    ASSERT_TRUE(buffer.is_ok()) << buffer.error_msg();
+    EXPECT_FALSE(buffer.is_saving());
+    EXPECT_EQ(buffer.save_method(), SaveMethod::IN_PLACE);
+    EXPECT_EQ(raw_data[1], 0x11);
+    EXPECT_EQ(raw_data[7], 0x77);
+    EXPECT_EQ(raw_data[CHUNK_SIZE + 2], 0u);
+    EXPECT_FALSE(buffer.is_dirty(1));
+    EXPECT_TRUE(buffer.is_dirty(7));
+    EXPECT_TRUE(buffer.is_dirty(CHUNK_SIZE + 2));
+    EXPECT_EQ(buffer[7], 0x70);
+
+    ASSERT_TRUE(buffer.start_save());
+    while (!buffer.poll_save())
+        std::this_thread::yield();
+    EXPECT_FALSE(buffer.has_dirty());
+    EXPECT_EQ(raw_data[7], 0x70);
+    EXPECT_EQ(raw_data[CHUNK_SIZE + 2], 0x22);
+}
+
+// A cancelled save stops between two batches of extents and keeps all of its changes.
+TEST(ByteBufferTest, CancelSave)
+{
+    IOHandlerMock handler;
+    ASSERT_TRUE(handler.open(file_name));
+    std::uint8_t* raw_data = handler.data();
+    std::memset(raw_data, 0, handler.size());
+    ByteBuffer           buffer(handler, { .m_slots = 2 });
+    constexpr std::uintmax_t STRIDE = 100;
+    static_assert(IOHandlerMock::chunk_count * CHUNK_SIZE / STRIDE > SAVE_BATCH);
+    for (std::uintmax_t byte_id = 0; byte_id < handler.size(); byte_id += STRIDE)
+        buffer.set_byte(byte_id, 0xCC);
+
+    handler.hold_writes(true);
+    ASSERT_TRUE(buffer.start_save());
+    buffer.cancel_save();
+    handler.hold_writes(false);
+    buffer.wait_save();
+    EXPECT_TRUE(buffer.is_ok()) << buffer.error_msg();
+    EXPECT_TRUE(buffer.has_dirty());
+    EXPECT_EQ(buffer.save_method(), SaveMethod::NONE);
+    EXPECT_LE(handler.write_count(), SAVE_BATCH);
+
+    std::uintmax_t saved = 0;
+    for (std::uintmax_t byte_id = 0; byte_id < handler.size(); byte_id += STRIDE)
+    {
+        saved += raw_data[byte_id] == 0xCC;
+        ASSERT_TRUE(buffer.is_dirty(byte_id));
+        ASSERT_EQ(buffer[byte_id], 0xCC);
+    }
+    EXPECT_LE(saved, SAVE_BATCH);
+
+    buffer.save();
+    EXPECT_FALSE(buffer.has_dirty());
+    for (std::uintmax_t byte_id = 0; byte_id < handler.size(); byte_id += STRIDE)
+        ASSERT_EQ(raw_data[byte_id], 0xCC);
+}
 } // namespace
@@ -1,19 +1,21 @@
 #include "ChunkCache.h"
 #include "IOHandlerMock.h"
 #include <filesystem>
+#include <fstream>
 #include <gtest/gtest.h>
+#include <unistd.h>
 
 namespace
 {
 namespace fs = std::filesystem;
 using namespace Hexit;
 
-constexpr std::uintmax_t expected_size_bytes = IOHandlerMock::chunk_count * ChunkCache::capacity;
+constexpr std::uintmax_t expected_size_bytes = IOHandlerMock::chunk_count * CHUNK_SIZE;
 
 inline std::uintmax_t expected_chunks()
 {
-    std::uintmax_t chunks = expected_size_bytes / ChunkCache::capacity;
-    if (expected_size_bytes % ChunkCache::capacity)
+    std::uintmax_t chunks = expected_size_bytes / CHUNK_SIZE;
+    if (expected_size_bytes % CHUNK_SIZE)
         chunks++;
     return chunks;
 }
@@ -26,19 +28,17 @@ TEST(ChunkCacheTest, IOHandlerInformation)
 
     ASSERT_EQ(cache.recent().m_id, UINT64_MAX);
     ASSERT_EQ(cache.recent().m_count, 0);
-    ASSERT_EQ(sizeof(cache.recent().m_data), ChunkCache::capacity);
-
-    ASSERT_EQ(cache.fallback().m_id, UINT64_MAX);
-    ASSERT_EQ(cache.fallback().m_count, 0);
-    ASSERT_EQ(sizeof(cache.fallback().m_data), ChunkCache::capacity);
+    ASSERT_EQ(cache.recent().m_storage.size(), CHUNK_SIZE);
+    ASSERT_EQ(cache.chunk_size(), CHUNK_SIZE);
+    ASSERT_EQ(cache.slots(), CACHE_SLOTS);
+    ASSERT_EQ(cache.find(0), nullptr);
 
     ASSERT_EQ(expected_chunks(), cache.total_chunks());
 }
 
 // When load_chunk(chunk_id) gets called, the chunk returned by recent()
-// should contain the data of chunk_id. The chunk returned by fallback()
-// should contain the data that recent() had before the call to
-// load_chunk(chunk_id).
+// should contain the data of chunk_id. The chunk that was loaded right
+// before it should still be cached.
 TEST(ChunkCacheTest, LoadChunk)
 {
     IOHandlerMock handler;
@@ -49,10 +49,25 @@ TEST(ChunkCacheTest, LoadChunk)
     for (std::uintmax_t i = 1; i < cache.total_chunks(); ++i)
     {
         ASSERT_TRUE(cache.load_chunk(i));
-        EXPECT_EQ(cache.recent().m_id, cache.fallback().m_id + 1);
+        EXPECT_EQ(cache.recent().m_id, i);
+        EXPECT_NE(cache.find(i - 1), nullptr);
+        EXPECT_EQ(cache.recent().m_id, i - 1);
     }
 }
 
+// Only the bytes of the most recently used chunk are served by recent_byte().
+TEST(ChunkCacheTest, RecentByte)
+{
+    IOHandlerMock handler;
+    ChunkCache    cache(handler);
+    EXPECT_EQ(cache.recent_byte(0), nullptr);
+    ASSERT_TRUE(cache.load_chunk(1));
+    EXPECT_EQ(cache.recent_byte(CHUNK_SIZE - 1), nullptr);
+    ASSERT_NE(cache.recent_byte(CHUNK_SIZE), nullptr);
+    EXPECT_EQ(*cache.recent_byte(CHUNK_SIZE + 5), handler.data()[CHUNK_SIZE + 5]);
+    EXPECT_EQ(cache.recent_byte(2 * CHUNK_SIZE), nullptr);
+}
+
 // This is the same test as LoadChunk but this time the chunks get loaded
 // in reverse order.
 TEST(ChunkCacheTest, LoadChunkReverse)
@@ -65,8 +80,54 @@ TEST(ChunkCacheTest, LoadChunkReverse)
     for (std::uintmax_t i = cache.total_chunks() - 2; i > 0; --i)
     {
         ASSERT_TRUE(cache.load_chunk(i));
-        EXPECT_EQ(cache.recent().m_id, cache.fallback().m_id - 1);
+        EXPECT_EQ(cache.recent().m_id, i);
+        EXPECT_NE(cache.find(i + 1), nullptr);
+        EXPECT_EQ(cache.recent().m_id, i + 1);
+    }
+}
+
+// Once all the slots are in use, loading a new chunk should evict the least
+// recently used one. Looking up a chunk should protect it from eviction.
+TEST(ChunkCacheTest, LeastRecentlyUsedEviction)
+{
+    constexpr std::uintmax_t slots = 4;
+    IOHandlerMock            handler;
+    ChunkCache               cache(handler, { .m_slots = slots });
+    ASSERT_EQ(cache.slots(), slots);
+    for (std::uintmax_t i = 0; i < slots; ++i)
+        ASSERT_TRUE(cache.load_chunk(i));
+    EXPECT_EQ(handler.load_count(), slots);
+
+    // Chunk 0 becomes the most recently used one, chunk 1 is now the least recently used.
+    ASSERT_NE(cache.find(0), nullptr);
+    ASSERT_TRUE(cache.load_chunk(slots));
+    EXPECT_EQ(cache.find(1), nullptr);
+    for (std::uintmax_t i : { 0u, 2u, 3u, 4u })
+    {
+        auto* chunk = cache.find(i);
+        ASSERT_NE(chunk, nullptr);
+        EXPECT_EQ(chunk->m_id, i);
+        EXPECT_EQ(std::memcmp(chunk->m_data, handler.data() + i * CHUNK_SIZE, chunk->m_count), 0);
     }
+    EXPECT_EQ(handler.load_count(), slots + 1);
+}
+
+// A failed load should not leave a stale chunk behind.
+TEST(ChunkCacheTest, LoadChunkError)
+{
+    IOHandlerMock handler;
+    ChunkCache    cache(handler, { .m_slots = 2 });
+    ASSERT_TRUE(cache.load_chunk(0));
+    ASSERT_TRUE(cache.load_chunk(1));
+    handler.mock_io_fail(true);
+    EXPECT_FALSE(cache.load_chunk(2));
+    EXPECT_EQ(cache.find(2), nullptr);
+    EXPECT_NE(cache.find(1), nullptr);
+    handler.mock_io_fail(false);
+    EXPECT_TRUE(cache.load_chunk(2));
+    EXPECT_NE(cache.find(2), nullptr);
+    EXPECT_NE(cache.find(1), nullptr);
+    EXPECT_EQ(cache.find(0), nullptr);
 }
 
 // When a chunk gets saved, the underlying IOHandler should get updated.
@@ -83,7 +144,7 @@ TEST(ChunkCacheTest, SaveChunk)
     auto& data_chunk = cache.recent();
     EXPECT_EQ(chunk_id, data_chunk.m_id);
     std::memset(data_chunk.m_data, 0xEF, data_chunk.m_count);
-    std::uint8_t* expectation = raw_data + (chunk_id * ChunkCache::capacity);
+    std::uint8_t* expectation = raw_data + (chunk_id * CHUNK_SIZE);
     EXPECT_NE(std::memcmp(expectation, data_chunk.m_data, data_chunk.m_count), 0);
     EXPECT_TRUE(cache.save_chunk(data_chunk));
     EXPECT_EQ(std::memcmp(expectation, data_chunk.m_data, data_chunk.m_count), 0);
@@ -104,10 +165,75 @@ TEST(ChunkCacheTest, SaveChunkReadOnly)
     auto& data_chunk = cache.recent();
     EXPECT_EQ(chunk_id, data_chunk.m_id);
     std::memset(data_chunk.m_data, 0xEF, data_chunk.m_count);
-    std::uint8_t* expectation = raw_data + (chunk_id * ChunkCache::capacity);
+    std::uint8_t* expectation = raw_data + (chunk_id * CHUNK_SIZE);
     EXPECT_NE(std::memcmp(expectation, data_chunk.m_data, data_chunk.m_count), 0);
     EXPECT_FALSE(cache.save_chunk(data_chunk));
     EXPECT_NE(std::memcmp(expectation, data_chunk.m_data, data_chunk.m_count), 0);
     EXPECT_NE(expectation[0], 0xEF);
 }
+
+// The statistics should reflect every lookup, load, eviction and save.
+TEST(ChunkCacheTest, Statistics)
+{
+    IOHandlerMock handler;
+    ChunkCache    cache(handler, { .m_slots = 2 });
+    EXPECT_EQ(cache.find(0), nullptr);
+    ASSERT_TRUE(cache.load_chunk(0));
+    ASSERT_TRUE(cache.load_chunk(1));
+    EXPECT_NE(cache.find(0), nullptr);
+    EXPECT_NE(cache.find(0), nullptr);
+    // Evicts chunk 1.
+    ASSERT_TRUE(cache.load_chunks({ 2, 0 }));
+    EXPECT_EQ(cache.find(1), nullptr);
+    ASSERT_TRUE(cache.save_chunk(*cache.find(2)));
+
+    const auto& statistics = cache.statistics();
+    EXPECT_EQ(statistics.m_hits, 4u);
+    EXPECT_EQ(statistics.m_misses, 3u);
+    EXPECT_EQ(statistics.m_loads, 3u);
+    EXPECT_EQ(statistics.m_evictions, 1u);
+    EXPECT_EQ(statistics.m_saves, 1u);
+    EXPECT_EQ(cache.used_slots(), 2u);
+}
+
+// Revisiting recently evicted chunks should grow the cache within the budget,
+// memory pressure should shrink it back down.
+TEST(ChunkCacheTest, AdaptiveSize)
+{
+    const fs::path proc = fs::temp_directory_path() / ("hexit_cache_proc_" + std::to_string(::getpid()));
+    fs::create_directories(proc);
+    std::ofstream(proc / "meminfo") << "MemAvailable: 1048576 kB\n";
+
+    IOHandlerMock      handler;
+    const MemoryBudget budget(8 * CHUNK_SIZE, proc, proc);
+    ChunkCache         cache(handler, { .m_slots = 2, .m_budget = &budget });
+    EXPECT_EQ(cache.max_slots(), 8u);
+    for (std::uintmax_t round = 0; round < 8; ++round)
+    {
+        for (std::uintmax_t id = 0; id < 6; ++id)
+        {
+            if (!cache.find(id))
+            {
+                ASSERT_TRUE(cache.load_chunk(id));
+            }
+        }
+    }
+    EXPECT_EQ(cache.slots(), 6u);
+    EXPECT_EQ(cache.footprint(), 6u * CHUNK_SIZE);
+
+    // Once the cache holds the whole working set, no more loads are needed.
+    const auto loads = handler.load_count();
+    for (std::uintmax_t id = 0; id < 6; ++id)
+        EXPECT_NE(cache.find(id), nullptr);
+    EXPECT_EQ(handler.load_count(), loads);
+
+    std::ofstream(proc / "meminfo") << "MemAvailable: 4 kB\n";
+    for (std::uintmax_t id = 100; id < 100 + PRESSURE_CHECK_INTERVAL; ++id)
+        ASSERT_TRUE(cache.load_chunk(id));
+    EXPECT_EQ(cache.slots(), 3u);
+    for (std::uintmax_t id = 0; id < PRESSURE_CHECK_INTERVAL; ++id)
+        ASSERT_TRUE(cache.load_chunk(id));
+    EXPECT_EQ(cache.slots(), 2u);
+    fs::remove_all(proc);
+}
 } // namespace
@@ -0,0 +1,71 @@
+#include "Frame.h"
+#include <gtest/gtest.h>
+
+namespace
+{
+using namespace Hexit;
+
+Frame::Line plain_line(std::uint8_t first)
+{
+    Frame::Line line;
+    for (std::uint32_t i = 0; i < BYTES_PER_LINE; ++i)
+        line[i] = { static_cast<std::uint8_t>(first + i), Frame::Style::PLAIN };
+    return line;
+}
+
+TEST(FrameTest, ChangedCells)
+{
+    Frame frame;
+    frame.resize(3);
+    Frame::Line line = plain_line(0);
+    // Nothing was drawn yet.
+    EXPECT_EQ(frame.update(1, 16, line), Frame::ALL_CELLS);
+    EXPECT_EQ(frame.update(1, 16, line), 0u);
+
+    line[3].m_byte  = 0xFF;
+    line[5].m_style = Frame::Style::DIRTY;
+    EXPECT_EQ(frame.update(1, 16, line), 0b101000u);
+    line[5].m_style = Frame::Style::CURSOR_HIGH;
+    EXPECT_EQ(frame.update(1, 16, line), 0b100000u);
+    line[5].m_style = Frame::Style::CURSOR_LOW;
+    EXPECT_EQ(frame.update(1, 16, line), 0b100000u);
+
+    // The other lines are independent of it.
+    EXPECT_EQ(frame.update(0, 0, line), Frame::ALL_CELLS);
+    EXPECT_EQ(frame.update(1, 16, line), 0u);
+}
+
+// Scrolling moves other bytes onto a line, even if they look the same.
+TEST(FrameTest, Offsets)
+{
+    Frame             frame;
+    const Frame::Line line = plain_line(0);
+    frame.resize(2);
+    EXPECT_EQ(frame.update(0, 0, line), Frame::ALL_CELLS);
+    EXPECT_EQ(frame.update(0, 16, line), Frame::ALL_CELLS);
+    EXPECT_EQ(frame.update(0, 16, line), 0u);
+
+    // Lines that do not exist always get drawn.
+    EXPECT_EQ(frame.update(2, 32, line), Frame::ALL_CELLS);
+    EXPECT_EQ(frame.update(2, 32, line), Frame::ALL_CELLS);
+}
+
+TEST(FrameTest, Invalidate)
+{
+    Frame             frame;
+    const Frame::Line line = plain_line(7);
+    frame.resize(2);
+    frame.update(0, 0, line);
+    frame.update(1, 16, line);
+
+    frame.invalidate();
+    EXPECT_EQ(frame.update(0, 0, line), Frame::ALL_CELLS);
+    EXPECT_EQ(frame.update(1, 16, line), Frame::ALL_CELLS);
+
+    // The same number of lines keeps the cells, another one drops them.
+    frame.resize(2);
+    EXPECT_EQ(frame.update(0, 0, line), 0u);
+    frame.resize(3);
+    EXPECT_EQ(frame.update(0, 0, line), Frame::ALL_CELLS);
+}
+} // namespace
@@ -0,0 +1,190 @@
+#include "GzipHandler.h"
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <random>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include <zlib.h>
+
+namespace
+{
+namespace fs = std::filesystem;
+using namespace Hexit;
+
+constexpr std::uintmax_t SPAN = 64 * 1024;
+
+class GzipHandlerTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        const std::string suffix = std::to_string(::getpid());
+        m_path                   = fs::temp_directory_path() / ("hexit_gzip_test_" + suffix + ".gz");
+        m_index                  = fs::temp_directory_path() / ("hexit_gzip_index_" + suffix);
+        // Compressible, but not so much that the deflate blocks get huge.
+        std::mt19937 rng(3);
+        m_data.resize(3 * 1024 * 1024 + 333);
+        for (std::uintmax_t i = 0; i < m_data.size(); ++i)
+            m_data[i] = static_cast<std::uint8_t>((i / 64) * 3 + rng() % 8);
+    }
+
+    void TearDown() override
+    {
+        fs::remove(m_path);
+        fs::remove_all(m_index);
+    }
+
+    static std::vector<std::uint8_t> compress(const std::uint8_t* data, std::uintmax_t size)
+    {
+        z_stream stream {};
+        EXPECT_EQ(deflateInit2(&stream, 6, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY), Z_OK);
+        std::vector<std::uint8_t> out(deflateBound(&stream, static_cast<uLong>(size)));
+        stream.next_in   = const_cast<Bytef*>(data);
+        stream.avail_in  = static_cast<uInt>(size);
+        stream.next_out  = out.data();
+        stream.avail_out = static_cast<uInt>(out.size());
+        EXPECT_EQ(deflate(&stream, Z_FINISH), Z_STREAM_END);
+        out.resize(stream.total_out);
+        deflateEnd(&stream);
+        return out;
+    }
+
+    void write_file(const std::vector<std::uint8_t>& contents) const
+    {
+        std::ofstream file(m_path, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(contents.data()), static_cast<std::streamsize>(contents.size()));
+    }
+
+    static void finish(GzipHandler& handler)
+    {
+        for (int i = 0; i < 10000 && handler.is_streaming(); ++i)
+        {
+            handler.refresh();
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    void expect_reads(GzipHandler& handler, std::uintmax_t size) const
+    {
+        ASSERT_EQ(handler.size(), size);
+        std::vector<std::uint8_t> read(8192);
+        // Sequential chunks carry on with the stream, random ones restart at the checkpoints.
+        for (std::uintmax_t offset = 0; offset < size; offset += read.size())
+        {
+            const std::uintmax_t count = std::min<std::uintmax_t>(read.size(), size - offset);
+            ASSERT_TRUE(handler.read_at(offset, read.data(), count)) << offset;
+            ASSERT_TRUE(std::equal(read.begin(), read.begin() + static_cast<std::ptrdiff_t>(count), m_data.begin() + static_cast<std::ptrdiff_t>(offset))) << offset;
+        }
+
+        std::mt19937_64 rng(11);
+        for (int i = 0; i < 200; ++i)
+        {
+            const std::uintmax_t offset = rng() % size;
+            const std::uintmax_t count  = std::min<std::uintmax_t>(1 + rng() % read.size(), size - offset);
+            ASSERT_TRUE(handler.read_at(offset, read.data(), count)) << offset;
+            ASSERT_TRUE(std::equal(read.begin(), read.begin() + static_cast<std::ptrdiff_t>(count), m_data.begin() + static_cast<std::ptrdiff_t>(offset))) << offset;
+        }
+
+        EXPECT_FALSE(handler.read_at(size - 1, read.data(), 2));
+    }
+
+    fs::path                  m_path;
+    fs::path                  m_index;
+    std::vector<std::uint8_t> m_data;
+};
+
+TEST_F(GzipHandlerTest, NotCompressed)
+{
+    write_file(m_data);
+    GzipHandler handler(m_index, SPAN);
+    EXPECT_FALSE(handler.open(m_path));
+    EXPECT_FALSE(handler.open(m_path.string() + "_does_not_exist"));
+}
+
+TEST_F(GzipHandlerTest, RandomAccess)
+{
+    write_file(compress(m_data.data(), m_data.size()));
+    GzipHandler handler(m_index, SPAN);
+    ASSERT_TRUE(handler.open(m_path));
+    EXPECT_TRUE(handler.read_only());
+    EXPECT_FALSE(handler.is_index_cached());
+    EXPECT_GT(handler.size(), 0u);
+    finish(handler);
+    EXPECT_FALSE(handler.is_streaming());
+    EXPECT_GT(handler.checkpoints(), 10u);
+    expect_reads(handler, m_data.size());
+    EXPECT_FALSE(handler.write_at(0, m_data.data(), 1));
+}
+
+// Concatenated members make up a single stream, as with gzip -d.
+TEST_F(GzipHandlerTest, Members)
+{
+    const std::uintmax_t      half     = m_data.size() / 2 + 17;
+    std::vector<std::uint8_t> contents = compress(m_data.data(), half);
+    const auto                second   = compress(m_data.data() + half, m_data.size() - half);
+    contents.insert(contents.end(), second.begin(), second.end());
+    write_file(contents);
+
+    GzipHandler handler(m_index, SPAN);
+    ASSERT_TRUE(handler.open(m_path));
+    finish(handler);
+    // Resuming at a checkpoint of the first member has to skip its trailer to get into the second one.
+    std::vector<std::uint8_t> read(200);
+    ASSERT_TRUE(handler.read_at(half - 100, read.data(), read.size()));
+    EXPECT_TRUE(std::equal(read.begin(), read.end(), m_data.begin() + static_cast<std::ptrdiff_t>(half - 100)));
+    expect_reads(handler, m_data.size());
+}
+
+TEST_F(GzipHandlerTest, CachedIndex)
+{
+    write_file(compress(m_data.data(), m_data.size()));
+    std::uintmax_t checkpoints = 0;
+    {
+        GzipHandler handler(m_index, SPAN);
+        ASSERT_TRUE(handler.open(m_path));
+        finish(handler);
+        checkpoints = handler.checkpoints();
+        EXPECT_TRUE(fs::exists(handler.index_path(m_path)));
+    }
+
+    // Reopening the file needs no first pass.
+    {
+        GzipHandler handler(m_index, SPAN);
+        ASSERT_TRUE(handler.open(m_path));
+        EXPECT_TRUE(handler.is_index_cached());
+        EXPECT_FALSE(handler.is_streaming());
+        EXPECT_EQ(handler.checkpoints(), checkpoints);
+        expect_reads(handler, m_data.size());
+    }
+
+    // A modified file gets indexed again.
+    fs::last_write_time(m_path, fs::last_write_time(m_path) + std::chrono::seconds(5));
+    {
+        GzipHandler handler(m_index, SPAN);
+        ASSERT_TRUE(handler.open(m_path));
+        EXPECT_FALSE(handler.is_index_cached());
+        finish(handler);
+        expect_reads(handler, m_data.size());
+    }
+}
+
+// A truncated file shows as far as it can be inflated.
+TEST_F(GzipHandlerTest, Truncated)
+{
+    auto contents = compress(m_data.data(), m_data.size());
+    contents.resize(contents.size() / 2);
+    write_file(contents);
+
+    GzipHandler handler(m_index, SPAN);
+    ASSERT_TRUE(handler.open(m_path));
+    finish(handler);
+    EXPECT_FALSE(handler.is_streaming());
+    EXPECT_GT(handler.size(), 0u);
+    EXPECT_LT(handler.size(), m_data.size());
+    expect_reads(handler, handler.size());
+    EXPECT_FALSE(fs::exists(handler.index_path(m_path)));
+}
+} // namespace
@@ -0,0 +1,166 @@
+#include "HitIndex.h"
+#include "MemoryReader.h"
+#include <chrono>
+#include <cstring>
+#include <gtest/gtest.h>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace
+{
+using namespace Hexit;
+
+class HitIndexTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        std::mt19937 rng(7);
+        m_data.resize(3 * SEARCH_BLOCK_SIZE + 777);
+        for (auto& byte : m_data)
+            byte = static_cast<std::uint8_t>(rng() % 16);
+    }
+
+    std::vector<std::uintmax_t> expected_hits(const std::vector<std::uint8_t>& pattern) const
+    {
+        std::vector<std::uintmax_t> hits;
+        for (std::uintmax_t i = 0; i + pattern.size() <= m_data.size(); ++i)
+        {
+            if (std::equal(pattern.begin(), pattern.end(), m_data.begin() + static_cast<std::ptrdiff_t>(i)))
+                hits.push_back(i);
+        }
+        return hits;
+    }
+
+    static void finish(HitIndex& index)
+    {
+        for (int i = 0; i < 10000 && index.is_running(); ++i)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    static void expect_hits(const HitIndex& index, const std::vector<std::uintmax_t>& hits)
+    {
+        ASSERT_EQ(index.count(), hits.size());
+        std::uintmax_t offset = 0;
+        for (std::uintmax_t i = 0; i < hits.size(); i += 97)
+        {
+            ASSERT_TRUE(index.at(i, offset));
+            ASSERT_EQ(offset, hits[i]) << i;
+            ASSERT_EQ(index.lower_bound(hits[i]), i);
+            ASSERT_EQ(index.lower_bound(hits[i] + 1), i + 1);
+        }
+        EXPECT_FALSE(index.at(hits.size(), offset));
+    }
+
+    std::vector<std::uint8_t> m_data;
+};
+
+TEST_F(HitIndexTest, FindsAllHits)
+{
+    const std::vector<std::uint8_t> pattern = { 0x01, 0x02, 0x03 };
+    HitIndex                        index(memory_reader(m_data), 4);
+    EXPECT_FALSE(index.is_active());
+    index.start(Searcher::Pattern(pattern), m_data.size());
+    EXPECT_TRUE(index.is_active());
+    finish(index);
+    EXPECT_TRUE(index.is_complete());
+    EXPECT_FALSE(index.failed());
+    EXPECT_FALSE(index.is_full());
+
+    const auto hits = expected_hits(pattern);
+    ASSERT_GT(hits.size(), 1000u);
+    expect_hits(index, hits);
+    EXPECT_EQ(index.lower_bound(m_data.size()), hits.size());
+    // The gaps between the hits take a byte or two each.
+    EXPECT_LT(index.memory(), hits.size() * 3);
+}
+
+// Hits far apart need several bytes for their distance, hits next to each other overlap.
+TEST_F(HitIndexTest, Distances)
+{
+    std::fill(m_data.begin(), m_data.end(), std::uint8_t { 0 });
+    std::vector<std::uintmax_t> hits;
+    for (std::uintmax_t offset = 5, gap = 1; offset < m_data.size(); offset += gap, gap = gap * 3 % 2000003)
+        hits.push_back(offset);
+    for (const auto offset : hits)
+        m_data[offset] = 0xAA;
+
+    HitIndex index(memory_reader(m_data), 3);
+    index.start(Searcher::Pattern({ 0xAA }), m_data.size());
+    finish(index);
+    expect_hits(index, hits);
+    for (std::uintmax_t i = 0; i < hits.size(); ++i)
+    {
+        std::uintmax_t offset = 0;
+        ASSERT_TRUE(index.at(i, offset));
+        ASSERT_EQ(offset, hits[i]);
+    }
+}
+
+TEST_F(HitIndexTest, Mask)
+{
+    std::fill(m_data.begin(), m_data.end(), std::uint8_t { 0 });
+    for (const std::uintmax_t offset : { 10u, 13u, 60u, 100u })
+        std::memcpy(m_data.data() + offset, "\x01\x02\x03", 3);
+
+    HitIndex index(memory_reader(m_data), 2);
+    index.start(Searcher::Pattern({ 0x01, 0x02, 0x03 }), m_data.size());
+    finish(index);
+    ASSERT_EQ(index.count(), 4u);
+    EXPECT_EQ(index.mask(0, 16), 0b1111110000000000u);
+    EXPECT_EQ(index.mask(8, 8), 0b11111100u);
+    // Hits that start before the range.
+    EXPECT_EQ(index.mask(61, 16), 0b11u);
+    EXPECT_EQ(index.mask(48, 64), (std::uint64_t { 0b111 } << 12) | (std::uint64_t { 0b111 } << 52));
+    EXPECT_EQ(index.mask(200, 64), 0u);
+}
+
+// Changing the bytes from some offset on keeps the hits before it, and finds the ones after it again.
+TEST_F(HitIndexTest, Invalidate)
+{
+    const std::vector<std::uint8_t> pattern = { 0x05, 0x06 };
+    HitIndex                        index(memory_reader(m_data), 4);
+    index.start(Searcher::Pattern(pattern), m_data.size());
+    finish(index);
+    expect_hits(index, expected_hits(pattern));
+
+    for (const std::uintmax_t byte_id : { 2 * SEARCH_BLOCK_SIZE + 3, SEARCH_BLOCK_SIZE - 1, std::uintmax_t { 0 } })
+    {
+        index.invalidate(byte_id);
+        EXPECT_LE(index.scanned(), byte_id);
+        EXPECT_FALSE(index.is_complete());
+        // Erasing a byte moves the ones after it and can create a new hit.
+        m_data.erase(m_data.begin() + static_cast<std::ptrdiff_t>(byte_id));
+        m_data[byte_id]     = 0x05;
+        m_data[byte_id + 1] = 0x06;
+        index.resume(m_data.size());
+        finish(index);
+        EXPECT_TRUE(index.is_complete());
+        expect_hits(index, expected_hits(pattern));
+    }
+
+    // Bytes that get appended.
+    index.invalidate(m_data.size());
+    m_data.insert(m_data.end(), { 0x05, 0x06 });
+    index.resume(m_data.size());
+    finish(index);
+    expect_hits(index, expected_hits(pattern));
+
+    index.clear();
+    EXPECT_FALSE(index.is_active());
+    EXPECT_EQ(index.count(), 0u);
+}
+
+TEST_F(HitIndexTest, ReaderFailure)
+{
+    HitIndex index([](std::uintmax_t, std::uint8_t*, std::uintmax_t)
+                   { return false; },
+                   2);
+    index.start(Searcher::Pattern({ 0x01 }), m_data.size());
+    finish(index);
+    EXPECT_TRUE(index.failed());
+    EXPECT_FALSE(index.is_complete());
+    EXPECT_EQ(index.count(), 0u);
+}
+} // namespace
@@ -2,11 +2,14 @@
 
 IOHandlerMock::IOHandlerMock(bool read_only)
     : IOHandler(read_only)
-    , m_id(0u)
+    , m_offset(0u)
     , m_load_count(0u)
+    , m_write_count(0u)
     , m_io_fail(false)
+    , m_hold(false)
 {
-    m_size = chunk_count * Hexit::ChunkCache::capacity;
+    m_size = chunk_count * Hexit::CHUNK_SIZE;
+    m_data.resize(m_size);
     randomize();
 }
 
@@ -24,13 +27,12 @@ bool IOHandlerMock::read(std::uint8_t* o_buffer, std::uintmax_t buffer_size)
 {
     if (!o_buffer
         || buffer_size == 0
-        || buffer_size > Hexit::ChunkCache::capacity
-        || m_id >= chunk_count)
+        || (m_offset + buffer_size) > m_size)
         return false;
 
-    std::memcpy(o_buffer, m_data[m_id], buffer_size);
+    std::memcpy(o_buffer, m_data.data() + m_offset, buffer_size);
     m_load_count++;
-    m_id++;
+    m_offset += buffer_size;
     return !m_io_fail;
 }
 
@@ -38,25 +40,42 @@ bool IOHandlerMock::write(const std::uint8_t* i_buffer, std::uintmax_t buffer_si
 {
     if (!i_buffer
         || buffer_size == 0
-        || buffer_size > Hexit::ChunkCache::capacity
-        || m_id >= chunk_count)
+        || (m_offset + buffer_size) > m_size)
         return false;
 
-    std::memcpy(m_data[m_id], i_buffer, buffer_size);
+    {
+        std::unique_lock<std::mutex> lock(m_hold_lock);
+        m_release.wait(lock, [this]
+                       { return !m_hold; });
+    }
+    std::memcpy(m_data.data() + m_offset, i_buffer, buffer_size);
+    m_write_count++;
+    m_offset += buffer_size;
     return !m_io_fail;
 }
 
 bool IOHandlerMock::seek(std::uintmax_t offset)
 {
-    m_id = offset / Hexit::ChunkCache::capacity;
+    m_offset = offset;
     return !m_io_fail;
 }
 
-std::uint8_t* IOHandlerMock::data() { return reinterpret_cast<std::uint8_t*>(m_data); }
+std::uint8_t* IOHandlerMock::data() { return m_data.data(); }
 
 std::uintmax_t IOHandlerMock::load_count() const { return m_load_count; }
 
+std::uintmax_t IOHandlerMock::write_count() const { return m_write_count; }
+
 void IOHandlerMock::mock_io_fail(bool should_fail)
 {
     m_io_fail = should_fail;
 }
+
+void IOHandlerMock::hold_writes(bool hold)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_hold_lock);
+        m_hold = hold;
+    }
+    m_release.notify_all();
+}
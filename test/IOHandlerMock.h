@@ -3,8 +3,11 @@
 
 #include "ChunkCache.h"
 #include "IOHandler.h"
+#include <condition_variable>
 #include <cstdlib>
 #include <cstring>
+#include <mutex>
+#include <vector>
 
 namespace fs = std::filesystem;
 
@@ -31,8 +34,13 @@ public:
 
     std::uintmax_t load_count() const;
 
+    std::uintmax_t write_count() const;
+
     void mock_io_fail(bool should_fail);
 
+    // Writes block while held, to catch a background save in the middle of it.
+    void hold_writes(bool hold);
+
 private:
     inline void randomize()
     {
@@ -42,9 +50,13 @@ private:
             bytes[i] = static_cast<std::uint8_t>(rand() % 256);
     }
 
-    std::uint8_t  m_data[chunk_count][Hexit::ChunkCache::capacity];
-    std::uintmax_t m_id;
-    std::uintmax_t m_load_count;
-    bool          m_io_fail;
+    std::vector<std::uint8_t> m_data;
+    std::uintmax_t            m_offset;
+    std::uintmax_t            m_load_count;
+    std::uintmax_t            m_write_count;
+    bool                      m_io_fail;
+    bool                      m_hold;
+    std::mutex                m_hold_lock;
+    std::condition_variable   m_release;
 };
 #endif // IOHANDLER_MOCK_H
@@ -0,0 +1,173 @@
+#include "MagicDatabase.h"
+#include "MemoryReader.h"
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+namespace
+{
+using namespace Hexit;
+using namespace std::string_literals;
+
+class MagicDatabaseTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        const std::string suffix = std::to_string(::getpid());
+        m_path                   = fs::temp_directory_path() / ("hexit_magic_test_" + suffix);
+        m_cache                  = fs::temp_directory_path() / ("hexit_magic_cache_" + suffix);
+        m_data.assign(0x9000, 0x00);
+    }
+
+    void TearDown() override
+    {
+        fs::remove(m_path);
+        fs::remove_all(m_cache);
+    }
+
+    void write(const std::string& text)
+    {
+        std::ofstream(m_path, std::ios::binary) << text;
+    }
+
+    void embed(std::uintmax_t offset, const std::string& bytes)
+    {
+        std::memcpy(m_data.data() + offset, bytes.data(), bytes.size());
+    }
+
+    // Records the ranges that get read.
+    Searcher::Reader reader()
+    {
+        return [this, read = memory_reader(m_data)](std::uintmax_t offset, std::uint8_t* data, std::uintmax_t count)
+        {
+            m_reads.emplace_back(offset, count);
+            return read(offset, data, count);
+        };
+    }
+
+    fs::path                                               m_path;
+    fs::path                                               m_cache;
+    std::vector<std::uint8_t>                              m_data;
+    std::vector<std::pair<std::uintmax_t, std::uintmax_t>> m_reads;
+};
+
+constexpr const char* DATABASE = "# offset priority type bytes\n"
+                                 "257 50 tar 75 73 74 61 72\n"
+                                 "\n"
+                                 "0x8001 50 iso 43 44 30 30 31\n"
+                                 "0 10 zip 50 4B 03 04\n"
+                                 "0 20 docx 50 4B 03 04 ?? ?? 06 00\n"
+                                 "0 20 jar 50 4B 03 04 ?? ?? 08 00\n"
+                                 "0 5 text ?? ?? ?? ?? ?? ?? ?? ?? 0A\n"
+                                 "0 10 nibble ?F 00 FF\r\n";
+
+TEST_F(MagicDatabaseTest, Offsets)
+{
+    write(DATABASE);
+    MagicDatabase database(m_cache);
+    ASSERT_TRUE(database.load(m_path)) << database.error();
+    EXPECT_EQ(database.size(), 7u);
+    EXPECT_FALSE(database.is_cached());
+
+    EXPECT_EQ(database.get_type(reader(), m_data.size()), "");
+    // The bytes at each offset are read once, as many as the longest signature there takes.
+    const std::vector<std::pair<std::uintmax_t, std::uintmax_t>> reads = { { 0, 9 }, { 257, 5 }, { 0x8001, 5 } };
+    EXPECT_EQ(m_reads, reads);
+
+    embed(257, "ustar");
+    EXPECT_EQ(database.get_type(reader(), m_data.size()), "tar");
+    embed(0x8001, "CD001");
+    EXPECT_EQ(database.get_type(reader(), m_data.size()), "tar");
+
+    // Offsets past the end do not get read.
+    m_reads.clear();
+    EXPECT_EQ(database.get_type(reader(), 0x100), "");
+    EXPECT_EQ(m_reads.size(), 1u);
+    EXPECT_EQ(database.get_type(reader(), 259), "");
+}
+
+TEST_F(MagicDatabaseTest, Priority)
+{
+    write(DATABASE);
+    MagicDatabase database(m_cache);
+    ASSERT_TRUE(database.load(m_path)) << database.error();
+
+    embed(0, "PK\x03\x04");
+    EXPECT_EQ(database.get_type(reader(), m_data.size()), "zip");
+    m_data[6] = 0x06;
+    EXPECT_EQ(database.get_type(reader(), m_data.size()), "docx");
+    m_data[6] = 0x08;
+    EXPECT_EQ(database.get_type(reader(), m_data.size()), "jar");
+    // A higher priority wins, whatever the offset.
+    embed(257, "ustar");
+    EXPECT_EQ(database.get_type(reader(), m_data.size()), "tar");
+    embed(257, "-----");
+
+    // Wildcards in the first byte.
+    embed(0, "\x3F\x00\xFF"s);
+    EXPECT_EQ(database.get_type(reader(), m_data.size()), "nibble");
+    embed(0, "\x30\x00\xFF"s);
+    EXPECT_EQ(database.get_type(reader(), m_data.size()), "");
+    m_data[8] = 0x0A;
+    EXPECT_EQ(database.get_type(reader(), m_data.size()), "text");
+    embed(0, "\x4F\x00\xFF"s);
+    EXPECT_EQ(database.get_type(reader(), m_data.size()), "nibble");
+}
+
+// The compiled signatures get cached until the file changes.
+TEST_F(MagicDatabaseTest, Cache)
+{
+    write(DATABASE);
+    {
+        MagicDatabase database(m_cache);
+        ASSERT_TRUE(database.load(m_path));
+        EXPECT_FALSE(database.is_cached());
+        EXPECT_TRUE(fs::exists(database.cache_path(m_path)));
+    }
+
+    embed(0, "PK\x03\x04\x00\x00\x06\x00"s);
+    MagicDatabase database(m_cache);
+    ASSERT_TRUE(database.load(m_path));
+    EXPECT_TRUE(database.is_cached());
+    EXPECT_EQ(database.size(), 7u);
+    EXPECT_EQ(database.get_type(reader(), m_data.size()), "docx");
+
+    write("0 1 pk 50 4B\n");
+    fs::last_write_time(m_path, fs::last_write_time(m_path) + std::chrono::seconds(1));
+    ASSERT_TRUE(database.load(m_path));
+    EXPECT_FALSE(database.is_cached());
+    EXPECT_EQ(database.size(), 1u);
+    EXPECT_EQ(database.get_type(reader(), m_data.size()), "pk");
+
+    // A corrupt cache gets compiled again.
+    std::ofstream(database.cache_path(m_path), std::ios::binary) << "HXMAGIC1 and some garbage";
+    ASSERT_TRUE(database.load(m_path));
+    EXPECT_FALSE(database.is_cached());
+    EXPECT_EQ(database.get_type(reader(), m_data.size()), "pk");
+
+    // Without a cache directory.
+    MagicDatabase uncached { fs::path() };
+    ASSERT_TRUE(uncached.load(m_path));
+    EXPECT_FALSE(uncached.is_cached());
+}
+
+TEST_F(MagicDatabaseTest, Errors)
+{
+    MagicDatabase database(m_cache);
+    EXPECT_FALSE(database.load(m_path));
+    EXPECT_FALSE(database.error().empty());
+
+    for (const char* text : { "0 1 zip 50 4B\n12 zip 50 4B\n", "0 1 zip 50 4B\n0 1 zip 50 4\n", "0 1 zip 50 4B\n0 1 zip\n", "0 1 zip 50 4B\n0x 1 zip 50\n" })
+    {
+        write(text);
+        EXPECT_FALSE(database.load(m_path)) << text;
+        EXPECT_EQ(database.error(), "Invalid signature on line 2") << text;
+        EXPECT_EQ(database.size(), 0u);
+    }
+}
+} // namespace
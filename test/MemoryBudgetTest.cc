@@ -0,0 +1,108 @@
+#include "MemoryBudget.h"
+#include "config.h"
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <string>
+#include <unistd.h>
+
+namespace
+{
+namespace fs = std::filesystem;
+using namespace Hexit;
+
+constexpr std::uintmax_t MIB = 1024 * 1024;
+
+// Lays out fake /proc and /sys/fs/cgroup trees.
+class MemoryBudgetTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        m_root = fs::temp_directory_path() / ("hexit_budget_test_" + std::to_string(::getpid()));
+        fs::create_directories(proc() / "self");
+        fs::create_directories(cgroup());
+    }
+
+    void TearDown() override { fs::remove_all(m_root); }
+
+    fs::path proc() const { return m_root / "proc"; }
+
+    fs::path cgroup() const { return m_root / "cgroup"; }
+
+    static void write(const fs::path& path, const std::string& contents)
+    {
+        fs::create_directories(path.parent_path());
+        std::ofstream(path) << contents;
+    }
+
+    void write_meminfo(std::uintmax_t available)
+    {
+        write(proc() / "meminfo",
+              "MemTotal:       16000000 kB\n"
+              "MemFree:          100000 kB\n"
+              "MemAvailable:   "
+                  + std::to_string(available / 1024) + " kB\n");
+    }
+
+    fs::path m_root;
+};
+
+TEST_F(MemoryBudgetTest, ExplicitLimit)
+{
+    write_meminfo(1024 * MIB);
+    MemoryBudget budget(32 * MIB, proc(), cgroup());
+    EXPECT_EQ(budget.limit(), 32 * MIB);
+    EXPECT_EQ(budget.available(), 1024 * MIB);
+    EXPECT_FALSE(budget.under_pressure());
+    write_meminfo(16 * MIB);
+    EXPECT_TRUE(budget.under_pressure());
+}
+
+TEST_F(MemoryBudgetTest, MemAvailable)
+{
+    write_meminfo(1024 * MIB);
+    write(proc() / "self" / "cgroup", "0::/\n");
+    MemoryBudget budget(0, proc(), cgroup());
+    EXPECT_EQ(budget.limit(), 1024 * MIB / MEMORY_BUDGET_SHARE);
+}
+
+TEST_F(MemoryBudgetTest, Unknown)
+{
+    MemoryBudget budget(0, proc(), cgroup());
+    EXPECT_EQ(budget.available(), UINTMAX_MAX);
+    EXPECT_EQ(budget.limit(), DEFAULT_MEMORY_BUDGET);
+    EXPECT_FALSE(budget.under_pressure());
+}
+
+TEST_F(MemoryBudgetTest, UnifiedHierarchy)
+{
+    write_meminfo(1024 * MIB);
+    write(proc() / "self" / "cgroup", "0::/user.slice/hexit.scope\n");
+    write(cgroup() / "user.slice" / "hexit.scope" / "memory.max", std::to_string(100 * MIB) + "\n");
+    write(cgroup() / "user.slice" / "hexit.scope" / "memory.current", std::to_string(60 * MIB) + "\n");
+    MemoryBudget budget(0, proc(), cgroup());
+    EXPECT_EQ(budget.available(), 40 * MIB);
+    EXPECT_EQ(budget.limit(), 40 * MIB / MEMORY_BUDGET_SHARE);
+
+    // Without a limit the available memory is all that counts.
+    write(cgroup() / "user.slice" / "hexit.scope" / "memory.max", "max\n");
+    EXPECT_EQ(budget.available(), 1024 * MIB);
+}
+
+TEST_F(MemoryBudgetTest, LegacyHierarchy)
+{
+    write_meminfo(1024 * MIB);
+    write(proc() / "self" / "cgroup", "5:cpu,cpuacct:/\n4:memory:/docker/abcdef\n0::/\n");
+    // Inside a cgroup namespace only the root of the hierarchy is visible.
+    write(cgroup() / "memory" / "memory.limit_in_bytes", std::to_string(512 * MIB) + "\n");
+    write(cgroup() / "memory" / "memory.usage_in_bytes", std::to_string(128 * MIB) + "\n");
+    MemoryBudget budget(0, proc(), cgroup());
+    EXPECT_EQ(budget.available(), 384 * MIB);
+
+    write(cgroup() / "memory" / "docker" / "abcdef" / "memory.limit_in_bytes", std::to_string(256 * MIB) + "\n");
+    write(cgroup() / "memory" / "docker" / "abcdef" / "memory.usage_in_bytes", std::to_string(300 * MIB) + "\n");
+    EXPECT_EQ(budget.available(), 0u);
+    EXPECT_TRUE(budget.under_pressure());
+}
+} // namespace
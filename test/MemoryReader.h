@@ -0,0 +1,19 @@
+#ifndef MEMORY_READER_H
+#define MEMORY_READER_H
+
+#include "Searcher.h"
+#include <cstring>
+#include <vector>
+
+// A reader over the bytes of data, failing past their end. It refers to data, later changes to it get read.
+inline Hexit::Searcher::Reader memory_reader(const std::vector<std::uint8_t>& data)
+{
+    return [&data](std::uintmax_t offset, std::uint8_t* o_data, std::uintmax_t count)
+    {
+        if (offset > data.size() || count > data.size() - offset)
+            return false;
+        std::memcpy(o_data, data.data() + offset, count);
+        return true;
+    };
+}
+#endif // MEMORY_READER_H
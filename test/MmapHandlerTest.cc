@@ -0,0 +1,123 @@
+#include "ByteBuffer.h"
+#include "MmapHandler.h"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <unistd.h>
+#include <vector>
+
+namespace
+{
+namespace fs = std::filesystem;
+using namespace Hexit;
+
+class MmapHandlerTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        m_path = fs::temp_directory_path() / ("hexit_mmap_test_" + std::to_string(::getpid()));
+        m_data.resize(10 * CHUNK_SIZE + 123);
+        for (std::uintmax_t i = 0; i < m_data.size(); ++i)
+            m_data[i] = static_cast<std::uint8_t>(i * 7);
+
+        std::ofstream file(m_path, std::ios::binary);
+        file.write(reinterpret_cast<const char*>(m_data.data()), static_cast<std::streamsize>(m_data.size()));
+    }
+
+    void TearDown() override { fs::remove(m_path); }
+
+    std::vector<std::uint8_t> file_contents() const
+    {
+        std::ifstream             file(m_path, std::ios::binary);
+        std::vector<std::uint8_t> contents(fs::file_size(m_path));
+        file.read(reinterpret_cast<char*>(contents.data()), static_cast<std::streamsize>(contents.size()));
+        return contents;
+    }
+
+    fs::path                  m_path;
+    std::vector<std::uint8_t> m_data;
+};
+
+// Files that cannot be mapped should be rejected so that the caller can fall back to FileHandler.
+TEST_F(MmapHandlerTest, OpenErrors)
+{
+    MmapHandler handler;
+    EXPECT_FALSE(handler.open(m_path.string() + "_does_not_exist"));
+    EXPECT_FALSE(handler.open(fs::temp_directory_path()));
+    EXPECT_EQ(handler.mapping(), nullptr);
+
+    const fs::path empty = m_path.string() + "_empty";
+    std::ofstream(empty).close();
+    EXPECT_FALSE(handler.open(empty));
+    fs::remove(empty);
+}
+
+TEST_F(MmapHandlerTest, ReadWrite)
+{
+    MmapHandler handler;
+    ASSERT_TRUE(handler.open(m_path));
+    ASSERT_NE(handler.mapping(), nullptr);
+    EXPECT_EQ(handler.size(), m_data.size());
+    EXPECT_EQ(std::memcmp(handler.mapping(), m_data.data(), m_data.size()), 0);
+
+    std::uint8_t buffer[16];
+    ASSERT_TRUE(handler.seek(100));
+    ASSERT_TRUE(handler.read(buffer, sizeof(buffer)));
+    EXPECT_EQ(std::memcmp(buffer, m_data.data() + 100, sizeof(buffer)), 0);
+    EXPECT_FALSE(handler.seek(m_data.size()));
+
+    std::memset(buffer, 0xEF, sizeof(buffer));
+    ASSERT_TRUE(handler.seek(m_data.size() - sizeof(buffer)));
+    ASSERT_TRUE(handler.write(buffer, sizeof(buffer)));
+    handler.close();
+
+    std::memset(m_data.data() + m_data.size() - sizeof(buffer), 0xEF, sizeof(buffer));
+    EXPECT_EQ(file_contents(), m_data);
+}
+
+// The chunks of a mapped file should point into the mapping and changes should only
+// reach the file once they get saved.
+TEST_F(MmapHandlerTest, ZeroCopyChunks)
+{
+    MmapHandler handler;
+    ASSERT_TRUE(handler.open(m_path));
+    {
+        ChunkCache cache(handler, { .m_slots = 2, .m_read_ahead = 4 });
+        for (std::uintmax_t i = 0; i < cache.total_chunks(); ++i)
+        {
+            ASSERT_TRUE(cache.load_chunk(i));
+            EXPECT_EQ(cache.recent().m_data, handler.mapping() + i * CHUNK_SIZE);
+            EXPECT_TRUE(cache.recent().m_storage.empty());
+        }
+        EXPECT_EQ(cache.recent().m_count, 123u);
+    }
+
+    ByteBuffer buffer(handler);
+    for (std::uintmax_t i = 0; i < m_data.size(); ++i)
+        ASSERT_EQ(buffer[i], m_data[i]);
+
+    const std::uintmax_t byte_id = 3 * CHUNK_SIZE + 5;
+    buffer.set_byte(byte_id, static_cast<std::uint8_t>(m_data[byte_id] + 1));
+    EXPECT_EQ(buffer[byte_id], static_cast<std::uint8_t>(m_data[byte_id] + 1));
+    EXPECT_EQ(file_contents(), m_data);
+
+    buffer.save();
+    EXPECT_TRUE(buffer.is_ok());
+    m_data[byte_id]++;
+    EXPECT_EQ(file_contents(), m_data);
+}
+
+// Read only handlers should never modify the file.
+TEST_F(MmapHandlerTest, ReadOnly)
+{
+    MmapHandler handler(true);
+    ASSERT_TRUE(handler.open(m_path));
+    ByteBuffer buffer(handler);
+    buffer.set_byte(0, static_cast<std::uint8_t>(m_data[0] + 1));
+    buffer.save();
+    EXPECT_EQ(buffer[0], static_cast<std::uint8_t>(m_data[0] + 1));
+    EXPECT_EQ(file_contents(), m_data);
+}
+} // namespace
@@ -0,0 +1,150 @@
+#include "OverlayPage.h"
+#include <gtest/gtest.h>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+namespace
+{
+using namespace Hexit;
+
+constexpr std::uintmax_t PAGE_SIZE = 300;
+
+TEST(OverlayPageTest, SetBytes)
+{
+    OverlayPage page(PAGE_SIZE);
+    EXPECT_EQ(page.count(), 0u);
+    EXPECT_FALSE(page.is_dirty(0));
+
+    page.set(0, 0xAA);
+    page.set(63, 0xBB);
+    page.set(64, 0xCC);
+    page.set(64, 0xCD);
+    page.set(PAGE_SIZE - 1, 0xDD);
+    EXPECT_EQ(page.count(), 4u);
+    EXPECT_TRUE(page.is_dirty(63));
+    EXPECT_FALSE(page.is_dirty(62));
+    EXPECT_FALSE(page.is_dense());
+
+    std::uint8_t data[PAGE_SIZE] = {};
+    page.apply(data, PAGE_SIZE);
+    EXPECT_EQ(data[64], 0xCD);
+}
+
+// Once enough bytes are modified the page switches to a bitmap, without losing any of them.
+TEST(OverlayPageTest, Densify)
+{
+    OverlayPage page(PAGE_SIZE);
+    for (std::uintmax_t i = 0; i < PAGE_SIZE; i += 3)
+        page.set(i, static_cast<std::uint8_t>(i));
+    EXPECT_TRUE(page.is_dense());
+    EXPECT_EQ(page.count(), PAGE_SIZE / 3);
+    EXPECT_EQ(page.mask(0, 8), 0b01001001u);
+
+    std::vector<std::uint8_t> data(PAGE_SIZE, 0xFF);
+    page.apply(data.data(), PAGE_SIZE);
+    for (std::uintmax_t i = 0; i < PAGE_SIZE; ++i)
+    {
+        EXPECT_EQ(page.is_dirty(i), i % 3 == 0);
+        EXPECT_EQ(data[i], i % 3 == 0 ? static_cast<std::uint8_t>(i) : 0xFF);
+    }
+}
+
+// Masks may straddle two words of the bitmap.
+TEST(OverlayPageTest, Mask)
+{
+    OverlayPage sparse(PAGE_SIZE);
+    OverlayPage dense(PAGE_SIZE);
+    for (std::uintmax_t i = 100; dense.count() < PAGE_SIZE / 2; ++i)
+        dense.set(i, 1);
+    ASSERT_TRUE(dense.is_dense());
+
+    for (auto* page : { &sparse, &dense })
+    {
+        page->set(60, 1);
+        page->set(66, 1);
+        page->set(PAGE_SIZE - 2, 1);
+        EXPECT_EQ(page->mask(60, 16), 0b1000001u);
+        EXPECT_EQ(page->mask(61, 4), 0u);
+        EXPECT_EQ(page->mask(0, 64), std::uint64_t { 1 } << 60);
+        EXPECT_EQ(page->mask(PAGE_SIZE - 16, 16), std::uint64_t { 1 } << 14);
+    }
+}
+
+TEST(OverlayPageTest, Apply)
+{
+    OverlayPage page(PAGE_SIZE);
+    for (std::uintmax_t i = 64; i < 128; ++i)
+        page.set(i, 0xFF);
+    page.set(5, 0xEE);
+    page.set(PAGE_SIZE - 1, 0xDD);
+
+    std::vector<std::uint8_t> data(PAGE_SIZE);
+    std::iota(data.begin(), data.end(), 0);
+    std::vector<std::uint8_t> expectation = data;
+    for (std::uintmax_t i = 64; i < 128; ++i)
+        expectation[i] = 0xFF;
+    expectation[5] = 0xEE;
+
+    // Bytes past the end of the data are left alone.
+    page.apply(data.data(), PAGE_SIZE - 1);
+    EXPECT_EQ(data, expectation);
+    page.apply(data.data(), PAGE_SIZE);
+    expectation[PAGE_SIZE - 1] = 0xDD;
+    EXPECT_EQ(data, expectation);
+}
+
+// A part of the page applies to data that starts at its first byte.
+TEST(OverlayPageTest, ApplyRange)
+{
+    OverlayPage sparse(PAGE_SIZE);
+    OverlayPage dense(PAGE_SIZE);
+    for (std::uintmax_t i = 0; dense.count() < PAGE_SIZE / 2; i += 2)
+        dense.set(i, 0xAA);
+    ASSERT_TRUE(dense.is_dense());
+    for (std::uintmax_t i : { 3u, 61u, 64u, 70u })
+        sparse.set(i, 0xAA);
+
+    for (auto* page : { &sparse, &dense })
+    {
+        for (std::uintmax_t first : { 0u, 3u, 60u, 63u, 65u })
+        {
+            for (std::uintmax_t count : { 1u, 5u, 70u, 200u })
+            {
+                std::vector<std::uint8_t> data(count, 0x00);
+                page->apply(data.data(), first, count);
+                for (std::uintmax_t i = 0; i < count; ++i)
+                    ASSERT_EQ(data[i], page->is_dirty(first + i) ? 0xAA : 0x00) << first << " " << i;
+            }
+        }
+    }
+}
+
+TEST(OverlayPageTest, Runs)
+{
+    OverlayPage sparse(PAGE_SIZE);
+    OverlayPage dense(PAGE_SIZE);
+    for (std::uintmax_t i = 100; dense.count() < PAGE_SIZE / 2; ++i)
+        dense.set(i, 1);
+    ASSERT_TRUE(dense.is_dense());
+
+    for (auto* page : { &sparse, &dense })
+    {
+        for (std::uintmax_t i : { 0u, 1u, 2u, 64u, 299u })
+            page->set(i, static_cast<std::uint8_t>(i));
+
+        std::vector<std::pair<std::uintmax_t, std::uintmax_t>> runs;
+        page->for_each_run(
+            [&](std::uintmax_t offset, std::uint8_t* data, std::uintmax_t length)
+            {
+                EXPECT_EQ(data[0], offset == 100 ? 1u : static_cast<std::uint8_t>(offset));
+                runs.emplace_back(offset, length);
+            });
+
+        if (page == &sparse)
+            EXPECT_EQ(runs, (std::vector<std::pair<std::uintmax_t, std::uintmax_t>> { { 0, 3 }, { 64, 1 }, { 299, 1 } }));
+        else
+            EXPECT_EQ(runs, (std::vector<std::pair<std::uintmax_t, std::uintmax_t>> { { 0, 3 }, { 64, 1 }, { 100, PAGE_SIZE / 2 }, { 299, 1 } }));
+    }
+}
+} // namespace
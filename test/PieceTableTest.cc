@@ -0,0 +1,163 @@
+#include "PieceTable.h"
+#include <gtest/gtest.h>
+#include <random>
+#include <vector>
+
+namespace
+{
+using namespace Hexit;
+
+// Expands the table into the source offsets of its bytes, ADD offsets are tagged with the top bit.
+std::vector<std::uintmax_t> expand(const PieceTable& table)
+{
+    constexpr std::uintmax_t  ADD_TAG = std::uintmax_t { 1 } << 63;
+    std::vector<std::uintmax_t> bytes;
+    table.for_each(
+        [&](const PieceTable::Piece& piece)
+        {
+            for (std::uintmax_t i = 0; i < piece.m_length; ++i)
+                bytes.push_back((piece.m_source == PieceTable::Source::ADD ? ADD_TAG : 0) | (piece.m_offset + i));
+            return true;
+        });
+    return bytes;
+}
+
+TEST(PieceTableTest, Original)
+{
+    PieceTable table(1000);
+    EXPECT_TRUE(table.is_original());
+    EXPECT_EQ(table.size(), 1000u);
+    EXPECT_EQ(table.piece_count(), 1u);
+
+    const auto location = table.locate(500);
+    EXPECT_EQ(location.m_start, 0u);
+    EXPECT_EQ(location.m_piece.m_source, PieceTable::Source::ORIGINAL);
+    EXPECT_EQ(location.m_piece.m_length, 1000u);
+
+    PieceTable empty;
+    EXPECT_EQ(empty.size(), 0u);
+    EXPECT_EQ(empty.piece_count(), 0u);
+}
+
+TEST(PieceTableTest, InsertErase)
+{
+    PieceTable table(100);
+    table.insert(40, { PieceTable::Source::ADD, 0, 1 });
+    EXPECT_FALSE(table.is_original());
+    EXPECT_EQ(table.size(), 101u);
+    EXPECT_EQ(table.piece_count(), 3u);
+
+    auto location = table.locate(40);
+    EXPECT_EQ(location.m_piece.m_source, PieceTable::Source::ADD);
+    EXPECT_EQ(location.m_start, 40u);
+    location = table.locate(41);
+    EXPECT_EQ(location.m_piece.m_source, PieceTable::Source::ORIGINAL);
+    EXPECT_EQ(location.m_piece.m_offset, 40u);
+    EXPECT_EQ(location.m_start, 41u);
+
+    // Typing continues the piece of the previous byte instead of adding a new one.
+    table.insert(41, { PieceTable::Source::ADD, 1, 1 });
+    table.insert(42, { PieceTable::Source::ADD, 2, 1 });
+    EXPECT_EQ(table.piece_count(), 3u);
+    EXPECT_EQ(table.locate(42).m_piece.m_length, 3u);
+
+    table.erase(10, 5);
+    EXPECT_EQ(table.size(), 98u);
+    EXPECT_EQ(table.locate(10).m_piece.m_offset, 15u);
+
+    // Erasing past the end gets clamped.
+    table.erase(90, 100);
+    EXPECT_EQ(table.size(), 90u);
+
+    table.reset(100);
+    EXPECT_TRUE(table.is_original());
+    EXPECT_EQ(table.piece_count(), 1u);
+}
+
+// Random edits should leave the table in the same state as a plain vector of the bytes.
+TEST(PieceTableTest, RandomEdits)
+{
+    constexpr std::uintmax_t    ADD_TAG  = std::uintmax_t { 1 } << 63;
+    constexpr std::uintmax_t    ORIGINAL = 5000;
+    PieceTable                  table(ORIGINAL);
+    std::vector<std::uintmax_t> expectation(ORIGINAL);
+    for (std::uintmax_t i = 0; i < ORIGINAL; ++i)
+        expectation[i] = i;
+
+    std::mt19937_64 random(42);
+    std::uintmax_t  added = 0;
+    for (int i = 0; i < 4000; ++i)
+    {
+        const std::uintmax_t position = random() % (expectation.size() + 1);
+        if (random() % 3 != 0 || expectation.empty())
+        {
+            const std::uintmax_t length = 1 + random() % 4;
+            table.insert(position, { PieceTable::Source::ADD, added, length });
+            for (std::uintmax_t j = 0; j < length; ++j)
+                expectation.insert(expectation.begin() + static_cast<std::ptrdiff_t>(position + j), ADD_TAG | (added + j));
+            added += length;
+        }
+        else if (position < expectation.size())
+        {
+            const std::uintmax_t length = std::min<std::uintmax_t>(1 + random() % 8, expectation.size() - position);
+            table.erase(position, length);
+            expectation.erase(expectation.begin() + static_cast<std::ptrdiff_t>(position),
+                              expectation.begin() + static_cast<std::ptrdiff_t>(position + length));
+        }
+        ASSERT_EQ(table.size(), expectation.size());
+    }
+
+    ASSERT_EQ(expand(table), expectation);
+    for (std::uintmax_t i = 0; i < expectation.size(); i += 7)
+    {
+        const auto           location = table.locate(i);
+        const std::uintmax_t offset   = location.m_piece.m_offset + i - location.m_start;
+        const std::uintmax_t tag      = location.m_piece.m_source == PieceTable::Source::ADD ? ADD_TAG : 0;
+        ASSERT_EQ(tag | offset, expectation[i]);
+    }
+}
+
+// Slices are trimmed to the range and keep the index of the pieces, also across splits.
+TEST(PieceTableTest, Slice)
+{
+    PieceTable table(100);
+    table.erase(20, 30);
+    table.insert(20, { PieceTable::Source::FILL, 0, 30, 2 });
+    EXPECT_EQ(table.size(), 100u);
+    table.erase(30, 1);
+    table.insert(30, { PieceTable::Source::ADD, 0, 1 });
+    EXPECT_EQ(table.locate(31).m_piece.m_index, 2u);
+    EXPECT_EQ(table.locate(31).m_piece.m_offset, 11u);
+
+    const auto pieces = table.slice(10, 85);
+    ASSERT_EQ(pieces.size(), 5u);
+    EXPECT_EQ(pieces[0].m_source, PieceTable::Source::ORIGINAL);
+    EXPECT_EQ(pieces[0].m_offset, 10u);
+    EXPECT_EQ(pieces[0].m_length, 10u);
+    EXPECT_EQ(pieces[1].m_source, PieceTable::Source::FILL);
+    EXPECT_EQ(pieces[1].m_length, 10u);
+    EXPECT_EQ(pieces[2].m_source, PieceTable::Source::ADD);
+    EXPECT_EQ(pieces[3].m_index, 2u);
+    EXPECT_EQ(pieces[3].m_offset, 11u);
+    EXPECT_EQ(pieces[3].m_length, 19u);
+    EXPECT_EQ(pieces[4].m_offset, 50u);
+    EXPECT_EQ(pieces[4].m_length, 45u);
+
+    // Pieces of different patterns are not merged.
+    table.insert(100, { PieceTable::Source::FILL, 30, 5, 3 });
+    EXPECT_EQ(table.locate(100).m_piece.m_length, 5u);
+    EXPECT_TRUE(table.slice(200, 5).empty());
+}
+
+// Many edits on a huge file only cost time in the number of pieces.
+TEST(PieceTableTest, LargeFile)
+{
+    constexpr std::uintmax_t SIZE = std::uintmax_t { 64 } << 30;
+    PieceTable               table(SIZE);
+    for (std::uintmax_t i = 0; i < 100000; ++i)
+        table.insert((i * 2654435761u) % SIZE, { PieceTable::Source::ADD, i, 1 });
+
+    EXPECT_EQ(table.size(), SIZE + 100000);
+    EXPECT_EQ(table.locate(SIZE + 99999).m_start + table.locate(SIZE + 99999).m_piece.m_length, SIZE + 100000);
+}
+} // namespace
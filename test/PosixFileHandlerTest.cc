@@ -0,0 +1,150 @@
+#include "ByteBuffer.h"
+#include "PosixFileHandler.h"
+#include <array>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace
+{
+namespace fs = std::filesystem;
+using namespace Hexit;
+
+class PosixFileHandlerTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        m_path = fs::temp_directory_path() / ("hexit_posix_test_" + std::to_string(::getpid()));
+        m_data.resize(64 * CHUNK_SIZE + 77);
+        for (std::uintmax_t i = 0; i < m_data.size(); ++i)
+            m_data[i] = static_cast<std::uint8_t>(i * 13 + i / 256);
+
+        std::ofstream file(m_path, std::ios::binary);
+        file.write(reinterpret_cast<const char*>(m_data.data()), static_cast<std::streamsize>(m_data.size()));
+    }
+
+    void TearDown() override { fs::remove(m_path); }
+
+    std::vector<std::uint8_t> file_contents() const
+    {
+        std::ifstream             file(m_path, std::ios::binary);
+        std::vector<std::uint8_t> contents(fs::file_size(m_path));
+        file.read(reinterpret_cast<char*>(contents.data()), static_cast<std::streamsize>(contents.size()));
+        return contents;
+    }
+
+    fs::path                  m_path;
+    std::vector<std::uint8_t> m_data;
+};
+
+TEST_F(PosixFileHandlerTest, ReadWrite)
+{
+    PosixFileHandler handler;
+    EXPECT_FALSE(handler.open(m_path.string() + "_does_not_exist"));
+    ASSERT_TRUE(handler.open(m_path));
+    EXPECT_EQ(handler.size(), m_data.size());
+    EXPECT_GT(handler.block_size(), 0u);
+
+    std::uint8_t buffer[32];
+    ASSERT_TRUE(handler.seek(1000));
+    ASSERT_TRUE(handler.read(buffer, sizeof(buffer)));
+    EXPECT_EQ(std::memcmp(buffer, m_data.data() + 1000, sizeof(buffer)), 0);
+    // Consecutive reads continue from where the previous one stopped.
+    ASSERT_TRUE(handler.read(buffer, sizeof(buffer)));
+    EXPECT_EQ(std::memcmp(buffer, m_data.data() + 1000 + sizeof(buffer), sizeof(buffer)), 0);
+    // The positional methods leave the offset alone.
+    ASSERT_TRUE(handler.read_at(0, buffer, sizeof(buffer)));
+    EXPECT_EQ(std::memcmp(buffer, m_data.data(), sizeof(buffer)), 0);
+    ASSERT_TRUE(handler.read(buffer, sizeof(buffer)));
+    EXPECT_EQ(std::memcmp(buffer, m_data.data() + 1000 + 2 * sizeof(buffer), sizeof(buffer)), 0);
+    // Reading past the end of the file fails.
+    EXPECT_FALSE(handler.read_at(m_data.size() - 1, buffer, 2));
+    EXPECT_FALSE(handler.seek(m_data.size()));
+
+    std::memset(buffer, 0xEF, sizeof(buffer));
+    ASSERT_TRUE(handler.write_at(500, buffer, sizeof(buffer)));
+    EXPECT_EQ(handler.statistics().m_writes, 1u);
+    EXPECT_EQ(handler.statistics().m_bytes_written, sizeof(buffer));
+    EXPECT_GE(handler.statistics().m_bytes_read, 4 * sizeof(buffer));
+    handler.close();
+    std::memset(m_data.data() + 500, 0xEF, sizeof(buffer));
+    EXPECT_EQ(file_contents(), m_data);
+}
+
+TEST_F(PosixFileHandlerTest, ReadOnly)
+{
+    PosixFileHandler handler(true);
+    ASSERT_TRUE(handler.open(m_path));
+    std::uint8_t buffer[8] = { 0 };
+    EXPECT_TRUE(handler.write_at(0, buffer, sizeof(buffer)));
+    handler.close();
+    EXPECT_EQ(file_contents(), m_data);
+}
+
+TEST_F(PosixFileHandlerTest, VectoredRead)
+{
+    PosixFileHandler handler;
+    ASSERT_TRUE(handler.open(m_path));
+    std::vector<std::vector<std::uint8_t>> chunks { std::vector<std::uint8_t>(CHUNK_SIZE),
+                                                    std::vector<std::uint8_t>(0),
+                                                    std::vector<std::uint8_t>(3),
+                                                    std::vector<std::uint8_t>(CHUNK_SIZE) };
+    std::vector<std::span<std::uint8_t>>   buffers(chunks.begin(), chunks.end());
+    ASSERT_TRUE(handler.read_vectored_at(10, buffers));
+
+    std::uintmax_t offset = 10;
+    for (const auto& chunk : chunks)
+    {
+        EXPECT_EQ(std::memcmp(chunk.data(), m_data.data() + offset, chunk.size()), 0);
+        offset += chunk.size();
+    }
+
+    EXPECT_FALSE(handler.read_vectored_at(m_data.size() - CHUNK_SIZE, buffers));
+}
+
+// Several threads should be able to read from the same handler at the same time.
+TEST_F(PosixFileHandlerTest, ConcurrentReads)
+{
+    PosixFileHandler handler;
+    ASSERT_TRUE(handler.open(m_path));
+    std::vector<std::thread> threads;
+    std::array<bool, 4>      results { false };
+    for (std::size_t t = 0; t < results.size(); ++t)
+    {
+        threads.emplace_back([&, t]()
+                             {
+                                 std::vector<std::uint8_t> buffer(CHUNK_SIZE);
+                                 bool                      ok = true;
+                                 for (std::uintmax_t round = 0; round < 200 && ok; ++round)
+                                 {
+                                     const std::uintmax_t offset = ((round * 7 + t * 13) % 64) * CHUNK_SIZE + t;
+                                     ok = handler.read_at(offset, buffer.data(), buffer.size())
+                                         && std::memcmp(buffer.data(), m_data.data() + offset, buffer.size()) == 0;
+                                 }
+                                 results[t] = ok; });
+    }
+    for (auto& thread : threads)
+        thread.join();
+
+    for (bool result : results)
+        EXPECT_TRUE(result);
+}
+
+// Prefetching on top of the handler should expose the same bytes as the file.
+TEST_F(PosixFileHandlerTest, PrefetchedByteBuffer)
+{
+    PosixFileHandler handler;
+    ASSERT_TRUE(handler.open(m_path));
+    ByteBuffer buffer(handler, { .m_slots = 4, .m_read_ahead = 8 });
+    for (std::uintmax_t i = 0; i < m_data.size(); ++i)
+        ASSERT_EQ(buffer[i], m_data[i]);
+    for (std::uintmax_t i = m_data.size(); i > 0; --i)
+        ASSERT_EQ(buffer[i - 1], m_data[i - 1]);
+    EXPECT_TRUE(buffer.is_ok());
+}
+} // namespace
@@ -0,0 +1,94 @@
+#include "ChunkCache.h"
+#include "IOHandlerMock.h"
+#include "Prefetcher.h"
+#include "ScanDetector.h"
+#include <gtest/gtest.h>
+
+namespace
+{
+using namespace Hexit;
+
+// Prefetching should only be triggered by consecutive sequential accesses.
+TEST(PrefetcherTest, ScanDetection)
+{
+    ScanDetector scan;
+    EXPECT_EQ(scan.observe(10), 0);
+    EXPECT_EQ(scan.observe(11), 0);
+    EXPECT_EQ(scan.observe(12), 1);
+    EXPECT_EQ(scan.observe(13), 1);
+    // Random access resets the scan.
+    EXPECT_EQ(scan.observe(20), 0);
+    EXPECT_EQ(scan.observe(19), 0);
+    EXPECT_EQ(scan.observe(18), -1);
+    EXPECT_EQ(scan.observe(17), -1);
+    // Changing direction resets the scan as well.
+    EXPECT_EQ(scan.observe(18), 0);
+    EXPECT_EQ(scan.observe(18), 0);
+    EXPECT_EQ(scan.observe(0), 0);
+}
+
+// Once a forward scan is detected, the chunks ahead of it should get loaded
+// in the background and served without accessing the handler again.
+TEST(PrefetcherTest, ForwardScan)
+{
+    constexpr std::uintmax_t depth = 4;
+    IOHandlerMock            handler;
+    ChunkCache               cache(handler, { .m_read_ahead = depth });
+    for (std::uintmax_t i = 0; i < 3; ++i)
+        ASSERT_TRUE(cache.load_chunk(i));
+    cache.wait_prefetch();
+    EXPECT_EQ(handler.load_count(), 3 + depth);
+
+    ASSERT_TRUE(cache.load_chunk(3));
+    auto& chunk = cache.recent();
+    EXPECT_EQ(chunk.m_id, 3);
+    EXPECT_EQ(chunk.m_count, CHUNK_SIZE);
+    EXPECT_EQ(std::memcmp(chunk.m_data, handler.data() + 3 * CHUNK_SIZE, chunk.m_count), 0);
+    // Only the chunk that was not prefetched yet should get loaded.
+    cache.wait_prefetch();
+    EXPECT_EQ(handler.load_count(), 4 + depth);
+}
+
+// Same as ForwardScan but in the opposite direction, the scan should stop at the first chunk.
+TEST(PrefetcherTest, BackwardScan)
+{
+    IOHandlerMock handler;
+    ChunkCache    cache(handler, { .m_read_ahead = 8 });
+    for (std::uintmax_t i = 5; i > 2; --i)
+        ASSERT_TRUE(cache.load_chunk(i));
+    cache.wait_prefetch();
+    // Only chunks 2, 1 and 0 lie ahead of the scan.
+    EXPECT_EQ(handler.load_count(), 6);
+    for (std::uintmax_t i = 3; i > 0; --i)
+    {
+        ASSERT_TRUE(cache.load_chunk(i - 1));
+        EXPECT_EQ(std::memcmp(cache.recent().m_data, handler.data() + (i - 1) * CHUNK_SIZE, CHUNK_SIZE), 0);
+    }
+    cache.wait_prefetch();
+    EXPECT_EQ(handler.load_count(), 6);
+}
+
+// Saving a chunk should drop its prefetched copy, since it is no longer up to date.
+TEST(PrefetcherTest, SaveDiscardsPrefetchedChunk)
+{
+    IOHandlerMock handler;
+    ChunkCache    cache(handler, { .m_read_ahead = 4 });
+    for (std::uintmax_t i = 0; i < 3; ++i)
+        ASSERT_TRUE(cache.load_chunk(i));
+    cache.wait_prefetch();
+    const auto loads = handler.load_count();
+
+    ChunkCache::DataChunk chunk;
+    chunk.m_storage.resize(CHUNK_SIZE);
+    chunk.m_data  = chunk.m_storage.data();
+    chunk.m_id    = 3;
+    chunk.m_count = CHUNK_SIZE;
+    std::memset(chunk.m_data, 0xEF, chunk.m_count);
+    ASSERT_TRUE(cache.save_chunk(chunk));
+    ASSERT_TRUE(cache.load_chunk(3));
+    EXPECT_EQ(std::memcmp(cache.recent().m_data, chunk.m_data, chunk.m_count), 0);
+    // Chunk 3 gets reloaded and the scan moves on to chunk 7.
+    cache.wait_prefetch();
+    EXPECT_EQ(handler.load_count(), loads + 2);
+}
+} // namespace
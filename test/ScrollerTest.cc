@@ -119,4 +119,27 @@ TEST(ScrollerTest, AutoScrolling)
         }
     }
 }
+
+// Inserting or erasing bytes changes the number of lines.
+TEST(ScrollerTest, SetTotal)
+{
+    constexpr std::uintmax_t BYTES_PER_LINE = 16u;
+    Scroller                 scroller(BYTES_PER_LINE * 10, BYTES_PER_LINE);
+    ASSERT_EQ(scroller.total(), 10u);
+
+    scroller.adjust_lines(4u, 9u);
+    EXPECT_EQ(scroller.last(), 9u);
+
+    scroller.set_total(BYTES_PER_LINE * 10 + 1);
+    scroller.adjust_lines(4u, 10u);
+    EXPECT_EQ(scroller.total(), 11u);
+    EXPECT_EQ(scroller.last(), 10u);
+    EXPECT_EQ(scroller.active(), 3u);
+
+    scroller.set_total(BYTES_PER_LINE * 2);
+    scroller.adjust_lines(4u, 1u);
+    EXPECT_EQ(scroller.total(), 2u);
+    EXPECT_EQ(scroller.visible(), 2u);
+    EXPECT_EQ(scroller.last(), 1u);
+}
 } // namespace
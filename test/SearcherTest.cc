@@ -0,0 +1,158 @@
+#include "Searcher.h"
+#include "MemoryReader.h"
+#include <algorithm>
+#include <gtest/gtest.h>
+#include <random>
+#include <vector>
+
+namespace
+{
+using namespace Hexit;
+
+class SearcherTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        // Few distinct bytes, so that the first and the last byte of a pattern match often on their own.
+        std::mt19937 rng(5);
+        m_data.resize(3 * SEARCH_BLOCK_SIZE + 1234);
+        for (auto& byte : m_data)
+            byte = static_cast<std::uint8_t>(rng() % 4);
+    }
+
+    void place(std::uintmax_t offset, const std::vector<std::uint8_t>& bytes)
+    {
+        std::copy(bytes.begin(), bytes.end(), m_data.begin() + static_cast<std::ptrdiff_t>(offset));
+    }
+
+    std::vector<std::uint8_t> m_data;
+};
+
+TEST_F(SearcherTest, Scan)
+{
+    const Searcher::Pattern pattern({ 0x10, 0x01, 0x02, 0x11 });
+    // Every position of a group of 16 and of the tail past the groups.
+    for (std::uintmax_t offset = 0; offset + pattern.size() <= 100; ++offset)
+    {
+        std::vector<std::uint8_t> data(m_data.begin(), m_data.begin() + 100);
+        std::copy(pattern.m_value.begin(), pattern.m_value.end(), data.begin() + static_cast<std::ptrdiff_t>(offset));
+        EXPECT_EQ(Searcher::scan(data.data(), data.size(), pattern, true), offset);
+        EXPECT_EQ(Searcher::scan(data.data(), data.size(), pattern, false), offset);
+    }
+
+    std::vector<std::uint8_t> data(100, 0x10);
+    EXPECT_EQ(Searcher::scan(data.data(), data.size(), pattern, true), data.size());
+    // Overlapping matches.
+    EXPECT_EQ(Searcher::scan(data.data(), data.size(), Searcher::Pattern({ 0x10, 0x10 }), true), 0u);
+    EXPECT_EQ(Searcher::scan(data.data(), data.size(), Searcher::Pattern({ 0x10, 0x10 }), false), 98u);
+    EXPECT_EQ(Searcher::scan(data.data(), data.size(), Searcher::Pattern({ 0x10 }), false), 99u);
+    EXPECT_EQ(Searcher::scan(data.data(), 0, Searcher::Pattern({ 0x10 }), true), 0u);
+    EXPECT_EQ(Searcher::scan(data.data(), data.size(), Searcher::Pattern(), true), data.size());
+}
+
+// Matches that straddle the border of two blocks, with one or several threads.
+TEST_F(SearcherTest, FindAcrossBlocks)
+{
+    const Searcher::Pattern pattern({ 0x20, 0x21, 0x22, 0x23, 0x24 });
+    const std::uintmax_t    first  = SEARCH_BLOCK_SIZE - 2;
+    const std::uintmax_t    second = 2 * SEARCH_BLOCK_SIZE + 100;
+    place(first, pattern.m_value);
+    place(second, pattern.m_value);
+    for (unsigned threads : { 1u, 4u })
+    {
+        Searcher       searcher(memory_reader(m_data), threads);
+        std::uintmax_t offset = 0;
+        ASSERT_TRUE(searcher.find(pattern, 0, m_data.size(), true, offset));
+        EXPECT_EQ(offset, first);
+        ASSERT_TRUE(searcher.find(pattern, first + 1, m_data.size(), true, offset));
+        EXPECT_EQ(offset, second);
+        ASSERT_TRUE(searcher.find(pattern, 0, m_data.size(), false, offset));
+        EXPECT_EQ(offset, second);
+        ASSERT_TRUE(searcher.find(pattern, 0, second + pattern.size() - 1, false, offset));
+        EXPECT_EQ(offset, first);
+        // The match has to lie within the range.
+        EXPECT_FALSE(searcher.find(pattern, first + 1, second + pattern.size() - 1, true, offset));
+        EXPECT_FALSE(searcher.find(pattern, 0, first + pattern.size() - 1, false, offset));
+        EXPECT_FALSE(searcher.failed());
+    }
+}
+
+TEST_F(SearcherTest, FindSingleByte)
+{
+    std::replace(m_data.begin(), m_data.end(), std::uint8_t { 3 }, std::uint8_t { 2 });
+    m_data[SEARCH_BLOCK_SIZE + 7]     = 0xFF;
+    m_data[2 * SEARCH_BLOCK_SIZE + 8] = 0xFF;
+    Searcher       searcher(memory_reader(m_data), 3);
+    std::uintmax_t offset = 0;
+    ASSERT_TRUE(searcher.find(Searcher::Pattern({ 0xFF }), 0, m_data.size(), true, offset));
+    EXPECT_EQ(offset, SEARCH_BLOCK_SIZE + 7);
+    ASSERT_TRUE(searcher.find(Searcher::Pattern({ 0xFF }), 0, m_data.size(), false, offset));
+    EXPECT_EQ(offset, 2 * SEARCH_BLOCK_SIZE + 8);
+    EXPECT_FALSE(searcher.find(Searcher::Pattern({ 0x03 }), 0, m_data.size(), true, offset));
+    EXPECT_FALSE(searcher.find(Searcher::Pattern(), 0, m_data.size(), true, offset));
+}
+
+TEST_F(SearcherTest, ParsePattern)
+{
+    Searcher::Pattern pattern;
+    ASSERT_TRUE(Searcher::Pattern::parse("DE AD ?? EF", pattern));
+    EXPECT_EQ(pattern.m_value, (std::vector<std::uint8_t> { 0xDE, 0xAD, 0x00, 0xEF }));
+    EXPECT_EQ(pattern.m_mask, (std::vector<std::uint8_t> { 0xFF, 0xFF, 0x00, 0xFF }));
+    ASSERT_TRUE(Searcher::Pattern::parse("4?00?f", pattern));
+    EXPECT_EQ(pattern.m_value, (std::vector<std::uint8_t> { 0x40, 0x00, 0x0F }));
+    EXPECT_EQ(pattern.m_mask, (std::vector<std::uint8_t> { 0xF0, 0xFF, 0x0F }));
+
+    for (const char* invalid : { "", " ", "D", "DE A", "D E", "0xDE", "GG", "DE*" })
+        EXPECT_FALSE(Searcher::Pattern::parse(invalid, pattern)) << invalid;
+    // A failed parse leaves the pattern alone.
+    EXPECT_EQ(pattern.size(), 3u);
+}
+
+// Wildcards anywhere in the pattern, including its ends, which still take up positions.
+TEST_F(SearcherTest, ScanMasked)
+{
+    std::vector<std::uint8_t> data(100, 0x00);
+    std::copy_n(std::vector<std::uint8_t> { 0x4A, 0x00, 0x3F, 0x99 }.begin(), 4, data.begin() + 40);
+    Searcher::Pattern pattern;
+    for (const char* str : { "4? 00 ?F", "4A ?? 3F", "?? 4A ?? 3?", "?A" })
+    {
+        ASSERT_TRUE(Searcher::Pattern::parse(str, pattern));
+        const std::uintmax_t expectation = str[0] == '?' && str[1] == '?' ? 39u : 40u;
+        EXPECT_EQ(Searcher::scan(data.data(), data.size(), pattern, true), expectation) << str;
+        EXPECT_EQ(Searcher::scan(data.data(), data.size(), pattern, false), expectation) << str;
+    }
+
+    ASSERT_TRUE(Searcher::Pattern::parse("?? ?? ??", pattern));
+    EXPECT_EQ(Searcher::scan(data.data(), data.size(), pattern, true), 0u);
+    EXPECT_EQ(Searcher::scan(data.data(), data.size(), pattern, false), 97u);
+    ASSERT_TRUE(Searcher::Pattern::parse("4? 01", pattern));
+    EXPECT_EQ(Searcher::scan(data.data(), data.size(), pattern, true), data.size());
+}
+
+TEST_F(SearcherTest, FindMasked)
+{
+    const std::uintmax_t offset = 2 * SEARCH_BLOCK_SIZE - 3;
+    place(offset, { 0xDE, 0xAD, 0x77, 0xEF, 0x45, 0x00, 0x3F });
+    Searcher          searcher(memory_reader(m_data), 4);
+    Searcher::Pattern pattern;
+    ASSERT_TRUE(Searcher::Pattern::parse("DE AD ?? EF 4? 00 ?F", pattern));
+    std::uintmax_t found = 0;
+    ASSERT_TRUE(searcher.find(pattern, 0, m_data.size(), true, found));
+    EXPECT_EQ(found, offset);
+    ASSERT_TRUE(searcher.find(pattern, 0, m_data.size(), false, found));
+    EXPECT_EQ(found, offset);
+    ASSERT_TRUE(Searcher::Pattern::parse("DE AD ?? EF 4? 01", pattern));
+    EXPECT_FALSE(searcher.find(pattern, 0, m_data.size(), true, found));
+}
+
+TEST_F(SearcherTest, ReaderFailure)
+{
+    Searcher       searcher([](std::uintmax_t, std::uint8_t*, std::uintmax_t)
+                            { return false; },
+                            2);
+    std::uintmax_t offset = 0;
+    EXPECT_FALSE(searcher.find(Searcher::Pattern({ 0x01 }), 0, m_data.size(), true, offset));
+    EXPECT_TRUE(searcher.failed());
+}
+} // namespace
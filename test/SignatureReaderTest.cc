@@ -51,4 +51,16 @@ TEST(SignatureReaderTest, SignatureMapping)
     EXPECT_EQ(reader.get_type({ 0xFF, 0xF2 }), std::string("mp3"));
     EXPECT_EQ(reader.get_type({ 0x42, 0x4D }), std::string("bmp"));
 }
+
+// A query shorter than a signature does not match it, the ones after it still get tried.
+TEST(SignatureReaderTest, ShortQuery)
+{
+    const std::uint8_t query[] = { 0xFF, 0xD8, 0xFF, 0xE1, 0x00, 0x00, 0x45, 0x78, 0x69, 0x66, 0x00, 0x00 };
+    EXPECT_EQ(SignatureReader::get_type(query, sizeof(query)), "jpg");
+    EXPECT_EQ(SignatureReader::get_type(query, 3), "unk");
+    EXPECT_EQ(SignatureReader::get_type(query, 2), "unk");
+    const std::uint8_t nes[] = { 0x4E, 0x45, 0x53, 0x00 };
+    EXPECT_EQ(SignatureReader::get_type(nes, sizeof(nes)), "nes");
+    EXPECT_EQ(SignatureReader::get_type(nes, 0), "unk");
+}
 } // namespace
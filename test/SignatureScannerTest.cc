@@ -0,0 +1,94 @@
+#include "SignatureScanner.h"
+#include "MemoryReader.h"
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+namespace
+{
+using namespace Hexit;
+
+class SignatureScannerTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        // Bytes that start none of the signatures.
+        m_data.assign(3 * SEARCH_BLOCK_SIZE + 123, 0x77);
+    }
+
+    void embed(std::uintmax_t offset, const std::vector<std::uint8_t>& bytes)
+    {
+        std::copy(bytes.begin(), bytes.end(), m_data.begin() + static_cast<std::ptrdiff_t>(offset));
+    }
+
+    std::vector<std::uint8_t> m_data;
+};
+
+TEST_F(SignatureScannerTest, FindsEmbeddedFiles)
+{
+    embed(100, { 0x89, 0x50, 0x4E, 0x47, 0x0D, 0x0A, 0x1A, 0x0A });
+    // The skipped bytes of a signature can be anything.
+    embed(5000, { 0x52, 0x49, 0x46, 0x46, 0x12, 0x34, 0x56, 0x78, 0x57, 0x41, 0x56, 0x45 });
+    embed(6000, { 0xFF, 0xD8, 0xFF, 0xE1, 0xAB, 0xCD, 0x45, 0x78, 0x69, 0x66, 0x00, 0x00 });
+    // Across the border of two blocks.
+    embed(SEARCH_BLOCK_SIZE - 2, { 0x50, 0x4B, 0x03, 0x04 });
+    // Both nes signatures match, the first one of them wins.
+    embed(2 * SEARCH_BLOCK_SIZE + 9, { 0x4E, 0x45, 0x53, 0x1A });
+    embed(m_data.size() - 2, { 0x1F, 0x8B });
+
+    SignatureScanner scanner(memory_reader(m_data), 3);
+    ASSERT_TRUE(scanner.scan(0, m_data.size()));
+    const std::vector<std::pair<std::uintmax_t, std::string>> expected = {
+        { 100, "png" },
+        { 5000, "wav" },
+        { 6000, "jpg" },
+        { SEARCH_BLOCK_SIZE - 2, "zip" },
+        { 2 * SEARCH_BLOCK_SIZE + 9, "nes" },
+        { m_data.size() - 2, "gz" },
+    };
+    ASSERT_EQ(scanner.hits().size(), expected.size());
+    for (std::uintmax_t i = 0; i < expected.size(); ++i)
+    {
+        EXPECT_EQ(scanner.hits()[i].m_offset, expected[i].first) << i;
+        EXPECT_EQ(scanner.type(scanner.hits()[i]), expected[i].second) << i;
+    }
+    EXPECT_EQ(SignatureReader::signatures()[scanner.hits()[4].m_signature].m_size, 4u);
+
+    EXPECT_EQ(scanner.lower_bound(0), 0u);
+    EXPECT_EQ(scanner.lower_bound(101), 1u);
+    EXPECT_EQ(scanner.lower_bound(SEARCH_BLOCK_SIZE - 2), 3u);
+    EXPECT_EQ(scanner.lower_bound(m_data.size()), expected.size());
+
+    // A range that cuts signatures off finds only the ones within it.
+    ASSERT_TRUE(scanner.scan(101, SEARCH_BLOCK_SIZE + 1));
+    ASSERT_EQ(scanner.hits().size(), 2u);
+    EXPECT_EQ(scanner.hits()[0].m_offset, 5000u);
+    EXPECT_EQ(scanner.hits()[1].m_offset, 6000u);
+}
+
+// Signatures that overlap each other, or whose start is the end of another one.
+TEST_F(SignatureScannerTest, Overlapping)
+{
+    embed(10, { 0xFF, 0xD8, 0xFF, 0xDB, 0x42, 0x4D, 0x4E, 0x45, 0x53, 0x49, 0x44, 0x33 });
+    SignatureScanner scanner(memory_reader(m_data), 1);
+    ASSERT_TRUE(scanner.scan(0, 64));
+    ASSERT_EQ(scanner.hits().size(), 4u);
+    const std::vector<std::uintmax_t> offsets = { 10, 14, 16, 19 };
+    const std::vector<std::string>    types   = { "jpg", "bmp", "nes", "mp3" };
+    for (std::uintmax_t i = 0; i < offsets.size(); ++i)
+    {
+        EXPECT_EQ(scanner.hits()[i].m_offset, offsets[i]) << i;
+        EXPECT_EQ(scanner.type(scanner.hits()[i]), types[i]) << i;
+    }
+}
+
+TEST_F(SignatureScannerTest, ReaderFailure)
+{
+    SignatureScanner scanner([](std::uintmax_t, std::uint8_t*, std::uintmax_t)
+                             { return false; },
+                             2);
+    EXPECT_FALSE(scanner.scan(0, m_data.size()));
+    EXPECT_TRUE(scanner.hits().empty());
+}
+} // namespace
@@ -0,0 +1,205 @@
+#include "ByteBuffer.h"
+#include "StdInHandler.h"
+#include <chrono>
+#include <gtest/gtest.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace
+{
+using namespace Hexit;
+
+class StdInHandlerTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        ASSERT_EQ(::pipe(m_pipe), 0);
+        m_data.resize(2 * STDIN_BLOCK_SIZE + 777);
+        for (std::uintmax_t i = 0; i < m_data.size(); ++i)
+            m_data[i] = static_cast<std::uint8_t>(i * 7 + i / 256);
+    }
+
+    void TearDown() override { close_input(); }
+
+    void write_input(std::uintmax_t offset, std::uintmax_t count)
+    {
+        while (count > 0)
+        {
+            const ssize_t written = ::write(m_pipe[1], m_data.data() + offset, count);
+            ASSERT_GT(written, 0);
+            offset += static_cast<std::uintmax_t>(written);
+            count -= static_cast<std::uintmax_t>(written);
+        }
+    }
+
+    void close_input()
+    {
+        if (m_pipe[1] >= 0)
+            ::close(m_pipe[1]);
+        m_pipe[1] = -1;
+    }
+
+    // Waits for the reader thread to receive the given number of bytes.
+    static void wait_for(const StdInHandler& handler, std::uintmax_t received)
+    {
+        for (int i = 0; i < 5000 && handler.received() < received; ++i)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    // Waits for the input to end.
+    static void wait_for_end(StdInHandler& handler)
+    {
+        for (int i = 0; i < 5000 && handler.is_streaming(); ++i)
+        {
+            handler.refresh();
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    int                       m_pipe[2] = { -1, -1 };
+    std::vector<std::uint8_t> m_data;
+};
+
+TEST_F(StdInHandlerTest, EmptyInput)
+{
+    StdInHandler handler(true);
+    close_input();
+    EXPECT_FALSE(handler.open_input(m_pipe[0], "stdin"));
+    EXPECT_EQ(handler.size(), 0u);
+}
+
+TEST_F(StdInHandlerTest, Streaming)
+{
+    StdInHandler handler(true);
+    write_input(0, 100);
+    ASSERT_TRUE(handler.open_input(m_pipe[0], "stdin"));
+    EXPECT_EQ(handler.size(), 100u);
+    EXPECT_TRUE(handler.is_streaming());
+
+    std::vector<std::uint8_t> read(m_data.size());
+    ASSERT_TRUE(handler.read_at(0, read.data(), 100));
+    EXPECT_TRUE(std::equal(read.begin(), read.begin() + 100, m_data.begin()));
+    EXPECT_FALSE(handler.read_at(50, read.data(), 51));
+
+    // The size only grows on refresh, across the border of the blocks.
+    std::thread writer([this]()
+                       { write_input(100, m_data.size() - 100); });
+    wait_for(handler, m_data.size());
+    writer.join();
+    EXPECT_EQ(handler.size(), 100u);
+    EXPECT_TRUE(handler.has_pending());
+    EXPECT_TRUE(handler.refresh());
+    EXPECT_FALSE(handler.has_pending());
+    EXPECT_FALSE(handler.refresh());
+    EXPECT_EQ(handler.size(), m_data.size());
+    ASSERT_TRUE(handler.read_at(0, read.data(), read.size()));
+    EXPECT_EQ(read, m_data);
+    ASSERT_TRUE(handler.read_at(STDIN_BLOCK_SIZE - 3, read.data(), 6));
+    EXPECT_TRUE(std::equal(read.begin(), read.begin() + 6, m_data.begin() + STDIN_BLOCK_SIZE - 3));
+
+    close_input();
+    for (int i = 0; i < 5000 && handler.is_streaming(); ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    EXPECT_FALSE(handler.is_streaming());
+    handler.close();
+    EXPECT_EQ(handler.size(), 0u);
+}
+
+TEST_F(StdInHandlerTest, Spill)
+{
+    // Only the first block stays in memory, the rest goes into the temporary file.
+    StdInHandler handler(true, 1);
+    write_input(0, 100);
+    ASSERT_TRUE(handler.open_input(m_pipe[0], "stdin"));
+    EXPECT_FALSE(handler.is_spilled());
+
+    std::thread writer([this]()
+                       { write_input(100, m_data.size() - 100); });
+    wait_for(handler, m_data.size());
+    writer.join();
+    ASSERT_TRUE(handler.refresh());
+    EXPECT_TRUE(handler.is_spilled());
+    EXPECT_EQ(handler.size(), m_data.size());
+
+    std::vector<std::uint8_t> read(m_data.size());
+    ASSERT_TRUE(handler.read_at(0, read.data(), read.size()));
+    EXPECT_EQ(read, m_data);
+    ASSERT_TRUE(handler.read_at(STDIN_BLOCK_SIZE - 3, read.data(), 6));
+    EXPECT_TRUE(std::equal(read.begin(), read.begin() + 6, m_data.begin() + STDIN_BLOCK_SIZE - 3));
+    ASSERT_TRUE(handler.read_at(STDIN_BLOCK_SIZE + 5, read.data(), 6));
+    EXPECT_TRUE(std::equal(read.begin(), read.begin() + 6, m_data.begin() + STDIN_BLOCK_SIZE + 5));
+    EXPECT_FALSE(handler.read_at(m_data.size() - 5, read.data(), 6));
+    handler.close();
+    EXPECT_FALSE(handler.is_spilled());
+}
+
+TEST_F(StdInHandlerTest, CloseWhileStreaming)
+{
+    StdInHandler handler(true);
+    write_input(0, 10);
+    ASSERT_TRUE(handler.open_input(m_pipe[0], "stdin"));
+    // The reader thread must not wait for the end of the input.
+    handler.close();
+    EXPECT_FALSE(handler.is_streaming());
+}
+
+// A read error ends the input like EOF does, but the handler tells it apart.
+TEST_F(StdInHandlerTest, ReadError)
+{
+    StdInHandler handler(true);
+    write_input(0, 100);
+    close_input();
+    ASSERT_TRUE(handler.open_input(m_pipe[0], "stdin"));
+    wait_for_end(handler);
+    EXPECT_FALSE(handler.is_incomplete());
+
+    // A socket whose peer closes with bytes left unread gets reset.
+    int sockets[2];
+    ASSERT_EQ(::socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sockets), 0);
+    ASSERT_EQ(::write(sockets[0], "x", 1), 1);
+    ASSERT_EQ(::write(sockets[1], m_data.data(), 100), 100);
+    StdInHandler reset(true);
+    ASSERT_TRUE(reset.open_input(sockets[0], "stdin"));
+    ::close(sockets[1]);
+    wait_for_end(reset);
+    EXPECT_TRUE(reset.is_incomplete());
+    EXPECT_EQ(reset.size(), 100u);
+}
+
+TEST_F(StdInHandlerTest, BufferGrows)
+{
+    StdInHandler handler;
+    write_input(0, 1000);
+    ASSERT_TRUE(handler.open_input(m_pipe[0], "stdin"));
+    ByteBuffer buffer(handler, { .m_chunk_size = 256, .m_slots = 4 });
+    EXPECT_TRUE(buffer.is_streaming());
+    EXPECT_EQ(buffer[999], m_data[999]);
+
+    write_input(1000, 1000);
+    wait_for(handler, 2000);
+    EXPECT_TRUE(buffer.has_pending());
+    ASSERT_TRUE(buffer.refresh());
+    EXPECT_FALSE(buffer.has_pending());
+    EXPECT_EQ(buffer.size(), 2000u);
+    EXPECT_EQ(buffer.cache().total_chunks(), 8u);
+    // The last chunk was only partly filled before the refresh.
+    EXPECT_EQ(buffer[999], m_data[999]);
+    EXPECT_EQ(buffer[1000], m_data[1000]);
+    EXPECT_FALSE(buffer.has_dirty());
+
+    // New bytes get appended after the edits.
+    ASSERT_TRUE(buffer.insert_byte(0, 0xAA));
+    write_input(2000, 500);
+    wait_for(handler, 2500);
+    ASSERT_TRUE(buffer.refresh());
+    EXPECT_EQ(buffer.size(), 2501u);
+    std::vector<std::uint8_t> read(buffer.size());
+    ASSERT_TRUE(buffer.read_range(0, read));
+    EXPECT_EQ(read[0], 0xAA);
+    EXPECT_TRUE(std::equal(read.begin() + 1, read.end(), m_data.begin()));
+    EXPECT_FALSE(buffer.is_dirty(2400));
+}
+} // namespace
@@ -0,0 +1,124 @@
+#include "ByteBuffer.h"
+#include "UringHandler.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <unistd.h>
+#include <vector>
+
+namespace
+{
+namespace fs = std::filesystem;
+using namespace Hexit;
+
+class UringHandlerTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        m_path = fs::temp_directory_path() / ("hexit_uring_test_" + std::to_string(::getpid()));
+        m_data.resize(64 * CHUNK_SIZE + 77);
+        for (std::uintmax_t i = 0; i < m_data.size(); ++i)
+            m_data[i] = static_cast<std::uint8_t>(i * 7 + i / 256);
+
+        std::ofstream file(m_path, std::ios::binary);
+        file.write(reinterpret_cast<const char*>(m_data.data()), static_cast<std::streamsize>(m_data.size()));
+    }
+
+    void TearDown() override { fs::remove(m_path); }
+
+    std::vector<std::uint8_t> file_contents() const
+    {
+        std::ifstream             file(m_path, std::ios::binary);
+        std::vector<std::uint8_t> contents(fs::file_size(m_path));
+        file.read(reinterpret_cast<char*>(contents.data()), static_cast<std::streamsize>(contents.size()));
+        return contents;
+    }
+
+    // Reads every chunk of the file with a single batch in a scrambled order, then overwrites every third one.
+    void check_batches(UringHandler& handler)
+    {
+        ASSERT_TRUE(handler.open(m_path));
+        const std::uintmax_t                   total = (m_data.size() + CHUNK_SIZE - 1) / CHUNK_SIZE;
+        std::vector<std::vector<std::uint8_t>> chunks(total, std::vector<std::uint8_t>(CHUNK_SIZE));
+        std::vector<IOHandler::Request>        requests;
+        for (std::uintmax_t i = 0; i < total; ++i)
+        {
+            const std::uintmax_t id = (i * 17) % total;
+            requests.push_back({ id * CHUNK_SIZE, chunks[id].data(), std::min(CHUNK_SIZE, m_data.size() - id * CHUNK_SIZE), false });
+        }
+        ASSERT_TRUE(handler.submit_batch(requests));
+        for (const auto& request : requests)
+            EXPECT_EQ(std::memcmp(request.m_data, m_data.data() + request.m_offset, request.m_size), 0);
+
+        std::vector<IOHandler::Request> writes;
+        for (auto& request : requests)
+        {
+            if ((request.m_offset / CHUNK_SIZE) % 3 == 0)
+            {
+                std::memset(request.m_data, 0xCD, request.m_size);
+                std::memset(m_data.data() + request.m_offset, 0xCD, request.m_size);
+                request.m_write = true;
+                writes.push_back(request);
+            }
+        }
+        ASSERT_TRUE(handler.submit_batch(writes));
+        handler.close();
+        EXPECT_EQ(file_contents(), m_data);
+    }
+
+    fs::path                  m_path;
+    std::vector<std::uint8_t> m_data;
+};
+
+TEST_F(UringHandlerTest, Batches)
+{
+    // A shallow queue makes the batches wrap around the ring several times.
+    UringHandler handler(false, 4);
+    check_batches(handler);
+}
+
+TEST_F(UringHandlerTest, Fallback)
+{
+    // The kernel refuses to set up a ring without entries.
+    UringHandler handler(false, 0);
+    EXPECT_FALSE(handler.uring_active());
+    check_batches(handler);
+}
+
+TEST_F(UringHandlerTest, BatchErrors)
+{
+    UringHandler handler(true);
+    ASSERT_TRUE(handler.open(m_path));
+    std::vector<std::uint8_t> buffer(2 * CHUNK_SIZE, 0);
+    // Writes are dropped silently by read only handlers.
+    EXPECT_TRUE(handler.submit_batch({ { 0, buffer.data(), CHUNK_SIZE, true },
+                                       { CHUNK_SIZE, buffer.data() + CHUNK_SIZE, CHUNK_SIZE, true } }));
+    EXPECT_EQ(file_contents(), m_data);
+    // Reading past the end of the file fails the whole batch.
+    EXPECT_FALSE(handler.submit_batch({ { 0, buffer.data(), CHUNK_SIZE, false },
+                                        { m_data.size() - 10, buffer.data() + CHUNK_SIZE, CHUNK_SIZE, false } }));
+}
+
+// Saving more dirty chunks than fit in the cache should write all of them.
+TEST_F(UringHandlerTest, SaveByteBuffer)
+{
+    UringHandler handler;
+    ASSERT_TRUE(handler.open(m_path));
+    {
+        ByteBuffer buffer(handler, { .m_slots = 4 });
+        for (std::uintmax_t i = 0; i < m_data.size(); i += CHUNK_SIZE / 2 + 3)
+        {
+            buffer.set_byte(i, static_cast<std::uint8_t>(~m_data[i]));
+            m_data[i] = static_cast<std::uint8_t>(~m_data[i]);
+        }
+        buffer.save();
+        EXPECT_TRUE(buffer.is_ok());
+        EXPECT_FALSE(buffer.has_dirty());
+    }
+    handler.close();
+    EXPECT_EQ(file_contents(), m_data);
+}
+} // namespace
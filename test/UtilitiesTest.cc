@@ -1,7 +1,11 @@
 #include "Utilities.h"
 #include <cstring>
 #include <filesystem>
+#include <fstream>
 #include <gtest/gtest.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
 
 namespace
 {
@@ -76,6 +80,14 @@ TEST(UtilitiesTest, StringChecks)
     EXPECT_FALSE(is_dec_string("0x0123456789aAbBcCdDeEfF"));
     EXPECT_FALSE(is_dec_string("0X0123456789aAbBcCdDeEfF"));
     EXPECT_FALSE(is_dec_string(""));
+
+    std::vector<std::uint8_t> bytes;
+    EXPECT_TRUE(hex_string_to_bytes("00fFa5", bytes));
+    EXPECT_EQ(bytes, (std::vector<std::uint8_t> { 0x00, 0xFF, 0xA5 }));
+    EXPECT_FALSE(hex_string_to_bytes("0x00", bytes));
+    EXPECT_FALSE(hex_string_to_bytes("abc", bytes));
+    EXPECT_FALSE(hex_string_to_bytes("zz", bytes));
+    EXPECT_FALSE(hex_string_to_bytes("", bytes));
 }
 
 TEST(UtilitiesTest, StrToInt)
@@ -89,6 +101,61 @@ TEST(UtilitiesTest, StrToInt)
     EXPECT_EQ(str_to_int(""), 0u);
 }
 
+TEST(UtilitiesTest, Sizes)
+{
+    EXPECT_TRUE(is_size_string("1024"));
+    EXPECT_TRUE(is_size_string("64k"));
+    EXPECT_TRUE(is_size_string("512M"));
+    EXPECT_TRUE(is_size_string("2G"));
+    EXPECT_FALSE(is_size_string("G"));
+    EXPECT_FALSE(is_size_string("0x100"));
+    EXPECT_FALSE(is_size_string("1T"));
+    EXPECT_FALSE(is_size_string(""));
+
+    EXPECT_EQ(str_to_size("1024"), 1024u);
+    EXPECT_EQ(str_to_size("64k"), 64u * 1024u);
+    EXPECT_EQ(str_to_size("512M"), 512u * 1024u * 1024u);
+    EXPECT_EQ(str_to_size("2G"), 2ull * 1024u * 1024u * 1024u);
+    EXPECT_EQ(str_to_size("abc"), 0u);
+    EXPECT_EQ(str_to_size(nullptr), 0u);
+
+    EXPECT_EQ(format_size(512u), "512B");
+    EXPECT_EQ(format_size(1536u), "1.5K");
+    EXPECT_EQ(format_size(256u * 1024u), "256K");
+    EXPECT_EQ(format_size(3u * 1024u * 1024u * 1024u), "3.0G");
+}
+
+TEST(UtilitiesTest, AlignChunkSize)
+{
+    EXPECT_EQ(align_chunk_size(0u, 4096u), 4096u);
+    EXPECT_EQ(align_chunk_size(1u, 4096u), 4096u);
+    EXPECT_EQ(align_chunk_size(4096u, 4096u), 4096u);
+    EXPECT_EQ(align_chunk_size(4097u, 4096u), 8192u);
+    EXPECT_EQ(align_chunk_size(1024u * 1024u, 4096u), 1024u * 1024u);
+    // An unknown page size leaves the chunk size unmodified.
+    EXPECT_EQ(align_chunk_size(1000u, 0u), 1000u);
+    EXPECT_GT(page_size(), 0u);
+}
+
+TEST(UtilitiesTest, CacheFiles)
+{
+    const fs::path directory = fs::temp_directory_path() / ("hexit_utilities_test_" + std::to_string(::getpid()));
+    const fs::path file      = cache_file(directory / "sub", "some/file", "ext");
+    EXPECT_EQ(file.parent_path(), directory / "sub");
+    EXPECT_EQ(file.extension(), ".ext");
+    EXPECT_EQ(file, cache_file(directory / "sub", "some/../some/./file", "ext"));
+    EXPECT_NE(file, cache_file(directory / "sub", "some/other", "ext"));
+
+    // The missing directories get created, an existing file replaced.
+    ASSERT_TRUE(write_file_atomically(file, "first"));
+    ASSERT_TRUE(write_file_atomically(file, "second"));
+    std::string contents;
+    std::getline(std::ifstream(file), contents);
+    EXPECT_EQ(contents, "second");
+    EXPECT_EQ(std::distance(fs::directory_iterator(file.parent_path()), fs::directory_iterator()), 1);
+    fs::remove_all(directory);
+}
+
 TEST(UtilitiesTest, GetArgFlags)
 {
     EXPECT_EQ(get_arg(0, nullptr, "--nothing"), nullptr);
@@ -218,6 +285,66 @@ TEST(UtilitiesTest, ValidateArgs)
         const char* argv[] = { "0xabcdef", "-f", current_path.c_str(), nullptr };
         EXPECT_FALSE(validate_args(3, argv));
     }
+    {
+        const char* argv[] = { "-c", nullptr };
+        EXPECT_FALSE(validate_args(1, argv));
+    }
+    {
+        const char* argv[] = { "--chunk-size", "0x10000", "-f", current_path.c_str(), nullptr };
+        EXPECT_TRUE(validate_args(4, argv));
+    }
+    {
+        const char* argv[] = { "-c", "4096", "-o", "1234", nullptr };
+        EXPECT_TRUE(validate_args(4, argv));
+    }
+    {
+        const char* argv[] = { "-c", "4096", "--chunk-size", "4096", nullptr };
+        EXPECT_FALSE(validate_args(4, argv));
+    }
+    {
+        const char* argv[] = { "-c", "four", nullptr };
+        EXPECT_FALSE(validate_args(2, argv));
+    }
+    {
+        const char* argv[] = { "-m", "-f", current_path.c_str(), nullptr };
+        EXPECT_TRUE(validate_args(3, argv));
+    }
+    {
+        const char* argv[] = { "--mmap", "-m", nullptr };
+        EXPECT_FALSE(validate_args(2, argv));
+    }
+    {
+        const char* argv[] = { "--stats", "-f", current_path.c_str(), nullptr };
+        EXPECT_TRUE(validate_args(3, argv));
+    }
+    {
+        const char* argv[] = { "--stats", "--stats", nullptr };
+        EXPECT_FALSE(validate_args(2, argv));
+    }
+    {
+        const char* argv[] = { "-a", "-f", current_path.c_str(), nullptr };
+        EXPECT_TRUE(validate_args(3, argv));
+    }
+    {
+        const char* argv[] = { "--atomic-save", "-a", nullptr };
+        EXPECT_FALSE(validate_args(2, argv));
+    }
+    {
+        const char* argv[] = { "--max-memory", "512M", "-f", current_path.c_str(), nullptr };
+        EXPECT_TRUE(validate_args(4, argv));
+    }
+    {
+        const char* argv[] = { "--max-memory", "lots", nullptr };
+        EXPECT_FALSE(validate_args(2, argv));
+    }
+    {
+        const char* argv[] = { "--magic", current_path.c_str(), "-f", current_path.c_str(), nullptr };
+        EXPECT_TRUE(validate_args(4, argv));
+    }
+    {
+        const char* argv[] = { "--magic", "this file does not exist", nullptr };
+        EXPECT_FALSE(validate_args(2, argv));
+    }
     {
         const char* argv[] = { "-d", "--some-random-flag", current_path.c_str(), nullptr };
         EXPECT_FALSE(validate_args(3, argv));